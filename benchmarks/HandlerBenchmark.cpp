@@ -0,0 +1,121 @@
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <folly/Benchmark.h>
+#include <folly/Conv.h>
+#include <folly/Portability.h>
+#include <folly/futures/Future.h>
+#include <folly/io/IOBuf.h>
+#include <gflags/gflags.h>
+#include <proxygen/lib/http/HTTPMessage.h>
+#include <proxygen/lib/http/HTTPMethod.h>
+
+#if FOLLY_HAS_COROUTINES
+#include <folly/experimental/coro/Task.h>
+#endif
+
+#include "src/HTTPRequest.h"
+#include "src/HTTPResponse.h"
+#include "src/Route.h"
+#include "src/RoutingContext.h"
+#include "test/AllocationCounter.h"
+
+using namespace std;
+using folly::Future;
+using nozomi::test::allocation_count;
+using proxygen::HTTPMessage;
+using proxygen::HTTPMethod;
+
+namespace nozomi {
+namespace benchmarks {
+
+/** Stands in for a call to another service that has already completed */
+Future<int64_t> lookup(int64_t id) {
+  return folly::makeFuture(id + 1);
+}
+
+Future<HTTPResponse> future_handler(const HTTPRequest&, int64_t id) {
+  return HTTPResponse::future(200, folly::to<string>(id));
+}
+
+Future<HTTPResponse> future_chain_handler(const HTTPRequest&, int64_t id) {
+  return lookup(id).then(&lookup).then(&lookup).then([](int64_t result) {
+    return HTTPResponse(200, folly::to<string>(result));
+  });
+}
+
+#if FOLLY_HAS_COROUTINES
+folly::coro::Task<HTTPResponse> coroutine_handler(const HTTPRequest&,
+                                                  int64_t id) {
+  co_return HTTPResponse(200, folly::to<string>(id));
+}
+
+folly::coro::Task<HTTPResponse> coroutine_chain_handler(const HTTPRequest&,
+                                                        int64_t id) {
+  auto result = co_await lookup(id);
+  result = co_await lookup(result);
+  result = co_await lookup(result);
+  co_return HTTPResponse(200, folly::to<string>(result));
+}
+#endif
+
+/**
+ * Matches a typed route, and then calls its handler and waits for the
+ * response the way that an Inline route is called. Reports the number of
+ * allocations for each request
+ */
+template <typename Handler>
+void dispatch(folly::UserCounters& counters, size_t iters, Handler handler) {
+  unique_ptr<BaseRoute> route;
+  unique_ptr<RoutingContext> context;
+  unique_ptr<HTTPRequest> request;
+  BENCHMARK_SUSPEND {
+    route = make_route("/items/{{i}}", {HTTPMethod::GET}, handler);
+    auto message = make_unique<HTTPMessage>();
+    message->setMethod(HTTPMethod::GET);
+    message->setURL("/items/12");
+    context = make_unique<RoutingContext>(message.get());
+    request = make_unique<HTTPRequest>(std::move(message),
+                                       folly::IOBuf::create(0));
+  }
+  auto before = allocation_count();
+  for (size_t i = 0; i < iters; ++i) {
+    auto match = route->handler(*context);
+    folly::doNotOptimizeAway(match.handler(*request).get());
+  }
+  BENCHMARK_SUSPEND {
+    auto after = allocation_count();
+    counters["allocations"] = static_cast<int64_t>((after - before) / iters);
+  }
+}
+
+BENCHMARK_COUNTERS(future, counters, iters) {
+  dispatch(counters, iters, &future_handler);
+}
+
+#if FOLLY_HAS_COROUTINES
+BENCHMARK_COUNTERS_RELATIVE(coroutine, counters, iters) {
+  dispatch(counters, iters, &coroutine_handler);
+}
+#endif
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK_COUNTERS(future_three_calls, counters, iters) {
+  dispatch(counters, iters, &future_chain_handler);
+}
+
+#if FOLLY_HAS_COROUTINES
+BENCHMARK_COUNTERS_RELATIVE(coroutine_three_calls, counters, iters) {
+  dispatch(counters, iters, &coroutine_chain_handler);
+}
+#endif
+}
+}
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <folly/Benchmark.h>
+#include <folly/Format.h>
+#include <folly/io/IOBuf.h>
+#include <folly/json.h>
+#include <gflags/gflags.h>
+#include <proxygen/lib/http/HTTPMessage.h>
+
+#include "src/HTTPRequest.h"
+#include "src/JsonBinding.h"
+
+using namespace std;
+using folly::IOBuf;
+using proxygen::HTTPMessage;
+
+namespace nozomi {
+namespace benchmarks {
+
+struct Event {
+  int64_t id = 0;
+  string name;
+  vector<string> tags;
+  double value = 0;
+};
+NOZOMI_JSON_FIELDS(Event, id, name, tags, value)
+
+// proxygen hands bodies over in pieces of about this size
+constexpr size_t kChunkSize = 16 * 1024;
+
+/**
+ * A json upload of about size bytes: an array of small event objects
+ *
+ * @param pretty - Whether each field goes on its own indented line, the
+ *                 way that pretty printers and hand-written files lay out
+ *                 json, instead of the whole array on one line
+ */
+string make_json(size_t size, bool pretty = false) {
+  auto format = pretty ? R"({{
+        "id": {},
+        "name": "event {}",
+        "tags": ["a", "b"],
+        "value": {}.5
+    }})"
+                       : R"({{"id":{},"name":"event {}","tags":["a","b"],)"
+                         R"("value":{}.5}})";
+  string json = "[";
+  for (size_t i = 0; json.size() < size; ++i) {
+    if (i > 0) {
+      json += ",";
+    }
+    if (pretty) {
+      json += "\n    ";
+    }
+    json += folly::sformat(format, i, i, i);
+  }
+  json += pretty ? "\n]" : "]";
+  return json;
+}
+
+/**
+ * Splits json into a chain of kChunkSize buffers, the way that a large
+ * body arrives, or into one buffer if chained is false
+ */
+unique_ptr<IOBuf> make_body(const string& json, bool chained) {
+  if (!chained) {
+    return IOBuf::copyBuffer(json);
+  }
+  auto body = IOBuf::create(0);
+  for (size_t offset = 0; offset < json.size(); offset += kChunkSize) {
+    body->prependChain(IOBuf::copyBuffer(
+        json.data() + offset, min(kChunkSize, json.size() - offset)));
+  }
+  return body;
+}
+
+/**
+ * Parses the body of a new request for each iteration, so that
+ * coalescing the body is part of what is measured
+ */
+template <typename Parse>
+void parse_body(size_t iters,
+                size_t size,
+                bool chained,
+                Parse parse,
+                bool pretty = false) {
+  unique_ptr<IOBuf> body;
+  BENCHMARK_SUSPEND { body = make_body(make_json(size, pretty), chained); }
+  for (size_t i = 0; i < iters; ++i) {
+    unique_ptr<HTTPRequest> request;
+    BENCHMARK_SUSPEND {
+      request = make_unique<HTTPRequest>(make_unique<HTTPMessage>(),
+                                         body->clone());
+    }
+    folly::doNotOptimizeAway(parse(*request));
+    BENCHMARK_SUSPEND { request.reset(); }
+  }
+}
+
+/**
+ * How bodies were parsed before they were viewed in place: copied into a
+ * string, and then parsed
+ */
+void copied_parse(size_t iters, size_t size, bool chained) {
+  parse_body(iters, size, chained, [](const HTTPRequest& request) {
+    return folly::parseJson(request.getBodyAsString());
+  });
+}
+
+void in_place_parse(size_t iters, size_t size, bool chained) {
+  parse_body(iters, size, chained, [](const HTTPRequest& request) {
+    return request.getBodyAsJson();
+  });
+}
+
+/**
+ * How getBodyAsJson() parsed the body before it used JsonReader: viewed in
+ * place, and then parsed with folly's parser
+ */
+void folly_parse(size_t iters, size_t size, bool pretty) {
+  parse_body(iters, size, false,
+             [](const HTTPRequest& request) {
+               return folly::parseJson(request.getBodyAsStringPiece());
+             },
+             pretty);
+}
+
+void reader_parse(size_t iters, size_t size, bool pretty) {
+  parse_body(iters, size, false,
+             [](const HTTPRequest& request) {
+               return request.getBodyAsJson();
+             },
+             pretty);
+}
+
+/**
+ * How handlers read typed bodies before they were bound to structs: parsed
+ * into a folly::dynamic, and then copied out of it field by field
+ */
+void dynamic_events(size_t iters, size_t size) {
+  parse_body(iters, size, false, [](const HTTPRequest& request) {
+    auto json = request.getBodyAsJson();
+    vector<Event> events;
+    events.reserve(json.size());
+    for (const auto& item : json) {
+      Event event;
+      event.id = item["id"].asInt();
+      event.name = item["name"].asString();
+      for (const auto& tag : item["tags"]) {
+        event.tags.push_back(tag.asString());
+      }
+      event.value = item["value"].asDouble();
+      events.push_back(std::move(event));
+    }
+    return events;
+  });
+}
+
+void typed_events(size_t iters, size_t size) {
+  parse_body(iters, size, false, [](const HTTPRequest& request) {
+    return from_json<vector<Event>>(request.getBodyAsStringPiece());
+  });
+}
+
+BENCHMARK_NAMED_PARAM(copied_parse, 1mb_chained, 1024 * 1024, true)
+BENCHMARK_RELATIVE_NAMED_PARAM(in_place_parse, 1mb_chained, 1024 * 1024, true)
+BENCHMARK_NAMED_PARAM(copied_parse, 1mb_contiguous, 1024 * 1024, false)
+BENCHMARK_RELATIVE_NAMED_PARAM(in_place_parse,
+                               1mb_contiguous,
+                               1024 * 1024,
+                               false)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM(copied_parse, 5mb_chained, 5 * 1024 * 1024, true)
+BENCHMARK_RELATIVE_NAMED_PARAM(in_place_parse,
+                               5mb_chained,
+                               5 * 1024 * 1024,
+                               true)
+BENCHMARK_NAMED_PARAM(copied_parse, 5mb_contiguous, 5 * 1024 * 1024, false)
+BENCHMARK_RELATIVE_NAMED_PARAM(in_place_parse,
+                               5mb_contiguous,
+                               5 * 1024 * 1024,
+                               false)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM(folly_parse, 1mb_compact, 1024 * 1024, false)
+BENCHMARK_RELATIVE_NAMED_PARAM(reader_parse, 1mb_compact, 1024 * 1024, false)
+BENCHMARK_NAMED_PARAM(folly_parse, 1mb_pretty, 1024 * 1024, true)
+BENCHMARK_RELATIVE_NAMED_PARAM(reader_parse, 1mb_pretty, 1024 * 1024, true)
+BENCHMARK_NAMED_PARAM(folly_parse, 5mb_pretty, 5 * 1024 * 1024, true)
+BENCHMARK_RELATIVE_NAMED_PARAM(reader_parse,
+                               5mb_pretty,
+                               5 * 1024 * 1024,
+                               true)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM(dynamic_events, 1mb, 1024 * 1024)
+BENCHMARK_RELATIVE_NAMED_PARAM(typed_events, 1mb, 1024 * 1024)
+BENCHMARK_NAMED_PARAM(dynamic_events, 5mb, 5 * 1024 * 1024)
+BENCHMARK_RELATIVE_NAMED_PARAM(typed_events, 5mb, 5 * 1024 * 1024)
+}
+}
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  folly::runBenchmarks();
+  return 0;
+}
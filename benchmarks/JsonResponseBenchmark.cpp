@@ -0,0 +1,82 @@
+#include <memory>
+#include <string>
+
+#include <folly/Benchmark.h>
+#include <folly/Format.h>
+#include <folly/dynamic.h>
+#include <folly/io/IOBuf.h>
+#include <folly/json.h>
+#include <gflags/gflags.h>
+
+#include "src/HTTPResponse.h"
+
+using namespace std;
+using folly::IOBuf;
+using folly::dynamic;
+
+namespace nozomi {
+namespace benchmarks {
+
+/**
+ * A list endpoint's response of about size bytes: an array of records with
+ * a few numbers, and strings that sometimes need escaping
+ */
+dynamic make_list(size_t size) {
+  dynamic items = dynamic::array();
+  size_t approximateSize = 0;
+  for (int64_t i = 0; approximateSize < size; ++i) {
+    dynamic item = dynamic::object("id", i)("score", i * 0.75)(
+        "title", folly::sformat("Item {} \"featured\"", i))(
+        "description", "A longer description of the item,\nover two lines")(
+        "tags", dynamic::array("sale", "new"))("active", i % 2 == 0);
+    items.push_back(std::move(item));
+    // Each item is about this long once serialized
+    approximateSize += 150;
+  }
+  return items;
+}
+
+/**
+ * How dynamic responses were written before they were serialized into
+ * blocks: into a string, and then copied into an IOBuf
+ */
+unique_ptr<IOBuf> copied_body(const dynamic& body) {
+  auto str = folly::toJson(body);
+  return IOBuf::copyBuffer(str.data(), str.size());
+}
+
+void copied_response(size_t iters, size_t size) {
+  dynamic list;
+  BENCHMARK_SUSPEND { list = make_list(size); }
+  for (size_t i = 0; i < iters; ++i) {
+    HTTPResponse response(200, copied_body(list),
+                          {{"Content-Type", "application/json"}});
+    folly::doNotOptimizeAway(response);
+  }
+}
+
+void direct_response(size_t iters, size_t size) {
+  dynamic list;
+  BENCHMARK_SUSPEND { list = make_list(size); }
+  for (size_t i = 0; i < iters; ++i) {
+    HTTPResponse response(200, list, {{"Content-Type", "application/json"}});
+    folly::doNotOptimizeAway(response);
+  }
+}
+
+BENCHMARK_NAMED_PARAM(copied_response, 1kb, 1024)
+BENCHMARK_RELATIVE_NAMED_PARAM(direct_response, 1kb, 1024)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM(copied_response, 200kb, 200 * 1024)
+BENCHMARK_RELATIVE_NAMED_PARAM(direct_response, 200kb, 200 * 1024)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM(copied_response, 2mb, 2 * 1024 * 1024)
+BENCHMARK_RELATIVE_NAMED_PARAM(direct_response, 2mb, 2 * 1024 * 1024)
+}
+}
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  folly::runBenchmarks();
+  return 0;
+}
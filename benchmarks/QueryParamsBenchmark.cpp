@@ -0,0 +1,139 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <folly/Benchmark.h>
+#include <folly/Optional.h>
+#include <folly/String.h>
+#include <folly/io/IOBuf.h>
+#include <gflags/gflags.h>
+#include <proxygen/lib/http/HTTPMessage.h>
+
+#include "src/HTTPRequest.h"
+
+using namespace std;
+using proxygen::HTTPMessage;
+
+namespace nozomi {
+namespace benchmarks {
+
+/**
+ * An analytics beacon with 40 parameters, several of them url encoded, as
+ * sent by a page view tracker
+ */
+const string kBeaconUrl =
+    "/collect?v=1&_v=j68&a=1238271390&t=pageview&_s=1&"
+    "dl=https%3A%2F%2Fexample.com%2Fproducts%2Fshoes%3Fcolor%3Dred&"
+    "ul=en-us&de=UTF-8&dt=Red%20Running%20Shoes%20%7C%20Example&sd=24-bit&"
+    "sr=1920x1080&vp=1903x969&je=0&_u=QACAAEAB~&jid=1534519261&gjid=82392&"
+    "cid=1049373571.1529935402&tid=UA-1234567-1&_gid=1793629182.1530110402&"
+    "gtm=2wg6k0&cd1=logged%20out&cd2=desktop&cd3=spring+sale&cd4=control&"
+    "cm1=3&cm2=129.99&pa=detail&pr1id=SKU-12345&pr1nm=Red+Shoes&pr1ca=shoes&"
+    "pr1br=Example&pr1va=red&pr1pr=129.99&pr1qt=1&cu=USD&ni=0&"
+    "el=hero%20banner&ec=ecommerce&ea=view&ev=0&z=1403859340";
+
+/** The parameters that a handler reads from each beacon */
+const vector<string> kParams = {"t",   "dl",  "dt",    "cid", "tid",
+                                "cd3", "pa",  "pr1id", "cu",  "missing"};
+
+/**
+ * How query parameters were looked up before they were indexed: proxygen's
+ * map of raw parameters, and then every raw name decoded in turn
+ */
+folly::Optional<string> unindexed_lookup(const HTTPMessage& request,
+                                         const string& param) {
+  if (request.hasQueryParam(param)) {
+    return request.getDecodedQueryParam(param);
+  }
+  for (const auto& kvp : request.getQueryParams()) {
+    try {
+      auto decodedParam = folly::uriUnescape<std::string>(
+          kvp.first, folly::UriEscapeMode::QUERY);
+      if (decodedParam == param) {
+        return folly::uriUnescape<std::string>(kvp.second,
+                                               folly::UriEscapeMode::QUERY);
+      }
+    } catch (const std::exception& e) {
+      continue;
+    }
+  }
+  return folly::Optional<string>();
+}
+
+unique_ptr<HTTPRequest> make_beacon_request() {
+  auto message = make_unique<HTTPMessage>();
+  message->setURL(kBeaconUrl);
+  return make_unique<HTTPRequest>(std::move(message), folly::IOBuf::create(0));
+}
+
+/**
+ * Reads every parameter in kParams from a new request, so that indexing
+ * the query string is part of what is measured
+ */
+template <typename Lookup>
+void read_params(size_t iters, Lookup lookup) {
+  for (size_t i = 0; i < iters; ++i) {
+    unique_ptr<HTTPRequest> request;
+    BENCHMARK_SUSPEND { request = make_beacon_request(); }
+    for (const auto& param : kParams) {
+      folly::doNotOptimizeAway(lookup(*request, param));
+    }
+    BENCHMARK_SUSPEND { request.reset(); }
+  }
+}
+
+BENCHMARK(unindexed_ten_params, iters) {
+  read_params(iters, [](const HTTPRequest& request, const string& param) {
+    return unindexed_lookup(request.getRawRequest(), param);
+  });
+}
+
+BENCHMARK_RELATIVE(indexed_ten_params, iters) {
+  read_params(iters, [](const HTTPRequest& request, const string& param) {
+    return request.getQueryParams()[param];
+  });
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(unindexed_every_param, iters) {
+  vector<string> names;
+  BENCHMARK_SUSPEND {
+    auto request = make_beacon_request();
+    for (const auto& param : request->getQueryParams()) {
+      names.push_back(param.name.str());
+    }
+  }
+  read_params(iters, [&names](const HTTPRequest& request, const string&) {
+    size_t found = 0;
+    for (const auto& name : names) {
+      found += unindexed_lookup(request.getRawRequest(), name).hasValue();
+    }
+    return found;
+  });
+}
+
+BENCHMARK_RELATIVE(indexed_every_param, iters) {
+  vector<string> names;
+  BENCHMARK_SUSPEND {
+    auto request = make_beacon_request();
+    for (const auto& param : request->getQueryParams()) {
+      names.push_back(param.name.str());
+    }
+  }
+  read_params(iters, [&names](const HTTPRequest& request, const string&) {
+    size_t found = 0;
+    for (const auto& name : names) {
+      found += request.getQueryParams()[name].hasValue();
+    }
+    return found;
+  });
+}
+}
+}
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,162 @@
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <boost/regex.hpp>
+#include <folly/Benchmark.h>
+#include <folly/Conv.h>
+#include <folly/Format.h>
+#include <folly/io/IOBuf.h>
+#include <gflags/gflags.h>
+#include <proxygen/lib/http/HTTPMessage.h>
+#include <proxygen/lib/http/HTTPMethod.h>
+
+#include "src/HTTPRequest.h"
+#include "src/HTTPResponse.h"
+#include "src/Route.h"
+#include "src/RouteParsing.h"
+#include "src/RoutingContext.h"
+
+using namespace std;
+using folly::Future;
+using proxygen::HTTPMessage;
+using proxygen::HTTPMethod;
+
+namespace nozomi {
+namespace benchmarks {
+
+using route_parsing::RoutePattern;
+
+template <size_t>
+using Int64Arg = int64_t;
+
+template <size_t... N>
+Future<HTTPResponse> int_handler(const HTTPRequest&, Int64Arg<N>...) {
+  return HTTPResponse::future(200);
+}
+
+/**
+ * A pattern with args {{i}} parameters in one segment, which has to be
+ * matched with a regular expression, and a path that matches it
+ */
+pair<string, string> int_pattern_and_path(size_t args) {
+  string pattern = "/args";
+  string path = "/args";
+  for (size_t i = 0; i < args; ++i) {
+    pattern += "-{{i}}";
+    path += folly::sformat("-{}", i);
+  }
+  return make_pair(pattern, path);
+}
+
+/**
+ * How typed arguments were extracted before group indexes were resolved
+ * when routes were created
+ */
+void named_extraction(size_t iters, size_t args) {
+  RoutePattern pattern;
+  string path;
+  boost::smatch matches;
+  BENCHMARK_SUSPEND {
+    auto patternAndPath = int_pattern_and_path(args);
+    pattern = route_parsing::parse_route_pattern(patternAndPath.first);
+    path = std::move(patternAndPath.second);
+    boost::regex_match(path, matches, pattern.regex.value());
+  }
+  for (size_t i = 0; i < iters; ++i) {
+    for (size_t n = 0; n < args; ++n) {
+      folly::doNotOptimizeAway(
+          folly::to<int64_t>(matches[folly::sformat("__{}", n)].str()));
+    }
+  }
+}
+
+void positional_extraction(size_t iters, size_t args) {
+  RoutePattern pattern;
+  string path;
+  boost::smatch matches;
+  BENCHMARK_SUSPEND {
+    auto patternAndPath = int_pattern_and_path(args);
+    pattern = route_parsing::parse_route_pattern(patternAndPath.first);
+    path = std::move(patternAndPath.second);
+    boost::regex_match(path, matches, pattern.regex.value());
+  }
+  for (size_t i = 0; i < iters; ++i) {
+    for (size_t n = 0; n < args; ++n) {
+      folly::doNotOptimizeAway(route_parsing::get_handler_arg<int64_t>(
+          matches[pattern.groups[n]]));
+    }
+  }
+}
+
+/**
+ * Converts the arguments from a regex match, and calls the handler
+ */
+template <size_t... N>
+void dispatch_handler(size_t iters, index_sequence<N...>) {
+  unique_ptr<BaseRoute> route;
+  unique_ptr<RoutingContext> context;
+  unique_ptr<HTTPRequest> request;
+  boost::smatch matches;
+  BENCHMARK_SUSPEND {
+    auto patternAndPath = int_pattern_and_path(sizeof...(N));
+    route = make_route(patternAndPath.first, {HTTPMethod::GET},
+                       &int_handler<N...>);
+    auto message = make_unique<HTTPMessage>();
+    message->setMethod(HTTPMethod::GET);
+    message->setURL(patternAndPath.second);
+    context = make_unique<RoutingContext>(message.get());
+    request = make_unique<HTTPRequest>(std::move(message),
+                                       folly::IOBuf::create(0));
+    boost::regex_match(context->getPath(), matches, *route->getRegex());
+  }
+  for (size_t i = 0; i < iters; ++i) {
+    auto match = route->handlerFromMatch(*context, matches, 0);
+    folly::doNotOptimizeAway(match.handler(*request));
+  }
+}
+
+/**
+ * Parsing a route's pattern, which happens once per route when the router
+ * is created
+ */
+void parse_pattern(size_t iters, const string& pattern) {
+  for (size_t i = 0; i < iters; ++i) {
+    folly::doNotOptimizeAway(route_parsing::parse_route_pattern(pattern));
+  }
+}
+
+BENCHMARK_NAMED_PARAM(parse_pattern, static, "/resource/1/name")
+BENCHMARK_NAMED_PARAM(parse_pattern, typed, "/resource/{{i}}/{{s:[^/]+}}")
+BENCHMARK_NAMED_PARAM(parse_pattern, regex, "/resource/{{i}}/{{s:.+}}")
+BENCHMARK_NAMED_PARAM(parse_pattern,
+                      heavy_regex,
+                      R"(/(a|b)/{{i}}/(x)?{{d?:/}}{{s:(\w)\w+}}/[0-9a-f]{8})")
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM(named_extraction, 1_arg, 1)
+BENCHMARK_RELATIVE_NAMED_PARAM(positional_extraction, 1_arg, 1)
+BENCHMARK_NAMED_PARAM(named_extraction, 2_args, 2)
+BENCHMARK_RELATIVE_NAMED_PARAM(positional_extraction, 2_args, 2)
+BENCHMARK_NAMED_PARAM(named_extraction, 3_args, 3)
+BENCHMARK_RELATIVE_NAMED_PARAM(positional_extraction, 3_args, 3)
+BENCHMARK_NAMED_PARAM(named_extraction, 4_args, 4)
+BENCHMARK_RELATIVE_NAMED_PARAM(positional_extraction, 4_args, 4)
+BENCHMARK_NAMED_PARAM(named_extraction, 5_args, 5)
+BENCHMARK_RELATIVE_NAMED_PARAM(positional_extraction, 5_args, 5)
+BENCHMARK_NAMED_PARAM(named_extraction, 6_args, 6)
+BENCHMARK_RELATIVE_NAMED_PARAM(positional_extraction, 6_args, 6)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM(dispatch_handler, 1_arg, make_index_sequence<1>{})
+BENCHMARK_NAMED_PARAM(dispatch_handler, 2_args, make_index_sequence<2>{})
+BENCHMARK_NAMED_PARAM(dispatch_handler, 3_args, make_index_sequence<3>{})
+BENCHMARK_NAMED_PARAM(dispatch_handler, 4_args, make_index_sequence<4>{})
+BENCHMARK_NAMED_PARAM(dispatch_handler, 5_args, make_index_sequence<5>{})
+BENCHMARK_NAMED_PARAM(dispatch_handler, 6_args, make_index_sequence<6>{})
+}
+}
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,238 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <folly/Benchmark.h>
+#include <folly/Format.h>
+#include <folly/Optional.h>
+#include <gflags/gflags.h>
+#include <proxygen/lib/http/HTTPMessage.h>
+#include <proxygen/lib/http/HTTPMethod.h>
+
+#include "src/HTTPRequest.h"
+#include "src/HTTPResponse.h"
+#include "src/Route.h"
+#include "src/Router.h"
+#include "src/RoutingContext.h"
+#include "src/StaticRoute.h"
+
+using namespace std;
+using folly::Optional;
+using proxygen::HTTPMessage;
+using proxygen::HTTPMethod;
+
+namespace nozomi {
+namespace benchmarks {
+
+/**
+ * The kinds of route tables that are benchmarked. Each is looked up
+ * differently by the Router
+ */
+enum class RouteShape {
+  // Routes without parameters, found with a hash lookup
+  Static,
+  // Routes with typed parameters in their own segments, found in a RouteTrie
+  Typed,
+  // Routes that can only be matched with a regular expression. {{s:.+}} can
+  // span segments, so it can't be matched by a RouteTrie
+  Regex,
+};
+
+/**
+ * Creates the route for index i of a table of the given shape
+ */
+unique_ptr<BaseRoute> make_shaped_route(RouteShape shape, size_t i) {
+  switch (shape) {
+    case RouteShape::Static:
+      return make_static_route(folly::sformat("/resource{}/1/name", i),
+                               {HTTPMethod::GET}, [](const HTTPRequest&) {
+                                 return HTTPResponse::future(200);
+                               });
+    case RouteShape::Typed:
+      return make_route(
+          folly::sformat("/resource{}", i) + "/{{i}}/{{s:[^/]+}}",
+          {HTTPMethod::GET}, [](const HTTPRequest&, int64_t, string) {
+            return HTTPResponse::future(200);
+          });
+    case RouteShape::Regex:
+      return make_route(
+          folly::sformat("/resource{}", i) + "/{{i}}/{{s:.+}}",
+          {HTTPMethod::GET}, [](const HTTPRequest&, int64_t, string) {
+            return HTTPResponse::future(200);
+          });
+  }
+  return nullptr;
+}
+
+vector<unique_ptr<BaseRoute>> make_routes(RouteShape shape,
+                                          size_t routeCount) {
+  vector<unique_ptr<BaseRoute>> routes;
+  routes.reserve(routeCount);
+  for (size_t i = 0; i < routeCount; ++i) {
+    routes.push_back(make_shaped_route(shape, i));
+  }
+  return routes;
+}
+
+/**
+ * Creates routeCount routes that cycle through every shape
+ */
+vector<unique_ptr<BaseRoute>> make_mixed_routes(size_t routeCount) {
+  vector<unique_ptr<BaseRoute>> routes;
+  routes.reserve(routeCount);
+  for (size_t i = 0; i < routeCount; ++i) {
+    routes.push_back(make_shaped_route(static_cast<RouteShape>(i % 3), i));
+  }
+  return routes;
+}
+
+void match_path(size_t iters,
+                RouteShape shape,
+                size_t routeCount,
+                bool combined,
+                bool cached,
+                const string& path) {
+  Optional<Router> router;
+  unique_ptr<RoutingContext> context;
+  BENCHMARK_SUSPEND {
+    router = Router({}, make_routes(shape, routeCount));
+    if (combined) {
+      router->combineRegexRoutes();
+    }
+    if (cached) {
+      router->enableMatchCache(1024);
+    }
+    HTTPMessage message;
+    message.setMethod(HTTPMethod::GET);
+    message.setURL(path);
+    context = make_unique<RoutingContext>(&message);
+  }
+  for (size_t i = 0; i < iters; ++i) {
+    folly::doNotOptimizeAway(router->getHandler(*context).result);
+  }
+}
+
+/**
+ * A path that only the last route in a table matches
+ */
+string last_route_path(size_t routeCount) {
+  return folly::sformat("/resource{}/1/name", routeCount - 1);
+}
+
+const string kMissingPath = "/missing/1/name";
+
+void static_last_route(size_t iters, size_t routeCount) {
+  match_path(iters, RouteShape::Static, routeCount, false, false,
+             last_route_path(routeCount));
+}
+
+void typed_last_route(size_t iters, size_t routeCount) {
+  match_path(iters, RouteShape::Typed, routeCount, false, false,
+             last_route_path(routeCount));
+}
+
+void per_route_last_route(size_t iters, size_t routeCount) {
+  match_path(iters, RouteShape::Regex, routeCount, false, false,
+             last_route_path(routeCount));
+}
+
+void combined_last_route(size_t iters, size_t routeCount) {
+  match_path(iters, RouteShape::Regex, routeCount, true, false,
+             last_route_path(routeCount));
+}
+
+void cached_last_route(size_t iters, size_t routeCount) {
+  match_path(iters, RouteShape::Regex, routeCount, false, true,
+             last_route_path(routeCount));
+}
+
+void static_no_route(size_t iters, size_t routeCount) {
+  match_path(iters, RouteShape::Static, routeCount, false, false,
+             kMissingPath);
+}
+
+void typed_no_route(size_t iters, size_t routeCount) {
+  match_path(iters, RouteShape::Typed, routeCount, false, false,
+             kMissingPath);
+}
+
+void per_route_no_route(size_t iters, size_t routeCount) {
+  match_path(iters, RouteShape::Regex, routeCount, false, false,
+             kMissingPath);
+}
+
+void combined_no_route(size_t iters, size_t routeCount) {
+  match_path(iters, RouteShape::Regex, routeCount, true, false,
+             kMissingPath);
+}
+
+/**
+ * Creating routes, which parses their patterns
+ */
+void create_routes(size_t iters, size_t routeCount) {
+  for (size_t i = 0; i < iters; ++i) {
+    folly::doNotOptimizeAway(make_mixed_routes(routeCount));
+  }
+}
+
+/**
+ * Building a router from routes that were already created
+ */
+void construct_router(size_t iters, size_t routeCount) {
+  for (size_t i = 0; i < iters; ++i) {
+    vector<unique_ptr<BaseRoute>> routes;
+    BENCHMARK_SUSPEND { routes = make_mixed_routes(routeCount); }
+    Router router({}, std::move(routes));
+    folly::doNotOptimizeAway(router);
+    // Don't time tearing down the routes
+    BENCHMARK_SUSPEND {
+      Router discarded(std::move(router));
+    }
+  }
+}
+
+BENCHMARK_NAMED_PARAM(static_last_route, 10_routes, 10)
+BENCHMARK_NAMED_PARAM(static_last_route, 100_routes, 100)
+BENCHMARK_NAMED_PARAM(static_last_route, 1000_routes, 1000)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM(typed_last_route, 10_routes, 10)
+BENCHMARK_NAMED_PARAM(typed_last_route, 100_routes, 100)
+BENCHMARK_NAMED_PARAM(typed_last_route, 1000_routes, 1000)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM(per_route_last_route, 10_routes, 10)
+BENCHMARK_RELATIVE_NAMED_PARAM(combined_last_route, 10_routes, 10)
+BENCHMARK_RELATIVE_NAMED_PARAM(cached_last_route, 10_routes, 10)
+BENCHMARK_NAMED_PARAM(per_route_last_route, 100_routes, 100)
+BENCHMARK_RELATIVE_NAMED_PARAM(combined_last_route, 100_routes, 100)
+BENCHMARK_RELATIVE_NAMED_PARAM(cached_last_route, 100_routes, 100)
+BENCHMARK_NAMED_PARAM(per_route_last_route, 1000_routes, 1000)
+BENCHMARK_RELATIVE_NAMED_PARAM(combined_last_route, 1000_routes, 1000)
+BENCHMARK_RELATIVE_NAMED_PARAM(cached_last_route, 1000_routes, 1000)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM(static_no_route, 10_routes, 10)
+BENCHMARK_NAMED_PARAM(static_no_route, 1000_routes, 1000)
+BENCHMARK_NAMED_PARAM(typed_no_route, 10_routes, 10)
+BENCHMARK_NAMED_PARAM(typed_no_route, 1000_routes, 1000)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM(per_route_no_route, 10_routes, 10)
+BENCHMARK_RELATIVE_NAMED_PARAM(combined_no_route, 10_routes, 10)
+BENCHMARK_NAMED_PARAM(per_route_no_route, 100_routes, 100)
+BENCHMARK_RELATIVE_NAMED_PARAM(combined_no_route, 100_routes, 100)
+BENCHMARK_NAMED_PARAM(per_route_no_route, 1000_routes, 1000)
+BENCHMARK_RELATIVE_NAMED_PARAM(combined_no_route, 1000_routes, 1000)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM(create_routes, 10_routes, 10)
+BENCHMARK_NAMED_PARAM(create_routes, 100_routes, 100)
+BENCHMARK_NAMED_PARAM(create_routes, 1000_routes, 1000)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM(construct_router, 10_routes, 10)
+BENCHMARK_NAMED_PARAM(construct_router, 100_routes, 100)
+BENCHMARK_NAMED_PARAM(construct_router, 1000_routes, 1000)
+}
+}
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,158 @@
+#include "src/AdmissionController.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <glog/logging.h>
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+
+namespace nozomi {
+
+namespace {
+constexpr size_t kNoLimit = std::numeric_limits<size_t>::max();
+// How much QueueDelay's limit shrinks for each interval that the queue
+// doesn't drain
+constexpr double kQueueDelayBackoff = 0.75;
+}
+
+AdmissionController::AdmissionController(const AdmissionConfig& config)
+    : config_(config),
+      limit_(static_cast<double>(config.minConcurrency)),
+      minDelayUs_(std::numeric_limits<int64_t>::max()),
+      delayLimit_(kNoLimit) {
+  DCHECK(config_.maxConcurrency > 0);
+}
+
+bool AdmissionController::tryAcquire() {
+  size_t limit = std::numeric_limits<size_t>::max();
+  switch (config_.policy) {
+    case AdmissionPolicy::AcceptAll:
+      break;
+    case AdmissionPolicy::ConcurrencyLimit:
+      limit = config_.maxConcurrency;
+      break;
+    case AdmissionPolicy::QueueDelay:
+      limit = delayLimit_.load(std::memory_order_relaxed);
+      break;
+    case AdmissionPolicy::AIMD:
+      limit = static_cast<size_t>(limit_.load(std::memory_order_relaxed));
+      break;
+  }
+
+  if (inFlight_.fetch_add(1, std::memory_order_relaxed) >=
+      std::max<size_t>(limit, 1)) {
+    inFlight_.fetch_sub(1, std::memory_order_relaxed);
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  admitted_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void AdmissionController::onStart(microseconds queueDelay,
+                                  steady_clock::time_point now) {
+  if (config_.policy == AdmissionPolicy::QueueDelay) {
+    updateDelay(queueDelay, now);
+  }
+}
+
+void AdmissionController::release(microseconds latency) {
+  DCHECK(inFlight_.load(std::memory_order_relaxed) > 0)
+      << "An admission was released more than once";
+  inFlight_.fetch_sub(1, std::memory_order_relaxed);
+  if (config_.policy == AdmissionPolicy::AIMD) {
+    updateLimit(latency);
+  }
+}
+
+void AdmissionController::updateLimit(microseconds latency) {
+  auto limit = limit_.load(std::memory_order_relaxed);
+  double next;
+  do {
+    if (latency <= config_.targetLatency) {
+      // Grows by one after a whole limit's worth of fast responses
+      next = limit + 1.0 / limit;
+    } else {
+      next = limit * config_.backoffRatio;
+    }
+    next = std::min(std::max(next, (double)config_.minConcurrency),
+                    (double)config_.maxConcurrency);
+  } while (!limit_.compare_exchange_weak(limit, next,
+                                         std::memory_order_relaxed));
+}
+
+void AdmissionController::updateDelay(microseconds queueDelay,
+                                      steady_clock::time_point now) {
+  auto delayUs = queueDelay.count();
+  auto nowUs =
+      duration_cast<microseconds>(now.time_since_epoch()).count();
+  auto minDelayUs = minDelayUs_.load(std::memory_order_relaxed);
+  while (delayUs < minDelayUs &&
+         !minDelayUs_.compare_exchange_weak(minDelayUs, delayUs,
+                                            std::memory_order_relaxed)) {
+  }
+
+  auto intervalEndUs = intervalEndUs_.load(std::memory_order_relaxed);
+  if (intervalEndUs == 0) {
+    // The first measurement starts the first interval
+    intervalEndUs_.compare_exchange_strong(
+        intervalEndUs,
+        nowUs + duration_cast<microseconds>(config_.interval).count(),
+        std::memory_order_relaxed);
+    return;
+  }
+  if (nowUs < intervalEndUs) {
+    return;
+  }
+  // Only the thread that moves the interval forward looks at its minimum.
+  // If even the least delayed request in the interval waited longer than
+  // the target, there is a standing queue that won't drain by itself
+  auto nextEndUs =
+      nowUs + duration_cast<microseconds>(config_.interval).count();
+  if (intervalEndUs_.compare_exchange_strong(intervalEndUs, nextEndUs,
+                                             std::memory_order_relaxed)) {
+    auto intervalMinUs = minDelayUs_.exchange(
+        std::numeric_limits<int64_t>::max(), std::memory_order_relaxed);
+    if (intervalMinUs <=
+        duration_cast<microseconds>(config_.targetDelay).count()) {
+      delayLimit_.store(kNoLimit, std::memory_order_relaxed);
+      return;
+    }
+    // The work that is in flight is still served, but no more than that is
+    // admitted, and a quarter less for each interval that the queue stays
+    auto limit = std::min(delayLimit_.load(std::memory_order_relaxed),
+                          inFlight_.load(std::memory_order_relaxed));
+    if (delayLimit_.load(std::memory_order_relaxed) != kNoLimit) {
+      limit = static_cast<size_t>(limit * kQueueDelayBackoff);
+    }
+    delayLimit_.store(std::max<size_t>(limit, 1), std::memory_order_relaxed);
+  }
+}
+
+AdmissionStats AdmissionController::getStats() const {
+  AdmissionStats stats;
+  stats.inFlight = inFlight_.load(std::memory_order_relaxed);
+  stats.admitted = admitted_.load(std::memory_order_relaxed);
+  stats.rejected = rejected_.load(std::memory_order_relaxed);
+  switch (config_.policy) {
+    case AdmissionPolicy::AcceptAll:
+      break;
+    case AdmissionPolicy::QueueDelay: {
+      auto limit = delayLimit_.load(std::memory_order_relaxed);
+      stats.limit = limit != kNoLimit ? limit : 0;
+      break;
+    }
+    case AdmissionPolicy::ConcurrencyLimit:
+      stats.limit = config_.maxConcurrency;
+      break;
+    case AdmissionPolicy::AIMD:
+      stats.limit =
+          static_cast<size_t>(limit_.load(std::memory_order_relaxed));
+      break;
+  }
+  return stats;
+}
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "src/Config.h"
+
+namespace nozomi {
+
+/**
+ * A snapshot of the requests seen by an AdmissionController
+ */
+struct AdmissionStats {
+  // The number of admitted requests that have not finished yet
+  size_t inFlight = 0;
+  // The current concurrency limit. Only meaningful for the
+  // ConcurrencyLimit and AIMD policies, and for QueueDelay while it is
+  // shedding
+  size_t limit = 0;
+  uint64_t admitted = 0;
+  uint64_t rejected = 0;
+};
+
+/**
+ * Decides whether a request should be handled, or rejected right away
+ * because the server is overloaded. Every admitted request must be paired
+ * with exactly one call to release(). Thread safe, and none of the methods
+ * take a lock or allocate. See AdmissionPolicy for how each policy decides
+ */
+class AdmissionController {
+ private:
+  AdmissionConfig config_;
+  std::atomic<size_t> inFlight_{0};
+  std::atomic<uint64_t> admitted_{0};
+  std::atomic<uint64_t> rejected_{0};
+
+  // AIMD
+  std::atomic<double> limit_;
+
+  // QueueDelay. Times are microseconds since the steady clock's epoch
+  std::atomic<int64_t> intervalEndUs_{0};
+  std::atomic<int64_t> minDelayUs_;
+  // How many requests may be in flight while the queue doesn't drain
+  std::atomic<size_t> delayLimit_;
+
+  void updateLimit(std::chrono::microseconds latency);
+  void updateDelay(std::chrono::microseconds queueDelay,
+                   std::chrono::steady_clock::time_point now);
+
+ public:
+  /**
+   * Creates an AdmissionController
+   *
+   * @param config - The policy and its settings. Assumed to be validated
+   *                 by Config
+   */
+  explicit AdmissionController(const AdmissionConfig& config);
+
+  /**
+   * Admits a request if the policy allows it. A request is always admitted
+   * if no others are in flight, so that the QueueDelay and AIMD policies
+   * keep getting measurements to recover from
+   *
+   * @returns true if the request was admitted, and must be released
+   */
+  bool tryAcquire();
+
+  /**
+   * Records how long an admitted request waited between being read and
+   * its handler starting
+   *
+   * @param queueDelay - The time spent waiting for a thread
+   * @param now - The time that the handler started
+   */
+  void onStart(std::chrono::microseconds queueDelay,
+               std::chrono::steady_clock::time_point now =
+                   std::chrono::steady_clock::now());
+
+  /**
+   * Marks an admitted request as finished
+   *
+   * @param latency - The time from being admitted until the response was
+   *                  sent, or the request failed
+   */
+  void release(std::chrono::microseconds latency);
+
+  AdmissionStats getStats() const;
+};
+}
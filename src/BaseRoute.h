@@ -1,13 +1,20 @@
 #pragma once
 
+#include <chrono>
 #include <string>
 #include <unordered_set>
+#include <vector>
 
+#include "src/ExecutionPolicy.h"
 #include "src/HTTPRequest.h"
 #include "src/HTTPResponse.h"
 #include "src/RouteMatch.h"
+#include "src/RouteParsing.h"
+#include "src/RoutingContext.h"
 
+#include <boost/regex.hpp>
 #include <folly/Optional.h>
+#include <folly/Range.h>
 #include <proxygen/lib/http/HTTPMethod.h>
 
 namespace nozomi {
@@ -20,6 +27,9 @@ class BaseRoute {
   std::string originalPattern_;
   std::unordered_set<proxygen::HTTPMethod> methods_;
   bool isStaticRoute_;
+  ExecutionPolicy executionPolicy_;
+  folly::Optional<size_t> maxBodySize_;
+  folly::Optional<std::chrono::milliseconds> timeout_;
 
   /**
    * Sets up some common properties of all routes
@@ -46,7 +56,178 @@ class BaseRoute {
    * matches this routes' path and method. Successful matches usually
    * wrap a user-provided handler. See Route and StaticRoute
    */
-  virtual RouteMatch handler(const proxygen::HTTPMessage* request) = 0;
+  virtual RouteMatch handler(const RoutingContext& context) = 0;
+
+  /**
+   * Convenience method that builds a RoutingContext for a single
+   * request. Prefer building the context once when checking many routes
+   */
+  inline RouteMatch handler(const proxygen::HTTPMessage* request) {
+    DCHECK(request != nullptr) << "Request must not be null";
+    return handler(RoutingContext(request));
+  }
+
+  /**
+   * Get a RouteMatch object for a request whose path has already been
+   * matched against getPatternSegments() (e.g. by a RouteTrie). Only the
+   * method is checked.
+   *
+   * @param captures - The pieces of the path that matched each typed
+   *                   parameter, in order
+   */
+  virtual RouteMatch handlerFromCaptures(
+      const RoutingContext& context,
+      const route_parsing::RouteCaptures& captures) {
+    return handler(context);
+  }
+
+  /**
+   * Get a RouteMatch object for a request whose path has already been
+   * matched against getRegex() (e.g. by a CombinedRouteRegex). Only the
+   * method is checked.
+   *
+   * @param matches - The results of the match. They must point into
+   *                  context.getPath()
+   * @param groupOffset - The number of groups in matches that come before
+   *                      the groups from getRegex(). 0 if getRegex() was
+   *                      used on its own
+   */
+  virtual RouteMatch handlerFromMatch(const RoutingContext& context,
+                                      const boost::smatch& matches,
+                                      size_t groupOffset) {
+    return handler(context);
+  }
+
+  /**
+   * Calls the handler of a non-streaming route that matched. See RouteHandler
+   *
+   * @param request - The request. Captures are offsets into its path
+   * @param captures - The captures from when the route matched
+   * @param executor - The executor that the handler is being called on, or
+   *                   nullptr
+   */
+  virtual folly::Future<HTTPResponse> call(
+      const HTTPRequest& request,
+      const route_parsing::RouteCaptures& captures,
+      folly::Executor* executor) {
+    DCHECK(false) << "Only non-streaming routes can be called";
+    return HTTPResponse::future(500);
+  }
+
+  /**
+   * Creates the handler of a streaming route that matched. See
+   * StreamingRouteHandler
+   *
+   * @param path - The decoded path that captures point into
+   * @param captures - The captures from when the route matched
+   */
+  virtual proxygen::RequestHandler* callStreaming(
+      folly::StringPiece path,
+      const route_parsing::RouteCaptures& captures) {
+    DCHECK(false) << "Only streaming routes can create streaming handlers";
+    return nullptr;
+  }
+
+  /**
+   * If this route's pattern is matched with a regular expression, returns
+   * that regular expression. Otherwise returns nullptr
+   */
+  virtual const boost::basic_regex<char>* getRegex() const { return nullptr; }
+
+  /**
+   * If this route's pattern can be matched one path segment at a time,
+   * returns those segments. Otherwise returns nullptr
+   */
+  virtual const std::vector<route_parsing::PatternSegment>*
+  getPatternSegments() const {
+    return nullptr;
+  }
+
   inline bool isStaticRoute() { return isStaticRoute_; }
+
+  /**
+   * Returns where this route's handler is run. Not used by streaming routes
+   */
+  inline const ExecutionPolicy& getExecutionPolicy() const {
+    return executionPolicy_;
+  }
+
+  /**
+   * Sets where this route's handler is run. This must be called before the
+   * router handles requests
+   */
+  inline void setExecutionPolicy(ExecutionPolicy executionPolicy) {
+    executionPolicy_ = std::move(executionPolicy);
+  }
+
+  /**
+   * Returns the largest request body, in bytes, that this route accepts,
+   * or none if the server's limit from Config is used
+   */
+  inline const folly::Optional<size_t>& getMaxBodySize() const {
+    return maxBodySize_;
+  }
+
+  /**
+   * Overrides the server's maximum body size for this route. Not used by
+   * streaming routes. This must be called before the router handles
+   * requests
+   */
+  inline void setMaxBodySize(size_t maxBodySize) {
+    maxBodySize_ = maxBodySize;
+  }
+
+  /**
+   * Returns how long this route's handler has to respond, or none if the
+   * server's request timeout from Config is used
+   */
+  inline const folly::Optional<std::chrono::milliseconds>& getTimeout() const {
+    return timeout_;
+  }
+
+  /**
+   * Overrides the server's request timeout for this route. Not used by
+   * streaming routes. This must be called before the router handles
+   * requests
+   */
+  inline void setTimeout(std::chrono::milliseconds timeout) {
+    timeout_ = timeout;
+  }
+  inline const std::string& getOriginalPattern() const {
+    return originalPattern_;
+  }
+  inline const std::unordered_set<proxygen::HTTPMethod>& getMethods() const {
+    return methods_;
+  }
 };
+
+inline folly::Future<HTTPResponse> RouteHandler::operator()(
+    const HTTPRequest& request,
+    folly::Executor* executor) const {
+  if (route_ != nullptr) {
+    return route_->call(request, captures_, executor);
+  }
+  return function_(request);
+}
+
+inline const ExecutionPolicy& RouteHandler::getExecutionPolicy() const {
+  static const ExecutionPolicy defaultPolicy;
+  return route_ != nullptr ? route_->getExecutionPolicy() : defaultPolicy;
+}
+
+inline folly::Optional<size_t> RouteHandler::getMaxBodySize() const {
+  return route_ != nullptr ? route_->getMaxBodySize()
+                           : folly::Optional<size_t>();
+}
+
+inline folly::Optional<std::chrono::milliseconds> RouteHandler::getTimeout()
+    const {
+  return route_ != nullptr ? route_->getTimeout()
+                           : folly::Optional<std::chrono::milliseconds>();
+}
+
+inline proxygen::RequestHandler* StreamingRouteHandler::operator()() const {
+  DCHECK(route_ != nullptr && path_ != nullptr);
+  return route_->callStreaming(*path_, captures_);
+}
 }
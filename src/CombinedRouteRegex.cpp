@@ -0,0 +1,132 @@
+#include "src/CombinedRouteRegex.h"
+
+#include <stdexcept>
+
+#include <folly/Format.h>
+#include <folly/Range.h>
+
+using boost::basic_regex;
+using folly::Optional;
+using folly::sformat;
+using folly::StringPiece;
+using std::invalid_argument;
+using std::string;
+using std::vector;
+
+namespace nozomi {
+
+namespace {
+
+inline bool is_digit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+/**
+ * Whether a group that starts with (? refers to another group: a recursion
+ * or subroutine call like (?1), (?+1), (?-1), (?R), (?&name) or (?P>name),
+ * or a condition on a group like (?(1)...) or (?(<name>)...)
+ *
+ * @param rest - What follows the (?
+ */
+bool is_group_reference(StringPiece rest) {
+  if (rest.empty()) {
+    return false;
+  }
+  switch (rest[0]) {
+    case 'R':
+    case '&':
+      return true;
+    case '(':
+      // Conditions on a lookaround, like (?(?=a)...), don't name a group
+      return rest.size() < 2 || rest[1] != '?';
+    case '+':
+    case '-':
+      // (?-i) turns a flag off
+      return rest.size() > 1 && is_digit(rest[1]);
+    case 'P':
+      return rest.size() > 1 && rest[1] == '>';
+    default:
+      return is_digit(rest[0]);
+  }
+}
+
+/**
+ * Whether a regular expression refers to one of its own groups, by number
+ * or by name. Either way the reference is resolved to a group number, and
+ * those shift when patterns are combined. Covers backreferences (\1 - \9,
+ * \g and \k) and the (? forms in is_group_reference()
+ */
+bool has_group_reference(const string& pattern) {
+  bool inClass = false;
+  for (size_t i = 0; i + 1 < pattern.size(); ++i) {
+    auto c = pattern[i];
+    if (c == '\\') {
+      auto next = pattern[i + 1];
+      if (!inClass &&
+          ((next >= '1' && next <= '9') || next == 'g' || next == 'k')) {
+        return true;
+      }
+      // Skip the escaped character so that \\1 isn't treated as \1
+      ++i;
+    } else if (inClass) {
+      inClass = c != ']';
+    } else if (c == '[') {
+      inClass = true;
+      // A ] right at the start of a class is a literal
+      if (i + 1 < pattern.size() && pattern[i + 1] == '^') {
+        ++i;
+      }
+      if (i + 1 < pattern.size() && pattern[i + 1] == ']') {
+        ++i;
+      }
+    } else if (c == '(' && pattern[i + 1] == '?' &&
+               is_group_reference(StringPiece(pattern).subpiece(i + 2))) {
+      return true;
+    }
+  }
+  return false;
+}
+}
+
+CombinedRouteRegex::CombinedRouteRegex(
+    const vector<const basic_regex<char>*>& regexes) {
+  if (regexes.empty()) {
+    return;
+  }
+
+  string combined;
+  size_t group = 1;
+  groups_.reserve(regexes.size());
+  for (const auto* regex : regexes) {
+    auto pattern = regex->str();
+    if (has_group_reference(pattern)) {
+      throw invalid_argument(
+          sformat("Regular expression {} refers to its own groups, and "
+                  "cannot be combined",
+                  pattern));
+    }
+    if (!combined.empty()) {
+      combined.push_back('|');
+    }
+    combined.push_back('(');
+    combined.append(pattern);
+    combined.push_back(')');
+    groups_.push_back(group);
+    group += regex->mark_count() + 1;
+  }
+  regex_ = basic_regex<char>(combined, boost::regex::perl);
+}
+
+Optional<size_t> CombinedRouteRegex::match(const string& path,
+                                           boost::smatch& matches) const {
+  if (groups_.empty() || !boost::regex_match(path, matches, regex_)) {
+    return Optional<size_t>();
+  }
+  for (size_t i = 0; i < groups_.size(); ++i) {
+    if (matches[groups_[i]].matched) {
+      return i;
+    }
+  }
+  return Optional<size_t>();
+}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/regex.hpp>
+#include <folly/Optional.h>
+
+namespace nozomi {
+
+/**
+ * Combines the regular expressions of many routes into a single alternation
+ * so that a path can be checked against all of them in one pass. Alternatives
+ * are tried in the order that they were provided, so the first regex that
+ * matches the whole path wins, the same as checking them one at a time.
+ *
+ * Each regex is wrapped in its own capture group, so group N of the regex
+ * at index i is group getGroupOffset(i) + N of the combined match.
+ */
+class CombinedRouteRegex {
+ private:
+  boost::basic_regex<char> regex_;
+  // The index of the group that wraps each regex, in the combined regex
+  std::vector<size_t> groups_;
+
+ public:
+  /**
+   * Creates a CombinedRouteRegex
+   *
+   * @param regexes - The regular expressions to combine, in priority order.
+   *                  They are copied, and do not need to outlive this object
+   * @throws invalid_argument if any of the regular expressions refer to
+   *                          their own groups with backreferences,
+   *                          recursion, subroutine calls or conditions.
+   *                          Group numbers change when regexes are
+   *                          combined, so those would not match the same
+   *                          paths anymore
+   */
+  explicit CombinedRouteRegex(
+      const std::vector<const boost::basic_regex<char>*>& regexes);
+
+  /**
+   * Finds the first regex that matches all of path
+   *
+   * @param path - The path to match. It must outlive matches
+   * @param matches - Set to the results of the match. See getGroupOffset()
+   * @returns The index of the regex that matched in the list that was
+   *          provided to the constructor, or empty if none matched
+   */
+  folly::Optional<size_t> match(const std::string& path,
+                                boost::smatch& matches) const;
+
+  /**
+   * Returns the number of groups in a combined match that come before the
+   * groups of the regex at index
+   */
+  inline size_t getGroupOffset(size_t index) const { return groups_[index]; }
+
+  inline size_t size() const { return groups_.size(); }
+};
+}
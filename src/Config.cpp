@@ -1,11 +1,16 @@
 #include "src/Config.h"
 
+#include <unordered_set>
+
 namespace fs = boost::filesystem;
 
 namespace nozomi {
 
 const size_t Config::kDefaultFileReaderBufferSize;
 const int64_t Config::kDefaultRequestTimeoutMs;
+const size_t Config::kDefaultMaxBodySize;
+const size_t Config::kDefaultArenaBlockSize;
+const size_t Config::kDefaultMaxPooledHandlers;
 
 void Config::setHTTPAddresses(
     std::vector<proxygen::HTTPServer::IPConfig> httpAddresses) {
@@ -63,12 +68,83 @@ void Config::setPublicDir(const folly::Optional<std::string>& path) {
   }
 }
 
+void Config::setExecutorPools(std::vector<ExecutorPoolConfig> executorPools) {
+  std::unordered_set<std::string> names;
+  for (const auto& pool : executorPools) {
+    if (pool.name.empty()) {
+      throw std::invalid_argument("Executor pool names must not be empty");
+    }
+    if (!names.insert(pool.name).second) {
+      throw std::invalid_argument(
+          folly::sformat("Executor pool {} was declared twice", pool.name));
+    }
+    if (pool.threads == 0) {
+      throw std::invalid_argument(folly::sformat(
+          "Executor pool {} must have more than zero threads", pool.name));
+    }
+    if (pool.maxQueueSize == 0) {
+      throw std::invalid_argument(folly::sformat(
+          "Executor pool {} must have a queue size greater than zero",
+          pool.name));
+    }
+  }
+  executorPools_ = std::move(executorPools);
+}
+
+void Config::setAdmission(AdmissionConfig admission) {
+  if (admission.maxConcurrency == 0) {
+    throw std::invalid_argument(
+        "The maximum admission concurrency must be greater than zero");
+  }
+  if (admission.policy == AdmissionPolicy::AIMD &&
+      (admission.minConcurrency == 0 ||
+       admission.minConcurrency > admission.maxConcurrency)) {
+    throw std::invalid_argument(folly::sformat(
+        "The minimum admission concurrency ({}) must be between 1 and the "
+        "maximum ({})",
+        admission.minConcurrency, admission.maxConcurrency));
+  }
+  if (admission.targetDelay.count() <= 0 || admission.interval.count() <= 0 ||
+      admission.targetLatency.count() <= 0) {
+    throw std::invalid_argument(
+        "Admission delays and intervals must be greater than zero");
+  }
+  if (admission.backoffRatio <= 0 || admission.backoffRatio >= 1) {
+    throw std::invalid_argument(folly::sformat(
+        "Admission backoff ratio ({}) must be between 0 and 1",
+        admission.backoffRatio));
+  }
+  admission_ = admission;
+}
+
+void Config::setMaxBodySize(size_t size) {
+  if (size == 0) {
+    throw std::invalid_argument(
+        "Maximum body size must be greater than zero bytes");
+  }
+  maxBodySize_ = size;
+}
+
+void Config::setArenaBlockSize(size_t size) {
+  if (size < 64 || size > 64 * 1024 * 1024) {
+    throw std::invalid_argument(folly::sformat(
+        "The arena block size ({}) must be between 64 bytes and 64MB", size));
+  }
+  arenaBlockSize_ = size;
+}
+
 Config::Config(
     std::vector<std::tuple<std::string, uint16_t, Protocol>> httpAddresses,
     size_t workerThreads,
     folly::Optional<std::string> publicDir,
     std::chrono::milliseconds requestTimeout,
-    size_t fileReaderBufferSize) {
+    size_t fileReaderBufferSize,
+    std::vector<ExecutorPoolConfig> executorPools,
+    AdmissionConfig admission,
+    size_t maxBodySize,
+    size_t arenaBlockSize,
+    size_t maxPooledHandlers)
+    : maxPooledHandlers_(maxPooledHandlers) {
   std::string host;
   uint16_t port;
   Protocol protocol;
@@ -91,17 +167,31 @@ Config::Config(
   setPublicDir(publicDir);
   setRequestTimeout(requestTimeout);
   setFileReaderBufferSize(fileReaderBufferSize);
+  setExecutorPools(std::move(executorPools));
+  setAdmission(admission);
+  setMaxBodySize(maxBodySize);
+  setArenaBlockSize(arenaBlockSize);
 }
 
 Config::Config(std::vector<proxygen::HTTPServer::IPConfig> httpAddresses,
                size_t workerThreads,
                folly::Optional<std::string> publicDir,
                std::chrono::milliseconds requestTimeout,
-               size_t fileReaderBufferSize) {
+               size_t fileReaderBufferSize,
+               std::vector<ExecutorPoolConfig> executorPools,
+               AdmissionConfig admission,
+               size_t maxBodySize,
+               size_t arenaBlockSize,
+               size_t maxPooledHandlers)
+    : maxPooledHandlers_(maxPooledHandlers) {
   setHTTPAddresses(std::move(httpAddresses));
   setWorkerThreads(workerThreads);
   setPublicDir(publicDir);
   setRequestTimeout(requestTimeout);
   setFileReaderBufferSize(fileReaderBufferSize);
+  setExecutorPools(std::move(executorPools));
+  setAdmission(admission);
+  setMaxBodySize(maxBodySize);
+  setArenaBlockSize(arenaBlockSize);
 }
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include <limits>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -11,12 +12,69 @@
 #include <folly/SocketAddress.h>
 #include <proxygen/httpserver/HTTPServer.h>
 
+#include "src/RequestArena.h"
+
 namespace nozomi {
 
+/**
+ * A named pool of threads that routes can run their handlers on. See
+ * ExecutionPolicy::pool()
+ */
+struct ExecutorPoolConfig {
+  // The name that routes refer to the pool by
+  std::string name;
+  // The number of threads in the pool
+  size_t threads;
+  // The most handlers that can wait for a thread. Requests for the pool's
+  // routes get a 503 without being queued while it is full
+  size_t maxQueueSize;
+};
+
+/**
+ * How HTTPHandlerFactory decides whether to accept a non-streaming request,
+ * or to reject it right away with a 503. See AdmissionController
+ */
+enum class AdmissionPolicy {
+  // Every request is accepted
+  AcceptAll,
+  // At most maxConcurrency requests are in flight at once
+  ConcurrencyLimit,
+  // CoDel style. Once the shortest time that a handler waited for a thread
+  // during an interval was over targetDelay, no more requests are admitted
+  // than were in flight, and that limit shrinks by a quarter for each
+  // interval that the delay stays over targetDelay
+  QueueDelay,
+  // The concurrency limit grows by one each time a limit's worth of
+  // requests finish within targetLatency, and shrinks by backoffRatio
+  // each time one takes longer. It stays between minConcurrency and
+  // maxConcurrency
+  AIMD,
+};
+
+struct AdmissionConfig {
+  AdmissionPolicy policy = AdmissionPolicy::AcceptAll;
+  // The limit for ConcurrencyLimit, and the upper limit for AIMD
+  size_t maxConcurrency = 1024;
+  // The lower limit for AIMD. It also starts here
+  size_t minConcurrency = 16;
+  // QueueDelay only
+  std::chrono::milliseconds targetDelay{5};
+  std::chrono::milliseconds interval{100};
+  // AIMD only
+  std::chrono::milliseconds targetLatency{100};
+  double backoffRatio = 0.9;
+};
+
 class Config {
  public:
   static constexpr size_t kDefaultFileReaderBufferSize = 4096;
   static constexpr int64_t kDefaultRequestTimeoutMs = 30000;
+  // No limit, so that routes that accepted any upload keep doing so
+  static constexpr size_t kDefaultMaxBodySize =
+      std::numeric_limits<size_t>::max();
+  static constexpr size_t kDefaultArenaBlockSize =
+      RequestArena::kDefaultBlockSize;
+  static constexpr size_t kDefaultMaxPooledHandlers = 1024;
   using Protocol = proxygen::HTTPServer::Protocol;
 
  private:
@@ -26,6 +84,11 @@ class Config {
   std::chrono::milliseconds requestTimeout_;
   size_t fileReaderBufferSize_;
   bool addPublicDirectoryHandler_ = false;
+  std::vector<ExecutorPoolConfig> executorPools_;
+  AdmissionConfig admission_;
+  size_t maxBodySize_;
+  size_t arenaBlockSize_;
+  size_t maxPooledHandlers_;
 
   void setHTTPAddresses(
       std::vector<proxygen::HTTPServer::IPConfig> httpAddresses);
@@ -33,6 +96,10 @@ class Config {
   void setRequestTimeout(std::chrono::milliseconds timeout);
   void setFileReaderBufferSize(size_t size);
   void setPublicDir(const folly::Optional<std::string>& path);
+  void setExecutorPools(std::vector<ExecutorPoolConfig> executorPools);
+  void setAdmission(AdmissionConfig admission);
+  void setMaxBodySize(size_t size);
+  void setArenaBlockSize(size_t size);
 
  public:
   /**
@@ -47,6 +114,19 @@ class Config {
    * @param fileReaderBufferSize - If static files are served, how large
    *                               the read buffer should be. Not usually
    *                               modified
+   * @param executorPools - Named thread pools that routes can run their
+   *                        handlers on. See ExecutorPoolConfig
+   * @param admission - How requests are rejected early when the server is
+   *                    overloaded. See AdmissionConfig
+   * @param maxBodySize - The largest request body, in bytes, that is
+   *                      buffered for a non-streaming route. Larger requests
+   *                      get a 413, and their connection is closed. There
+   *                      is no limit by default. Routes can override it
+   * @param arenaBlockSize - The size of the blocks that each request's
+   *                         arena allocates. See HTTPRequest::getArena()
+   * @param maxPooledHandlers - The most finished HTTPHandlers that each
+   *                            worker thread keeps for reuse. 0 turns
+   *                            handler reuse off
    * @throws std::invalid_argument if any of the settings are not valid
    */
   Config(
@@ -55,7 +135,13 @@ class Config {
       folly::Optional<std::string> publicDir = folly::Optional<std::string>(),
       std::chrono::milliseconds requestTimeout =
           std::chrono::milliseconds(kDefaultRequestTimeoutMs),
-      size_t fileReaderBufferSize = kDefaultFileReaderBufferSize);
+      size_t fileReaderBufferSize = kDefaultFileReaderBufferSize,
+      std::vector<ExecutorPoolConfig> executorPools =
+          std::vector<ExecutorPoolConfig>(),
+      AdmissionConfig admission = AdmissionConfig(),
+      size_t maxBodySize = kDefaultMaxBodySize,
+      size_t arenaBlockSize = kDefaultArenaBlockSize,
+      size_t maxPooledHandlers = kDefaultMaxPooledHandlers);
   /**
    * Creates a Config object for Servers
    * @param httpAddresses - A list of host / port / protocols to listen on
@@ -68,6 +154,19 @@ class Config {
    * @param fileReaderBufferSize - If static files are served, how large
    *                               the read buffer should be. Not usually
    *                               modified
+   * @param executorPools - Named thread pools that routes can run their
+   *                        handlers on. See ExecutorPoolConfig
+   * @param admission - How requests are rejected early when the server is
+   *                    overloaded. See AdmissionConfig
+   * @param maxBodySize - The largest request body, in bytes, that is
+   *                      buffered for a non-streaming route. Larger requests
+   *                      get a 413, and their connection is closed. There
+   *                      is no limit by default. Routes can override it
+   * @param arenaBlockSize - The size of the blocks that each request's
+   *                         arena allocates. See HTTPRequest::getArena()
+   * @param maxPooledHandlers - The most finished HTTPHandlers that each
+   *                            worker thread keeps for reuse. 0 turns
+   *                            handler reuse off
    * @throws std::invalid_argument if any of the settings are not valid
    */
   Config(
@@ -76,7 +175,13 @@ class Config {
       folly::Optional<std::string> publicDir = folly::Optional<std::string>(),
       std::chrono::milliseconds requestTimeout =
           std::chrono::milliseconds(kDefaultRequestTimeoutMs),
-      size_t fileReaderBufferSize = kDefaultFileReaderBufferSize);
+      size_t fileReaderBufferSize = kDefaultFileReaderBufferSize,
+      std::vector<ExecutorPoolConfig> executorPools =
+          std::vector<ExecutorPoolConfig>(),
+      AdmissionConfig admission = AdmissionConfig(),
+      size_t maxBodySize = kDefaultMaxBodySize,
+      size_t arenaBlockSize = kDefaultArenaBlockSize,
+      size_t maxPooledHandlers = kDefaultMaxPooledHandlers);
 
   /**
    * Returns the number of threads used for running event handlers
@@ -98,6 +203,26 @@ class Config {
 
   inline size_t getFileReaderBufferSize() { return fileReaderBufferSize_; }
 
+  /**
+   * Returns the named thread pools that routes can run their handlers on
+   */
+  inline const std::vector<ExecutorPoolConfig>& getExecutorPools() const
+      noexcept {
+    return executorPools_;
+  }
+
+  inline const AdmissionConfig& getAdmission() const noexcept {
+    return admission_;
+  }
+
+  inline size_t getMaxBodySize() const noexcept { return maxBodySize_; }
+
+  inline size_t getArenaBlockSize() const noexcept { return arenaBlockSize_; }
+
+  inline size_t getMaxPooledHandlers() const noexcept {
+    return maxPooledHandlers_;
+  }
+
   /**
    * Returns the path to the public directory if a public directory handler
    * should be created (else empty)
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+
+#include <folly/Executor.h>
+#include <glog/logging.h>
+
+namespace nozomi {
+
+/**
+ * Where a non-streaming route's handler is run once its request has been
+ * received
+ */
+enum class ExecutionMode {
+  // Directly on the connection's EventBase thread. The response is sent
+  // without changing threads, so handlers must not block
+  Inline,
+  // On the IO thread pool (wangle::getIOExecutor()). This is the default
+  IOExecutor,
+  // On the CPU thread pool (wangle::getCPUExecutor())
+  CPUPool,
+  // On an executor provided by the application
+  Custom,
+  // On one of the named ExecutorPools declared in the server's Config
+  Pool,
+};
+
+/**
+ * Determines where a route's handler is run. Implicitly constructible
+ * from an ExecutionMode, or from an executor for ExecutionMode::Custom
+ */
+struct ExecutionPolicy {
+  ExecutionMode mode = ExecutionMode::IOExecutor;
+  // Only set for ExecutionMode::Custom. It must outlive the route
+  folly::Executor* executor = nullptr;
+  // Only set for ExecutionMode::Pool. See ExecutorPoolConfig
+  std::string poolName;
+
+  ExecutionPolicy() {}
+
+  /* implicit */ ExecutionPolicy(ExecutionMode mode) : mode(mode) {
+    DCHECK(mode != ExecutionMode::Custom && mode != ExecutionMode::Pool)
+        << "Custom and pool execution policies need an executor or a pool";
+  }
+
+  /* implicit */ ExecutionPolicy(folly::Executor* executor)
+      : mode(ExecutionMode::Custom), executor(executor) {
+    DCHECK(executor != nullptr) << "Executor must not be null";
+  }
+
+  /**
+   * Runs handlers on the ExecutorPool with the given name. If its queue is
+   * full, the router's 503 handler is used instead
+   */
+  static ExecutionPolicy pool(std::string name) {
+    ExecutionPolicy policy;
+    policy.mode = ExecutionMode::Pool;
+    policy.poolName = std::move(name);
+    return policy;
+  }
+};
+}
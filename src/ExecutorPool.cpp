@@ -0,0 +1,85 @@
+#include "src/ExecutorPool.h"
+
+#include <wangle/concurrent/NamedThreadFactory.h>
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+namespace nozomi {
+
+ExecutorPool::ExecutorPool(const ExecutorPoolConfig& config)
+    : name_(config.name),
+      maxQueueSize_(config.maxQueueSize),
+      executor_(std::make_unique<wangle::CPUThreadPoolExecutor>(
+          config.threads,
+          std::make_shared<wangle::NamedThreadFactory>(config.name))) {}
+
+bool ExecutorPool::tryAdd(folly::Func func) {
+  if (queueDepth_.fetch_add(1, std::memory_order_relaxed) >= maxQueueSize_) {
+    queueDepth_.fetch_sub(1, std::memory_order_relaxed);
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  auto queuedAt = steady_clock::now();
+  executor_->add([ this, queuedAt, func = std::move(func) ]() mutable {
+    queueDepth_.fetch_sub(1, std::memory_order_relaxed);
+    started_.fetch_add(1, std::memory_order_relaxed);
+    recordWait(queuedAt);
+    func();
+  });
+  return true;
+}
+
+void ExecutorPool::add(folly::Func func) {
+  auto queuedAt = steady_clock::now();
+  executor_->add([ this, queuedAt, func = std::move(func) ]() mutable {
+    recordWait(queuedAt);
+    func();
+  });
+}
+
+void ExecutorPool::recordWait(steady_clock::time_point queuedAt) {
+  auto waitUs =
+      duration_cast<microseconds>(steady_clock::now() - queuedAt).count();
+  totalWaitUs_.fetch_add(waitUs, std::memory_order_relaxed);
+  auto maxWaitUs = maxWaitUs_.load(std::memory_order_relaxed);
+  while (waitUs > maxWaitUs &&
+         !maxWaitUs_.compare_exchange_weak(maxWaitUs, waitUs,
+                                           std::memory_order_relaxed)) {
+  }
+}
+
+ExecutorPoolStats ExecutorPool::getStats() const {
+  ExecutorPoolStats stats;
+  stats.queueDepth = queueDepth_.load(std::memory_order_relaxed);
+  stats.started = started_.load(std::memory_order_relaxed);
+  stats.rejected = rejected_.load(std::memory_order_relaxed);
+  stats.totalWaitTime =
+      microseconds(totalWaitUs_.load(std::memory_order_relaxed));
+  stats.maxWaitTime = microseconds(maxWaitUs_.load(std::memory_order_relaxed));
+  return stats;
+}
+
+ExecutorPools::ExecutorPools(const vector<ExecutorPoolConfig>& configs) {
+  for (const auto& config : configs) {
+    pools_.emplace(config.name, std::make_unique<ExecutorPool>(config));
+  }
+}
+
+ExecutorPool* ExecutorPools::get(const string& name) const {
+  auto pool = pools_.find(name);
+  return pool == pools_.end() ? nullptr : pool->second.get();
+}
+
+unordered_map<string, ExecutorPoolStats> ExecutorPools::getStats() const {
+  unordered_map<string, ExecutorPoolStats> stats;
+  for (const auto& pool : pools_) {
+    stats.emplace(pool.first, pool.second->getStats());
+  }
+  return stats;
+}
+}
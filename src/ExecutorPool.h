@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <folly/Executor.h>
+#include <wangle/concurrent/CPUThreadPoolExecutor.h>
+
+#include "src/Config.h"
+
+namespace nozomi {
+
+/**
+ * A snapshot of the work done by an ExecutorPool
+ */
+struct ExecutorPoolStats {
+  // The number of functions from tryAdd() waiting for a thread
+  size_t queueDepth = 0;
+  // The number of functions from tryAdd() that have been started
+  uint64_t started = 0;
+  // The number of functions that were rejected because the queue was full
+  uint64_t rejected = 0;
+  // The total and longest time that functions waited for a thread. This
+  // includes the continuations queued with add()
+  std::chrono::microseconds totalWaitTime{0};
+  std::chrono::microseconds maxWaitTime{0};
+};
+
+/**
+ * A named thread pool with a bounded queue. New work is rejected instead
+ * of queued once maxQueueSize functions are waiting, so that one slow set of
+ * routes can't build up an unbounded backlog or starve other routes. Work
+ * that was already admitted, e.g. a coroutine that resumes or a future's
+ * continuation, is always queued, so that it can finish
+ */
+class ExecutorPool : public folly::Executor {
+ private:
+  std::string name_;
+  size_t maxQueueSize_;
+  std::atomic<size_t> queueDepth_{0};
+  std::atomic<uint64_t> started_{0};
+  std::atomic<uint64_t> rejected_{0};
+  std::atomic<int64_t> totalWaitUs_{0};
+  std::atomic<int64_t> maxWaitUs_{0};
+  // Last, so that its threads are joined before the counters are destroyed
+  std::unique_ptr<wangle::CPUThreadPoolExecutor> executor_;
+
+  /**
+   * Adds the time that a function waited for a thread to the stats
+   */
+  void recordWait(std::chrono::steady_clock::time_point queuedAt);
+
+ public:
+  /**
+   * Creates an ExecutorPool, and starts its threads
+   *
+   * @param config - The pool's name, thread count and queue size
+   */
+  explicit ExecutorPool(const ExecutorPoolConfig& config);
+
+  /**
+   * Queues new work to run on one of the pool's threads
+   *
+   * @returns false without queueing func if the queue is full
+   */
+  bool tryAdd(folly::Func func);
+
+  /**
+   * Queues func to run on one of the pool's threads, even if the queue is
+   * full. This is how handlers that were given the pool as their executor
+   * schedule their continuations, so it doesn't take a queue slot.
+   * See folly::Executor::add()
+   */
+  virtual void add(folly::Func func) override;
+
+  inline const std::string& getName() const { return name_; }
+
+  ExecutorPoolStats getStats() const;
+};
+
+/**
+ * The ExecutorPools declared in a Config, by name
+ */
+class ExecutorPools {
+ private:
+  std::unordered_map<std::string, std::unique_ptr<ExecutorPool>> pools_;
+
+ public:
+  /**
+   * Creates an ExecutorPool for each config
+   */
+  explicit ExecutorPools(const std::vector<ExecutorPoolConfig>& configs);
+
+  /**
+   * Returns the pool with a given name, or nullptr if there is none
+   */
+  ExecutorPool* get(const std::string& name) const;
+
+  /**
+   * Returns the stats of every pool, by name
+   */
+  std::unordered_map<std::string, ExecutorPoolStats> getStats() const;
+};
+}
@@ -1,59 +1,247 @@
 #include "src/HTTPHandler.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include <folly/Conv.h>
+#include <folly/futures/Promise.h>
 #include <folly/io/async/EventBaseManager.h>
 #include <proxygen/httpserver/ResponseBuilder.h>
 
 #include <glog/logging.h>
 
+#include "src/HTTPHandlerPool.h"
+
 using folly::EventBase;
 using folly::EventBaseManager;
 using folly::Executor;
 using folly::Future;
 using folly::IOBuf;
+using folly::Promise;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
 using std::shared_ptr;
 using std::unique_ptr;
+using proxygen::HTTPHeaderCode;
 using proxygen::HTTPMessage;
 using proxygen::ProxygenError;
 using proxygen::ResponseBuilder;
 
 namespace nozomi {
 
-HTTPHandler::HTTPHandler(
-    std::chrono::milliseconds timeout,
-    Router* router,
-    std::function<Future<HTTPResponse>(const HTTPRequest&)> handler,
-    EventBase* responseEvb,
-    Executor* ioExecutor)
+constexpr size_t HTTPHandler::kMaxPreallocatedBodySize;
+constexpr size_t HTTPHandler::kMaxPooledBodySize;
+
+folly::Optional<size_t> get_content_length(const HTTPMessage& message) {
+  const auto& value = message.getHeaders().getSingleOrEmpty(
+      HTTPHeaderCode::HTTP_HEADER_CONTENT_LENGTH);
+  if (value.empty()) {
+    return folly::Optional<size_t>();
+  }
+  try {
+    return folly::to<size_t>(value);
+  } catch (const std::exception&) {
+    return folly::Optional<size_t>();
+  }
+}
+
+HTTPHandler::HTTPHandler(std::chrono::milliseconds timeout,
+                         Router* router,
+                         RouteHandler handler,
+                         EventBase* responseEvb,
+                         Executor* ioExecutor,
+                         ExecutorPools* executorPools,
+                         AdmissionController* admission,
+                         size_t maxBodySize,
+                         size_t arenaBlockSize)
     : timeout_(timeout),
       router_(router),
       handler_(std::move(handler)),
       body_(IOBuf::create(0)),
+      maxBodySize_(maxBodySize),
+      arenaBlockSize_(arenaBlockSize),
       responseEvb_(responseEvb),
-      ioExecutor_(ioExecutor) {
+      ioExecutor_(ioExecutor),
+      executorPools_(executorPools),
+      admission_(admission),
+      createdAt_(admission != nullptr ? steady_clock::now()
+                                      : steady_clock::time_point()) {
   DCHECK(router != nullptr);
 }
 
-void HTTPHandler::sendResponse(const HTTPResponse& response) {
-  // TODO: Add headers to response if missing
-  // Yes, this copies the headers object, but I'd rather have a clean
-  // response builder ATM
-  auto builder = ResponseBuilder(downstream_);
-  builder.status(response.getStatusCode(), "");
-  response.getHeaders().getHeaders().forEach(
-      [&builder](const auto& header, const auto& value) {
-        builder.header(header, value);
-      });
+HTTPHandler::HTTPHandler(std::chrono::milliseconds timeout,
+                         Router* router,
+                         RouteHandler handler,
+                         proxygen::HTTPMethod method,
+                         std::shared_ptr<const std::string> path,
+                         EventBase* responseEvb,
+                         Executor* ioExecutor,
+                         ExecutorPools* executorPools,
+                         AdmissionController* admission,
+                         size_t maxBodySize,
+                         size_t arenaBlockSize)
+    : HTTPHandler(timeout,
+                  router,
+                  std::move(handler),
+                  responseEvb,
+                  ioExecutor,
+                  executorPools,
+                  admission,
+                  maxBodySize,
+                  arenaBlockSize) {
+  method_ = method;
+  path_ = std::move(path);
+}
+
+HTTPHandler::~HTTPHandler() noexcept {
+  releaseAdmission();
+}
+
+void HTTPHandler::reset(std::chrono::milliseconds timeout,
+                        Router* router,
+                        RouteHandler handler,
+                        proxygen::HTTPMethod method,
+                        std::shared_ptr<const std::string> path,
+                        EventBase* responseEvb,
+                        Executor* ioExecutor,
+                        ExecutorPools* executorPools,
+                        AdmissionController* admission,
+                        size_t maxBodySize,
+                        size_t arenaBlockSize) {
+  DCHECK(router != nullptr);
+  DCHECK(message_ == nullptr && !request_ && pending_ == 0);
+  timeout_ = timeout;
+  router_ = router;
+  handler_ = std::move(handler);
+  method_ = method;
+  path_ = std::move(path);
+  responseEvb_ = responseEvb;
+  ioExecutor_ = ioExecutor;
+  executorPools_ = executorPools;
+  admission_ = admission;
+  maxBodySize_ = maxBodySize;
+  arenaBlockSize_ = arenaBlockSize;
+  createdAt_ = admission != nullptr ? steady_clock::now()
+                                    : steady_clock::time_point();
+}
 
-  builder.body(response.getBody()).sendWithEOM();
+void HTTPHandler::recycle() {
+  releaseAdmission();
+  auto body = request_ ? request_->releaseBody() : std::move(body_);
+  request_.clear();
+  message_.reset();
+  path_.reset();
+  handler_ = RouteHandler();
+  response_ = folly::makeFuture();
+  bodySize_ = 0;
+  rejected_ = false;
+  timedOut_ = false;
+  detached_ = false;
+  deadline_.cancelTimeout();
+  downstream_ = nullptr;
+
+  if (body != nullptr && !body->isChained() && !body->isSharedOne() &&
+      body->capacity() <= kMaxPooledBodySize) {
+    body->clear();
+    body_ = std::move(body);
+  } else {
+    body_ = IOBuf::create(0);
+  }
+}
+
+void HTTPHandler::releaseAdmission() {
+  if (admission_ != nullptr) {
+    admission_->release(
+        duration_cast<microseconds>(steady_clock::now() - createdAt_));
+    admission_ = nullptr;
+  }
+}
+
+void HTTPHandler::finish() {
+  if (pending_ > 0) {
+    // Nobody will read the response, but the handler may still be running,
+    // and will use this object when it completes
+    detached_ = true;
+    cancel();
+    response_.cancel();
+    return;
+  }
+  deadline_.cancelTimeout();
+  if (pool_ == nullptr) {
+    delete this;
+  } else {
+    auto pool = std::move(pool_);
+    pool->release(this);
+  }
+}
+
+void HTTPHandler::sendResponse(HTTPResponse response) {
+  // The message and body are moved straight to proxygen, instead of being
+  // copied into a ResponseBuilder
+  auto body = std::move(response).getBody();
+  auto message = std::move(response).getHeaders();
+  message.setHTTPVersion(1, 1);
+  auto& headers = message.getHeaders();
+  if (!headers.exists(HTTPHeaderCode::HTTP_HEADER_CONTENT_LENGTH)) {
+    headers.set(HTTPHeaderCode::HTTP_HEADER_CONTENT_LENGTH,
+                folly::to<std::string>(
+                    body != nullptr ? body->computeChainDataLength() : 0));
+  }
+  if (rejected_) {
+    // The client may still be sending a body that is never going to be
+    // read, so the connection is closed once the response is sent instead
+    // of reading and dropping the rest of the upload
+    headers.set(HTTPHeaderCode::HTTP_HEADER_CONNECTION, "close");
+  }
+
+  downstream_->sendHeaders(message);
+  if (body != nullptr) {
+    downstream_->sendBody(std::move(body));
+  }
+  downstream_->sendEOM();
 }
 
 void HTTPHandler::onRequest(unique_ptr<HTTPMessage> headers) noexcept {
   DCHECK(message_ == nullptr);
   message_ = std::move(headers);
+
+  auto contentLength = get_content_length(*message_);
+  if (contentLength && *contentLength > maxBodySize_) {
+    // Rejected before any of the body is buffered. HTTPHandlerFactory drops
+    // the Expect header of these requests, so proxygen doesn't tell the
+    // client to continue
+    reject(413);
+    return;
+  }
+
+  if (contentLength && *contentLength > 0 &&
+      *contentLength <= kMaxPreallocatedBodySize &&
+      *contentLength > body_->tailroom()) {
+    body_ = IOBuf::create(*contentLength);
+  }
 };
 
 void HTTPHandler::onBody(unique_ptr<IOBuf> body) noexcept {
-  body_->prependChain(std::move(body));
+  if (rejected_) {
+    return;
+  }
+  auto length = body->computeChainDataLength();
+  bodySize_ += length;
+  if (bodySize_ > maxBodySize_) {
+    reject(413);
+    return;
+  }
+  if (length <= body_->tailroom() && !body_->isChained()) {
+    // Fill the buffer that was allocated from the Content-Length
+    for (const auto& buf : *body) {
+      std::memcpy(body_->writableTail(), buf.data(), buf.size());
+      body_->append(buf.size());
+    }
+  } else {
+    body_->prependChain(std::move(body));
+  }
 };
 
 void HTTPHandler::onUpgrade(proxygen::UpgradeProtocol ) noexcept {
@@ -61,8 +249,40 @@ void HTTPHandler::onUpgrade(proxygen::UpgradeProtocol ) noexcept {
 };
 
 void HTTPHandler::onEOM() noexcept {
-  request_ = HTTPRequest(std::move(message_), std::move(body_));
+  if (rejected_) {
+    return;
+  }
+  makeRequest(std::move(body_));
+
+  auto* evb = getResponseEvb();
+  const auto& policy = handler_.getExecutionPolicy();
+  if (admission_ != nullptr) {
+    eomAt_ = steady_clock::now();
+  }
+  if (policy.mode == ExecutionMode::Inline) {
+    if (admission_ != nullptr) {
+      admission_->onStart(microseconds(0), eomAt_);
+    }
+    // Inline handlers usually return a future that is already complete, so
+    // the response is sent right away without going back through the evb
+    auto response = folly::makeFutureWith(
+        [this, evb]() { return handler_(*request_, evb); });
+    if (response.isReady() && response.hasValue()) {
+      sendResponse(std::move(response.value()));
+      return;
+    }
+    respondWith(std::move(response), evb);
+  } else if (policy.mode == ExecutionMode::Pool) {
+    runOnPool(policy.poolName, evb);
+  } else {
+    auto* executor = getExecutor(policy);
+    respondWith(
+        via(executor, [this, executor]() { return callHandler(executor); }),
+        evb);
+  }
+};
 
+EventBase* HTTPHandler::getResponseEvb() const {
   /*
    * We have to pull in the evb from the EventBaseManager because the evb
    * that we're handed in the factory is not the one that we need to use to
@@ -70,34 +290,168 @@ void HTTPHandler::onEOM() noexcept {
    * response handler calls "runInLoop", which will break if we're running
    * in the wrong thread.
    */
-  auto* evb = responseEvb_ != nullptr ? responseEvb_
-                                      : EventBaseManager::get()->getEventBase();
-  response_ = via(ioExecutor_, [this]() { return handler_(*request_); })
+  return responseEvb_ != nullptr ? responseEvb_
+                                 : EventBaseManager::get()->getEventBase();
+}
+
+void HTTPHandler::makeRequest(unique_ptr<IOBuf> body) {
+  if (path_) {
+    request_.emplace(std::move(message_), std::move(body), method_,
+                     std::move(path_), arenaBlockSize_);
+  } else {
+    request_.emplace(std::move(message_), std::move(body), arenaBlockSize_);
+  }
+  deadlineAt_ = steady_clock::now() + timeout_;
+  request_->setDeadline(deadlineAt_);
+}
+
+void HTTPHandler::reject(int statusCode) {
+  DCHECK(!rejected_);
+  rejected_ = true;
+  body_.reset();
+  makeRequest(IOBuf::create(0));
+  respondWith(folly::makeFutureWith([this, statusCode]() {
+                return router_->getErrorHandler(statusCode)(*request_);
+              }),
+              getResponseEvb());
+}
+
+Executor* HTTPHandler::getExecutor(const ExecutionPolicy& policy) const {
+  switch (policy.mode) {
+    case ExecutionMode::CPUPool:
+      return wangle::getCPUExecutor().get();
+    case ExecutionMode::Custom:
+      return policy.executor;
+    case ExecutionMode::Inline:
+    case ExecutionMode::IOExecutor:
+    case ExecutionMode::Pool:
+      break;
+  }
+  return ioExecutor_;
+}
+
+void HTTPHandler::runOnPool(const std::string& poolName, EventBase* evb) {
+  auto* pool =
+      executorPools_ != nullptr ? executorPools_->get(poolName) : nullptr;
+  if (pool == nullptr) {
+    LOG(ERROR) << "No executor pool named " << poolName;
+    respondWith(folly::makeFutureWith([this]() {
+                  return router_->getErrorHandler(500)(*request_);
+                }),
+                evb);
+    return;
+  }
+
+  auto promise = std::make_shared<Promise<HTTPResponse>>();
+  auto response = promise->getFuture();
+  auto added = pool->tryAdd([this, pool, promise]() {
+    folly::makeFutureWith([this, pool]() { return callHandler(pool); })
+        .then([promise](folly::Try<HTTPResponse>&& result) {
+          promise->setTry(std::move(result));
+        });
+  });
+  if (!added) {
+    response = folly::makeFutureWith(
+        [this]() { return router_->getErrorHandler(503)(*request_); });
+  }
+  respondWith(std::move(response), evb);
+}
+
+void HTTPHandler::reportStart() {
+  if (admission_ != nullptr) {
+    auto now = steady_clock::now();
+    admission_->onStart(duration_cast<microseconds>(now - eomAt_), now);
+  }
+}
+
+Future<HTTPResponse> HTTPHandler::callHandler(Executor* executor) {
+  reportStart();
+  if (request_->isCancelled()) {
+    // Nobody is waiting for the response, so don't use a worker on it
+    return folly::makeFuture<HTTPResponse>(folly::FutureCancellation());
+  }
+  return handler_(*request_, executor);
+}
+
+void HTTPHandler::cancel() {
+  if (request_) {
+    request_->cancel();
+  }
+}
+
+void HTTPHandler::respondWith(Future<HTTPResponse> response, EventBase* evb) {
+  ++pending_;
+  if (!deadline_.isScheduled()) {
+    auto remaining =
+        duration_cast<milliseconds>(deadlineAt_ - steady_clock::now());
+    evb->timer().scheduleTimeout(&deadline_,
+                                 std::max(remaining, milliseconds(0)));
+  }
+  response_ = std::move(response)
                   .onError([this](const std::exception& e) {
                     return router_->getErrorHandler(500)(*request_);
                   })
-                  .onTimeout(timeout_,
-                             [this]() {
-                               return router_->getErrorHandler(503)(*request_);
-                             })
                   .onError([](const std::exception& e) {
                     return HTTPResponse(500, "Unknown error");
                   })
-                  .then(evb, [this, evb](const HTTPResponse& response) {
-                    sendResponse(response);
+                  .then(evb, [this](HTTPResponse&& response) {
+                    complete(std::move(response), false);
                   });
-};
+}
+
+void HTTPHandler::onDeadline() {
+  if (timedOut_ || detached_ || pending_ == 0) {
+    return;
+  }
+  timedOut_ = true;
+  cancel();
+  ++pending_;
+  folly::makeFutureWith(
+      [this]() { return router_->getErrorHandler(503)(*request_); })
+      .onError([](const std::exception& e) {
+        return HTTPResponse(500, "Unknown error");
+      })
+      .then(getResponseEvb(), [this](HTTPResponse&& response) {
+        complete(std::move(response), true);
+      });
+}
+
+void HTTPHandler::complete(HTTPResponse&& response, bool fromDeadline) {
+  DCHECK(pending_ > 0);
+  if (!fromDeadline && !detached_ && !timedOut_ &&
+      steady_clock::now() >= deadlineAt_) {
+    // The timer may not have run yet if this thread was busy. This response
+    // still counts as pending here, so that onDeadline() sends the 503
+    onDeadline();
+  }
+  --pending_;
+  if (detached_) {
+    // The client is gone, and proxygen is done with us
+    if (pending_ == 0) {
+      finish();
+    }
+    return;
+  }
+  if (!fromDeadline && timedOut_) {
+    // Too late, the 503 response was already chosen
+    return;
+  }
+  deadline_.cancelTimeout();
+  sendResponse(std::move(response));
+}
 
 void HTTPHandler::requestComplete() noexcept {
-  // This is not called until after the response is sent,
-  // so deleting here is fine. This is the pattern that's
-  // used in all of the proxygen example code
-  delete this;
+  // This is not called until after the response is sent, so the handler
+  // can be deleted or pooled here, unless a handler that timed out is still
+  // running. This is the pattern that's used in all of the proxygen example
+  // code
+  finish();
 };
 
 void HTTPHandler::onError(ProxygenError ) noexcept {
   // Once this is called, no other callbacks will be run, so it's safe to
-  // delete here. This is the pattern used in proxygen example code
-  delete this;
+  // delete or pool the handler here. If the response is still being
+  // computed, finish() cancels it instead
+  finish();
 };
 }
@@ -1,45 +1,222 @@
 #pragma once
 
 #include <chrono>
+#include <limits>
 #include <memory>
+#include <string>
 
 #include <folly/Optional.h>
 #include <folly/io/IOBuf.h>
 #include <folly/io/async/EventBase.h>
+#include <folly/io/async/HHWheelTimer.h>
 #include <proxygen/httpserver/RequestHandler.h>
 #include <proxygen/lib/http/HTTPMessage.h>
+#include <proxygen/lib/http/HTTPMethod.h>
 #include <wangle/concurrent/GlobalExecutor.h>
 
+#include "src/AdmissionController.h"
+#include "src/ExecutionPolicy.h"
+#include "src/ExecutorPool.h"
 #include "src/Router.h"
 
 namespace nozomi {
 
+class HTTPHandlerPool;
+
+/**
+ * Returns the request's Content-Length, or none if it is missing or not a
+ * number
+ *
+ * @param message - The request's headers
+ */
+folly::Optional<size_t> get_content_length(
+    const proxygen::HTTPMessage& message);
+
 /**
  * Class that waits for the headers and body to arrive before calling
  * a user-defined handler, and sending that response back. Handlers
- * run asynchronously on a threadpool and handlers must return futures
- * in order to be valid.
+ * run asynchronously on the executor from their route's ExecutionPolicy,
+ * or directly on the connection's thread for ExecutionMode::Inline, and
+ * handlers must return futures in order to be valid.
  */
 class HTTPHandler : public virtual proxygen::RequestHandler {
+ public:
+  /**
+   * Bodies with a Content-Length up to this size are read into one buffer
+   * that is allocated when the headers arrive
+   */
+  static constexpr size_t kMaxPreallocatedBodySize = 256 * 1024;
+  /**
+   * A pooled handler keeps its body buffer for the next request if it is
+   * no larger than this. Larger buffers are freed, so that idle handlers
+   * don't hold on to the memory of a burst of uploads
+   */
+  static constexpr size_t kMaxPooledBodySize = 8 * 1024;
+
  private:
   std::chrono::milliseconds timeout_;
   Router* router_;
-  std::function<folly::Future<HTTPResponse>(const HTTPRequest&)> handler_;
+  RouteHandler handler_;
   std::unique_ptr<folly::IOBuf> body_;
+  size_t bodySize_ = 0;
+  size_t maxBodySize_;
+  size_t arenaBlockSize_;
+  // Set once a response was sent before the request finished arriving
+  bool rejected_ = false;
   folly::EventBase* responseEvb_;
   folly::Executor* ioExecutor_;
+  ExecutorPools* executorPools_;
+  AdmissionController* admission_;
+  std::chrono::steady_clock::time_point createdAt_;
+  std::chrono::steady_clock::time_point eomAt_;
+  // Set if this handler is returned to a pool instead of being deleted. It
+  // keeps the pool alive for handlers that finish after its owner is gone
+  std::shared_ptr<HTTPHandlerPool> pool_;
+  // The number of response futures that will still use this object
+  size_t pending_ = 0;
+  // Set once the deadline passed, and the router's 503 response was chosen
+  bool timedOut_ = false;
+  // Set if proxygen was done with the handler while a response was pending.
+  // The handler is finished once the last response completes instead
+  bool detached_ = false;
+
+  /**
+   * Calls onDeadline() when the request's deadline passes. Scheduled on the
+   * connection's HHWheelTimer, so no timer is registered with, or called
+   * back from, another thread
+   */
+  class DeadlineCallback : public folly::HHWheelTimer::Callback {
+   public:
+    explicit DeadlineCallback(HTTPHandler* handler) : handler_(handler) {}
+    virtual void timeoutExpired() noexcept override { handler_->onDeadline(); }
+    virtual void callbackCanceled() noexcept override {}
+
+   private:
+    HTTPHandler* handler_;
+  };
+
+  DeadlineCallback deadline_{this};
+  std::chrono::steady_clock::time_point deadlineAt_;
 
   std::unique_ptr<proxygen::HTTPMessage> message_;
+  proxygen::HTTPMethod method_ = proxygen::HTTPMethod::GET;
+  std::shared_ptr<const std::string> path_;
 
   folly::Future<folly::Unit> response_;
   folly::Optional<HTTPRequest> request_;
 
+  friend class HTTPHandlerPool;
+
+  /**
+   * Sets up a handler from a pool for a new request. Takes the same
+   * arguments as the constructor for routed requests
+   */
+  void reset(std::chrono::milliseconds timeout,
+             Router* router,
+             RouteHandler handler,
+             proxygen::HTTPMethod method,
+             std::shared_ptr<const std::string> path,
+             folly::EventBase* responseEvb,
+             folly::Executor* ioExecutor,
+             ExecutorPools* executorPools,
+             AdmissionController* admission,
+             size_t maxBodySize,
+             size_t arenaBlockSize);
+
+  /**
+   * Drops the finished request's state so the handler can be pooled. The
+   * body buffer is kept if it is small and nobody else holds it
+   */
+  void recycle();
+
+  /**
+   * Releases the request's admission, if it has one
+   */
+  void releaseAdmission();
+
+  /**
+   * Returns this handler to its pool, or deletes it. Called once proxygen
+   * is done with the handler. If a response is still pending, the request
+   * is cancelled, and the handler is finished once that response completes
+   */
+  void finish();
+
+  /**
+   * Returns the event base that responses are sent on
+   */
+  folly::EventBase* getResponseEvb() const;
+
+  /**
+   * Builds request_ from the headers, and the body that was read
+   */
+  void makeRequest(std::unique_ptr<folly::IOBuf> body);
+
+  /**
+   * Sends the router's handler's response for statusCode before the body
+   * has been read, and ignores the rest of the request. The response
+   * closes the connection
+   */
+  void reject(int statusCode);
+
+  /**
+   * Returns the executor that a handler with the given policy runs on.
+   * Not used for ExecutionMode::Inline
+   */
+  folly::Executor* getExecutor(const ExecutionPolicy& policy) const;
+
+  /**
+   * Runs the handler on the named ExecutorPool, and sends its response on
+   * evb. If the pool's queue is full, the router's 503 handler is used
+   * instead, without queueing anything
+   */
+  void runOnPool(const std::string& poolName, folly::EventBase* evb);
+
+  /**
+   * Tells the AdmissionController how long the handler waited to start
+   * after the request was read
+   */
+  void reportStart();
+
+  /**
+   * Calls the handler on executor, unless the request was cancelled while
+   * it was queued
+   */
+  folly::Future<HTTPResponse> callHandler(folly::Executor* executor);
+
+  /**
+   * Cancels the request's token, and interrupts the pending response, once
+   * nobody is waiting for the response
+   */
+  void cancel();
+
+  /**
+   * Sends response on evb once it completes, or the error handler's
+   * response if it fails. The router's 503 response is sent instead if the
+   * request's deadline passes first
+   */
+  void respondWith(folly::Future<HTTPResponse> response, folly::EventBase* evb);
+
+  /**
+   * Cancels the request, and sends the router's 503 response, unless a
+   * response was already sent
+   */
+  void onDeadline();
+
+  /**
+   * Called on the connection's thread when a pending response completes
+   *
+   * @param response - The response
+   * @param fromDeadline - Whether this is the 503 response from onDeadline()
+   */
+  void complete(HTTPResponse&& response, bool fromDeadline);
+
  public:
   /**
    * Creates an HTTPHandler instance
    *
-   * @param timeout - How long to wait for the handler to complete. A 503
-   *                  is sent if this timeout is exceeded
+   * @param timeout - How long to wait for the handler to complete, from
+   *                  when the request has been read. A 503 is sent if this
+   *                  timeout is exceeded. See HTTPRequest::getDeadline()
    * @param router  - The router that was used to create handler. Used
    *                  primarly for fetching error handlers
    * @param handler - The handler to call once the request metadata and body
@@ -48,23 +225,60 @@ class HTTPHandler : public virtual proxygen::RequestHandler {
    *                      out on. If nullptr, the handler will pull an
    *                      EventBase from the EventBase manager before calling
    *                      handler
-   * @param ioExecutor - The executor where handler should be run. If not
+   * @param ioExecutor - The executor where handlers with the default
+   *                     ExecutionMode::IOExecutor policy are run. If not
    *                     provided, the wangle global IO threadpool is used.
+   * @param executorPools - The pools for handlers with an
+   *                        ExecutionMode::Pool policy. Those handlers get a
+   *                        500 if this is nullptr or has no such pool
+   * @param admission - If set, the request was admitted by this
+   *                    controller, and is released when the handler is
+   *                    destroyed
+   * @param maxBodySize - Requests whose Content-Length or body is larger
+   *                      than this many bytes get the router's 413 handler
+   *                      without the handler being called
+   * @param arenaBlockSize - The block size of the request's arena
+   */
+  HTTPHandler(std::chrono::milliseconds timeout,
+              Router* router,
+              RouteHandler handler,
+              folly::EventBase* responseEvb = nullptr,
+              folly::Executor* ioExecutor = wangle::getIOExecutor().get(),
+              ExecutorPools* executorPools = nullptr,
+              AdmissionController* admission = nullptr,
+              size_t maxBodySize = std::numeric_limits<size_t>::max(),
+              size_t arenaBlockSize = RequestArena::kDefaultBlockSize);
+
+  /**
+   * Creates an HTTPHandler instance for a request that was already routed.
+   * The method and decoded path from the RoutingContext are handed to the
+   * HTTPRequest, so that the path is not decoded again.
+   *
+   * @param method - The method that was used for routing
+   * @param path - The decoded path that was used for routing
+   *
+   * See above for the other parameters
    */
-  HTTPHandler(
-      std::chrono::milliseconds timeout,
-      Router* router,
-      std::function<folly::Future<HTTPResponse>(const HTTPRequest&)> handler,
-      folly::EventBase* responseEvb = nullptr,
-      folly::Executor* ioExecutor = wangle::getIOExecutor().get());
-  virtual ~HTTPHandler() noexcept {}
+  HTTPHandler(std::chrono::milliseconds timeout,
+              Router* router,
+              RouteHandler handler,
+              proxygen::HTTPMethod method,
+              std::shared_ptr<const std::string> path,
+              folly::EventBase* responseEvb = nullptr,
+              folly::Executor* ioExecutor = wangle::getIOExecutor().get(),
+              ExecutorPools* executorPools = nullptr,
+              AdmissionController* admission = nullptr,
+              size_t maxBodySize = std::numeric_limits<size_t>::max(),
+              size_t arenaBlockSize = RequestArena::kDefaultBlockSize);
+  virtual ~HTTPHandler() noexcept;
 
   /**
-   * Sends the response back to the user. This should only be invoked on
-   * the correct IO thread, lest the proxygen ResponseBuilder will cause
-   * problems.
+   * Sends the response back to the user, with a Content-Length for its
+   * body. The response's message and body are handed to proxygen without
+   * being copied. This should only be invoked on the correct IO thread,
+   * lest proxygen will cause problems.
    */
-  void sendResponse(const HTTPResponse& response);
+  void sendResponse(HTTPResponse response);
 
   /**
    * @copydoc proxygen::RequestHandler::onRequest()
@@ -93,7 +307,9 @@ class HTTPHandler : public virtual proxygen::RequestHandler {
   virtual void requestComplete() noexcept override;
 
   /**
-   * @copydoc proxygen::RequestHandler::onError()
+   * Cancels the request if the client went away while its response was
+   * pending, and finishes the handler. See
+   * HTTPRequest::getCancellationToken()
    */
   virtual void onError(proxygen::ProxygenError err) noexcept override;
 };
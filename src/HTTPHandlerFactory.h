@@ -1,12 +1,21 @@
+#include <memory>
+#include <type_traits>
+#include <utility>
+
 #include <folly/io/async/EventBase.h>
 #include <glog/logging.h>
 #include <proxygen/httpserver/RequestHandler.h>
 #include <proxygen/httpserver/RequestHandlerFactory.h>
 #include <proxygen/lib/http/HTTPMessage.h>
 
+#include "src/AdmissionController.h"
 #include "src/Config.h"
+#include "src/ExecutorPool.h"
 #include "src/HTTPHandler.h"
+#include "src/HTTPHandlerPool.h"
+#include "src/RejectedRequestHandler.h"
 #include "src/Router.h"
+#include "src/RoutingContext.h"
 
 namespace nozomi {
 
@@ -21,17 +30,65 @@ class HTTPHandlerFactory : public virtual proxygen::RequestHandlerFactory {
  private:
   Config config_;
   Router router_;
+  std::shared_ptr<ExecutorPools> executorPools_;
+  std::shared_ptr<AdmissionController> admission_;
+  std::unique_ptr<folly::IOBuf> rejectedBody_;
+  std::shared_ptr<HTTPHandlerPools> handlerPools_;
   folly::EventBase* evb_;
 
+  /**
+   * HTTPHandlers come from the calling thread's pool
+   */
+  template <typename... Args>
+  HandlerType* createHandler(std::true_type, Args&&... args) {
+    return handlerPools_->local().acquire(std::forward<Args>(args)...);
+  }
+
+  /**
+   * Other handler types are allocated for each request
+   */
+  template <typename... Args>
+  HandlerType* createHandler(std::false_type, Args&&... args) {
+    return new HandlerType(std::forward<Args>(args)...);
+  }
+
  public:
   /**
    * Creates an HTTPHandlerFactory
    *
    * @param config - The server configuration
    * @param router - The router object to use to fetch handlers
+   * @param executorPools - The pools that routes with an
+   *                        ExecutionMode::Pool policy run on. If not
+   *                        provided, they are created from config
+   * @param admission - Decides which non-streaming requests are shed with
+   *                    a 503 before they are routed to a handler. If not
+   *                    provided, it is created from config
+   * @param handlerPools - Where finished HTTPHandlers are kept for reuse.
+   *                       Not used for other handler types. If not
+   *                       provided, they are created from config
    */
-  HTTPHandlerFactory(Config config, Router router)
-      : config_(std::move(config)), router_(std::move(router)) {}
+  HTTPHandlerFactory(
+      Config config,
+      Router router,
+      std::shared_ptr<ExecutorPools> executorPools = nullptr,
+      std::shared_ptr<AdmissionController> admission = nullptr,
+      std::shared_ptr<HTTPHandlerPools> handlerPools = nullptr)
+      : config_(std::move(config)),
+        router_(std::move(router)),
+        executorPools_(executorPools != nullptr
+                           ? std::move(executorPools)
+                           : std::make_shared<ExecutorPools>(
+                                 config_.getExecutorPools())),
+        admission_(admission != nullptr
+                       ? std::move(admission)
+                       : std::make_shared<AdmissionController>(
+                             config_.getAdmission())),
+        rejectedBody_(RejectedRequestHandler::makeBody()),
+        handlerPools_(handlerPools != nullptr
+                          ? std::move(handlerPools)
+                          : std::make_shared<HTTPHandlerPools>(
+                                config_.getMaxPooledHandlers())) {}
 
   /**
    * @copydoc proxygen::RequestHandlerFactory::onServerStart()
@@ -53,15 +110,37 @@ class HTTPHandlerFactory : public virtual proxygen::RequestHandlerFactory {
   proxygen::RequestHandler* onRequest(proxygen::RequestHandler* previousHandler,
                                       proxygen::HTTPMessage* message) noexcept {
     DCHECK(message != nullptr);
-    auto routeMatch = router_.getHandler(message);
+    RoutingContext context(message);
+    auto routeMatch = router_.getHandler(context);
     DCHECK((bool)routeMatch.handler || (bool)routeMatch.streamingHandler)
         << "Neither handler nor streamingHandler were set in "
            "HTTPHandlerFactory";
     // TODO: Error handling if streamingHandler() blows up, or if somehow
     // neither of those two handlers are set
     if (routeMatch.handler) {
-      return new HandlerType(config_.getRequestTimeout(), &router_,
-                             std::move(routeMatch.handler));
+      // Shedding happens here, on the connection's thread, so a rejected
+      // request never reaches an executor
+      if (!admission_->tryAcquire()) {
+        return new RejectedRequestHandler(*rejectedBody_);
+      }
+      auto maxBodySize = routeMatch.handler.getMaxBodySize().value_or(
+          config_.getMaxBodySize());
+      auto contentLength = get_content_length(*message);
+      if (contentLength && *contentLength > maxBodySize) {
+        // proxygen answers Expect: 100-continue before the handler sees the
+        // request. Without the header, the handler's 413 is the only answer,
+        // and a client that waits to be told to continue never sends the body
+        message->getHeaders().remove(
+            proxygen::HTTPHeaderCode::HTTP_HEADER_EXPECT);
+      }
+      auto timeout = routeMatch.handler.getTimeout().value_or(
+          config_.getRequestTimeout());
+      return createHandler(std::is_same<HandlerType, HTTPHandler>(), timeout,
+                           &router_, std::move(routeMatch.handler),
+                           context.getMethod(), context.releasePath(), nullptr,
+                           wangle::getIOExecutor().get(), executorPools_.get(),
+                           admission_.get(), maxBodySize,
+                           config_.getArenaBlockSize());
     } else if (routeMatch.streamingHandler) {
       // TODO: If streamingHandler is null, we need to instead return
       //      a default handler that returns a 500
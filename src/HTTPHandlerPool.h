@@ -0,0 +1,187 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <folly/ThreadLocal.h>
+#include <glog/logging.h>
+
+#include "src/HTTPHandler.h"
+
+namespace nozomi {
+
+/**
+ * A snapshot of one thread's HTTPHandlerPool
+ */
+struct HTTPHandlerPoolStats {
+  // The number of idle handlers that are waiting to be reused
+  size_t pooled = 0;
+  // The number of handlers that had to be allocated, and that were reused
+  uint64_t created = 0;
+  uint64_t reused = 0;
+  // The number of finished handlers that were deleted because the pool was
+  // full
+  uint64_t dropped = 0;
+};
+
+/**
+ * A free list of HTTPHandlers for one EventBase thread. Finished handlers
+ * are returned to it from requestComplete() or onError() instead of being
+ * deleted, and keep their body buffer, so steady state requests don't
+ * allocate a handler or a small body. Only the owning thread may acquire
+ * and release handlers, but stats can be read from any thread. Handlers
+ * keep their pool alive, and once the pool is closed, finished handlers
+ * are deleted instead of being kept
+ */
+class HTTPHandlerPool : public std::enable_shared_from_this<HTTPHandlerPool> {
+ private:
+  size_t maxSize_;
+  std::atomic<bool> closed_{false};
+  std::vector<std::unique_ptr<HTTPHandler>> free_;
+  std::atomic<size_t> pooled_{0};
+  std::atomic<uint64_t> created_{0};
+  std::atomic<uint64_t> reused_{0};
+  std::atomic<uint64_t> dropped_{0};
+
+ public:
+  /**
+   * Creates an HTTPHandlerPool
+   *
+   * @param maxSize - The most idle handlers to keep
+   */
+  explicit HTTPHandlerPool(size_t maxSize) : maxSize_(maxSize) {
+    free_.reserve(maxSize_);
+  }
+
+  HTTPHandlerPool(const HTTPHandlerPool&) = delete;
+  HTTPHandlerPool& operator=(const HTTPHandlerPool&) = delete;
+
+  /**
+   * Returns an idle handler that was reset with args, or a new one if
+   * there are none. See HTTPHandler's constructors for the arguments
+   */
+  template <typename... Args>
+  HTTPHandler* acquire(Args&&... args) {
+    HTTPHandler* handler;
+    if (free_.empty()) {
+      created_.fetch_add(1, std::memory_order_relaxed);
+      handler = new HTTPHandler(std::forward<Args>(args)...);
+    } else {
+      reused_.fetch_add(1, std::memory_order_relaxed);
+      handler = free_.back().release();
+      free_.pop_back();
+      pooled_.store(free_.size(), std::memory_order_relaxed);
+      handler->reset(std::forward<Args>(args)...);
+    }
+    handler->pool_ = shared_from_this();
+    return handler;
+  }
+
+  /**
+   * Takes back a finished handler, or deletes it if the pool is full or
+   * closed. The handler must have given up its reference to the pool
+   */
+  void release(HTTPHandler* handler) {
+    DCHECK(handler != nullptr && handler->pool_ == nullptr);
+    if (free_.size() >= maxSize_ || closed_.load(std::memory_order_acquire)) {
+      drop(handler);
+      return;
+    }
+    handler->recycle();
+    free_.emplace_back(handler);
+    pooled_.store(free_.size(), std::memory_order_relaxed);
+  }
+
+  /**
+   * Deletes a finished handler that could not be reused
+   */
+  void drop(HTTPHandler* handler) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    delete handler;
+  }
+
+  /**
+   * Stops keeping finished handlers. Called from any thread once the
+   * pool's owner is destroyed
+   */
+  void close() { closed_.store(true, std::memory_order_release); }
+
+  HTTPHandlerPoolStats getStats() const {
+    HTTPHandlerPoolStats stats;
+    stats.pooled = pooled_.load(std::memory_order_relaxed);
+    stats.created = created_.load(std::memory_order_relaxed);
+    stats.reused = reused_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    return stats;
+  }
+};
+
+/**
+ * The HTTPHandlerPool of every thread that has handled a request. Each
+ * EventBase runs on its own thread, so this is a pool per EventBase. A
+ * thread that serves more than one HTTPHandlerPools, e.g. for two Servers,
+ * keeps a pool for each of them
+ */
+class HTTPHandlerPools {
+ private:
+  size_t maxSize_;
+  mutable std::mutex mutex_;
+  std::vector<std::shared_ptr<HTTPHandlerPool>> pools_;
+  // Each thread's pool, for this object only
+  folly::ThreadLocal<std::shared_ptr<HTTPHandlerPool>> local_;
+
+ public:
+  /**
+   * Creates an HTTPHandlerPools. Pools are created as threads need them
+   *
+   * @param maxSize - The most idle handlers that each thread keeps. See
+   *                  Config::getMaxPooledHandlers()
+   */
+  explicit HTTPHandlerPools(size_t maxSize) : maxSize_(maxSize) {}
+
+  HTTPHandlerPools(const HTTPHandlerPools&) = delete;
+  HTTPHandlerPools& operator=(const HTTPHandlerPools&) = delete;
+
+  /**
+   * Closes every thread's pool. Handlers that are still running keep their
+   * pool alive, and are deleted once they finish
+   */
+  ~HTTPHandlerPools() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& pool : pools_) {
+      pool->close();
+    }
+  }
+
+  /**
+   * Returns the calling thread's pool, creating it on first use. Only
+   * takes a lock the first time that it is called on a thread
+   */
+  HTTPHandlerPool& local() {
+    auto& pool = *local_;
+    if (pool == nullptr) {
+      pool = std::make_shared<HTTPHandlerPool>(maxSize_);
+      std::lock_guard<std::mutex> lock(mutex_);
+      pools_.push_back(pool);
+    }
+    return *pool;
+  }
+
+  /**
+   * Returns the stats of every thread's pool
+   */
+  std::vector<HTTPHandlerPoolStats> getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<HTTPHandlerPoolStats> stats;
+    stats.reserve(pools_.size());
+    for (const auto& pool : pools_) {
+      stats.push_back(pool->getStats());
+    }
+    return stats;
+  }
+};
+}
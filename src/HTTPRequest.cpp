@@ -1,20 +1,298 @@
 #include "src/HTTPRequest.h"
 
+#include <cstring>
+
 #include <glog/logging.h>
 
+#include "src/JsonBinding.h"
+
+using folly::StringPiece;
+
 namespace nozomi {
+
+namespace {
+
+// FNV-1a
+inline uint32_t hashName(StringPiece name) {
+  uint32_t hash = 2166136261U;
+  for (char c : name) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 16777619U;
+  }
+  return hash;
+}
+
+inline int hexValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  } else if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  } else if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+/**
+ * Decodes a query string component the same way as folly::uriUnescape in
+ * QUERY mode, without allocating. Components without escapes are returned
+ * as they are, otherwise they are decoded into the arena
+ *
+ * @param raw - The encoded name or value
+ * @param arena - Where decoded strings are written
+ * @param decoded - Set to the decoded component
+ * @returns false if raw has an invalid percent encoding
+ */
+bool unescapeQuery(StringPiece raw, RequestArena& arena, StringPiece& decoded) {
+  auto escape = std::find_if(
+      raw.begin(), raw.end(), [](char c) { return c == '%' || c == '+'; });
+  if (escape == raw.end()) {
+    decoded = raw;
+    return true;
+  }
+
+  // Decoding never makes a component longer
+  auto out = static_cast<char*>(arena.allocate(raw.size(), 1));
+  auto prefix = static_cast<size_t>(escape - raw.begin());
+  std::memcpy(out, raw.data(), prefix);
+  auto length = prefix;
+  for (auto it = escape; it != raw.end(); ++it) {
+    if (*it == '+') {
+      out[length++] = ' ';
+    } else if (*it == '%') {
+      if (raw.end() - it < 3) {
+        return false;
+      }
+      auto high = hexValue(it[1]);
+      auto low = hexValue(it[2]);
+      if (high < 0 || low < 0) {
+        return false;
+      }
+      out[length++] = static_cast<char>((high << 4) | low);
+      it += 2;
+    } else {
+      out[length++] = *it;
+    }
+  }
+  decoded = StringPiece(out, length);
+  return true;
+}
+}
+
+constexpr uint32_t HTTPRequest::QueryParams::kNone;
+
+void HTTPRequest::QueryParams::parse() const {
+  std::lock_guard<std::mutex> lock(parseMutex_);
+  if (parsed_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  StringPiece query(request_->getQueryString());
+  if (query.empty()) {
+    parsed_.store(true, std::memory_order_release);
+    return;
+  }
+
+  // Every parameter is followed by a '&', except for the last one
+  size_t capacity = std::count(query.begin(), query.end(), '&') + 1;
+  uint32_t slotCount = 1;
+  while (slotCount < capacity * 2) {
+    slotCount <<= 1;
+  }
+  slotMask_ = slotCount - 1;
+  params_ = static_cast<Param*>(
+      arena_->allocate(capacity * sizeof(Param), alignof(Param)));
+  next_ = static_cast<uint32_t*>(
+      arena_->allocate(capacity * sizeof(uint32_t), alignof(uint32_t)));
+  slots_ = static_cast<uint32_t*>(
+      arena_->allocate(slotCount * sizeof(uint32_t), alignof(uint32_t)));
+  std::fill(slots_, slots_ + slotCount, kNone);
+
+  auto begin = query.begin();
+  while (true) {
+    auto end = std::find(begin, query.end(), '&');
+    add(StringPiece(begin, end));
+    if (end == query.end()) {
+      break;
+    }
+    begin = end + 1;
+  }
+  parsed_.store(true, std::memory_order_release);
+}
+
+void HTTPRequest::QueryParams::add(StringPiece pair) const {
+  auto equals = std::find(pair.begin(), pair.end(), '=');
+  StringPiece rawName(pair.begin(), equals);
+  StringPiece rawValue(equals == pair.end() ? equals : equals + 1, pair.end());
+  Param param;
+  if (rawName.empty() || !unescapeQuery(rawName, *arena_, param.name) ||
+      !unescapeQuery(rawValue, *arena_, param.value)) {
+    // TODO: Log
+    return;
+  }
+
+  auto index = size_++;
+  params_[index] = param;
+  next_[index] = kNone;
+  auto slot = hashName(param.name) & slotMask_;
+  while (slots_[slot] != kNone && params_[slots_[slot]].name != param.name) {
+    slot = (slot + 1) & slotMask_;
+  }
+  if (slots_[slot] == kNone) {
+    slots_[slot] = index;
+    return;
+  }
+  // Repeated parameters are rare, and short, so walk to the last value
+  auto last = slots_[slot];
+  while (next_[last] != kNone) {
+    last = next_[last];
+  }
+  next_[last] = index;
+}
+
+uint32_t HTTPRequest::QueryParams::find(StringPiece param) const {
+  ensureParsed();
+  if (size_ == 0) {
+    return kNone;
+  }
+  auto slot = hashName(param) & slotMask_;
+  while (slots_[slot] != kNone) {
+    if (params_[slots_[slot]].name == param) {
+      return slots_[slot];
+    }
+    slot = (slot + 1) & slotMask_;
+  }
+  return kNone;
+}
+
+folly::small_vector<StringPiece, 2>
+HTTPRequest::QueryParams::getQueryParamValues(StringPiece param) const {
+  folly::small_vector<StringPiece, 2> values;
+  for (auto index = find(param); index != kNone; index = next_[index]) {
+    values.push_back(params_[index].value);
+  }
+  return values;
+}
+
 HTTPRequest::HTTPRequest(std::unique_ptr<proxygen::HTTPMessage> request,
-                         std::unique_ptr<folly::IOBuf> body)
+                         std::unique_ptr<folly::IOBuf> body,
+                         size_t arenaBlockSize)
     : request_(std::move(request)),
       body_(std::move(body)),
-      queryParams_(HTTPRequest::QueryParams(request_.get())),
+      queryParams_(request_.get(), &arena_),
       headers_(HTTPRequest::Headers(request_.get())),
-      cookies_(Cookies(request_.get())) {
+      cookies_(Cookies(request_.get())),
+      arena_(arenaBlockSize) {
   DCHECK(request_ != nullptr);
   DCHECK(body_ != nullptr);
   auto methodAndPath = getMethodAndPath(request_.get());
   method_ = std::get<0>(methodAndPath);
-  path_ = std::move(std::get<1>(methodAndPath));
+  path_ = std::make_shared<const std::string>(
+      std::move(std::get<1>(methodAndPath)));
+}
+
+HTTPRequest::HTTPRequest(std::unique_ptr<proxygen::HTTPMessage> request,
+                         std::unique_ptr<folly::IOBuf> body,
+                         proxygen::HTTPMethod method,
+                         std::shared_ptr<const std::string> path,
+                         size_t arenaBlockSize)
+    : request_(std::move(request)),
+      body_(std::move(body)),
+      path_(std::move(path)),
+      queryParams_(request_.get(), &arena_),
+      headers_(HTTPRequest::Headers(request_.get())),
+      cookies_(Cookies(request_.get())),
+      method_(method),
+      arena_(arenaBlockSize) {
+  DCHECK(request_ != nullptr);
+  DCHECK(body_ != nullptr);
+  DCHECK(path_ != nullptr);
+}
+
+HTTPRequest::HTTPRequest(HTTPRequest&& other) noexcept
+    : request_(std::move(other.request_)),
+      body_(std::move(other.body_)),
+      coalesced_(other.coalesced_.load(std::memory_order_acquire)),
+      coalescedBody_(other.coalescedBody_),
+      path_(std::move(other.path_)),
+      queryParams_(std::move(other.queryParams_), &arena_),
+      headers_(other.headers_),
+      cookies_(other.cookies_),
+      method_(other.method_),
+      arena_(std::move(other.arena_)),
+#if NOZOMI_HAS_CANCELLATION_TOKEN
+      cancellation_(std::move(other.cancellation_)),
+#endif
+      cancelled_(other.cancelled_.load()),
+      deadline_(other.deadline_) {}
+
+#if NOZOMI_HAS_CANCELLATION_TOKEN
+folly::CancellationToken HTTPRequest::getCancellationToken() const {
+  std::lock_guard<std::mutex> lock(cancellationMutex_);
+  if (!cancellation_.canBeCancelled()) {
+    cancellation_ = folly::CancellationSource();
+    if (cancelled_.load()) {
+      // Nothing can be waiting on the new token yet
+      cancellation_.requestCancellation();
+    }
+  }
+  return cancellation_.getToken();
+}
+
+#endif
+
+void HTTPRequest::cancel() {
+#if NOZOMI_HAS_CANCELLATION_TOKEN
+  auto source = folly::CancellationSource::invalid();
+  {
+    std::lock_guard<std::mutex> lock(cancellationMutex_);
+    cancelled_.store(true, std::memory_order_release);
+    source = cancellation_;
+  }
+  // Callbacks run without the lock, so they can ask for the token too
+  source.requestCancellation();
+#else
+  cancelled_.store(true, std::memory_order_release);
+#endif
+}
+
+StringPiece HTTPRequest::getBodyAsStringPiece() const {
+  if (coalesced_.load(std::memory_order_acquire)) {
+    return coalescedBody_;
+  }
+
+  // Bodies are often chained behind an empty buffer, which doesn't stop
+  // them from being viewed in place
+  StringPiece only;
+  size_t buffers = 0;
+  size_t length = 0;
+  for (const auto& buf : *body_) {
+    if (buf.size() == 0) {
+      continue;
+    }
+    only = StringPiece(reinterpret_cast<const char*>(buf.data()), buf.size());
+    length += buf.size();
+    ++buffers;
+  }
+  if (buffers <= 1) {
+    return only;
+  }
+
+  std::lock_guard<std::mutex> lock(coalesceMutex_);
+  if (coalesced_.load(std::memory_order_relaxed)) {
+    return coalescedBody_;
+  }
+  auto out = static_cast<char*>(arena_.allocate(length, 1));
+  size_t offset = 0;
+  for (const auto& buf : *body_) {
+    std::memcpy(out + offset, buf.data(), buf.size());
+    offset += buf.size();
+  }
+  coalescedBody_ = StringPiece(out, length);
+  coalesced_.store(true, std::memory_order_release);
+  return coalescedBody_;
+}
+
+folly::dynamic HTTPRequest::getBodyAsJson() const {
+  return from_json<folly::dynamic>(getBodyAsStringPiece());
 }
 
 std::tuple<proxygen::HTTPMethod, std::string> HTTPRequest::getMethodAndPath(
@@ -1,17 +1,41 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
 
 #include <folly/String.h>
+#include <folly/small_vector.h>
 #include <folly/io/IOBuf.h>
 #include <folly/json.h>
 #include <proxygen/lib/http/HTTPHeaders.h>
 #include <proxygen/lib/http/HTTPMessage.h>
 #include <proxygen/lib/http/HTTPMethod.h>
 
+#include "src/RequestArena.h"
 #include "src/StringUtils.h"
 
+// folly::CancellationToken is only in folly releases from 2020 on. With
+// older releases, requests can still be cancelled, but have no token
+#ifndef NOZOMI_HAS_CANCELLATION_TOKEN
+#if defined(__has_include)
+#if __has_include(<folly/CancellationToken.h>)
+#define NOZOMI_HAS_CANCELLATION_TOKEN 1
+#endif
+#endif
+#endif
+#ifndef NOZOMI_HAS_CANCELLATION_TOKEN
+#define NOZOMI_HAS_CANCELLATION_TOKEN 0
+#endif
+
+#if NOZOMI_HAS_CANCELLATION_TOKEN
+#include <folly/CancellationToken.h>
+#endif
+
 namespace nozomi {
 
 /**
@@ -21,49 +45,150 @@ class HTTPRequest {
  public:
   /**
    * Wraps up query parameters and does absence checking + url
-   * decoding
+   * decoding. The query string is parsed once, the first time that a
+   * parameter is looked up, into a flat index in the request's arena, so
+   * each lookup after that is a hash probe with no decoding. Lookups may
+   * be made from several threads at once
    */
   struct QueryParams {
-    QueryParams(const proxygen::HTTPMessage* request) : request_(request) {
+    /**
+     * A decoded query parameter. Both pieces stay valid for as long as the
+     * request does
+     */
+    struct Param {
+      folly::StringPiece name;
+      folly::StringPiece value;
+    };
+
+    using const_iterator = const Param*;
+
+    QueryParams(const proxygen::HTTPMessage* request, RequestArena* arena)
+        : request_(request), arena_(arena) {
       DCHECK(request != nullptr);
+      DCHECK(arena != nullptr);
     }
+
+    /**
+     * Moves the index of another request's parameters, whose arena was
+     * moved to arena
+     */
+    QueryParams(QueryParams&& other, RequestArena* arena)
+        : request_(other.request_),
+          arena_(arena),
+          parsed_(other.parsed_.load(std::memory_order_acquire)),
+          params_(other.params_),
+          next_(other.next_),
+          size_(other.size_),
+          slots_(other.slots_),
+          slotMask_(other.slotMask_) {}
+
     /**
      * Get a query parameter by name, or empty optional if the key
-     * does not have an associated value
+     * does not have an associated value. If the parameter appears more
+     * than once, its first value is returned
      */
     inline folly::Optional<std::string> getQueryParam(
         const std::string& param) const {
-      if (request_->hasQueryParam(param)) {
-        return request_->getDecodedQueryParam(param);
-      }
-      for (const auto& kvp : request_->getQueryParams()) {
-        try {
-          auto decodedParam = folly::uriUnescape<std::string>(
-              kvp.first, folly::UriEscapeMode::QUERY);
-          if (decodedParam == param) {
-            return folly::uriUnescape<std::string>(kvp.second,
-                                                   folly::UriEscapeMode::QUERY);
-          }
-        } catch (const std::exception& e) {
-          // TODO: Log
-          continue;
-        }
+      auto value = getQueryParamPiece(param);
+      if (!value) {
+        return folly::Optional<std::string>();
       }
+      return value->str();
+    }
 
-      return folly::Optional<std::string>();
+    /**
+     * Like getQueryParam(), without copying the value. It stays valid for
+     * as long as the request does
+     */
+    inline folly::Optional<folly::StringPiece> getQueryParamPiece(
+        folly::StringPiece param) const {
+      auto index = find(param);
+      if (index == kNone) {
+        return folly::Optional<folly::StringPiece>();
+      }
+      return params_[index].value;
     }
     inline folly::Optional<std::string> operator[](
         const std::string& param) const {
       return getQueryParam(param);
     }
 
+    /**
+     * Gets every value of a query parameter, in the order that they appear
+     * in the query string, e.g. ["a", "b"] for ?tag=a&tag=b
+     */
+    folly::small_vector<folly::StringPiece, 2> getQueryParamValues(
+        folly::StringPiece param) const;
+
+    /**
+     * Returns the number of parameters, counting each value of a repeated
+     * parameter. Parameters that could not be decoded are skipped
+     */
+    inline size_t size() const {
+      ensureParsed();
+      return size_;
+    }
+
+    /**
+     * Iterates over every parameter, in the order that they appear in the
+     * query string
+     */
+    inline const_iterator begin() const {
+      ensureParsed();
+      return params_;
+    }
+    inline const_iterator end() const {
+      ensureParsed();
+      return params_ + size_;
+    }
+
    private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
     const proxygen::HTTPMessage* request_;
+    RequestArena* arena_;
+    // Set once parse() has finished. The first lookups take parseMutex_, so
+    // that threads sharing a request parse it once
+    mutable std::atomic<bool> parsed_{false};
+    mutable std::mutex parseMutex_;
+    // Everything below is allocated from arena_ by parse()
+    mutable Param* params_ = nullptr;
+    // The index of the next value of the same parameter, or kNone
+    mutable uint32_t* next_ = nullptr;
+    mutable uint32_t size_ = 0;
+    // An open addressing table of the index of each name's first value
+    mutable uint32_t* slots_ = nullptr;
+    mutable uint32_t slotMask_ = 0;
+
+    inline void ensureParsed() const {
+      if (!parsed_.load(std::memory_order_acquire)) {
+        parse();
+      }
+    }
+
+    /**
+     * Builds the index, unless another thread already has
+     */
+    void parse() const;
+
+    /**
+     * Decodes one name=value pair and adds it to the index, unless it could
+     * not be decoded
+     */
+    void add(folly::StringPiece pair) const;
+
+    /**
+     * Returns the index of the first value of param, or kNone
+     */
+    uint32_t find(folly::StringPiece param) const;
   };
 
   /**
    * Wraps up headers into a more easily queriable object that returns
-   * Optionals, rather than empty strings
+   * Optionals, rather than empty strings. Each getter has a Piece variant
+   * that returns a view of the value instead of a copy, which stays valid
+   * for as long as the request does. Looking a header up by its
+   * proxygen::HTTPHeaderCode skips hashing its name
    */
   struct Headers {
     Headers(const proxygen::HTTPMessage* request) : request_(request) {
@@ -72,11 +197,11 @@ class HTTPRequest {
     template <typename HeaderKeyType>
     inline folly::Optional<std::string> getHeader(
         const HeaderKeyType& param) const {
-      const auto& value = request_->getHeaders().getSingleOrEmpty(param);
-      if (value.empty()) {
+      auto value = getHeaderPiece(param);
+      if (!value) {
         return folly::Optional<std::string>();
       } else {
-        return folly::Optional<std::string>(value);
+        return folly::Optional<std::string>(value->str());
       }
     }
     inline folly::Optional<std::string> getHeader(const char* param) const {
@@ -92,8 +217,54 @@ class HTTPRequest {
       return getHeader(folly::StringPiece(param));
     }
 
+    /**
+     * Gets a header without copying it, or an empty optional if it is not
+     * set, or is set more than once. See getHeaderValues()
+     */
+    inline folly::Optional<folly::StringPiece> getHeaderPiece(
+        proxygen::HTTPHeaderCode code) const {
+      return toPiece(request_->getHeaders().getSingleOrEmpty(code));
+    }
+    inline folly::Optional<folly::StringPiece> getHeaderPiece(
+        folly::StringPiece name) const {
+      return toPiece(request_->getHeaders().getSingleOrEmpty(name));
+    }
+
+    /**
+     * Gets every value of a header, in the order that they were received,
+     * e.g. for repeated Accept or X-Forwarded-For headers
+     */
+    inline folly::small_vector<folly::StringPiece, 2> getHeaderValues(
+        proxygen::HTTPHeaderCode code) const {
+      folly::small_vector<folly::StringPiece, 2> values;
+      request_->getHeaders().forEachValueOfHeader(
+          code, [&values](const std::string& value) {
+            values.push_back(value);
+            return false;
+          });
+      return values;
+    }
+    inline folly::small_vector<folly::StringPiece, 2> getHeaderValues(
+        folly::StringPiece name) const {
+      folly::small_vector<folly::StringPiece, 2> values;
+      request_->getHeaders().forEachValueOfHeader(
+          name, [&values](const std::string& value) {
+            values.push_back(value);
+            return false;
+          });
+      return values;
+    }
+
    private:
     const proxygen::HTTPMessage* request_;
+
+    static inline folly::Optional<folly::StringPiece> toPiece(
+        const std::string& value) {
+      if (value.empty()) {
+        return folly::Optional<folly::StringPiece>();
+      }
+      return folly::StringPiece(value);
+    }
   };
 
   /**
@@ -106,11 +277,11 @@ class HTTPRequest {
     }
     inline folly::Optional<std::string> getCookie(
         const std::string& param) const {
-      auto value = request_->getCookie(param);
-      if (value.empty()) {
+      auto value = getCookiePiece(param);
+      if (!value) {
         return folly::Optional<std::string>();
       } else {
-        return folly::Optional<std::string>(value.str());
+        return folly::Optional<std::string>(value->str());
       }
     }
     inline folly::Optional<std::string> operator[](
@@ -118,17 +289,58 @@ class HTTPRequest {
       return getCookie(param);
     }
 
+    /**
+     * Like getCookie(), without copying the value. It points into the
+     * Cookie header, and stays valid for as long as the request does
+     */
+    inline folly::Optional<folly::StringPiece> getCookiePiece(
+        const std::string& param) const {
+      auto value = request_->getCookie(param);
+      if (value.empty()) {
+        return folly::Optional<folly::StringPiece>();
+      }
+      return value;
+    }
+
    private:
     const proxygen::HTTPMessage* request_;
   };
 
-  HTTPRequest(std::unique_ptr<proxygen::HTTPMessage> request,
-              std::unique_ptr<folly::IOBuf> body);
+  /**
+   * Creates an HTTPRequest
+   *
+   * @param arenaBlockSize - The block size of the request's arena. See
+   *                         getArena()
+   */
+  HTTPRequest(
+      std::unique_ptr<proxygen::HTTPMessage> request,
+      std::unique_ptr<folly::IOBuf> body,
+      size_t arenaBlockSize = RequestArena::kDefaultBlockSize);
+
+  /**
+   * Creates an HTTPRequest whose method and decoded path were already
+   * computed for routing (see RoutingContext), so the path is not decoded
+   * a second time. StringPiece route arguments point into path, and stay
+   * valid for as long as this request does
+   */
+  HTTPRequest(
+      std::unique_ptr<proxygen::HTTPMessage> request,
+      std::unique_ptr<folly::IOBuf> body,
+      proxygen::HTTPMethod method,
+      std::shared_ptr<const std::string> path,
+      size_t arenaBlockSize = RequestArena::kDefaultBlockSize);
+
+  /**
+   * Moves a request. The parsed query parameters are kept, and point into
+   * the moved arena
+   */
+  HTTPRequest(HTTPRequest&& other) noexcept;
+  HTTPRequest& operator=(HTTPRequest&& other) = delete;
 
   /**
    * Returns the uri decoded path
    */
-  inline const std::string& getPath() const { return path_; }
+  inline const std::string& getPath() const { return *path_; }
 
   /**
    * Returns the method that the request was made with, or GET
@@ -156,13 +368,21 @@ class HTTPRequest {
   inline std::string getBodyAsString() const { return to_string(body_); }
 
   /**
-   * Gets the body as a json object
+   * Gets the body as one contiguous view. A body in a single buffer is not
+   * copied. A chained body is copied into the request's arena the first
+   * time, so it is never copied more than once, even when several threads
+   * ask for it at once. The view is valid for as long as the request is
+   */
+  folly::StringPiece getBodyAsStringPiece() const;
+
+  /**
+   * Gets the body as a json object. It is parsed in place from
+   * getBodyAsStringPiece() with JsonReader, which skips runs of plain
+   * string bytes and of indentation a word at a time
    *
-   * @throws runtime_error is thrown from folly::parseJson
+   * @throws runtime_error if the body is not valid json
    */
-  folly::dynamic getBodyAsJson() const {
-    return folly::parseJson(getBodyAsString());
-  }
+  folly::dynamic getBodyAsJson() const;
 
   /**
    * Gets the raw bytes from the body of the request. This
@@ -172,6 +392,80 @@ class HTTPRequest {
     return body_->clone();
   }
 
+  /**
+   * Takes the body buffer back from a request that is finished with, so
+   * that it can be reused for another request. Nothing else may be called
+   * on the request afterwards
+   */
+  inline std::unique_ptr<folly::IOBuf> releaseBody() {
+    return std::move(body_);
+  }
+
+  /**
+   * Returns an arena for memory that only needs to live as long as this
+   * request, e.g. ArenaString and ArenaVector scratch space in a handler.
+   * Everything in it is released at once when the request is destroyed.
+   * It must only be used by one thread at a time, and not while another
+   * thread may be the first to call getBodyAsStringPiece() or look up a
+   * query parameter, since those allocate from it too
+   */
+  inline RequestArena& getArena() const { return arena_; }
+
+  /**
+   * Returns a token that is cancelled once nobody is waiting for this
+   * request's response: the client disconnected, or the handler timed out.
+   * Long running handlers should check it between steps, and pass it to
+   * outbound calls, so that abandoned work stops using workers. Coroutine
+   * handlers are run with it, so cancellation aware awaits stop early.
+   * Only available when NOZOMI_HAS_CANCELLATION_TOKEN is set
+   */
+#if NOZOMI_HAS_CANCELLATION_TOKEN
+  folly::CancellationToken getCancellationToken() const;
+#endif
+
+  /**
+   * Whether the response to this request is no longer wanted: the client
+   * disconnected, or the handler timed out. See getCancellationToken()
+   */
+  inline bool isCancelled() const {
+    return cancelled_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Cancels the request's token. Called by HTTPHandler, from any thread
+   */
+  void cancel();
+
+  /**
+   * Returns when the handler must have responded by, or the maximum time
+   * point if the request has no deadline
+   */
+  inline std::chrono::steady_clock::time_point getDeadline() const {
+    return deadline_;
+  }
+
+  /**
+   * Returns how much of the request's deadline is left, or zero if it has
+   * passed. Handlers should use this as the timeout for outbound calls, so
+   * that they give up when the request does
+   */
+  inline std::chrono::milliseconds getRemainingTime() const {
+    if (deadline_ == std::chrono::steady_clock::time_point::max()) {
+      return std::chrono::milliseconds::max();
+    }
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline_ - std::chrono::steady_clock::now());
+    return std::max(remaining, std::chrono::milliseconds(0));
+  }
+
+  /**
+   * Sets the request's deadline. Called by HTTPHandler before the handler
+   * runs
+   */
+  inline void setDeadline(std::chrono::steady_clock::time_point deadline) {
+    deadline_ = deadline;
+  }
+
   inline const QueryParams& getQueryParams() const { return queryParams_; }
   inline const Headers& getHeaders() const { return headers_; }
   inline const Cookies& getCookies() const { return cookies_; }
@@ -182,22 +476,52 @@ class HTTPRequest {
   static std::tuple<proxygen::HTTPMethod, std::string> getMethodAndPath(
       const proxygen::HTTPMessage* message);
 
+  /**
+   * Decodes a request's path into out, replacing what it held. out keeps
+   * its capacity, so decoding into a reused string does not allocate.
+   * Paths that can't be decoded are copied as they are
+   *
+   * @param originalPath - The path from the request line
+   * @param out - Where the decoded path is written
+   */
+  static inline void unescapePath(const std::string& originalPath,
+                                  std::string& out) {
+    out.clear();
+    try {
+      folly::uriUnescape(originalPath, out, folly::UriEscapeMode::PATH);
+    } catch (const std::exception& e) {
+      out.assign(originalPath);
+    }
+  }
+
  private:
   std::unique_ptr<proxygen::HTTPMessage> request_;
   std::unique_ptr<folly::IOBuf> body_;
-  std::string path_;
+  // A chained body that was copied into arena_. See getBodyAsStringPiece()
+  mutable std::mutex coalesceMutex_;
+  mutable std::atomic<bool> coalesced_{false};
+  mutable folly::StringPiece coalescedBody_;
+  std::shared_ptr<const std::string> path_;
   QueryParams queryParams_;
   Headers headers_;
   Cookies cookies_;
   proxygen::HTTPMethod method_;
+  mutable RequestArena arena_;
+#if NOZOMI_HAS_CANCELLATION_TOKEN
+  // Created by the first getCancellationToken(), so that requests whose
+  // handler never asks for a token don't allocate one
+  mutable std::mutex cancellationMutex_;
+  mutable folly::CancellationSource cancellation_ =
+      folly::CancellationSource::invalid();
+#endif
+  std::atomic<bool> cancelled_{false};
+  std::chrono::steady_clock::time_point deadline_ =
+      std::chrono::steady_clock::time_point::max();
 
   static inline std::string getUnescapedPath(const std::string& originalPath) {
-    try {
-      return folly::uriUnescape<std::string>(originalPath,
-                                             folly::UriEscapeMode::PATH);
-    } catch (const std::exception& e) {
-      return originalPath;
-    }
+    std::string path;
+    unescapePath(originalPath, path);
+    return path;
   }
 };
 }
@@ -1,8 +1,7 @@
 #include "src/HTTPResponse.h"
 
-#include <folly/json.h>
+#include "src/JsonBinding.h"
 
-using folly::toJson;
 using folly::dynamic;
 using std::string;
 using std::unique_ptr;
@@ -15,8 +14,7 @@ HTTPResponse::HTTPResponse(int16_t statusCode,
                            const dynamic& body,
                            unordered_map<string, string> headers) {
   response_.setStatusCode(statusCode);
-  auto str = toJson(body);
-  body_ = IOBuf::copyBuffer(str.data(), str.size());
+  body_ = to_json_body(body);
   for (auto& kv : headers) {
     response_.getHeaders().set(kv.first, std::move(kv.second));
   }
@@ -47,8 +45,7 @@ HTTPResponse::HTTPResponse(
     const dynamic& body,
     unordered_map<proxygen::HTTPHeaderCode, string> headers) {
   response_.setStatusCode(statusCode);
-  auto str = toJson(body);
-  body_ = IOBuf::copyBuffer(str.data(), str.size());
+  body_ = to_json_body(body);
   for (auto& kv : headers) {
     response_.getHeaders().set(kv.first, std::move(kv.second));
   }
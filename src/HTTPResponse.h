@@ -16,7 +16,8 @@
 namespace nozomi {
 
 /**
- * Represents an HTTP response and body
+ * Represents an HTTP response and body. Responses are move only, so that
+ * the message and body can be handed to proxygen without being copied
  */
 class HTTPResponse {
  private:
@@ -50,6 +51,11 @@ class HTTPResponse {
   HTTPResponse(int16_t statusCode);
   HTTPResponse(int16_t statusCode, const std::string& body);
 
+  HTTPResponse(HTTPResponse&&) = default;
+  HTTPResponse& operator=(HTTPResponse&&) = default;
+  HTTPResponse(const HTTPResponse&) = delete;
+  HTTPResponse& operator=(const HTTPResponse&) = delete;
+
   // string converts to dynamic, and I can't seem to disable conversion
   // for specific arguments. Different names should do it, though
   static inline folly::Future<HTTPResponse> fromJson(
@@ -94,11 +100,28 @@ class HTTPResponse {
     return folly::makeFuture(HTTPResponse(std::forward<Args>(args)...));
   }
 
-  inline const proxygen::HTTPMessage& getHeaders() const { return response_; }
+  inline const proxygen::HTTPMessage& getHeaders() const& {
+    return response_;
+  }
+
+  /**
+   * Moves the message out of a response that is being sent
+   */
+  inline proxygen::HTTPMessage getHeaders() && { return std::move(response_); }
+
   inline int16_t getStatusCode() const { return response_.getStatusCode(); }
   inline std::string getBodyString() const { return to_string(body_); }
-  inline std::unique_ptr<folly::IOBuf> getBody() const {
+
+  /**
+   * Returns a clone of the body. The clone shares the body's buffers
+   */
+  inline std::unique_ptr<folly::IOBuf> getBody() const& {
     return body_->clone();
   }
+
+  /**
+   * Moves the body out of a response that is being sent
+   */
+  inline std::unique_ptr<folly::IOBuf> getBody() && { return std::move(body_); }
 };
 }
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+#include <folly/Executor.h>
+#include <folly/Portability.h>
+#include <folly/futures/Future.h>
+
+#include "src/HTTPRequest.h"
+#include "src/HTTPResponse.h"
+
+#if FOLLY_HAS_COROUTINES
+#include <folly/executors/InlineExecutor.h>
+#include <folly/experimental/coro/Task.h>
+#if NOZOMI_HAS_CANCELLATION_TOKEN
+#include <folly/experimental/coro/WithCancellation.h>
+#endif
+#endif
+
+namespace nozomi {
+
+/**
+ * Whether a handler's return type can be used for a non-streaming route.
+ * Handlers return a folly::Future<HTTPResponse>, or a
+ * folly::coro::Task<HTTPResponse> when the compiler supports coroutines
+ */
+template <typename Result>
+struct is_handler_result : std::false_type {};
+
+template <>
+struct is_handler_result<folly::Future<HTTPResponse>> : std::true_type {};
+
+/**
+ * Converts the result of a handler into the future that HTTPHandler
+ * responds with. Futures are returned as they are. HTTPHandler interrupts
+ * them when the request is cancelled
+ *
+ * @param response - The handler's result
+ * @param request - The request that the handler was called with
+ * @param executor - The executor that the handler was called on
+ */
+inline folly::Future<HTTPResponse> to_response_future(
+    folly::Future<HTTPResponse>&& response,
+    const HTTPRequest&,
+    folly::Executor*) {
+  return std::move(response);
+}
+
+/**
+ * Makes a handler result of type Result that is already complete, e.g. for
+ * wrappers that answer a request without calling the handler that they
+ * wrap
+ *
+ * @param response - The response to complete the result with
+ */
+template <typename Result>
+inline std::enable_if_t<
+    std::is_same<Result, folly::Future<HTTPResponse>>::value,
+    Result>
+make_handler_result(HTTPResponse response) {
+  return folly::makeFuture<HTTPResponse>(std::move(response));
+}
+
+#if FOLLY_HAS_COROUTINES
+template <>
+struct is_handler_result<folly::coro::Task<HTTPResponse>> : std::true_type {};
+
+/**
+ * Starts a coroutine handler on the executor that it was called on, so
+ * that it runs, and resumes after each co_await, on the route's executor.
+ * Unlike a chain of continuations, a coroutine only allocates its frame
+ * and the core of the future that is returned. The task is run with the
+ * request's cancellation token, if folly has them
+ *
+ * @param response - The handler's task
+ * @param request - The request that the handler was called with
+ * @param executor - The executor that the handler was called on. If it is
+ *                   nullptr, the task is run inline
+ */
+inline folly::Future<HTTPResponse> to_response_future(
+    folly::coro::Task<HTTPResponse>&& response,
+    const HTTPRequest& request,
+    folly::Executor* executor) {
+  auto keepAlive = folly::getKeepAliveToken(
+      executor != nullptr ? executor : &folly::InlineExecutor::instance());
+#if NOZOMI_HAS_CANCELLATION_TOKEN
+  return folly::coro::co_withCancellation(request.getCancellationToken(),
+                                          std::move(response))
+      .scheduleOn(keepAlive)
+      .start()
+      .via(keepAlive);
+#else
+  return std::move(response).scheduleOn(keepAlive).start().via(keepAlive);
+#endif
+}
+
+template <typename Result>
+inline std::enable_if_t<
+    std::is_same<Result, folly::coro::Task<HTTPResponse>>::value,
+    Result>
+make_handler_result(HTTPResponse response) {
+  co_return std::move(response);
+}
+#endif
+}
@@ -0,0 +1,638 @@
+#include "src/JsonBinding.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include <folly/Format.h>
+#include <glog/logging.h>
+
+using folly::IOBuf;
+using folly::dynamic;
+using folly::StringPiece;
+using std::string;
+
+namespace nozomi {
+
+constexpr size_t JsonReader::kMaxDepth;
+constexpr size_t JsonWriter::kBlockSize;
+constexpr size_t JsonWriter::kFirstBlockSize;
+
+namespace {
+
+inline bool is_digit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+inline int hex_value(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  } else if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  } else if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+constexpr size_t kMaxCachedBlocks = 64;
+constexpr size_t kMaxDynamicDepth = JsonReader::kMaxDepth;
+
+/**
+ * Blocks of JsonWriter::kBlockSize that were made, and then freed, on this
+ * thread, waiting to be reused
+ */
+struct BlockCache {
+  struct Node {
+    Node* next;
+  };
+  Node* head = nullptr;
+  size_t count = 0;
+
+  ~BlockCache() {
+    while (head != nullptr) {
+      auto* next = head->next;
+      std::free(head);
+      head = next;
+    }
+  }
+};
+
+inline BlockCache& block_cache() {
+  static thread_local BlockCache cache;
+  return cache;
+}
+
+/**
+ * Frees a block, or caches it if it is freed on the thread whose cache it
+ * came from. Caching blocks on whichever thread frees them would pile them
+ * up on the IO threads that send responses written on other executors
+ */
+void release_block(void* block, void* owner) {
+  auto& cache = block_cache();
+  if (owner == &cache && cache.count < kMaxCachedBlocks) {
+    auto* node = static_cast<BlockCache::Node*>(block);
+    node->next = cache.head;
+    cache.head = node;
+    ++cache.count;
+  } else {
+    std::free(block);
+  }
+}
+
+std::unique_ptr<IOBuf> make_block(size_t size) {
+  if (size != JsonWriter::kBlockSize) {
+    return IOBuf::create(size);
+  }
+  auto& cache = block_cache();
+  void* block = cache.head;
+  if (block != nullptr) {
+    cache.head = cache.head->next;
+    --cache.count;
+  } else {
+    block = std::malloc(size);
+    if (block == nullptr) {
+      throw std::bad_alloc();
+    }
+  }
+  return IOBuf::takeOwnership(block, size, 0, release_block, &cache);
+}
+
+/**
+ * Whether any of the eight bytes in word is a control character, a quote
+ * or a backslash. Each test sets the high bit of a byte that matches it,
+ * and of no byte if none do
+ */
+inline bool needs_escape(uint64_t word) {
+  constexpr uint64_t kOnes = 0x0101010101010101ULL;
+  constexpr uint64_t kHighBits = 0x8080808080808080ULL;
+  auto quotes = word ^ (kOnes * '"');
+  auto backslashes = word ^ (kOnes * '\\');
+  auto matches = ((word - kOnes * 0x20) & ~word) |
+                 ((quotes - kOnes) & ~quotes) |
+                 ((backslashes - kOnes) & ~backslashes);
+  return (matches & kHighBits) != 0;
+}
+
+inline bool needs_escape(char c) {
+  auto byte = static_cast<unsigned char>(c);
+  return byte < 0x20 || byte == '"' || byte == '\\';
+}
+
+/**
+ * Returns the first byte from begin that is a control character, a quote
+ * or a backslash, or end if there is none. Runs of bytes that are none of
+ * those are skipped eight bytes at a time
+ */
+inline const char* find_escape(const char* begin, const char* end) {
+  while (end - begin >= 8) {
+    uint64_t word;
+    std::memcpy(&word, begin, sizeof(word));
+    if (needs_escape(word)) {
+      break;
+    }
+    begin += 8;
+  }
+  while (begin != end && !needs_escape(*begin)) {
+    ++begin;
+  }
+  return begin;
+}
+
+void append_utf8(uint32_t codePoint, string& out) {
+  if (codePoint < 0x80) {
+    out.push_back(static_cast<char>(codePoint));
+  } else if (codePoint < 0x800) {
+    out.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+    out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+  } else if (codePoint < 0x10000) {
+    out.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+    out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+  } else {
+    out.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+    out.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+  }
+}
+}
+
+void JsonReader::fail(StringPiece expected) const {
+  throw std::runtime_error(folly::sformat(
+      "Invalid JSON at offset {}: expected {}", pos_ - begin_, expected));
+}
+
+void JsonReader::expect(char c) {
+  if (!consume(c)) {
+    fail(StringPiece(&c, 1));
+  }
+}
+
+void JsonReader::expectLiteral(StringPiece literal) {
+  if (static_cast<size_t>(end_ - pos_) < literal.size() ||
+      std::memcmp(pos_, literal.data(), literal.size()) != 0) {
+    fail(literal);
+  }
+  pos_ += literal.size();
+}
+
+void JsonReader::beginObject() {
+  expect('{');
+  afterOpen_ = true;
+}
+
+void JsonReader::beginArray() {
+  expect('[');
+  afterOpen_ = true;
+}
+
+bool JsonReader::nextInContainer(char close) {
+  if (consume(close)) {
+    afterOpen_ = false;
+    return false;
+  }
+  if (!afterOpen_) {
+    if (!consume(',')) {
+      fail(close == '}' ? "',' or '}'" : "',' or ']'");
+    }
+  }
+  afterOpen_ = false;
+  return true;
+}
+
+bool JsonReader::nextField(StringPiece& name) {
+  if (!nextInContainer('}')) {
+    return false;
+  }
+  skipWhitespace();
+  name = readStringPiece(name_);
+  expect(':');
+  return true;
+}
+
+bool JsonReader::nextElement() {
+  return nextInContainer(']');
+}
+
+bool JsonReader::readNull() {
+  skipWhitespace();
+  if (pos_ != end_ && *pos_ == 'n') {
+    expectLiteral("null");
+    return true;
+  }
+  return false;
+}
+
+bool JsonReader::readBool() {
+  skipWhitespace();
+  if (pos_ != end_ && *pos_ == 't') {
+    expectLiteral("true");
+    return true;
+  } else if (pos_ != end_ && *pos_ == 'f') {
+    expectLiteral("false");
+    return false;
+  }
+  fail("a boolean");
+}
+
+StringPiece JsonReader::readNumberToken() {
+  skipWhitespace();
+  auto start = pos_;
+  if (pos_ != end_ && *pos_ == '-') {
+    ++pos_;
+  }
+  if (pos_ == end_ || !is_digit(*pos_)) {
+    pos_ = start;
+    fail("a number");
+  }
+  if (*pos_ == '0') {
+    ++pos_;
+  } else {
+    while (pos_ != end_ && is_digit(*pos_)) {
+      ++pos_;
+    }
+  }
+  if (pos_ != end_ && *pos_ == '.') {
+    ++pos_;
+    if (pos_ == end_ || !is_digit(*pos_)) {
+      fail("a digit");
+    }
+    while (pos_ != end_ && is_digit(*pos_)) {
+      ++pos_;
+    }
+  }
+  if (pos_ != end_ && (*pos_ == 'e' || *pos_ == 'E')) {
+    ++pos_;
+    if (pos_ != end_ && (*pos_ == '+' || *pos_ == '-')) {
+      ++pos_;
+    }
+    if (pos_ == end_ || !is_digit(*pos_)) {
+      fail("a digit");
+    }
+    while (pos_ != end_ && is_digit(*pos_)) {
+      ++pos_;
+    }
+  }
+  return StringPiece(start, pos_);
+}
+
+void JsonReader::readEscape(string& out) {
+  if (pos_ == end_) {
+    fail("an escape");
+  }
+  char c = *pos_++;
+  switch (c) {
+    case '"':
+    case '\\':
+    case '/':
+      out.push_back(c);
+      return;
+    case 'b':
+      out.push_back('\b');
+      return;
+    case 'f':
+      out.push_back('\f');
+      return;
+    case 'n':
+      out.push_back('\n');
+      return;
+    case 'r':
+      out.push_back('\r');
+      return;
+    case 't':
+      out.push_back('\t');
+      return;
+    case 'u':
+      break;
+    default:
+      --pos_;
+      fail("an escape");
+  }
+
+  auto readHex = [this]() {
+    if (end_ - pos_ < 4) {
+      fail("four hex digits");
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+      auto digit = hex_value(pos_[i]);
+      if (digit < 0) {
+        fail("four hex digits");
+      }
+      value = (value << 4) | static_cast<uint32_t>(digit);
+    }
+    pos_ += 4;
+    return value;
+  };
+  auto codePoint = readHex();
+  if (codePoint >= 0xD800 && codePoint < 0xDC00) {
+    // The high half of a surrogate pair must be followed by the low half
+    if (end_ - pos_ < 2 || pos_[0] != '\\' || pos_[1] != 'u') {
+      fail("a low surrogate");
+    }
+    pos_ += 2;
+    auto low = readHex();
+    if (low < 0xDC00 || low >= 0xE000) {
+      fail("a low surrogate");
+    }
+    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+  } else if (codePoint >= 0xDC00 && codePoint < 0xE000) {
+    fail("a high surrogate");
+  }
+  append_utf8(codePoint, out);
+}
+
+StringPiece JsonReader::readStringPiece(string& scratch) {
+  expect('"');
+  auto start = pos_;
+  pos_ = find_escape(pos_, end_);
+  if (pos_ != end_ && *pos_ == '"') {
+    return StringPiece(start, pos_++);
+  }
+
+  // Only strings with escapes are copied
+  scratch.assign(start, pos_);
+  while (true) {
+    if (pos_ == end_) {
+      fail("'\"'");
+    }
+    char c = *pos_;
+    if (c == '"') {
+      ++pos_;
+      return StringPiece(scratch);
+    } else if (c != '\\') {
+      fail("an escaped control character");
+    }
+    ++pos_;
+    readEscape(scratch);
+    auto run = find_escape(pos_, end_);
+    scratch.append(pos_, run);
+    pos_ = run;
+  }
+}
+
+void JsonReader::readString(string& value) {
+  skipWhitespace();
+  if (pos_ == end_ || *pos_ != '"') {
+    fail("a string");
+  }
+  auto piece = readStringPiece(value);
+  if (piece.data() != value.data()) {
+    value.assign(piece.data(), piece.size());
+  }
+}
+
+void JsonReader::skipValue(size_t depth) {
+  if (depth >= kMaxDepth) {
+    fail("less nesting");
+  }
+  skipWhitespace();
+  if (pos_ == end_) {
+    fail("a value");
+  }
+  switch (*pos_) {
+    case '{': {
+      beginObject();
+      StringPiece name;
+      while (nextField(name)) {
+        skipValue(depth + 1);
+      }
+      return;
+    }
+    case '[':
+      beginArray();
+      while (nextElement()) {
+        skipValue(depth + 1);
+      }
+      return;
+    case '"':
+      readStringPiece(name_);
+      return;
+    case 't':
+    case 'f':
+      readBool();
+      return;
+    case 'n':
+      readNull();
+      return;
+    default:
+      readNumberToken();
+  }
+}
+
+void JsonReader::end() {
+  skipWhitespace();
+  if (pos_ != end_) {
+    fail("the end of the document");
+  }
+}
+
+JsonWriter::JsonWriter(size_t blockSize)
+    : head_(make_block(std::min(kFirstBlockSize, blockSize))),
+      tail_(head_.get()),
+      blockSize_(blockSize),
+      nextBlockSize_(std::min(2 * kFirstBlockSize, blockSize)) {
+  DCHECK(blockSize_ > 0) << "JsonWriter block size must be at least 1";
+}
+
+void JsonWriter::grow() {
+  auto block = make_block(nextBlockSize_);
+  nextBlockSize_ = std::min(2 * nextBlockSize_, blockSize_);
+  tail_ = block.get();
+  // prependChain on the head adds to the end of the chain
+  head_->prependChain(std::move(block));
+}
+
+void JsonWriter::write(StringPiece data) {
+  while (!data.empty()) {
+    if (tail_->tailroom() == 0) {
+      grow();
+    }
+    auto size = std::min(data.size(), tail_->tailroom());
+    std::memcpy(tail_->writableTail(), data.data(), size);
+    tail_->append(size);
+    length_ += size;
+    data.advance(size);
+  }
+}
+
+void JsonWriter::string(StringPiece value) {
+  static constexpr char kHex[] = "0123456789abcdef";
+  write('"');
+  auto start = value.begin();
+  while (true) {
+    auto it = find_escape(start, value.end());
+    write(StringPiece(start, it));
+    if (it == value.end()) {
+      break;
+    }
+    auto c = static_cast<unsigned char>(*it);
+    start = it + 1;
+    switch (c) {
+      case '"':
+        write("\\\"");
+        break;
+      case '\\':
+        write("\\\\");
+        break;
+      case '\n':
+        write("\\n");
+        break;
+      case '\r':
+        write("\\r");
+        break;
+      case '\t':
+        write("\\t");
+        break;
+      case '\b':
+        write("\\b");
+        break;
+      case '\f':
+        write("\\f");
+        break;
+      default:
+        write("\\u00");
+        write(kHex[c >> 4]);
+        write(kHex[c & 0xF]);
+    }
+  }
+  write('"');
+}
+
+void JsonWriter::integer(int64_t value) {
+  scratch_.clear();
+  folly::toAppend(value, &scratch_);
+  write(scratch_);
+}
+
+void JsonWriter::unsignedInteger(uint64_t value) {
+  scratch_.clear();
+  folly::toAppend(value, &scratch_);
+  write(scratch_);
+}
+
+void JsonWriter::number(double value) {
+  if (!std::isfinite(value)) {
+    throw std::runtime_error(
+        folly::sformat("JSON can't represent the number {}", value));
+  }
+  scratch_.clear();
+  folly::toAppend(value, &scratch_);
+  write(scratch_);
+}
+
+namespace {
+
+void read_dynamic(JsonReader& reader, dynamic& value, size_t depth) {
+  if (depth >= kMaxDynamicDepth) {
+    reader.fail("less nesting");
+  }
+  switch (reader.peek()) {
+    case '{': {
+      value = dynamic::object();
+      reader.beginObject();
+      StringPiece name;
+      while (reader.nextField(name)) {
+        // name is only valid until the next call on the reader
+        auto key = name.str();
+        dynamic field;
+        read_dynamic(reader, field, depth + 1);
+        value.insert(std::move(key), std::move(field));
+      }
+      return;
+    }
+    case '[':
+      value = dynamic::array();
+      reader.beginArray();
+      while (reader.nextElement()) {
+        dynamic element;
+        read_dynamic(reader, element, depth + 1);
+        value.push_back(std::move(element));
+      }
+      return;
+    case '"': {
+      string str;
+      reader.readString(str);
+      value = std::move(str);
+      return;
+    }
+    case 't':
+    case 'f':
+      value = reader.readBool();
+      return;
+    case 'n':
+      reader.readNull();
+      value = nullptr;
+      return;
+    default: {
+      auto token = reader.readNumberToken();
+      auto isInteger = std::none_of(token.begin(), token.end(), [](char c) {
+        return c == '.' || c == 'e' || c == 'E';
+      });
+      if (isInteger) {
+        try {
+          value = folly::to<int64_t>(token);
+          return;
+        } catch (const std::exception&) {
+          reader.fail("an integer that fits");
+        }
+      }
+      value = folly::to<double>(token);
+    }
+  }
+}
+
+void write_dynamic(JsonWriter& writer, const dynamic& value, size_t depth) {
+  if (depth >= kMaxDynamicDepth) {
+    throw std::runtime_error("JSON is nested too deeply to write");
+  }
+  switch (value.getType()) {
+    case dynamic::NULLT:
+      writer.null();
+      return;
+    case dynamic::BOOL:
+      writer.boolean(value.getBool());
+      return;
+    case dynamic::INT64:
+      writer.integer(value.getInt());
+      return;
+    case dynamic::DOUBLE:
+      writer.number(value.getDouble());
+      return;
+    case dynamic::STRING:
+      writer.string(value.getString());
+      return;
+    case dynamic::ARRAY:
+      writer.beginArray();
+      for (const auto& element : value) {
+        writer.element();
+        write_dynamic(writer, element, depth + 1);
+      }
+      writer.endArray();
+      return;
+    case dynamic::OBJECT:
+      writer.beginObject();
+      for (const auto& kv : value.items()) {
+        if (!kv.first.isString()) {
+          throw std::runtime_error("JSON object keys must be strings");
+        }
+        writer.name(kv.first.getString());
+        write_dynamic(writer, kv.second, depth + 1);
+      }
+      writer.endObject();
+      return;
+  }
+}
+}
+
+void JsonValue<dynamic>::read(JsonReader& reader, dynamic& value) {
+  read_dynamic(reader, value, 0);
+}
+
+void JsonValue<dynamic>::write(JsonWriter& writer, const dynamic& value) {
+  write_dynamic(writer, value, 0);
+}
+}
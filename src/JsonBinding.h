@@ -0,0 +1,637 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <folly/Conv.h>
+#include <folly/Optional.h>
+#include <folly/Range.h>
+#include <folly/dynamic.h>
+#include <folly/io/IOBuf.h>
+
+namespace nozomi {
+
+/**
+ * Reads JSON one token at a time, without building a folly::dynamic. Used
+ * by read_json to parse straight into typed objects. Strings without
+ * escapes are returned as views of the input, so the input must outlive
+ * the reader. Not thread safe
+ */
+class JsonReader {
+ private:
+  const char* begin_;
+  const char* pos_;
+  const char* end_;
+  // Whether the next field or element is the first in its object or array,
+  // and so must not be preceded by a comma
+  bool afterOpen_ = false;
+  // Holds names that had escapes in them
+  std::string name_;
+
+  inline void skipWhitespace() {
+    // Indentation is mostly runs of spaces, which are skipped eight at a time
+    constexpr uint64_t kSpaces = 0x2020202020202020ULL;
+    while (pos_ != end_ &&
+           (*pos_ == ' ' || *pos_ == '\n' || *pos_ == '\r' || *pos_ == '\t')) {
+      if (*pos_ == ' ' && end_ - pos_ >= 8) {
+        uint64_t word;
+        std::memcpy(&word, pos_, sizeof(word));
+        if (word == kSpaces) {
+          pos_ += 8;
+          continue;
+        }
+      }
+      ++pos_;
+    }
+  }
+
+  /**
+   * Consumes c if it is the next character after any whitespace
+   */
+  inline bool consume(char c) {
+    skipWhitespace();
+    if (pos_ != end_ && *pos_ == c) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  void expect(char c);
+  void expectLiteral(folly::StringPiece literal);
+  bool nextInContainer(char close);
+  void readEscape(std::string& out);
+  void skipValue(size_t depth);
+
+  /**
+   * Reads a string. Returns a view of the input if it has no escapes, or
+   * of scratch, which the unescaped string is written to, if it does
+   */
+  folly::StringPiece readStringPiece(std::string& scratch);
+
+ public:
+  static constexpr size_t kMaxDepth = 256;
+
+  explicit JsonReader(folly::StringPiece json)
+      : begin_(json.begin()), pos_(json.begin()), end_(json.end()) {}
+
+  /**
+   * Reads the opening brace of an object
+   */
+  void beginObject();
+
+  /**
+   * Reads the name of the next field of the current object, or its closing
+   * brace
+   *
+   * @param name - Set to the field's name. It is valid until the next call
+   * @returns false if the object has no more fields
+   */
+  bool nextField(folly::StringPiece& name);
+
+  /**
+   * Reads the opening bracket of an array
+   */
+  void beginArray();
+
+  /**
+   * Moves to the next element of the current array, or reads its closing
+   * bracket
+   *
+   * @returns false if the array has no more elements
+   */
+  bool nextElement();
+
+  /**
+   * Reads a null if it is the next value
+   *
+   * @returns whether a null was read
+   */
+  bool readNull();
+
+  bool readBool();
+
+  /**
+   * Reads a number, and converts it to T
+   *
+   * @throws runtime_error if it is not a number, or doesn't fit in T
+   */
+  template <typename T>
+  inline T readNumber() {
+    auto token = readNumberToken();
+    try {
+      return folly::to<T>(token);
+    } catch (const std::exception&) {
+      fail(std::is_integral<T>::value ? "an integer that fits"
+                                      : "a number that fits");
+    }
+  }
+
+  /**
+   * Reads a number without converting it
+   */
+  folly::StringPiece readNumberToken();
+
+  /**
+   * Reads a string into value, unescaping it
+   */
+  void readString(std::string& value);
+
+  /**
+   * Returns the first character of the next value, without reading it, or
+   * '\0' if there is nothing left
+   */
+  inline char peek() {
+    skipWhitespace();
+    return pos_ != end_ ? *pos_ : '\0';
+  }
+
+  /**
+   * Skips over the next value, and everything in it
+   */
+  inline void skipValue() { skipValue(0); }
+
+  /**
+   * Checks that nothing but whitespace is left
+   */
+  void end();
+
+  /**
+   * Throws a runtime_error saying what was expected, and where
+   */
+  [[noreturn]] void fail(folly::StringPiece expected) const;
+};
+
+/**
+ * Writes JSON straight into a chain of IOBufs, without building a
+ * std::string first. The first buffer is kFirstBlockSize, so that small
+ * responses stay small, and each following one is twice as large, up to
+ * the block size. Blocks of kBlockSize are taken from a small cache on
+ * the writing thread, and only go back to it if the chain is freed on that
+ * same thread. Responses written on the connection's thread reuse the
+ * blocks of the ones before them, while blocks written on another
+ * executor are freed by the connection's thread. Not thread safe
+ */
+class JsonWriter {
+ private:
+  std::unique_ptr<folly::IOBuf> head_;
+  folly::IOBuf* tail_;
+  size_t blockSize_;
+  // The size of the block that grow() adds next
+  size_t nextBlockSize_;
+  size_t length_ = 0;
+  // Whether the next field or element is the first in its object or array
+  bool afterOpen_ = false;
+  // Reused when converting doubles
+  std::string scratch_;
+
+  void grow();
+
+  inline void separate() {
+    if (!afterOpen_) {
+      write(',');
+    }
+    afterOpen_ = false;
+  }
+
+ public:
+  static constexpr size_t kBlockSize = 16 * 1024;
+  static constexpr size_t kFirstBlockSize = 256;
+
+  /**
+   * Creates a JsonWriter
+   *
+   * @param blockSize - The size that buffers in the chain grow to. Only
+   *                    blocks of kBlockSize are cached
+   */
+  explicit JsonWriter(size_t blockSize = kBlockSize);
+
+  inline void write(char c) {
+    if (tail_->tailroom() == 0) {
+      grow();
+    }
+    *tail_->writableTail() = static_cast<uint8_t>(c);
+    tail_->append(1);
+    ++length_;
+  }
+
+  /**
+   * Writes raw bytes, which must already be valid JSON
+   */
+  void write(folly::StringPiece data);
+
+  inline void beginObject() {
+    write('{');
+    afterOpen_ = true;
+  }
+
+  /**
+   * Writes the name of the next field of the current object. Its value
+   * must be written next
+   */
+  inline void name(folly::StringPiece name) {
+    separate();
+    string(name);
+    write(':');
+  }
+
+  inline void endObject() {
+    write('}');
+    afterOpen_ = false;
+  }
+
+  inline void beginArray() {
+    write('[');
+    afterOpen_ = true;
+  }
+
+  /**
+   * Starts the next element of the current array. Its value must be
+   * written next
+   */
+  inline void element() { separate(); }
+
+  inline void endArray() {
+    write(']');
+    afterOpen_ = false;
+  }
+
+  /**
+   * Writes a quoted, escaped string. Bytes outside of ASCII are written as
+   * they are, so value should be UTF-8. Runs of bytes that don't need
+   * escaping are found eight bytes at a time, and copied at once
+   */
+  void string(folly::StringPiece value);
+
+  void integer(int64_t value);
+  void unsignedInteger(uint64_t value);
+
+  /**
+   * Writes the shortest representation of value that parses back to it
+   *
+   * @throws runtime_error if value is NaN or infinite, which JSON can't
+   *                       represent
+   */
+  void number(double value);
+
+  inline void boolean(bool value) { write(value ? "true" : "false"); }
+  inline void null() { write("null"); }
+
+  /**
+   * Returns the number of bytes that have been written
+   */
+  inline size_t length() const { return length_; }
+
+  /**
+   * Returns everything that has been written. Nothing else may be called
+   * on the writer afterwards
+   */
+  inline std::unique_ptr<folly::IOBuf> release() { return std::move(head_); }
+};
+
+/**
+ * A field of Class that is read from, and written to, JSON. See
+ * NOZOMI_JSON_FIELDS
+ */
+template <typename Class, typename Member>
+struct JsonField {
+  folly::StringPiece name;
+  Member Class::*member;
+};
+
+template <typename Class, typename Member>
+constexpr JsonField<Class, Member> json_field(folly::StringPiece name,
+                                              Member Class::*member) {
+  return JsonField<Class, Member>{name, member};
+}
+
+namespace json_binding {
+
+template <typename... Types>
+struct make_void {
+  using type = void;
+};
+
+template <typename... Types>
+using void_t = typename make_void<Types...>::type;
+
+template <typename T>
+struct dependent_false : std::false_type {};
+
+}  // namespace json_binding
+
+/**
+ * Whether T's fields were listed with NOZOMI_JSON_FIELDS
+ */
+template <typename T, typename = void>
+struct is_json_bound : std::false_type {};
+
+template <typename T>
+struct is_json_bound<T,
+                     json_binding::void_t<decltype(nozomi_json_fields(
+                         std::declval<const T*>()))>> : std::true_type {};
+
+/**
+ * Reads and writes a type as JSON. Specializations exist for bool,
+ * integers, floating point numbers, std::string, folly::dynamic,
+ * folly::Optional (null when empty), std::vector (arrays), and types
+ * listed with NOZOMI_JSON_FIELDS (objects). It can be specialized for
+ * other types
+ */
+template <typename T, typename = void>
+struct JsonValue {
+  static_assert(json_binding::dependent_false<T>::value,
+                "This type can't be read from or written to JSON. List its "
+                "fields with NOZOMI_JSON_FIELDS, or specialize JsonValue");
+};
+
+template <>
+struct JsonValue<bool> {
+  static inline void read(JsonReader& reader, bool& value) {
+    value = reader.readBool();
+  }
+  static inline void write(JsonWriter& writer, bool value) {
+    writer.boolean(value);
+  }
+};
+
+template <typename T>
+struct JsonValue<T,
+                 std::enable_if_t<std::is_integral<T>::value &&
+                                  !std::is_same<T, bool>::value>> {
+  static inline void read(JsonReader& reader, T& value) {
+    value = reader.readNumber<T>();
+  }
+  static inline void write(JsonWriter& writer, T value) {
+    if (std::is_signed<T>::value) {
+      writer.integer(static_cast<int64_t>(value));
+    } else {
+      writer.unsignedInteger(static_cast<uint64_t>(value));
+    }
+  }
+};
+
+template <typename T>
+struct JsonValue<T, std::enable_if_t<std::is_floating_point<T>::value>> {
+  static inline void read(JsonReader& reader, T& value) {
+    value = reader.readNumber<T>();
+  }
+  static inline void write(JsonWriter& writer, T value) {
+    writer.number(static_cast<double>(value));
+  }
+};
+
+template <>
+struct JsonValue<std::string> {
+  static inline void read(JsonReader& reader, std::string& value) {
+    reader.readString(value);
+  }
+  static inline void write(JsonWriter& writer, const std::string& value) {
+    writer.string(value);
+  }
+};
+
+/**
+ * Reads and writes a folly::dynamic. It is written the way folly::toJson
+ * writes it by default, so that HTTPResponse's dynamic constructors can
+ * write their bodies straight into a chain of blocks. Object keys must be
+ * strings
+ */
+template <>
+struct JsonValue<folly::dynamic> {
+  static void read(JsonReader& reader, folly::dynamic& value);
+  static void write(JsonWriter& writer, const folly::dynamic& value);
+};
+
+template <typename T>
+struct JsonValue<folly::Optional<T>> {
+  static inline void read(JsonReader& reader, folly::Optional<T>& value) {
+    if (reader.readNull()) {
+      value.clear();
+      return;
+    }
+    T inner{};
+    JsonValue<T>::read(reader, inner);
+    value = std::move(inner);
+  }
+  static inline void write(JsonWriter& writer,
+                           const folly::Optional<T>& value) {
+    if (value) {
+      JsonValue<T>::write(writer, *value);
+    } else {
+      writer.null();
+    }
+  }
+};
+
+template <typename T>
+struct JsonValue<std::vector<T>> {
+  static inline void read(JsonReader& reader, std::vector<T>& value) {
+    value.clear();
+    reader.beginArray();
+    while (reader.nextElement()) {
+      T element{};
+      JsonValue<T>::read(reader, element);
+      value.push_back(std::move(element));
+    }
+  }
+  static inline void write(JsonWriter& writer, const std::vector<T>& value) {
+    writer.beginArray();
+    for (const auto& element : value) {
+      writer.element();
+      JsonValue<T>::write(writer, element);
+    }
+    writer.endArray();
+  }
+};
+
+template <typename T>
+struct JsonValue<T, std::enable_if_t<is_json_bound<T>::value>> {
+ private:
+  using Fields = decltype(nozomi_json_fields(std::declval<const T*>()));
+  using Indexes = std::make_index_sequence<std::tuple_size<Fields>::value>;
+
+  template <typename Member>
+  static inline bool readField(JsonReader& reader,
+                               folly::StringPiece name,
+                               const JsonField<T, Member>& field,
+                               T& value) {
+    if (name != field.name) {
+      return false;
+    }
+    JsonValue<Member>::read(reader, value.*field.member);
+    return true;
+  }
+
+  template <size_t... N>
+  static inline bool readField(JsonReader& reader,
+                               folly::StringPiece name,
+                               const Fields& fields,
+                               T& value,
+                               std::index_sequence<N...>) {
+    bool found = false;
+    (void)std::initializer_list<int>{
+        (found = found || readField(reader, name, std::get<N>(fields), value),
+         0)...};
+    return found;
+  }
+
+  template <typename Member>
+  static inline void writeField(JsonWriter& writer,
+                                const JsonField<T, Member>& field,
+                                const T& value) {
+    writer.name(field.name);
+    JsonValue<Member>::write(writer, value.*field.member);
+  }
+
+  template <size_t... N>
+  static inline void writeFields(JsonWriter& writer,
+                                 const Fields& fields,
+                                 const T& value,
+                                 std::index_sequence<N...>) {
+    (void)std::initializer_list<int>{
+        (writeField(writer, std::get<N>(fields), value), 0)...};
+  }
+
+ public:
+  /**
+   * Reads an object into value. Fields that aren't listed are skipped, and
+   * listed fields that are missing keep their current values
+   */
+  static void read(JsonReader& reader, T& value) {
+    auto fields = nozomi_json_fields(static_cast<const T*>(nullptr));
+    reader.beginObject();
+    folly::StringPiece name;
+    while (reader.nextField(name)) {
+      if (!readField(reader, name, fields, value, Indexes())) {
+        reader.skipValue();
+      }
+    }
+  }
+
+  static void write(JsonWriter& writer, const T& value) {
+    auto fields = nozomi_json_fields(static_cast<const T*>(nullptr));
+    writer.beginObject();
+    writeFields(writer, fields, value, Indexes());
+    writer.endObject();
+  }
+};
+
+/**
+ * Parses a JSON document into value, without building a folly::dynamic
+ *
+ * @throws runtime_error if json is not valid, or does not match T
+ */
+template <typename T>
+inline void read_json(folly::StringPiece json, T& value) {
+  JsonReader reader(json);
+  JsonValue<T>::read(reader, value);
+  reader.end();
+}
+
+/**
+ * Parses a JSON document into a new T. See read_json
+ */
+template <typename T>
+inline T from_json(folly::StringPiece json) {
+  T value{};
+  read_json(json, value);
+  return value;
+}
+
+/**
+ * Writes value as JSON
+ */
+template <typename T>
+inline void write_json(JsonWriter& writer, const T& value) {
+  JsonValue<T>::write(writer, value);
+}
+
+/**
+ * Serializes value straight into a chain of IOBufs that can be used as a
+ * response body, e.g. HTTPResponse(200, to_json_body(user), headers)
+ */
+template <typename T>
+inline std::unique_ptr<folly::IOBuf> to_json_body(const T& value) {
+  JsonWriter writer;
+  write_json(writer, value);
+  return writer.release();
+}
+}
+
+/**
+ * Lists the fields of a struct that are read from, and written to, JSON
+ * by read_json and to_json_body, and by make_route for handlers that take
+ * the struct as their last argument. It must be used in the same
+ * namespace as the struct. Fields are named after their members, and up
+ * to 16 can be listed. Their types must have a JsonValue specialization.
+ *
+ * @examples
+ *  struct Order {
+ *    int64_t id;
+ *    std::string item;
+ *    folly::Optional<std::string> note;
+ *    std::vector<int64_t> quantities;
+ *  };
+ *  NOZOMI_JSON_FIELDS(Order, id, item, note, quantities)
+ */
+#define NOZOMI_JSON_FIELDS(Type, ...)                                    \
+  inline auto nozomi_json_fields(const Type*) {                          \
+    return std::make_tuple(                                              \
+        NOZOMI_JSON_FOR_EACH(NOZOMI_JSON_FIELD, Type, __VA_ARGS__));     \
+  }
+
+#define NOZOMI_JSON_FIELD(Type, member) \
+  ::nozomi::json_field(#member, &Type::member)
+
+#define NOZOMI_JSON_CAT(a, b) NOZOMI_JSON_CAT_IMPL(a, b)
+#define NOZOMI_JSON_CAT_IMPL(a, b) a##b
+#define NOZOMI_JSON_COUNT(...)                                              \
+  NOZOMI_JSON_COUNT_IMPL(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, \
+                         6, 5, 4, 3, 2, 1)
+#define NOZOMI_JSON_COUNT_IMPL(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, \
+                               _12, _13, _14, _15, _16, N, ...)              \
+  N
+#define NOZOMI_JSON_FOR_EACH(F, T, ...)                                  \
+  NOZOMI_JSON_CAT(NOZOMI_JSON_FOR_EACH_, NOZOMI_JSON_COUNT(__VA_ARGS__)) \
+  (F, T, __VA_ARGS__)
+#define NOZOMI_JSON_FOR_EACH_1(F, T, a) F(T, a)
+#define NOZOMI_JSON_FOR_EACH_2(F, T, a, ...) \
+  F(T, a), NOZOMI_JSON_FOR_EACH_1(F, T, __VA_ARGS__)
+#define NOZOMI_JSON_FOR_EACH_3(F, T, a, ...) \
+  F(T, a), NOZOMI_JSON_FOR_EACH_2(F, T, __VA_ARGS__)
+#define NOZOMI_JSON_FOR_EACH_4(F, T, a, ...) \
+  F(T, a), NOZOMI_JSON_FOR_EACH_3(F, T, __VA_ARGS__)
+#define NOZOMI_JSON_FOR_EACH_5(F, T, a, ...) \
+  F(T, a), NOZOMI_JSON_FOR_EACH_4(F, T, __VA_ARGS__)
+#define NOZOMI_JSON_FOR_EACH_6(F, T, a, ...) \
+  F(T, a), NOZOMI_JSON_FOR_EACH_5(F, T, __VA_ARGS__)
+#define NOZOMI_JSON_FOR_EACH_7(F, T, a, ...) \
+  F(T, a), NOZOMI_JSON_FOR_EACH_6(F, T, __VA_ARGS__)
+#define NOZOMI_JSON_FOR_EACH_8(F, T, a, ...) \
+  F(T, a), NOZOMI_JSON_FOR_EACH_7(F, T, __VA_ARGS__)
+#define NOZOMI_JSON_FOR_EACH_9(F, T, a, ...) \
+  F(T, a), NOZOMI_JSON_FOR_EACH_8(F, T, __VA_ARGS__)
+#define NOZOMI_JSON_FOR_EACH_10(F, T, a, ...) \
+  F(T, a), NOZOMI_JSON_FOR_EACH_9(F, T, __VA_ARGS__)
+#define NOZOMI_JSON_FOR_EACH_11(F, T, a, ...) \
+  F(T, a), NOZOMI_JSON_FOR_EACH_10(F, T, __VA_ARGS__)
+#define NOZOMI_JSON_FOR_EACH_12(F, T, a, ...) \
+  F(T, a), NOZOMI_JSON_FOR_EACH_11(F, T, __VA_ARGS__)
+#define NOZOMI_JSON_FOR_EACH_13(F, T, a, ...) \
+  F(T, a), NOZOMI_JSON_FOR_EACH_12(F, T, __VA_ARGS__)
+#define NOZOMI_JSON_FOR_EACH_14(F, T, a, ...) \
+  F(T, a), NOZOMI_JSON_FOR_EACH_13(F, T, __VA_ARGS__)
+#define NOZOMI_JSON_FOR_EACH_15(F, T, a, ...) \
+  F(T, a), NOZOMI_JSON_FOR_EACH_14(F, T, __VA_ARGS__)
+#define NOZOMI_JSON_FOR_EACH_16(F, T, a, ...) \
+  F(T, a), NOZOMI_JSON_FOR_EACH_15(F, T, __VA_ARGS__)
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <exception>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <folly/Format.h>
+#include <folly/futures/Future.h>
+
+#include "src/HTTPRequest.h"
+#include "src/HTTPResponse.h"
+#include "src/HandlerResult.h"
+#include "src/JsonBinding.h"
+#include "src/Util.h"
+
+namespace nozomi {
+
+/**
+ * Wraps a handler whose last argument is a struct listed with
+ * NOZOMI_JSON_FIELDS. The request body is parsed into the struct before
+ * the handler is called with it, and requests whose bodies can't be
+ * parsed get a 400 response without the handler being called. The struct
+ * lives until the handler's result is complete. make_route wraps handlers
+ * in this automatically
+ *
+ * @tparam Body - The type of the handler's last argument
+ * @tparam HandlerType - The type of the wrapped handler
+ */
+template <typename Body, typename HandlerType>
+class JsonBodyHandler {
+ private:
+  HandlerType handler_;
+
+  template <typename... PathArgs>
+  inline folly::Future<HTTPResponse> call(folly::Future<HTTPResponse>*,
+                                          const HTTPRequest& request,
+                                          std::unique_ptr<Body> body,
+                                          PathArgs&&... args) {
+    const Body& bodyRef = *body;
+    auto response =
+        handler_(request, std::forward<PathArgs>(args)..., bodyRef);
+    if (response.isReady()) {
+      return response;
+    }
+    return std::move(response).ensure([body = std::move(body)] {});
+  }
+
+#if FOLLY_HAS_COROUTINES
+  template <typename... PathArgs>
+  inline folly::coro::Task<HTTPResponse> call(
+      folly::coro::Task<HTTPResponse>*,
+      const HTTPRequest& request,
+      std::unique_ptr<Body> body,
+      PathArgs... args) {
+    co_return co_await handler_(request, std::move(args)..., *body);
+  }
+#endif
+
+ public:
+  explicit JsonBodyHandler(HandlerType handler)
+      : handler_(std::move(handler)) {}
+
+  template <typename... PathArgs>
+  auto operator()(const HTTPRequest& request, PathArgs&&... args) {
+    using Result = decltype(handler_(request, std::forward<PathArgs>(args)...,
+                                     std::declval<const Body&>()));
+    auto body = std::make_unique<Body>();
+    try {
+      read_json(request.getBodyAsStringPiece(), *body);
+    } catch (const std::exception& e) {
+      return make_handler_result<Result>(HTTPResponse(
+          400, folly::sformat("Invalid request body: {}", e.what())));
+    }
+    return call(static_cast<Result*>(nullptr), request, std::move(body),
+                std::forward<PathArgs>(args)...);
+  }
+};
+
+namespace json_body {
+
+/** Whether the last of Args is a struct listed with NOZOMI_JSON_FIELDS */
+template <typename... Args>
+struct last_arg_is_json_body : std::false_type {};
+
+template <typename Arg, typename... Args>
+struct last_arg_is_json_body<Arg, Args...>
+    : std::conditional_t<sizeof...(Args) == 0,
+                         is_json_bound<std::decay_t<Arg>>,
+                         last_arg_is_json_body<Args...>> {};
+
+template <bool IsJsonBody,
+          typename HandlerType,
+          typename Indexes,
+          typename... Args>
+struct json_body_args_impl {
+  using path_args = type_sequence<Args...>;
+
+  static inline HandlerType wrap(HandlerType handler) { return handler; }
+};
+
+template <typename HandlerType, size_t... N, typename... Args>
+struct json_body_args_impl<true,
+                           HandlerType,
+                           std::index_sequence<N...>,
+                           Args...> {
+  using path_args =
+      type_sequence<std::tuple_element_t<N, std::tuple<Args...>>...>;
+  using Body = std::decay_t<
+      std::tuple_element_t<sizeof...(Args) - 1, std::tuple<Args...>>>;
+
+  static inline JsonBodyHandler<Body, HandlerType> wrap(HandlerType handler) {
+    return JsonBodyHandler<Body, HandlerType>(std::move(handler));
+  }
+};
+}
+
+/**
+ * Splits the arguments of a handler (after the request) into the ones
+ * that come from the path and, if the last one is a struct listed with
+ * NOZOMI_JSON_FIELDS, the request body.
+ *
+ * path_args is a type_sequence of the arguments that come from the path,
+ * and wrap() returns the handler that a Route should call with them: the
+ * handler itself, or a JsonBodyHandler around it
+ */
+template <typename HandlerType, typename... HandlerArgs>
+struct json_body_args
+    : json_body::json_body_args_impl<
+          json_body::last_arg_is_json_body<HandlerArgs...>::value,
+          HandlerType,
+          std::make_index_sequence<
+              sizeof...(HandlerArgs) == 0 ? 0 : sizeof...(HandlerArgs) - 1>,
+          HandlerArgs...> {};
+}
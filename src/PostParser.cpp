@@ -4,7 +4,6 @@
 
 #include <folly/String.h>
 #include <folly/gen/Base.h>
-#include <folly/gen/String.h>
 #include <proxygen/lib/http/HTTPCommonHeaders.h>
 
 #include "src/StringUtils.h"
@@ -13,7 +12,6 @@ using folly::IOBuf;
 using folly::Optional;
 using folly::StringPiece;
 using std::unordered_map;
-using std::pair;
 using std::string;
 using std::unique_ptr;
 using std::vector;
@@ -27,13 +25,13 @@ PostParser::PostParser(const HTTPRequest& request)
 
 unordered_map<string, vector<unique_ptr<IOBuf>>> PostParser::parseRequest(
     const HTTPRequest& request, const unique_ptr<IOBuf>& body) {
-  auto contentType =
-      request.getHeaders()[HTTPHeaderCode::HTTP_HEADER_CONTENT_TYPE];
+  auto contentType = request.getHeaders().getHeaderPiece(
+      HTTPHeaderCode::HTTP_HEADER_CONTENT_TYPE);
   if (!contentType) {
     return unordered_map<string, vector<unique_ptr<IOBuf>>>();
   }
   if (*contentType == "application/x-www-form-urlencoded") {
-    return parseUrlEncoded(body);
+    return parseUrlEncoded(body, request.getArena());
   }
   if (*contentType == "multipart/form-data") {
     return parseFormData(body);
@@ -84,6 +82,12 @@ Optional<vector<unique_ptr<IOBuf>>> PostParser::getBinaryList(
 
 unordered_map<string, vector<unique_ptr<IOBuf>>> PostParser::parseUrlEncoded(
     const unique_ptr<IOBuf>& body) {
+  RequestArena arena;
+  return parseUrlEncoded(body, arena);
+}
+
+unordered_map<string, vector<unique_ptr<IOBuf>>> PostParser::parseUrlEncoded(
+    const unique_ptr<IOBuf>& body, RequestArena& arena) {
   // TODO: This completely ignores encoding headers when parsing. If you send it
   //      binary data, it's going to try its damndest to split and give you
   //      binary
@@ -92,43 +96,54 @@ unordered_map<string, vector<unique_ptr<IOBuf>>> PostParser::parseUrlEncoded(
   //      be careful using .data()/.c_str() on things that expect a raw char*
   //      with
   //      no length delimiter
-  // TODO: Optimize this to get rid of the extra copies. Chained IOBuf
-  // ownership: It's complicated
   unordered_map<string, vector<unique_ptr<IOBuf>>> ret;
-  auto asString = to_string(body);
-  auto kvps =
-      split(asString, "&") | filter([](StringPiece& keyValueString) {
-        return keyValueString.size() != 0;
-      }) |
-      map([](StringPiece keyValueString) {
-        folly::StringPiece key, value;
-        if (!folly::split<false>("=", keyValueString, key, value)) {
-          key = keyValueString;
-        }
-        return std::make_pair<StringPiece, StringPiece>(std::move(key),
-                                                        std::move(value));
-      }) |
-      map([](pair<StringPiece, StringPiece> kvp) {
-        // Ignore conversion failures. Better to give /something/ rather than
-        // nothing.
-        string key, value;
-        try {
-          folly::uriUnescape(kvp.first, key, folly::UriEscapeMode::QUERY);
-        } catch (const std::exception& e) {
-          key = kvp.first.toString();
-        }
-        try {
-          folly::uriUnescape(kvp.second, value, folly::UriEscapeMode::QUERY);
-        } catch (const std::exception& e) {
-          value = kvp.second.toString();
-        }
-        return std::make_pair<string, string>(std::move(key), std::move(value));
-      }) |
-      as<vector>();
-  ret.reserve(kvps.size());
-  for (auto& kvp : kvps) {
-    ret[std::move(kvp.first)].push_back(
-        IOBuf::copyBuffer(std::move(kvp.second)));
+
+  // The flattened body and the decoded keys and values are scratch space,
+  // so they live in the arena. Only the results are copied out
+  ArenaAllocator<char> allocator(arena);
+  ArenaString asString(allocator);
+  asString.reserve(body->computeChainDataLength());
+  for (const auto& buf : *body) {
+    asString.append(reinterpret_cast<const char*>(buf.data()), buf.size());
+  }
+  ArenaString key(allocator);
+  ArenaString value(allocator);
+
+  StringPiece remaining(asString.data(), asString.size());
+  while (!remaining.empty()) {
+    auto end = remaining.find('&');
+    auto keyValueString =
+        remaining.subpiece(0, end == StringPiece::npos ? remaining.size() : end);
+    remaining.advance(end == StringPiece::npos ? remaining.size() : end + 1);
+    if (keyValueString.empty()) {
+      continue;
+    }
+
+    StringPiece rawKey = keyValueString;
+    StringPiece rawValue;
+    auto equals = keyValueString.find('=');
+    if (equals != StringPiece::npos &&
+        keyValueString.find('=', equals + 1) == StringPiece::npos) {
+      rawKey = keyValueString.subpiece(0, equals);
+      rawValue = keyValueString.subpiece(equals + 1);
+    }
+
+    // Ignore conversion failures. Better to give /something/ rather than
+    // nothing.
+    key.clear();
+    value.clear();
+    try {
+      folly::uriUnescape(rawKey, key, folly::UriEscapeMode::QUERY);
+    } catch (const std::exception& e) {
+      key.assign(rawKey.data(), rawKey.size());
+    }
+    try {
+      folly::uriUnescape(rawValue, value, folly::UriEscapeMode::QUERY);
+    } catch (const std::exception& e) {
+      value.assign(rawValue.data(), rawValue.size());
+    }
+    ret[string(key.data(), key.size())].push_back(
+        IOBuf::copyBuffer(value.data(), value.size()));
   }
   return ret;
 }
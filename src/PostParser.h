@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "src/HTTPRequest.h"
+#include "src/RequestArena.h"
 
 namespace nozomi {
 
@@ -30,6 +31,13 @@ class PostParser {
   static std::unordered_map<std::string,
                             std::vector<std::unique_ptr<folly::IOBuf>>>
   parseUrlEncoded(const std::unique_ptr<folly::IOBuf>& body);
+  /**
+   * Parses a url encoded body, using arena for scratch space
+   */
+  static std::unordered_map<std::string,
+                            std::vector<std::unique_ptr<folly::IOBuf>>>
+  parseUrlEncoded(const std::unique_ptr<folly::IOBuf>& body,
+                  RequestArena& arena);
   static std::unordered_map<std::string,
                             std::vector<std::unique_ptr<folly::IOBuf>>>
   parseFormData(const std::unique_ptr<folly::IOBuf>& body);
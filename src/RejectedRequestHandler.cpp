@@ -0,0 +1,31 @@
+#include "src/RejectedRequestHandler.h"
+
+#include <proxygen/httpserver/ResponseBuilder.h>
+
+using folly::IOBuf;
+using proxygen::ProxygenError;
+using proxygen::ResponseBuilder;
+using std::unique_ptr;
+
+namespace nozomi {
+
+unique_ptr<IOBuf> RejectedRequestHandler::makeBody() {
+  return IOBuf::copyBuffer("Service Unavailable");
+}
+
+void RejectedRequestHandler::onEOM() noexcept {
+  ResponseBuilder(downstream_)
+      .status(503, "Service Unavailable")
+      .header("Retry-After", "1")
+      .body(body_.clone())
+      .sendWithEOM();
+}
+
+void RejectedRequestHandler::requestComplete() noexcept {
+  delete this;
+}
+
+void RejectedRequestHandler::onError(ProxygenError) noexcept {
+  delete this;
+}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <memory>
+
+#include <folly/io/IOBuf.h>
+#include <proxygen/httpserver/RequestHandler.h>
+#include <proxygen/lib/http/HTTPMessage.h>
+
+namespace nozomi {
+
+/**
+ * Sends a 503 with a Retry-After header to a request that was shed by the
+ * AdmissionController. It runs on the connection's thread, never calls a
+ * route's handler, and its body is shared with every other rejection
+ */
+class RejectedRequestHandler : public virtual proxygen::RequestHandler {
+ private:
+  const folly::IOBuf& body_;
+
+ public:
+  /**
+   * Creates a RejectedRequestHandler
+   *
+   * @param body - The response body. It is cloned, not copied, so it must
+   *               outlive this handler
+   */
+  explicit RejectedRequestHandler(const folly::IOBuf& body) : body_(body) {}
+  virtual ~RejectedRequestHandler() noexcept {}
+
+  /**
+   * Creates the body that is shared between rejections
+   */
+  static std::unique_ptr<folly::IOBuf> makeBody();
+
+  /**
+   * @copydoc proxygen::RequestHandler::onRequest()
+   */
+  virtual void onRequest(
+      std::unique_ptr<proxygen::HTTPMessage> headers) noexcept override {}
+
+  /**
+   * @copydoc proxygen::RequestHandler::onBody()
+   */
+  virtual void onBody(std::unique_ptr<folly::IOBuf> body) noexcept override {}
+
+  /**
+   * @copydoc proxygen::RequestHandler::onUpgrade()
+   */
+  virtual void onUpgrade(proxygen::UpgradeProtocol prot) noexcept override {}
+
+  /**
+   * @copydoc proxygen::RequestHandler::onEOM()
+   */
+  virtual void onEOM() noexcept override;
+
+  /**
+   * @copydoc proxygen::RequestHandler::requestComplete()
+   */
+  virtual void requestComplete() noexcept override;
+
+  /**
+   * @copydoc proxygen::RequestHandler::onError()
+   */
+  virtual void onError(proxygen::ProxygenError err) noexcept override;
+};
+}
@@ -0,0 +1,149 @@
+#include "src/RequestArena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include <glog/logging.h>
+
+namespace nozomi {
+
+constexpr size_t RequestArena::kDefaultBlockSize;
+
+namespace {
+constexpr size_t kMaxCachedBlocks = 64;
+
+/**
+ * Blocks that were released on this thread, waiting to be reused
+ */
+struct BlockCache {
+  struct Node {
+    Node* next;
+    size_t size;
+  };
+  Node* head = nullptr;
+  size_t count = 0;
+
+  ~BlockCache() {
+    while (head != nullptr) {
+      auto* next = head->next;
+      std::free(head);
+      head = next;
+    }
+  }
+};
+
+inline BlockCache& block_cache() {
+  static thread_local BlockCache cache;
+  return cache;
+}
+}
+
+RequestArena::RequestArena(size_t blockSize) : blockSize_(blockSize) {
+  DCHECK(blockSize_ > 0) << "RequestArena block size must be at least 1";
+}
+
+RequestArena::RequestArena(RequestArena&& other) noexcept
+    : blockSize_(other.blockSize_),
+      blocks_(other.blocks_),
+      cursor_(other.cursor_),
+      end_(other.end_),
+      bytesUsed_(other.bytesUsed_) {
+  other.blocks_ = nullptr;
+  other.cursor_ = nullptr;
+  other.end_ = nullptr;
+  other.bytesUsed_ = 0;
+}
+
+RequestArena& RequestArena::operator=(RequestArena&& other) noexcept {
+  if (this != &other) {
+    clear();
+    blockSize_ = other.blockSize_;
+    blocks_ = other.blocks_;
+    cursor_ = other.cursor_;
+    end_ = other.end_;
+    bytesUsed_ = other.bytesUsed_;
+    other.blocks_ = nullptr;
+    other.cursor_ = nullptr;
+    other.end_ = nullptr;
+    other.bytesUsed_ = 0;
+  }
+  return *this;
+}
+
+RequestArena::~RequestArena() {
+  clear();
+}
+
+void* RequestArena::allocateSlow(size_t size, size_t align) {
+  Block* block = nullptr;
+
+  if (size + align - 1 > blockSize_) {
+    // Too large to share a block. The current block stays first, so that
+    // smaller allocations keep using it
+    auto blockBytes = sizeof(Block) + align - 1 + size;
+    block = static_cast<Block*>(std::malloc(blockBytes));
+    if (block == nullptr) {
+      throw std::bad_alloc();
+    }
+    block->size = blockBytes;
+    if (blocks_ != nullptr) {
+      block->next = blocks_->next;
+      blocks_->next = block;
+    } else {
+      block->next = nullptr;
+      blocks_ = block;
+    }
+    bytesUsed_ += size;
+    auto data = reinterpret_cast<uintptr_t>(block) + sizeof(Block);
+    return reinterpret_cast<void*>((data + align - 1) &
+                                   ~(uintptr_t)(align - 1));
+  }
+
+  auto& cache = block_cache();
+  auto blockBytes = sizeof(Block) + blockSize_;
+  while (cache.head != nullptr && block == nullptr) {
+    auto* node = cache.head;
+    cache.head = node->next;
+    --cache.count;
+    if (node->size == blockBytes) {
+      block = reinterpret_cast<Block*>(node);
+    } else {
+      std::free(node);
+    }
+  }
+  if (block == nullptr) {
+    block = static_cast<Block*>(std::malloc(blockBytes));
+    if (block == nullptr) {
+      throw std::bad_alloc();
+    }
+  }
+  block->size = blockBytes;
+  block->next = blocks_;
+  blocks_ = block;
+  cursor_ = reinterpret_cast<char*>(block) + sizeof(Block);
+  end_ = reinterpret_cast<char*>(block) + blockBytes;
+  return allocate(size, align);
+}
+
+void RequestArena::clear() {
+  auto& cache = block_cache();
+  auto blockBytes = sizeof(Block) + blockSize_;
+  while (blocks_ != nullptr) {
+    auto* block = blocks_;
+    blocks_ = block->next;
+    if (block->size == blockBytes && cache.count < kMaxCachedBlocks) {
+      auto* node = reinterpret_cast<BlockCache::Node*>(block);
+      node->next = cache.head;
+      node->size = blockBytes;
+      cache.head = node;
+      ++cache.count;
+    } else {
+      std::free(block);
+    }
+  }
+  cursor_ = nullptr;
+  end_ = nullptr;
+  bytesUsed_ = 0;
+}
+}
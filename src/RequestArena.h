@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace nozomi {
+
+/**
+ * A monotonic allocator for memory that lives as long as one request.
+ * Allocation bumps a pointer through fixed size blocks, deallocation does
+ * nothing, and every block is released at once when the arena is cleared
+ * or destroyed. Released blocks go to a small per-thread cache, so a busy
+ * thread reuses the same blocks from request to request. No block is
+ * allocated until the first allocation. Destructors of objects placed in
+ * the arena are not run, so it is meant for strings, vectors and other
+ * containers that only hold memory. Not thread safe
+ */
+class RequestArena {
+ public:
+  static constexpr size_t kDefaultBlockSize = 4096;
+
+ private:
+  struct Block {
+    Block* next;
+    size_t size;
+  };
+
+  size_t blockSize_;
+  // The block being allocated from is first. Oversized allocations get
+  // their own block, which is put second
+  Block* blocks_ = nullptr;
+  char* cursor_ = nullptr;
+  char* end_ = nullptr;
+  size_t bytesUsed_ = 0;
+
+  void* allocateSlow(size_t size, size_t align);
+
+ public:
+  /**
+   * Creates a RequestArena
+   *
+   * @param blockSize - The size of each block. Allocations larger than
+   *                    this get a block of their own
+   */
+  explicit RequestArena(size_t blockSize = kDefaultBlockSize);
+  RequestArena(RequestArena&& other) noexcept;
+  RequestArena& operator=(RequestArena&& other) noexcept;
+  RequestArena(const RequestArena&) = delete;
+  RequestArena& operator=(const RequestArena&) = delete;
+  ~RequestArena();
+
+  /**
+   * Allocates size bytes, aligned to align, which must be a power of two
+   */
+  inline void* allocate(size_t size,
+                        size_t align = alignof(std::max_align_t)) {
+    auto address = reinterpret_cast<uintptr_t>(cursor_);
+    auto aligned = (address + align - 1) & ~(uintptr_t)(align - 1);
+    if (cursor_ != nullptr &&
+        aligned + size <= reinterpret_cast<uintptr_t>(end_)) {
+      cursor_ = reinterpret_cast<char*>(aligned + size);
+      bytesUsed_ += size;
+      return reinterpret_cast<void*>(aligned);
+    }
+    return allocateSlow(size, align);
+  }
+
+  /**
+   * Releases every block. Memory that was allocated must not be used
+   * afterwards
+   */
+  void clear();
+
+  /**
+   * Returns the number of bytes that have been allocated, not counting
+   * padding or unused space at the end of blocks
+   */
+  inline size_t getBytesUsed() const { return bytesUsed_; }
+
+  inline size_t getBlockSize() const { return blockSize_; }
+};
+
+/**
+ * An allocator for standard containers that allocates from a RequestArena.
+ * The arena must outlive every container that uses it
+ */
+template <typename T>
+class ArenaAllocator {
+ private:
+  template <typename U>
+  friend class ArenaAllocator;
+
+  RequestArena* arena_;
+
+ public:
+  using value_type = T;
+
+  explicit ArenaAllocator(RequestArena& arena) : arena_(&arena) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena_) {}
+
+  inline T* allocate(size_t n) {
+    return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  inline void deallocate(T*, size_t) {}
+
+  template <typename U>
+  inline bool operator==(const ArenaAllocator<U>& other) const {
+    return arena_ == other.arena_;
+  }
+
+  template <typename U>
+  inline bool operator!=(const ArenaAllocator<U>& other) const {
+    return arena_ != other.arena_;
+  }
+};
+
+using ArenaString =
+    std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+}
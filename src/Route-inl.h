@@ -2,101 +2,119 @@
 #include <folly/Conv.h>
 #include <folly/Format.h>
 
+#include "src/HandlerResult.h"
 #include "src/RouteParsing.h"
 
 namespace nozomi {
 namespace {
 
-template <typename... HandlerArgs, std::size_t... N>
-inline void call_streaming_handler(
-    std::index_sequence<N...>,
-    type_sequence<HandlerArgs...>,
-    StreamingHTTPHandler<HandlerArgs...>& handler,
-    const boost::smatch& matches) {
-  return handler.setRequestArgs(
-      route_parsing::get_handler_args<N, HandlerArgs>(matches)...);
-}
-
-template <typename... HandlerArgs>
-inline void call_streaming_handler(
-    StreamingHTTPHandler<HandlerArgs...>& handler,
-    const boost::smatch& matches) {
-  return call_streaming_handler(std::index_sequence_for<HandlerArgs...>{},
-                                type_sequence<HandlerArgs...>{}, handler,
-                                matches);
+/**
+ * Records the group for each of a route's typed parameters from a regex
+ * match on path
+ */
+template <size_t N>
+inline route_parsing::RouteCaptures capture_matches(
+    const std::string& path,
+    const boost::smatch& matches,
+    const std::array<size_t, N>& groups,
+    size_t groupOffset) {
+  route_parsing::RouteCaptures captures;
+  for (auto group : groups) {
+    const auto& match = matches[groupOffset + group];
+    if (match.matched) {
+      captures.push_back(match.first - path.begin(),
+                         match.second - match.first);
+    } else {
+      captures.push_back_unmatched();
+    }
+  }
+  return captures;
 }
 
-template <typename HandlerType, typename... HandlerArgs, std::size_t... N>
-inline folly::Future<HTTPResponse> call_handler(std::index_sequence<N...>,
-                                                type_sequence<HandlerArgs...>,
-                                                HandlerType& f,
-                                                const HTTPRequest& request,
-                                                const boost::smatch& matches) {
-  return f(request,
-           route_parsing::get_handler_args<N, HandlerArgs>(matches)...);
-}
+/**
+ * Makes RouteMatch objects for matched routes, and calls their handlers.
+ * Arguments are converted from the path when the handler is called, so
+ * matching a route does not allocate
+ */
+template <typename HandlerType, bool IsStreaming, typename... HandlerArgs>
+struct RouteCaller {};
 
 template <typename HandlerType, typename... HandlerArgs>
-inline folly::Future<HTTPResponse> call_handler(HandlerType& f,
-                                                const HTTPRequest& request,
-                                                const boost::smatch& matches) {
-  return call_handler(std::index_sequence_for<HandlerArgs...>{},
-                      type_sequence<HandlerArgs...>{}, f, request, matches);
-}
+struct RouteCaller<HandlerType, false, HandlerArgs...> {
+  inline RouteMatch match(BaseRoute* route,
+                          const RoutingContext&,
+                          const route_parsing::RouteCaptures& captures) {
+    return RouteMatch(RouteMatchResult::RouteMatched,
+                      RouteHandler(route, captures));
+  }
 
-template <typename HandlerType, bool IsStreaming, typename... HandlerArgs>
-struct RegexRouteMatchMaker {};
+  template <std::size_t... N>
+  inline folly::Future<HTTPResponse> call(
+      std::index_sequence<N...>,
+      HandlerType& handler,
+      const HTTPRequest& request,
+      const route_parsing::RouteCaptures& captures,
+      folly::Executor* executor) {
+    folly::StringPiece path(request.getPath());
+    return to_response_future(
+        handler(request, route_parsing::get_capture_arg<HandlerArgs>(
+                             path, captures[N])...),
+        request, executor);
+  }
 
-template <typename HandlerType, typename... HandlerArgs>
-struct RegexRouteMatchMaker<HandlerType, false, HandlerArgs...> {
-  inline RouteMatch operator()(std::shared_ptr<const std::string>& path,
-                               boost::smatch& matches,
-                               HandlerType& handler) {
-    return RouteMatch(
-        RouteMatchResult::RouteMatched,
-        std::function<folly::Future<HTTPResponse>(const HTTPRequest&)>([
-          path = std::move(path), matches = std::move(matches), &handler
-        ](const HTTPRequest& request) mutable {
-          // We have to hold onto the original path variable because
-          // the matches object
-          // retains a reference to the string that was matched on.
-          // We use a unique_ptr
-          // because there's no absolute guarantee that an std::move
-          // won't invalidate the
-          // reference to the original string.
-          return call_handler<HandlerType, HandlerArgs...>(handler, request,
-                                                           matches);
-        }));
+  template <std::size_t... N>
+  inline proxygen::RequestHandler* callStreaming(
+      std::index_sequence<N...>,
+      HandlerType&,
+      folly::StringPiece,
+      const route_parsing::RouteCaptures&) {
+    DCHECK(false) << "Non-streaming routes do not create streaming handlers";
+    return nullptr;
   }
 };
 
 template <typename HandlerType, typename... HandlerArgs>
-struct RegexRouteMatchMaker<HandlerType, true, HandlerArgs...> {
-  inline RouteMatch operator()(std::shared_ptr<const std::string>& path,
-                               boost::smatch& matches,
-                               HandlerType& handler) {
-    // TODO: Fill this out properly
+struct RouteCaller<HandlerType, true, HandlerArgs...> {
+  inline RouteMatch match(BaseRoute* route,
+                          const RoutingContext& context,
+                          const route_parsing::RouteCaptures& captures) {
     return RouteMatch(
         RouteMatchResult::RouteMatched,
-        std::function<proxygen::RequestHandler*()>([
-          path = std::move(path), matches = std::move(matches), &handler
-        ]() {
-          // TODO: Exception handling to cleanup memory
-          decltype(handler()) ret = nullptr;
-          try {
-            ret = handler();
-            if (ret != nullptr) {
-              call_streaming_handler<HandlerArgs...>(*ret, matches);
-            }
-          } catch (const std::exception& e) {
-            // TODO: Logging
-            if (ret != nullptr) {
-              delete ret;
-            }
-            ret = nullptr;
-          }
-          return ret;
-        }));
+        StreamingRouteHandler(route, captures, context.getPathBuffer()));
+  }
+
+  template <std::size_t... N>
+  inline folly::Future<HTTPResponse> call(
+      std::index_sequence<N...>,
+      HandlerType&,
+      const HTTPRequest&,
+      const route_parsing::RouteCaptures&,
+      folly::Executor*) {
+    DCHECK(false) << "Streaming routes are not called with a request";
+    return HTTPResponse::future(500);
+  }
+
+  template <std::size_t... N>
+  inline proxygen::RequestHandler* callStreaming(
+      std::index_sequence<N...>,
+      HandlerType& handler,
+      folly::StringPiece path,
+      const route_parsing::RouteCaptures& captures) {
+    decltype(handler()) ret = nullptr;
+    try {
+      ret = handler();
+      if (ret != nullptr) {
+        ret->setRequestArgs(
+            route_parsing::get_capture_arg<HandlerArgs>(path, captures[N])...);
+      }
+    } catch (const std::exception& e) {
+      // TODO: Logging
+      if (ret != nullptr) {
+        delete ret;
+      }
+      ret = nullptr;
+    }
+    return ret;
   }
 };
 
@@ -104,22 +122,74 @@ struct RegexRouteMatchMaker<HandlerType, true, HandlerArgs...> {
 
 template <typename HandlerType, bool IsStreaming, typename... HandlerArgs>
 RouteMatch Route<HandlerType, IsStreaming, HandlerArgs...>::handler(
-    const proxygen::HTTPMessage* request) {
-  DCHECK(request != nullptr) << "Request must not be null";
-  boost::smatch matches;
-  auto methodAndPath = HTTPRequest::getMethodAndPath(request);
-  // TODO: Make this unique when using folly::function
-  auto path = std::make_shared<const std::string>(
-      std::move(std::get<1>(methodAndPath)));
-  if (!boost::regex_match(*path, matches, regex_)) {
+    const RoutingContext& context) {
+  if (segments_) {
+    route_parsing::RouteCaptures captures;
+    if (!route_parsing::match_segments(segments_.value(), context.getPath(),
+                                       context.getPathSegments(), captures)) {
+      return RouteMatch(RouteMatchResult::PathNotMatched);
+    }
+    return handlerFromCaptures(context, captures);
+  }
+
+  const auto& path = context.getPath();
+  if (path.compare(0, prefixLength_, originalPattern_, 0, prefixLength_) !=
+      0) {
+    return RouteMatch(RouteMatchResult::PathNotMatched);
+  }
+  // Reused so that its storage is only allocated once per thread
+  static thread_local boost::smatch matches;
+  if (!boost::regex_match(path, matches, regex_.value())) {
     return RouteMatch(RouteMatchResult::PathNotMatched);
   }
-  if (methods_.find(std::get<0>(methodAndPath)) == methods_.end()) {
+  return handlerFromMatch(context, matches, 0);
+}
+
+template <typename HandlerType, bool IsStreaming, typename... HandlerArgs>
+RouteMatch Route<HandlerType, IsStreaming, HandlerArgs...>::handlerFromMatch(
+    const RoutingContext& context,
+    const boost::smatch& matches,
+    size_t groupOffset) {
+  DCHECK(regex_) << "Only regex routes can be matched from regex matches";
+  if (methods_.find(context.getMethod()) == methods_.end()) {
+    return RouteMatch(RouteMatchResult::MethodNotMatched);
+  }
+  return RouteCaller<HandlerType, IsStreaming, HandlerArgs...>{}.match(
+      this, context,
+      capture_matches(context.getPath(), matches, groups_, groupOffset));
+}
+
+template <typename HandlerType, bool IsStreaming, typename... HandlerArgs>
+RouteMatch Route<HandlerType, IsStreaming, HandlerArgs...>::handlerFromCaptures(
+    const RoutingContext& context,
+    const route_parsing::RouteCaptures& captures) {
+  DCHECK(segments_) << "Only segment routes can be matched from captures";
+  DCHECK(captures.size() == sizeof...(HandlerArgs));
+  if (methods_.find(context.getMethod()) == methods_.end()) {
     return RouteMatch(RouteMatchResult::MethodNotMatched);
   }
+  return RouteCaller<HandlerType, IsStreaming, HandlerArgs...>{}.match(
+      this, context, captures);
+}
 
-  return RegexRouteMatchMaker<HandlerType, IsStreaming, HandlerArgs...>{}(
-      path, matches, handler_);
+template <typename HandlerType, bool IsStreaming, typename... HandlerArgs>
+folly::Future<HTTPResponse>
+Route<HandlerType, IsStreaming, HandlerArgs...>::call(
+    const HTTPRequest& request,
+    const route_parsing::RouteCaptures& captures,
+    folly::Executor* executor) {
+  return RouteCaller<HandlerType, IsStreaming, HandlerArgs...>{}.call(
+      std::index_sequence_for<HandlerArgs...>{}, handler_, request, captures,
+      executor);
+}
+
+template <typename HandlerType, bool IsStreaming, typename... HandlerArgs>
+proxygen::RequestHandler*
+Route<HandlerType, IsStreaming, HandlerArgs...>::callStreaming(
+    folly::StringPiece path,
+    const route_parsing::RouteCaptures& captures) {
+  return RouteCaller<HandlerType, IsStreaming, HandlerArgs...>{}.callStreaming(
+      std::index_sequence_for<HandlerArgs...>{}, handler_, path, captures);
 }
 
 template <typename HandlerType, bool IsStreaming, typename... HandlerArgs>
@@ -129,12 +199,12 @@ Route<HandlerType, IsStreaming, HandlerArgs...>::Route(
     HandlerType handler)
     : BaseRoute(std::move(pattern), std::move(methods), false),
       handler_(std::move(handler)) {
-  auto regexAndPatternParams =
-      route_parsing::parse_route_pattern(originalPattern_);
+  auto routePattern = route_parsing::parse_route_pattern(originalPattern_);
   auto functionParams =
       route_parsing::parse_function_parameters<HandlerArgs...>();
-  const auto& patternParams = regexAndPatternParams.second;
-  regex_ = std::move(regexAndPatternParams.first);
+  const auto& patternParams = routePattern.types;
+  regex_ = std::move(routePattern.regex);
+  segments_ = std::move(routePattern.segments);
 
   if (patternParams.size() != functionParams.size()) {
     auto error = folly::sformat(
@@ -161,5 +231,33 @@ Route<HandlerType, IsStreaming, HandlerArgs...>::Route(
           to_string(functionParams[i])));
     }
   }
+  if (regex_) {
+    std::copy(routePattern.groups.begin(), routePattern.groups.end(),
+              groups_.begin());
+    prefixLength_ = route_parsing::literal_prefix_length(
+        originalPattern_.data(), originalPattern_.size());
+  }
+}
+
+template <typename HandlerType, bool IsStreaming, typename... HandlerArgs>
+Route<HandlerType, IsStreaming, HandlerArgs...>::Route(
+    std::string pattern,
+    std::unordered_set<proxygen::HTTPMethod> methods,
+    HandlerType handler,
+    const route_parsing::PatternInfo<sizeof...(HandlerArgs)>& info)
+    : BaseRoute(std::move(pattern), std::move(methods), false),
+      handler_(std::move(handler)) {
+  // Types were already checked at compile time, so the pattern only needs
+  // to be turned into a regex or segments
+  auto routePattern = route_parsing::parse_route_pattern(originalPattern_);
+  DCHECK(routePattern.types.size() == sizeof...(HandlerArgs));
+  regex_ = std::move(routePattern.regex);
+  segments_ = std::move(routePattern.segments);
+  if (regex_) {
+    std::copy(std::begin(info.groups),
+              std::begin(info.groups) + sizeof...(HandlerArgs),
+              groups_.begin());
+    prefixLength_ = info.prefixLength;
+  }
 }
 }
@@ -1,18 +1,24 @@
 #pragma once
 
+#include <array>
+#include <memory>
 #include <string>
 #include <unordered_set>
 #include <vector>
 
 #include "src/BaseRoute.h"
 #include "src/EnumHash.h"
+#include "src/HandlerResult.h"
 #include "src/HTTPRequest.h"
 #include "src/HTTPResponse.h"
+#include "src/JsonBody.h"
+#include "src/RouteParsing.h"
 #include "src/StreamingHTTPHandler.h"
 #include "src/Util.h"
 
 #include <boost/regex.hpp>
 #include <folly/Optional.h>
+#include <folly/Range.h>
 #include <folly/futures/Future.h>
 #include <proxygen/lib/http/HTTPMethod.h>
 
@@ -36,7 +42,19 @@ template <typename HandlerType, bool isStreaming, typename... HandlerArgs>
 class Route : public BaseRoute {
  private:
   HandlerType handler_;
-  boost::basic_regex<char> regex_;
+  folly::Optional<boost::basic_regex<char>> regex_;
+  // The regex group for each of HandlerArgs. Unused for segment routes
+  std::array<size_t, sizeof...(HandlerArgs)> groups_{};
+  // Paths that don't start with this much of the pattern can't match regex_
+  size_t prefixLength_ = 0;
+
+  static_assert(!isStreaming ||
+                    !route_parsing::has_path_views<HandlerArgs...>::value,
+                "Streaming handlers outlive the request path, and must take "
+                "std::string instead of StringPiece arguments");
+  static_assert(sizeof...(HandlerArgs) <= route_parsing::kMaxRouteParams,
+                "Routes can have at most kMaxRouteParams typed parameters");
+  folly::Optional<std::vector<route_parsing::PatternSegment>> segments_;
 
  public:
   /**
@@ -67,11 +85,23 @@ class Route : public BaseRoute {
    *                  - {{s?:<regex>:<consumed>}} passes a
    *                    folly::Optional<string> based on whether <regex>
    *                    matches. See above for how <consumed> works.
+   *                  Non-streaming handlers may take string parameters as
+   *                  folly::StringPiece (or std::string_view in C++17)
+   *                  instead of std::string to avoid a copy. These point
+   *                  into the request's path, and are valid for as long as
+   *                  the HTTPRequest is.
+   *                  Patterns made up of only literal segments and whole
+   *                  segment {{i}}, {{d}} and {{s:[^/]+}} parameters are
+   *                  matched segment by segment instead of with a regular
+   *                  expression, and a Router will look them up in a
+   *                  RouteTrie.
    * @param methods - The list of methods that this route is valid for
    * @param handler - A callable that does one of two things:
    *                  - Takes a const HTTPRequest& and HandlerArgs, and returns
-   *                    a folly::Future<HTTPResponse>. This is valid if
-   *                    IsStreaming is false
+   *                    a folly::Future<HTTPResponse>, or a
+   *                    folly::coro::Task<HTTPResponse> if the compiler
+   *                    supports coroutines. This is valid if IsStreaming is
+   *                    false
    *                  - Takes no arguments and returns a free instance
    *                    StreamingHTTPRequest<HandlerArgs>* This is valid if
    *                    IsStreaming is true
@@ -97,6 +127,20 @@ class Route : public BaseRoute {
    *               [](const HTTPRequest&, int64_t, Optional<int64_t>, string){
    *                  return HTTPResponse::future(200, "All good!");
    *               });
+   *  - make_route("/user/{{i}}", {HTTPMethod::GET},
+   *          [](const HTTPRequest&, int64_t userId)
+   *              -> folly::coro::Task<HTTPResponse> {
+   *              auto user = co_await fetchUser(userId);
+   *              co_return HTTPResponse(200, toJson(user));
+   *          })
+   *  - make_route("/user/{{i}}/orders", {HTTPMethod::POST},
+   *          [](const HTTPRequest&, int64_t userId, const Order& order) {
+   *              // Order is listed with NOZOMI_JSON_FIELDS, and is parsed
+   *              // from the request body. See JsonBodyHandler
+   *              return HTTPResponse::fromBytes(
+   *                  201, to_json_body(order),
+   *                  {{HTTP_HEADER_CONTENT_TYPE, "application/json"}});
+   *          })
    *  - make_streaming_route("/.*", {HTTPMethod::GET},
    *          [](const HTTPRequest&) {
    *              return SomeStreamingFileHandler();
@@ -111,20 +155,58 @@ class Route : public BaseRoute {
   Route(std::string pattern,
         std::unordered_set<proxygen::HTTPMethod> methods,
         HandlerType handler);
-  virtual RouteMatch handler(const proxygen::HTTPMessage* request) override;
+
+  /**
+   * Creates an instance of Route from a pattern that has already been
+   * checked against HandlerArgs at compile time. See NOZOMI_ROUTE_PATTERN
+   *
+   * @param info - The pattern's parameters, groups and literal prefix from
+   *               route_parsing::parse_pattern_info
+   */
+  Route(std::string pattern,
+        std::unordered_set<proxygen::HTTPMethod> methods,
+        HandlerType handler,
+        const route_parsing::PatternInfo<sizeof...(HandlerArgs)>& info);
+  using BaseRoute::handler;
+  virtual RouteMatch handler(const RoutingContext& context) override;
+  virtual RouteMatch handlerFromCaptures(
+      const RoutingContext& context,
+      const route_parsing::RouteCaptures& captures) override;
+  virtual RouteMatch handlerFromMatch(const RoutingContext& context,
+                                      const boost::smatch& matches,
+                                      size_t groupOffset) override;
+  virtual folly::Future<HTTPResponse> call(
+      const HTTPRequest& request,
+      const route_parsing::RouteCaptures& captures,
+      folly::Executor* executor) override;
+  virtual proxygen::RequestHandler* callStreaming(
+      folly::StringPiece path,
+      const route_parsing::RouteCaptures& captures) override;
+  virtual const boost::basic_regex<char>* getRegex() const override {
+    return regex_ ? &regex_.value() : nullptr;
+  }
+  virtual const std::vector<route_parsing::PatternSegment>*
+  getPatternSegments() const override {
+    return segments_ ? &segments_.value() : nullptr;
+  }
 };
 
 /**
  * Creates a non-streaming Route object from a function pointer. See Route<>
  * for description of all of the parameters.
+ *
+ * @param executionPolicy - Where the handler is run. See ExecutionPolicy
  */
-template <typename... HandlerArgs>
+template <typename Response,
+          typename... HandlerArgs,
+          typename = std::enable_if_t<is_handler_result<Response>::value>>
 inline auto make_route(std::string pattern,
                        std::unordered_set<proxygen::HTTPMethod> methods,
-                       folly::Future<HTTPResponse> (*handler)(
-                           const HTTPRequest&, HandlerArgs...)) {
-  return std::make_unique<Route<decltype(handler), false, HandlerArgs...>>(
-      std::move(pattern), std::move(methods), std::move(handler));
+                       Response (*handler)(const HTTPRequest&, HandlerArgs...),
+                       ExecutionPolicy executionPolicy = ExecutionPolicy()) {
+  return make_route(std::move(pattern), std::move(methods), std::move(handler),
+                    type_sequence<const HTTPRequest&, HandlerArgs...>(),
+                    std::move(executionPolicy));
 }
 
 /**
@@ -152,14 +234,41 @@ inline auto make_streaming_route(
       std::move(pattern), std::move(methods), std::move(handler));
 }
 
+/**
+ * Internal method that creates a Route once the handler's arguments have
+ * been split into the ones that come from the path, PathArgs, and the
+ * request body. See json_body_args
+ */
+template <typename HandlerType, typename... PathArgs>
+inline auto make_route_with_args(
+    std::string pattern,
+    std::unordered_set<proxygen::HTTPMethod> methods,
+    HandlerType handler,
+    type_sequence<PathArgs...>,
+    ExecutionPolicy executionPolicy) {
+  auto route = std::make_unique<Route<HandlerType, false, PathArgs...>>(
+      std::move(pattern), std::move(methods), std::move(handler));
+  route->setExecutionPolicy(std::move(executionPolicy));
+  return route;
+}
+
 /** Internal method used to help with template type deduction */
 template <typename HandlerType, typename Request, typename... HandlerArgs>
 inline auto make_route(std::string pattern,
                        std::unordered_set<proxygen::HTTPMethod> methods,
                        HandlerType handler,
-                       type_sequence<Request, HandlerArgs...>) {
-  return std::make_unique<Route<HandlerType, false, HandlerArgs...>>(
-      std::move(pattern), std::move(methods), std::move(handler));
+                       type_sequence<Request, HandlerArgs...>,
+                       ExecutionPolicy executionPolicy = ExecutionPolicy()) {
+  static_assert(
+      is_handler_result<decltype(handler(std::declval<Request>(),
+                                         std::declval<HandlerArgs>()...))>::
+          value,
+      "Handlers must return a Future<HTTPResponse> or a Task<HTTPResponse>");
+  using Args = json_body_args<HandlerType, HandlerArgs...>;
+  return make_route_with_args(std::move(pattern), std::move(methods),
+                              Args::wrap(std::move(handler)),
+                              typename Args::path_args(),
+                              std::move(executionPolicy));
 }
 
 /**
@@ -186,14 +295,126 @@ inline auto make_streaming_route(
 /**
  * Creates a non-streaming Route object from a callable (e.g. a lambda
  * or an std::function). See Route<> for description of all of the parameters.
+ *
+ * @param executionPolicy - Where the handler is run. See ExecutionPolicy
  */
 template <typename HandlerType>
 inline auto make_route(std::string pattern,
                        std::unordered_set<proxygen::HTTPMethod> methods,
-                       HandlerType handler) {
+                       HandlerType handler,
+                       ExecutionPolicy executionPolicy = ExecutionPolicy()) {
   auto types = make_type_sequence(handler);
   return make_route(std::move(pattern), std::move(methods), std::move(handler),
-                    types);
+                    types, std::move(executionPolicy));
+}
+
+/**
+ * Makes a route pattern that make_route parses at compile time. A pattern
+ * whose typed parameters don't match the handler's arguments fails to
+ * compile, instead of throwing when the route is created.
+ *
+ * @param pattern - A string literal. See Route<> for the pattern syntax
+ *
+ * @examples
+ *  - make_route(NOZOMI_ROUTE_PATTERN("/user/{{i}}"), {HTTPMethod::GET},
+ *          [](const HTTPRequest&, int64_t userId) {
+ *              return HTTPResponse::future(200, userDataJson);
+ *          })
+ */
+#define NOZOMI_ROUTE_PATTERN(pattern)                                        \
+  [] {                                                                       \
+    struct RoutePatternLiteral : ::nozomi::route_parsing::PatternLiteral {   \
+      static constexpr const char* data() { return pattern; }                \
+      static constexpr size_t size() {                                       \
+        return ::nozomi::route_parsing::literal_length(pattern);             \
+      }                                                                      \
+    };                                                                       \
+    return RoutePatternLiteral();                                            \
+  }()
+
+/** Internal method used to check compile time patterns against handlers */
+template <typename Pattern,
+          typename HandlerType,
+          typename... PathArgs,
+          typename = std::enable_if_t<
+              route_parsing::is_pattern_literal<Pattern>::value>>
+inline auto make_route_with_args(
+    Pattern,
+    std::unordered_set<proxygen::HTTPMethod> methods,
+    HandlerType handler,
+    type_sequence<PathArgs...>,
+    ExecutionPolicy executionPolicy) {
+  constexpr auto info = route_parsing::parse_pattern_info<sizeof...(PathArgs)>(
+      Pattern::data(), Pattern::size());
+  static_assert(info.paramCount == sizeof...(PathArgs),
+                "Pattern parameter count != function parameter count");
+  static_assert(route_parsing::pattern_types_match<PathArgs...>(info),
+                "Pattern parameter types do not match function parameters");
+  auto route = std::make_unique<Route<HandlerType, false, PathArgs...>>(
+      std::string(Pattern::data(), Pattern::size()), std::move(methods),
+      std::move(handler), info);
+  route->setExecutionPolicy(std::move(executionPolicy));
+  return route;
+}
+
+/** Internal method used to help with template type deduction */
+template <typename Pattern,
+          typename HandlerType,
+          typename Request,
+          typename... HandlerArgs>
+inline auto make_route(Pattern pattern,
+                       std::unordered_set<proxygen::HTTPMethod> methods,
+                       HandlerType handler,
+                       type_sequence<Request, HandlerArgs...>,
+                       ExecutionPolicy executionPolicy = ExecutionPolicy()) {
+  static_assert(route_parsing::is_pattern_literal<Pattern>::value,
+                "Use NOZOMI_ROUTE_PATTERN to make compile time patterns");
+  static_assert(
+      is_handler_result<decltype(handler(std::declval<Request>(),
+                                         std::declval<HandlerArgs>()...))>::
+          value,
+      "Handlers must return a Future<HTTPResponse> or a Task<HTTPResponse>");
+  using Args = json_body_args<HandlerType, HandlerArgs...>;
+  return make_route_with_args(pattern, std::move(methods),
+                              Args::wrap(std::move(handler)),
+                              typename Args::path_args(),
+                              std::move(executionPolicy));
+}
+
+/**
+ * Creates a non-streaming Route object from a compile time pattern and a
+ * function pointer. See NOZOMI_ROUTE_PATTERN
+ */
+template <typename Pattern,
+          typename Response,
+          typename... HandlerArgs,
+          typename = std::enable_if_t<
+              route_parsing::is_pattern_literal<Pattern>::value &&
+              is_handler_result<Response>::value>>
+inline auto make_route(Pattern pattern,
+                       std::unordered_set<proxygen::HTTPMethod> methods,
+                       Response (*handler)(const HTTPRequest&, HandlerArgs...),
+                       ExecutionPolicy executionPolicy = ExecutionPolicy()) {
+  return make_route(pattern, std::move(methods), std::move(handler),
+                    type_sequence<const HTTPRequest&, HandlerArgs...>(),
+                    std::move(executionPolicy));
+}
+
+/**
+ * Creates a non-streaming Route object from a compile time pattern and a
+ * callable. See NOZOMI_ROUTE_PATTERN
+ */
+template <typename Pattern,
+          typename HandlerType,
+          typename = std::enable_if_t<
+              route_parsing::is_pattern_literal<Pattern>::value>>
+inline auto make_route(Pattern pattern,
+                       std::unordered_set<proxygen::HTTPMethod> methods,
+                       HandlerType handler,
+                       ExecutionPolicy executionPolicy = ExecutionPolicy()) {
+  auto types = make_type_sequence(handler);
+  return make_route(pattern, std::move(methods), std::move(handler), types,
+                    std::move(executionPolicy));
 }
 }
 
@@ -0,0 +1,80 @@
+#include "src/RouteCache.h"
+
+#include <iterator>
+
+#include <glog/logging.h>
+
+using folly::StringPiece;
+using proxygen::HTTPMethod;
+
+namespace nozomi {
+
+size_t RouteCache::KeyHash::operator()(const Key& key) const {
+  // FNV-1a, seeded with the method
+  uint64_t hash = 14695981039346656037ULL ^ static_cast<uint64_t>(key.method);
+  for (char c : key.path) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+  }
+  return static_cast<size_t>(hash);
+}
+
+RouteCache::RouteCache(size_t capacity)
+    : capacity_(capacity),
+      counters_(std::make_shared<RouteCacheCounters>()) {
+  DCHECK(capacity_ > 0) << "RouteCache capacity must be at least 1";
+  index_.reserve(capacity_);
+}
+
+const RouteCache::Entry* RouteCache::find(HTTPMethod method,
+                                          StringPiece path) {
+  auto found = index_.find(Key{method, path});
+  // This thread is the only writer, so the counters don't need a locked add
+  if (found == index_.end()) {
+    counters_->misses.store(
+        counters_->misses.load(std::memory_order_relaxed) + 1,
+        std::memory_order_relaxed);
+    return nullptr;
+  }
+  counters_->hits.store(counters_->hits.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+  nodes_.splice(nodes_.begin(), nodes_, found->second);
+  return &found->second->entry;
+}
+
+void RouteCache::insert(HTTPMethod method,
+                        StringPiece path,
+                        const Entry& entry) {
+  auto found = index_.find(Key{method, path});
+  if (found != index_.end()) {
+    found->second->entry = entry;
+    nodes_.splice(nodes_.begin(), nodes_, found->second);
+    return;
+  }
+
+  if (nodes_.size() < capacity_) {
+    nodes_.emplace_front();
+  } else {
+    // Reuse the least recently used node, and its string's storage
+    auto& last = nodes_.back();
+    index_.erase(Key{last.method, last.path});
+    nodes_.splice(nodes_.begin(), nodes_, std::prev(nodes_.end()));
+  }
+  auto& node = nodes_.front();
+  node.method = method;
+  node.path.assign(path.data(), path.size());
+  node.entry = entry;
+  index_.emplace(Key{node.method, node.path}, nodes_.begin());
+}
+
+RouteCacheStats RouteCache::getStats() const {
+  RouteCacheStats stats;
+  stats.hits = counters_->hits.load(std::memory_order_relaxed);
+  stats.misses = counters_->misses.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void RouteCache::clear() {
+  index_.clear();
+  nodes_.clear();
+}
+}
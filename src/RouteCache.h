@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <folly/Range.h>
+#include <proxygen/lib/http/HTTPMethod.h>
+
+#include "src/RouteParsing.h"
+
+namespace nozomi {
+
+class BaseRoute;
+
+/**
+ * The number of lookups that found, and did not find, a cached route
+ */
+struct RouteCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+};
+
+/**
+ * A cache's hit and miss counts. Only the thread that owns the cache
+ * writes them, but any thread may read them
+ */
+struct RouteCacheCounters {
+  std::atomic<uint64_t> hits{0};
+  std::atomic<uint64_t> misses{0};
+};
+
+/**
+ * A bounded least recently used cache from a request's method and decoded
+ * path to the route that matched it, and the captures for its typed
+ * parameters. It is not thread safe; each thread is expected to own its own
+ * cache. Only its counters may be read from other threads. Finding an entry
+ * does not allocate.
+ */
+class RouteCache {
+ public:
+  /**
+   * A route that matched a path. Captures are offsets into that path, so
+   * they are valid for any path that is equal to it
+   */
+  struct Entry {
+    BaseRoute* route;
+    route_parsing::RouteCaptures captures;
+    bool isStreaming;
+  };
+
+ private:
+  struct Key {
+    proxygen::HTTPMethod method;
+    folly::StringPiece path;
+
+    inline bool operator==(const Key& other) const {
+      return method == other.method && path == other.path;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const;
+  };
+
+  struct Node {
+    proxygen::HTTPMethod method;
+    std::string path;
+    Entry entry;
+  };
+
+  size_t capacity_;
+  // Most recently used first. Keys in index_ point into the nodes' paths
+  std::list<Node> nodes_;
+  std::unordered_map<Key, std::list<Node>::iterator, KeyHash> index_;
+  std::shared_ptr<RouteCacheCounters> counters_;
+
+ public:
+  /**
+   * Creates a RouteCache
+   *
+   * @param capacity - The maximum number of entries. Must be at least 1
+   */
+  explicit RouteCache(size_t capacity);
+
+  RouteCache(const RouteCache&) = delete;
+  RouteCache& operator=(const RouteCache&) = delete;
+
+  /**
+   * Looks up the route for a request, and marks it as the most recently
+   * used entry. Counts a hit or a miss
+   *
+   * @returns The entry, or nullptr if there is none. It is valid until
+   *          the next call to insert() or clear()
+   */
+  const Entry* find(proxygen::HTTPMethod method, folly::StringPiece path);
+
+  /**
+   * Caches the route for a request, evicting the least recently used entry
+   * if the cache is full. Replaces any existing entry for the same key
+   */
+  void insert(proxygen::HTTPMethod method,
+              folly::StringPiece path,
+              const Entry& entry);
+
+  /**
+   * Removes all entries. The stats are kept
+   */
+  void clear();
+
+  inline size_t size() const { return nodes_.size(); }
+
+  inline size_t capacity() const { return capacity_; }
+
+  RouteCacheStats getStats() const;
+
+  /**
+   * Returns the cache's counters, which outlive the cache for as long as
+   * they are held
+   */
+  inline const std::shared_ptr<RouteCacheCounters>& getCounters() const {
+    return counters_;
+  }
+};
+}
@@ -1,19 +1,156 @@
 #pragma once
 
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+#include <folly/Optional.h>
 #include <folly/futures/Future.h>
 
 #include <proxygen/httpserver/RequestHandler.h>
 
+#include "src/ExecutionPolicy.h"
 #include "src/HTTPRequest.h"
 #include "src/HTTPResponse.h"
+#include "src/RouteParsing.h"
 
 namespace nozomi {
+
+class BaseRoute;
+
 enum RouteMatchResult {
   PathNotMatched,    // Path didn't match
   MethodNotMatched,  // Path matched, method didn't
   RouteMatched,      // The route matched entirely
 };
 
+/**
+ * Calls a matched route's handler with the arguments that were captured
+ * from the path. Only a pointer to the route and the offsets of its
+ * captures are kept, so making and copying one does not allocate, and the
+ * handler is called without going through a type-erased closure. It can
+ * also wrap any other callable (e.g. an error handler)
+ */
+class RouteHandler {
+ private:
+  BaseRoute* route_ = nullptr;
+  route_parsing::RouteCaptures captures_;
+  std::function<folly::Future<HTTPResponse>(const HTTPRequest&)> function_;
+
+ public:
+  RouteHandler() {}
+
+  /**
+   * Creates a RouteHandler for a route that matched
+   *
+   * @param route - The route. It must outlive this object
+   * @param captures - The captures for each of the route's typed
+   *                   parameters
+   */
+  RouteHandler(BaseRoute* route, const route_parsing::RouteCaptures& captures)
+      : route_(route), captures_(captures) {}
+
+  /**
+   * Creates a RouteHandler that calls function
+   */
+  template <typename Function,
+            typename = std::enable_if_t<
+                !std::is_same<std::decay_t<Function>, RouteHandler>::value &&
+                std::is_convertible<Function,
+                                    std::function<folly::Future<HTTPResponse>(
+                                        const HTTPRequest&)>>::value>>
+  RouteHandler(Function function) : function_(std::move(function)) {}
+
+  explicit inline operator bool() const {
+    return route_ != nullptr || (bool)function_;
+  }
+
+  /**
+   * Returns the route that matched, or nullptr if this wraps another
+   * callable
+   */
+  inline BaseRoute* getRoute() const { return route_; }
+
+  inline const route_parsing::RouteCaptures& getCaptures() const {
+    return captures_;
+  }
+
+  /**
+   * Calls the handler. Captures are read from the request's decoded path,
+   * which must be the same path that the route matched. Defined in
+   * BaseRoute.h
+   *
+   * @param executor - The executor that the handler is being called on.
+   *                   Coroutine handlers are started, and resumed, on it.
+   *                   If it is nullptr, they are run inline
+   */
+  folly::Future<HTTPResponse> operator()(
+      const HTTPRequest& request,
+      folly::Executor* executor = nullptr) const;
+
+  /**
+   * Returns where the handler should be run. Handlers that are not routes
+   * use the default policy. Defined in BaseRoute.h
+   */
+  const ExecutionPolicy& getExecutionPolicy() const;
+
+  /**
+   * Returns the route's maximum body size, if it overrides the server's.
+   * Defined in BaseRoute.h
+   */
+  folly::Optional<size_t> getMaxBodySize() const;
+
+  /**
+   * Returns the route's request timeout, if it overrides the server's.
+   * Defined in BaseRoute.h
+   */
+  folly::Optional<std::chrono::milliseconds> getTimeout() const;
+};
+
+/**
+ * Creates the StreamingHTTPHandler for a matched streaming route. Like
+ * RouteHandler, it only holds the route and its captures, along with a
+ * reference to the path that they point into
+ */
+class StreamingRouteHandler {
+ private:
+  BaseRoute* route_ = nullptr;
+  route_parsing::RouteCaptures captures_;
+  std::shared_ptr<const std::string> path_;
+
+ public:
+  StreamingRouteHandler() {}
+
+  /**
+   * Creates a StreamingRouteHandler
+   *
+   * @param route - The route. It must outlive this object
+   * @param captures - The captures for each of the route's typed parameters
+   * @param path - The decoded path that captures point into
+   */
+  StreamingRouteHandler(BaseRoute* route,
+                        const route_parsing::RouteCaptures& captures,
+                        std::shared_ptr<const std::string> path)
+      : route_(route), captures_(captures), path_(std::move(path)) {}
+
+  explicit inline operator bool() const { return route_ != nullptr; }
+
+  inline BaseRoute* getRoute() const { return route_; }
+
+  inline const route_parsing::RouteCaptures& getCaptures() const {
+    return captures_;
+  }
+
+  /**
+   * Creates the handler, and sets its arguments. Defined in BaseRoute.h
+   *
+   * @returns The handler, or nullptr if it could not be created
+   */
+  proxygen::RequestHandler* operator()() const;
+};
+
 /*
  * Determines whether a Route matches a given pattern, and if not,
  * why it doesn't. Mutable so that we can easily move member
@@ -21,8 +158,8 @@ enum RouteMatchResult {
  */
 struct RouteMatch {
   RouteMatchResult result;
-  std::function<folly::Future<HTTPResponse>(const HTTPRequest&)> handler;
-  std::function<proxygen::RequestHandler*()> streamingHandler;
+  RouteHandler handler;
+  StreamingRouteHandler streamingHandler;
 
   /**
    * Creates a RouteMatch object
@@ -33,11 +170,7 @@ struct RouteMatch {
    *            from the first byte being read, until the last byte is sent on
    *            the wire. Mutually exclusive with streamingHandler
    */
-  RouteMatch(
-      RouteMatchResult result,
-      std::function<folly::Future<HTTPResponse>(const HTTPRequest&)> handler =
-          std::function<folly::Future<HTTPResponse>(const HTTPRequest&)>())
-
+  RouteMatch(RouteMatchResult result, RouteHandler handler = RouteHandler())
       : result(result), handler(std::move(handler)) {
     DCHECK(result != RouteMatched || this->handler)
         << "Handler must be set if the route matched!";
@@ -52,8 +185,7 @@ struct RouteMatch {
    *                     memory. Mutually exclusive with handler
    *
    */
-  RouteMatch(RouteMatchResult result,
-             std::function<proxygen::RequestHandler*()> streamingHandler)
+  RouteMatch(RouteMatchResult result, StreamingRouteHandler streamingHandler)
       : result(result), streamingHandler(std::move(streamingHandler)) {
     DCHECK(result != RouteMatched || this->streamingHandler)
         << "Streaming handler must be set if the route matched!";
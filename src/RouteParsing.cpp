@@ -2,7 +2,9 @@
 
 #include <folly/Format.h>
 #include <folly/Optional.h>
+#include <folly/String.h>
 #include <folly/gen/Base.h>
+#include <glog/logging.h>
 #include <proxygen/lib/http/HTTPMessage.h>
 #include <proxygen/lib/http/HTTPMethod.h>
 
@@ -10,10 +12,10 @@
 
 using boost::basic_regex;
 using folly::Optional;
+using folly::StringPiece;
 using folly::sformat;
 using proxygen::HTTPMethod;
 using std::function;
-using std::pair;
 using std::runtime_error;
 using std::string;
 using std::unordered_set;
@@ -22,8 +24,6 @@ using std::vector;
 namespace nozomi {
 namespace route_parsing {
 
-using Replacement = pair<string, string>;
-
 string to_string(RouteParamType param) {
   switch (param) {
     case (RouteParamType::Int64):
@@ -47,157 +47,304 @@ std::ostream& operator<<(std::ostream& out, RouteParamType param) {
 }
 
 /**
- * Converts a piece of a route pattern into a corresponding regular
+ * Converts a typed parameter of a route pattern into a corresponding regular
  * expression chunk
  *
  * @param paramNum - Which parameter this is. This number is used
  *                     in the regex group name.
- * @param originalPattern - The original string that was matched (e.g. {{i}})
+ * @param type - The type of the parameter
  * @param value - The value if applicable for this type of parameter
  *                (e.g. {{s:\w+}}, would pass in "\w+")
  * @param consumed - The piece string that should be consumed whether
  *                   there was a full match or not. This is used by optionals
  *                   to consume pieces of the path if the value isn't present
- * @returns A pair of strings. The first one is the part of the original
- *          string that should be replaced, and the second string is the regex
- *          that it should be replaced with.
+ * @returns The regex that the parameter should be replaced with
+ */
+string param_to_regex(size_t paramNum,
+                      RouteParamType type,
+                      StringPiece value,
+                      StringPiece consumed) {
+  switch (type) {
+    case (RouteParamType::Int64):
+      return sformat(R"((?<__{}>[+-]?\d+))", paramNum);
+    case (RouteParamType::OptionalInt64):
+      return sformat(R"((?:(?<__{}>[+-]?\d+){})?)", paramNum, consumed);
+    case (RouteParamType::Double):
+      return sformat(R"((?<__{}>[+-]?\d+(?:\.\d+)?))", paramNum);
+    case (RouteParamType::OptionalDouble):
+      return sformat(R"((?:(?<__{}>[+-]?\d+(?:\.\d+)?){})?)", paramNum,
+                     consumed);
+    case (RouteParamType::String): {
+      // Ensure that the regex provided is valid
+      basic_regex<char> re(value.begin(), value.end(), boost::regex::perl);
+      return sformat(R"((?<__{}>{}))", paramNum, value);
+    }
+    case (RouteParamType::OptionalString): {
+      // Ensure that the regex provided is valid
+      basic_regex<char> re(value.begin(), value.end(), boost::regex::perl);
+      return sformat(R"((?:(?<__{}>{}){})?)", paramNum, value, consumed);
+    }
+  }
+  return "";
+}
+
+namespace {
+
+inline bool is_literal_char(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '~' ||
+         c == ',' || c == ';' || c == ':' || c == '=' || c == '@' ||
+         c == '!' || c == '&' || c == '\'' || c == '%';
+}
+
+inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+/**
+ * Consumes \d+ from the front of piece
+ *
+ * @returns whether at least one digit was consumed
+ */
+inline bool consume_digits(StringPiece& piece) {
+  size_t digits = 0;
+  while (digits < piece.size() && is_digit(piece[digits])) {
+    ++digits;
+  }
+  piece.advance(digits);
+  return digits > 0;
+}
+
+/**
+ * Consumes [+-]?\d+ from the front of piece
+ *
+ * @returns whether at least one digit was consumed
+ */
+inline bool consume_integer(StringPiece& piece) {
+  if (!piece.empty() && (piece.front() == '+' || piece.front() == '-')) {
+    piece.advance(1);
+  }
+  return consume_digits(piece);
+}
+
+/**
+ * Converts a single '/' delimited piece of a route pattern into a
+ * PatternSegment if it can be matched without a regular expression
+ */
+Optional<PatternSegment> to_pattern_segment(const string& piece) {
+  if (piece == "{{i}}") {
+    return PatternSegment{SegmentType::Int64, ""};
+  } else if (piece == "{{d}}") {
+    return PatternSegment{SegmentType::Double, ""};
+  } else if (piece == "{{s:[^/]+}}") {
+    return PatternSegment{SegmentType::String, ""};
+  }
+  for (char c : piece) {
+    if (!is_literal_char(c)) {
+      return Optional<PatternSegment>();
+    }
+  }
+  return PatternSegment{SegmentType::Literal, piece};
+}
+
+/**
+ * Splits a route pattern on '/' without splitting typed parameters
+ * (which may contain slashes), and converts each piece to a PatternSegment.
+ *
+ * @returns the segments, or empty if any piece needs a regular expression
  */
-template <typename T>
-Replacement route_to_regex(int paramNum,
-                           string originalPattern,
-                           const string& value,
-                           const string& consumed);
-
-template <>
-Replacement route_to_regex<int64_t>(int paramNum,
-                                    string originalPattern,
-                                    const string&,
-                                    const string& consumed) {
-  return std::make_pair(std::move(originalPattern),
-                        sformat(R"((?<__{}>[+-]?\d+))", paramNum));
-}
-
-template <>
-Replacement route_to_regex<Optional<int64_t>>(int paramNum,
-                                              string originalPattern,
-                                              const string&,
-                                              const string& consumed) {
-  return std::make_pair(
-      std::move(originalPattern),
-      sformat(R"((?:(?<__{}>[+-]?\d+){})?)", paramNum, consumed));
-}
-
-template <>
-Replacement route_to_regex<double>(int paramNum,
-                                   string originalPattern,
-                                   const string&,
-                                   const string&) {
-  return std::make_pair(std::move(originalPattern),
-                        sformat(R"((?<__{}>[+-]?\d+(?:\.\d+)?))", paramNum));
-}
-
-template <>
-Replacement route_to_regex<Optional<double>>(int paramNum,
-                                             string originalPattern,
-                                             const string&,
-                                             const string& consumed) {
-  return std::make_pair(
-      std::move(originalPattern),
-      sformat(R"((?:(?<__{}>[+-]?\d+(?:\.\d+)?){})?)", paramNum, consumed));
-}
-
-template <>
-Replacement route_to_regex<string>(int paramNum,
-                                   string originalPattern,
-                                   const string& value,
-                                   const string&) {
-  // Ensure that the regex provided is valid
-  basic_regex<char> re(value, boost::regex::perl);
-  return std::make_pair(std::move(originalPattern),
-                        sformat(R"((?<__{}>{}))", paramNum, value));
-}
-
-template <>
-Replacement route_to_regex<Optional<string>>(int paramNum,
-                                             string originalPattern,
-                                             const string& value,
-                                             const string& consumed) {
-  // Ensure that the regex provided is valid
-  basic_regex<char> re(value, boost::regex::perl);
-  return std::make_pair(
-      std::move(originalPattern),
-      sformat(R"((?:(?<__{}>{}){})?)", paramNum, value, consumed));
-}
-
-pair<basic_regex<char>, vector<RouteParamType>> parse_route_pattern(
-    const string& pattern) {
-  vector<RouteParamType> types;
-  string finalRoute = pattern;
-  string routeParser =
-      R"((?<int>\{\{i\}\})|)"
-      R"((?<optional_int>\{\{i\?(?::(?<optional_int_regex>.+?))?\}\})|)"
-      R"((?<double>\{\{d\}\})|)"
-      R"((?<optional_double>\{\{d\?(?::(?<optional_double_regex>.+?))?\}\})|)"
-      R"((?<string>\{\{s:(?<string_regex>.+?)\}\})|)"
-      R"((?<optional_string>\{\{s\?:(?<optional_string_regex>.+?)(?::(?<optional_string_consumed>.+?))?\}\}))";
-
-  basic_regex<char> re(routeParser, boost::regex::perl);
-  boost::sregex_iterator re_begin(pattern.cbegin(), pattern.cend(), re);
-  boost::sregex_iterator re_end;
-
-  // Replace as a second step because iterators don't like you changing the
-  // string during iteration
-  vector<Replacement> replacements;
-  for (auto& match_it = re_begin; match_it != re_end; ++match_it) {
-    auto& match = *match_it;
-    if (match["int"].matched) {
-      replacements.emplace_back(route_to_regex<int64_t>(
-          replacements.size(), match["int"].str(), "", ""));
-      types.push_back(RouteParamType::Int64);
-    } else if (match["optional_int"].matched) {
-      replacements.emplace_back(route_to_regex<Optional<int64_t>>(
-          replacements.size(), match["optional_int"].str(), "",
-          match["optional_int_regex"].str()));
-      types.push_back(RouteParamType::OptionalInt64);
-    } else if (match["double"].matched) {
-      replacements.emplace_back(route_to_regex<double>(
-          replacements.size(), match["double"].str(), "", ""));
-      types.push_back(RouteParamType::Double);
-    } else if (match["optional_double"].matched) {
-      replacements.emplace_back(route_to_regex<Optional<double>>(
-          replacements.size(), match["optional_double"].str(), "",
-          match["optional_double_regex"].str()));
-      types.push_back(RouteParamType::OptionalDouble);
-    } else if (match["string"].matched) {
-      replacements.emplace_back(
-          route_to_regex<string>(replacements.size(), match["string"].str(),
-                                 match["string_regex"].str(), ""));
-      types.push_back(RouteParamType::String);
-    } else if (match["optional_string"].matched) {
-      replacements.emplace_back(route_to_regex<Optional<string>>(
-          replacements.size(), match["optional_string"].str(),
-          match["optional_string_regex"].str(),
-          match["optional_string_consumed"]));
-      types.push_back(RouteParamType::OptionalString);
+Optional<vector<PatternSegment>> parse_route_segments(const string& pattern) {
+  vector<string> pieces(1);
+  for (size_t i = 0; i < pattern.size(); ++i) {
+    if (pattern.compare(i, 2, "{{") == 0) {
+      auto end = pattern.find("}}", i + 2);
+      if (end == string::npos) {
+        return Optional<vector<PatternSegment>>();
+      }
+      pieces.back().append(pattern, i, end + 2 - i);
+      i = end + 1;
+    } else if (pattern[i] == '/') {
+      pieces.emplace_back();
+    } else {
+      pieces.back().push_back(pattern[i]);
     }
   }
 
-  decltype(finalRoute.find("")) it = 0;
-  for (const auto& replacement : replacements) {
-    it = finalRoute.find(replacement.first, it);
-    if (it == string::npos) {
-      auto msg = sformat(
-          "Attempted to transform route pattern into regular expression, and"
-          " failed. This is a library error, and should be fixed. Tried to"
-          " replace {} with {}. Pattern so far: {}.",
-          replacement.first, replacement.second, finalRoute);
-      throw runtime_error(msg);
+  vector<PatternSegment> segments;
+  segments.reserve(pieces.size());
+  for (const auto& piece : pieces) {
+    auto segment = to_pattern_segment(piece);
+    if (!segment) {
+      return Optional<vector<PatternSegment>>();
     }
-    finalRoute.replace(it, replacement.first.size(), replacement.second);
-    it += replacement.first.size();
+    segments.push_back(std::move(segment.value()));
+  }
+  return segments;
+}
+
+RouteParamType segment_param_type(SegmentType type) {
+  switch (type) {
+    case (SegmentType::Int64):
+      return RouteParamType::Int64;
+    case (SegmentType::Double):
+      return RouteParamType::Double;
+    default:
+      DCHECK(type == SegmentType::String) << "Literals do not have a type";
+      return RouteParamType::String;
+  }
+}
+}
+
+vector<string> capture_group_names(StringPiece regex) {
+  vector<string> names;
+  bool inClass = false;
+  for (size_t i = 0; i < regex.size(); ++i) {
+    auto c = regex[i];
+    if (c == '\\') {
+      ++i;
+    } else if (inClass) {
+      if (c == '[' && i + 1 < regex.size() && regex[i + 1] == ':') {
+        // Skip over [:alpha:] style classes
+        auto end = regex.find(":]", i + 2);
+        i = end == StringPiece::npos ? regex.size() : end + 1;
+      } else if (c == ']') {
+        inClass = false;
+      }
+    } else if (c == '[') {
+      inClass = true;
+      // A ']' right after '[' or '[^' doesn't close the class
+      if (i + 1 < regex.size() && regex[i + 1] == '^') {
+        ++i;
+      }
+      if (i + 1 < regex.size() && regex[i + 1] == ']') {
+        ++i;
+      }
+    } else if (c == '(') {
+      auto rest = regex.subpiece(i + 1);
+      if (!rest.startsWith('?')) {
+        names.emplace_back();
+        continue;
+      }
+      // (?<name>, (?P<name> and (?'name' capture. (?<= and (?<! don't
+      char close = '>';
+      if (rest.startsWith("?P<")) {
+        rest.advance(3);
+      } else if (rest.startsWith("?'")) {
+        rest.advance(2);
+        close = '\'';
+      } else if (rest.startsWith("?<") && !rest.startsWith("?<=") &&
+                 !rest.startsWith("?<!")) {
+        rest.advance(2);
+      } else {
+        continue;
+      }
+      auto end = rest.find(close);
+      names.push_back(rest.subpiece(0, end).str());
+    }
+  }
+  return names;
+}
+
+PathSegments split_path(StringPiece path) {
+  PathSegments segments;
+  folly::splitTo<StringPiece>('/', path, std::back_inserter(segments));
+  return segments;
+}
+
+bool parameter_matches(SegmentType type, StringPiece piece) {
+  switch (type) {
+    case (SegmentType::Int64):
+      return consume_integer(piece) && piece.empty();
+    case (SegmentType::Double):
+      if (!consume_integer(piece)) {
+        return false;
+      }
+      if (!piece.empty() && piece.front() == '.') {
+        piece.advance(1);
+        return consume_digits(piece) && piece.empty();
+      }
+      return piece.empty();
+    case (SegmentType::String):
+      return !piece.empty();
+    case (SegmentType::Literal):
+      return false;
+  }
+  return false;
+}
+
+bool segment_matches(const PatternSegment& segment, StringPiece piece) {
+  if (segment.type == SegmentType::Literal) {
+    return piece == segment.literal;
+  }
+  return parameter_matches(segment.type, piece);
+}
+
+bool match_segments(const vector<PatternSegment>& pattern,
+                    StringPiece path,
+                    const PathSegments& pathSegments,
+                    RouteCaptures& captures) {
+  if (pattern.size() != pathSegments.size()) {
+    return false;
+  }
+  auto initialCaptures = captures.size();
+  for (size_t i = 0; i < pattern.size(); ++i) {
+    if (!segment_matches(pattern[i], pathSegments[i])) {
+      while (captures.size() > initialCaptures) {
+        captures.pop_back();
+      }
+      return false;
+    }
+    if (pattern[i].type != SegmentType::Literal) {
+      captures.push_back(path, pathSegments[i]);
+    }
+  }
+  return true;
+}
+
+RoutePattern parse_route_pattern(const string& pattern) {
+  auto segments = parse_route_segments(pattern);
+  if (segments) {
+    RoutePattern ret;
+    for (const auto& segment : segments.value()) {
+      if (segment.type != SegmentType::Literal) {
+        ret.types.push_back(segment_param_type(segment.type));
+      }
+    }
+    ret.segments = std::move(segments);
+    return ret;
+  }
+
+  // Typed parameters are replaced with named groups, and the index of each
+  // group is resolved so that matches can be read by index instead of by
+  // name
+  RoutePattern ret;
+  string finalRoute;
+  auto data = pattern.data();
+  auto size = pattern.size();
+  size_t groups = 0;
+  size_t literalBegin = 0;
+  for (auto token = find_pattern_token(data, size, 0); token.found();
+       token = find_pattern_token(data, size, token.end)) {
+    finalRoute.append(pattern, literalBegin, token.begin - literalBegin);
+    groups += count_capture_groups(data, literalBegin, token.begin);
+    ret.groups.push_back(groups + 1);
+    groups += count_token_groups(data, token);
+    finalRoute += param_to_regex(
+        ret.types.size(), token.type,
+        StringPiece(data + token.valueBegin, data + token.valueEnd),
+        StringPiece(data + token.consumedBegin, data + token.consumedEnd));
+    ret.types.push_back(token.type);
+    literalBegin = token.end;
+  }
+  groups += count_capture_groups(data, literalBegin, size);
+  finalRoute.append(pattern, literalBegin, string::npos);
+
+  ret.regex = basic_regex<char>(finalRoute, boost::regex::perl);
+  if (groups != ret.regex->mark_count()) {
+    throw runtime_error(sformat(
+        "Found {} capture groups in {}, but the regular expression has {}. "
+        "This is a library error, and should be fixed.",
+        groups, finalRoute, ret.regex->mark_count()));
   }
-  return std::make_pair(basic_regex<char>(finalRoute, boost::regex::perl),
-                        std::move(types));
+  return ret;
 }
 }
 }
@@ -1,13 +1,23 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <vector>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
 #include <boost/regex.hpp>
 #include <folly/Conv.h>
 #include <folly/Format.h>
 #include <folly/Optional.h>
+#include <folly/Range.h>
+#include <folly/small_vector.h>
+#include <glog/logging.h>
 
 namespace nozomi {
 namespace route_parsing {
@@ -24,56 +34,522 @@ enum class RouteParamType {
 std::string to_string(RouteParamType param);
 std::ostream& operator<<(std::ostream& out, RouteParamType param);
 
+/**
+ * The kinds of path segments that can be matched without a regular
+ * expression. See parse_route_pattern
+ */
+enum class SegmentType {
+  Literal,  // Matches the segment's literal text exactly
+  Int64,    // {{i}}
+  Double,   // {{d}}
+  String,   // {{s:[^/]+}}
+};
+
+/**
+ * A single '/' delimited piece of a route pattern
+ */
+struct PatternSegment {
+  SegmentType type;
+  std::string literal;
+};
+
+/**
+ * The result of parsing a route pattern. If the pattern only consists of
+ * literal segments and whole-segment {{i}}, {{d}} or {{s:[^/]+}} parameters,
+ * segments is set, and regex is not. Otherwise regex is set, and segments
+ * is not. When regex is set, groups holds the index of the regex group
+ * that captures each typed parameter, in the same order as types
+ */
+struct RoutePattern {
+  folly::Optional<boost::basic_regex<char>> regex;
+  folly::Optional<std::vector<PatternSegment>> segments;
+  std::vector<RouteParamType> types;
+  std::vector<size_t> groups;
+};
+
 /**
  * Converts type T to a RouteTypeParam
  */
 template <typename T>
-inline RouteParamType to_RouteParamType();
+constexpr RouteParamType to_RouteParamType();
 
 template <>
-inline RouteParamType to_RouteParamType<int64_t>() {
+constexpr RouteParamType to_RouteParamType<int64_t>() {
   return RouteParamType::Int64;
 }
 
 template <>
-inline RouteParamType to_RouteParamType<folly::Optional<int64_t>>() {
+constexpr RouteParamType to_RouteParamType<folly::Optional<int64_t>>() {
   return RouteParamType::OptionalInt64;
 }
 
 template <>
-inline RouteParamType to_RouteParamType<double>() {
+constexpr RouteParamType to_RouteParamType<double>() {
   return RouteParamType::Double;
 }
 
 template <>
-inline RouteParamType to_RouteParamType<folly::Optional<double>>() {
+constexpr RouteParamType to_RouteParamType<folly::Optional<double>>() {
   return RouteParamType::OptionalDouble;
 }
 
 template <>
-inline RouteParamType to_RouteParamType<std::string>() {
+constexpr RouteParamType to_RouteParamType<std::string>() {
+  return RouteParamType::String;
+}
+
+template <>
+constexpr RouteParamType to_RouteParamType<folly::Optional<std::string>>() {
+  return RouteParamType::OptionalString;
+}
+
+template <>
+constexpr RouteParamType to_RouteParamType<folly::StringPiece>() {
+  return RouteParamType::String;
+}
+
+template <>
+constexpr RouteParamType
+to_RouteParamType<folly::Optional<folly::StringPiece>>() {
+  return RouteParamType::OptionalString;
+}
+
+#if __cplusplus >= 201703L
+template <>
+constexpr RouteParamType to_RouteParamType<std::string_view>() {
   return RouteParamType::String;
 }
 
 template <>
-inline RouteParamType to_RouteParamType<folly::Optional<std::string>>() {
+constexpr RouteParamType
+to_RouteParamType<folly::Optional<std::string_view>>() {
   return RouteParamType::OptionalString;
 }
+#endif
+
+/** Returned by the constexpr pattern functions below when nothing is found */
+constexpr size_t kNotFound = static_cast<size_t>(-1);
+
+/**
+ * A typed parameter (e.g. {{s?:\w+:/}}) in a route pattern. All positions
+ * are offsets into the pattern
+ */
+struct PatternToken {
+  RouteParamType type = RouteParamType::Int64;
+  // The first '{', and one past the last '}'
+  size_t begin = kNotFound;
+  size_t end = kNotFound;
+  // <regex> for {{s:<regex>}} and {{s?:<regex>:<consumed>}}
+  size_t valueBegin = 0;
+  size_t valueEnd = 0;
+  // <consumed> for optional parameters
+  size_t consumedBegin = 0;
+  size_t consumedEnd = 0;
+
+  constexpr bool found() const { return begin != kNotFound; }
+};
+
+/**
+ * Whether pattern has needle at pos
+ */
+constexpr bool pattern_has_at(const char* pattern,
+                              size_t size,
+                              size_t pos,
+                              const char* needle) {
+  for (size_t i = 0; needle[i] != '\0'; ++i) {
+    if (pos + i >= size || pattern[pos + i] != needle[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Finds the first needle in pattern at or after from
+ */
+constexpr size_t pattern_find(const char* pattern,
+                              size_t size,
+                              size_t from,
+                              const char* needle) {
+  for (size_t i = from; i < size; ++i) {
+    if (pattern_has_at(pattern, size, i, needle)) {
+      return i;
+    }
+  }
+  return kNotFound;
+}
+
+/**
+ * Matches {{i?}}, {{i?:<consumed>}}, {{d?}} or {{d?:<consumed>}} at pos.
+ * <consumed> is at least one character, and ends at the first "}}"
+ */
+constexpr PatternToken match_optional_number_token(const char* pattern,
+                                                   size_t size,
+                                                   size_t pos,
+                                                   RouteParamType type) {
+  PatternToken token;
+  auto rest = pos + 4;
+  if (pattern_has_at(pattern, size, rest, ":")) {
+    auto close = pattern_find(pattern, size, rest + 2, "}}");
+    if (close != kNotFound) {
+      token.type = type;
+      token.begin = pos;
+      token.end = close + 2;
+      token.consumedBegin = rest + 1;
+      token.consumedEnd = close;
+      return token;
+    }
+  }
+  if (pattern_has_at(pattern, size, rest, "}}")) {
+    token.type = type;
+    token.begin = pos;
+    token.end = rest + 2;
+  }
+  return token;
+}
+
+/**
+ * Matches {{s?:<regex>}} or {{s?:<regex>:<consumed>}} at pos. <regex> is
+ * the shortest piece (at least one character) that is followed by either
+ * ":<consumed>}}" or "}}"
+ */
+constexpr PatternToken match_optional_string_token(const char* pattern,
+                                                   size_t size,
+                                                   size_t pos) {
+  PatternToken token;
+  auto valueBegin = pos + 5;
+  for (auto valueEnd = valueBegin + 1; valueEnd < size; ++valueEnd) {
+    if (pattern[valueEnd] == ':') {
+      auto close = pattern_find(pattern, size, valueEnd + 2, "}}");
+      if (close != kNotFound) {
+        token.consumedBegin = valueEnd + 1;
+        token.consumedEnd = close;
+        token.end = close + 2;
+      }
+    }
+    if (token.end == kNotFound &&
+        pattern_has_at(pattern, size, valueEnd, "}}")) {
+      token.end = valueEnd + 2;
+    }
+    if (token.end != kNotFound) {
+      token.type = RouteParamType::OptionalString;
+      token.begin = pos;
+      token.valueBegin = valueBegin;
+      token.valueEnd = valueEnd;
+      return token;
+    }
+  }
+  return token;
+}
+
+/**
+ * Matches a typed parameter that starts at pos
+ *
+ * @returns The parameter, or a token that wasn't found() if the text at pos
+ *          isn't a typed parameter
+ */
+constexpr PatternToken match_pattern_token(const char* pattern,
+                                           size_t size,
+                                           size_t pos) {
+  PatternToken token;
+  if (pattern_has_at(pattern, size, pos, "{{i}}") ||
+      pattern_has_at(pattern, size, pos, "{{d}}")) {
+    token.type = pattern[pos + 2] == 'i' ? RouteParamType::Int64
+                                         : RouteParamType::Double;
+    token.begin = pos;
+    token.end = pos + 5;
+  } else if (pattern_has_at(pattern, size, pos, "{{i?")) {
+    token = match_optional_number_token(pattern, size, pos,
+                                        RouteParamType::OptionalInt64);
+  } else if (pattern_has_at(pattern, size, pos, "{{d?")) {
+    token = match_optional_number_token(pattern, size, pos,
+                                        RouteParamType::OptionalDouble);
+  } else if (pattern_has_at(pattern, size, pos, "{{s:")) {
+    auto close = pattern_find(pattern, size, pos + 5, "}}");
+    if (close != kNotFound) {
+      token.type = RouteParamType::String;
+      token.begin = pos;
+      token.end = close + 2;
+      token.valueBegin = pos + 4;
+      token.valueEnd = close;
+    }
+  } else if (pattern_has_at(pattern, size, pos, "{{s?:")) {
+    token = match_optional_string_token(pattern, size, pos);
+  }
+  return token;
+}
+
+/**
+ * Finds the first typed parameter in pattern at or after from. Text that
+ * looks like the start of a parameter, but isn't one, is skipped
+ */
+constexpr PatternToken find_pattern_token(const char* pattern,
+                                          size_t size,
+                                          size_t from) {
+  for (auto pos = pattern_find(pattern, size, from, "{{"); pos != kNotFound;
+       pos = pattern_find(pattern, size, pos + 1, "{{")) {
+    auto token = match_pattern_token(pattern, size, pos);
+    if (token.found()) {
+      return token;
+    }
+  }
+  return PatternToken();
+}
+
+/**
+ * Finds the ']' that closes the character class that starts at open
+ */
+constexpr size_t find_class_close(const char* regex, size_t size, size_t open) {
+  auto i = open + 1;
+  // A ']' right after '[' or '[^' doesn't close the class
+  if (i < size && regex[i] == '^') {
+    ++i;
+  }
+  if (i < size && regex[i] == ']') {
+    ++i;
+  }
+  for (; i < size; ++i) {
+    if (regex[i] == '\\') {
+      ++i;
+    } else if (pattern_has_at(regex, size, i, "[:")) {
+      // Skip over [:alpha:] style classes
+      auto close = pattern_find(regex, size, i + 2, ":]");
+      if (close == kNotFound) {
+        return size;
+      }
+      i = close + 1;
+    } else if (regex[i] == ']') {
+      return i;
+    }
+  }
+  return size;
+}
+
+/**
+ * Counts the capture groups in regex[begin, end). (?<name>, (?P<name> and
+ * (?'name' groups capture, other (? groups don't
+ */
+constexpr size_t count_capture_groups(const char* regex,
+                                      size_t begin,
+                                      size_t end) {
+  size_t groups = 0;
+  for (auto i = begin; i < end; ++i) {
+    if (regex[i] == '\\') {
+      ++i;
+    } else if (regex[i] == '[') {
+      i = find_class_close(regex, end, i);
+    } else if (regex[i] == '(') {
+      if (!pattern_has_at(regex, end, i + 1, "?") ||
+          pattern_has_at(regex, end, i + 1, "?P<") ||
+          pattern_has_at(regex, end, i + 1, "?'") ||
+          (pattern_has_at(regex, end, i + 1, "?<") &&
+           !pattern_has_at(regex, end, i + 1, "?<=") &&
+           !pattern_has_at(regex, end, i + 1, "?<!"))) {
+        ++groups;
+      }
+    }
+  }
+  return groups;
+}
+
+/**
+ * Counts the capture groups that a typed parameter's regex will have. The
+ * parameter's own group comes first, followed by the groups in <regex> and
+ * <consumed>
+ */
+constexpr size_t count_token_groups(const char* pattern,
+                                    const PatternToken& token) {
+  return 1 + count_capture_groups(pattern, token.valueBegin, token.valueEnd) +
+         count_capture_groups(pattern, token.consumedBegin, token.consumedEnd);
+}
+
+/**
+ * Whether a '|' outside of any group or typed parameter splits the whole
+ * pattern into alternatives
+ */
+constexpr bool has_top_level_alternation(const char* pattern, size_t size) {
+  size_t depth = 0;
+  for (size_t i = 0; i < size; ++i) {
+    if (pattern_has_at(pattern, size, i, "{{")) {
+      auto token = match_pattern_token(pattern, size, i);
+      if (token.found()) {
+        i = token.end - 1;
+        continue;
+      }
+    }
+    if (pattern[i] == '\\') {
+      ++i;
+    } else if (pattern[i] == '[') {
+      i = find_class_close(pattern, size, i);
+    } else if (pattern[i] == '(') {
+      ++depth;
+    } else if (pattern[i] == ')' && depth > 0) {
+      --depth;
+    } else if (pattern[i] == '|' && depth == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Whether c has a special meaning in a regular expression
+ */
+constexpr bool is_regex_special(char c) {
+  return c == '\\' || c == '.' || c == '[' || c == ']' || c == '(' ||
+         c == ')' || c == '{' || c == '}' || c == '*' || c == '+' ||
+         c == '?' || c == '|' || c == '^' || c == '$';
+}
+
+/**
+ * Gets the length of the literal text that every path matching pattern
+ * has to start with. Paths that don't start with it can be skipped
+ * without running a regular expression
+ */
+constexpr size_t literal_prefix_length(const char* pattern, size_t size) {
+  if (has_top_level_alternation(pattern, size)) {
+    return 0;
+  }
+  for (size_t i = 0; i < size; ++i) {
+    auto c = pattern[i];
+    if (!is_regex_special(c)) {
+      continue;
+    }
+    if (c == '{' && match_pattern_token(pattern, size, i).found()) {
+      return i;
+    }
+    if (c == '{' || c == '*' || c == '+' || c == '?') {
+      // Quantifiers apply to the previous character, so it may not be in
+      // the path
+      return i == 0 ? 0 : i - 1;
+    }
+    return i;
+  }
+  return size;
+}
+
+/**
+ * What can be known about a route pattern at compile time
+ *
+ * @tparam N - The number of parameters to record types and groups for
+ */
+template <size_t N>
+struct PatternInfo {
+  // The number of typed parameters in the pattern, which may be more than N
+  size_t paramCount = 0;
+  // See literal_prefix_length
+  size_t prefixLength = 0;
+  // The type of each typed parameter
+  RouteParamType types[N == 0 ? 1 : N] = {};
+  // The regex group that captures each typed parameter
+  size_t groups[N == 0 ? 1 : N] = {};
+};
+
+/**
+ * Parses the typed parameters, their regex groups and the literal prefix
+ * out of a pattern. This does the same work as parse_route_pattern, but can
+ * be used in constant expressions. See NOZOMI_ROUTE_PATTERN
+ *
+ * @tparam N - The number of parameters that the handler takes
+ */
+template <size_t N>
+constexpr PatternInfo<N> parse_pattern_info(const char* pattern, size_t size) {
+  PatternInfo<N> info;
+  info.prefixLength = literal_prefix_length(pattern, size);
+  size_t groups = 0;
+  size_t literalBegin = 0;
+  for (auto token = find_pattern_token(pattern, size, 0); token.found();
+       token = find_pattern_token(pattern, size, token.end)) {
+    groups += count_capture_groups(pattern, literalBegin, token.begin);
+    if (info.paramCount < N) {
+      info.types[info.paramCount] = token.type;
+      info.groups[info.paramCount] = groups + 1;
+    }
+    ++info.paramCount;
+    groups += count_token_groups(pattern, token);
+    literalBegin = token.end;
+  }
+  return info;
+}
+
+/**
+ * Whether the typed parameters in info have the same types as Args
+ */
+template <typename... Args>
+constexpr bool pattern_types_match(PatternInfo<sizeof...(Args)> info) {
+  // The extra entry keeps the array from being empty
+  const RouteParamType params[] = {to_RouteParamType<Args>()...,
+                                   RouteParamType::Int64};
+  for (size_t i = 0; i < sizeof...(Args); ++i) {
+    if (info.types[i] != params[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * The base of the types made by NOZOMI_ROUTE_PATTERN
+ */
+struct PatternLiteral {};
+
+template <typename T>
+struct is_pattern_literal : std::is_base_of<PatternLiteral, T> {};
+
+/**
+ * Gets the length of a string literal, and refuses anything else
+ */
+template <size_t N>
+constexpr size_t literal_length(const char (&)[N]) {
+  return N - 1;
+}
+
+/**
+ * Whether a handler parameter type points into the request's path instead
+ * of owning its value
+ */
+template <typename T>
+struct is_path_view : std::false_type {};
+
+template <>
+struct is_path_view<folly::StringPiece> : std::true_type {};
+
+template <>
+struct is_path_view<folly::Optional<folly::StringPiece>> : std::true_type {};
+
+#if __cplusplus >= 201703L
+template <>
+struct is_path_view<std::string_view> : std::true_type {};
+
+template <>
+struct is_path_view<folly::Optional<std::string_view>> : std::true_type {};
+#endif
+
+/**
+ * Whether any of a handler's parameter types point into the request's path
+ */
+template <typename... Args>
+struct has_path_views : std::false_type {};
+
+template <typename Arg1, typename... Args>
+struct has_path_views<Arg1, Args...>
+    : std::integral_constant<bool,
+                             is_path_view<Arg1>::value ||
+                                 has_path_views<Args...>::value> {};
 
 /**
- * Converts match N of a regex match to type T.
+ * Converts a captured piece of a path to type T. If an integer is larger
+ * or smaller than an int64_t can represent, int64_t max is used
  *
- * @param matches - Regex matches from a Route match
+ * @param match - A piece of the path that matched a typed parameter
  */
 template <typename T>
-inline T get_handler_args(int N, const boost::smatch& matches);
+inline T parse_handler_arg(folly::StringPiece match);
 
 template <>
-inline int64_t get_handler_args<int64_t>(int N, const boost::smatch& matches) {
-  // TODO: There is probably a way to make all of these sformat("__{}", N)
-  //        calls constexpr
+inline int64_t parse_handler_arg<int64_t>(folly::StringPiece match) {
   try {
-    return folly::to<int64_t>(matches[folly::sformat("__{}", N)].str());
+    return folly::to<int64_t>(match);
   } catch (const std::exception& e) {
     // TODO: Logging
     return std::numeric_limits<int64_t>::max();
@@ -81,63 +557,228 @@ inline int64_t get_handler_args<int64_t>(int N, const boost::smatch& matches) {
 }
 
 template <>
-inline double get_handler_args<double>(int N, const boost::smatch& matches) {
-  return folly::to<double>(matches[folly::sformat("__{}", N)].str());
+inline double parse_handler_arg<double>(folly::StringPiece match) {
+  return folly::to<double>(match);
 }
 
 template <>
-inline std::string get_handler_args<std::string>(int N,
-                                                 const boost::smatch& matches) {
-  return matches[folly::sformat("__{}", N)].str();
+inline std::string parse_handler_arg<std::string>(folly::StringPiece match) {
+  return match.str();
 }
 
 template <>
-inline folly::Optional<int64_t> get_handler_args<folly::Optional<int64_t>>(
-    int N, const boost::smatch& matches) {
-  folly::Optional<int64_t> ret;
-  const auto& match = matches[folly::sformat("__{}", N)];
-  if (match.matched) {
-    try {
-      ret = folly::to<int64_t>(match.str());
-    } catch (const std::exception& e) {
-      // TODO: Logging
-      ret = std::numeric_limits<int64_t>::max();
-    }
+inline folly::Optional<int64_t> parse_handler_arg<folly::Optional<int64_t>>(
+    folly::StringPiece match) {
+  return folly::Optional<int64_t>(parse_handler_arg<int64_t>(match));
+}
+
+template <>
+inline folly::Optional<double> parse_handler_arg<folly::Optional<double>>(
+    folly::StringPiece match) {
+  return folly::Optional<double>(parse_handler_arg<double>(match));
+}
+
+template <>
+inline folly::Optional<std::string>
+parse_handler_arg<folly::Optional<std::string>>(folly::StringPiece match) {
+  return folly::Optional<std::string>(match.str());
+}
+
+template <>
+inline folly::StringPiece parse_handler_arg<folly::StringPiece>(
+    folly::StringPiece match) {
+  return match;
+}
+
+template <>
+inline folly::Optional<folly::StringPiece>
+parse_handler_arg<folly::Optional<folly::StringPiece>>(
+    folly::StringPiece match) {
+  return folly::Optional<folly::StringPiece>(match);
+}
+
+#if __cplusplus >= 201703L
+template <>
+inline std::string_view parse_handler_arg<std::string_view>(
+    folly::StringPiece match) {
+  return std::string_view(match.data(), match.size());
+}
+
+template <>
+inline folly::Optional<std::string_view>
+parse_handler_arg<folly::Optional<std::string_view>>(folly::StringPiece match) {
+  return folly::Optional<std::string_view>(
+      parse_handler_arg<std::string_view>(match));
+}
+#endif
+
+/**
+ * Gets the part of the path that a regex group matched, without copying it
+ */
+inline folly::StringPiece to_string_piece(const boost::ssub_match& match) {
+  if (!match.matched || match.first == match.second) {
+    return folly::StringPiece();
+  }
+  return folly::StringPiece(&*match.first,
+                            static_cast<size_t>(match.second - match.first));
+}
+
+/**
+ * Converts a regex group to type T. Numbers are parsed directly from the
+ * path, so only std::string arguments are copied. StringPiece arguments
+ * point into the string that was matched
+ *
+ * @param match - A group from a Route's regex match
+ */
+template <typename T>
+inline T get_handler_arg(const boost::ssub_match& match) {
+  return parse_handler_arg<T>(to_string_piece(match));
+}
+
+template <>
+inline folly::Optional<int64_t> get_handler_arg<folly::Optional<int64_t>>(
+    const boost::ssub_match& match) {
+  if (!match.matched) {
+    return folly::Optional<int64_t>();
   }
-  return ret;
+  return parse_handler_arg<folly::Optional<int64_t>>(to_string_piece(match));
 }
 
 template <>
-inline folly::Optional<double> get_handler_args<folly::Optional<double>>(
-    int N, const boost::smatch& matches) {
-  folly::Optional<double> ret;
-  const auto& match = matches[folly::sformat("__{}", N)];
-  if (match.matched) {
-    ret = folly::to<double>(match.str());
+inline folly::Optional<double> get_handler_arg<folly::Optional<double>>(
+    const boost::ssub_match& match) {
+  if (!match.matched) {
+    return folly::Optional<double>();
   }
-  return ret;
+  return parse_handler_arg<folly::Optional<double>>(to_string_piece(match));
 }
 
 template <>
 inline folly::Optional<std::string>
-get_handler_args<folly::Optional<std::string>>(int N,
-                                               const boost::smatch& matches) {
-  folly::Optional<std::string> ret;
-  const auto& match = matches[folly::sformat("__{}", N)];
-  if (match.matched) {
-    ret = match.str();
+get_handler_arg<folly::Optional<std::string>>(const boost::ssub_match& match) {
+  if (!match.matched) {
+    return folly::Optional<std::string>();
+  }
+  return parse_handler_arg<folly::Optional<std::string>>(
+      to_string_piece(match));
+}
+
+template <>
+inline folly::Optional<folly::StringPiece>
+get_handler_arg<folly::Optional<folly::StringPiece>>(
+    const boost::ssub_match& match) {
+  if (!match.matched) {
+    return folly::Optional<folly::StringPiece>();
+  }
+  return to_string_piece(match);
+}
+
+#if __cplusplus >= 201703L
+template <>
+inline folly::Optional<std::string_view>
+get_handler_arg<folly::Optional<std::string_view>>(
+    const boost::ssub_match& match) {
+  if (!match.matched) {
+    return folly::Optional<std::string_view>();
   }
-  return ret;
+  return parse_handler_arg<std::string_view>(to_string_piece(match));
 }
+#endif
+
+/** The most typed parameters that a dynamic route can have */
+constexpr size_t kMaxRouteParams = 16;
+
+/**
+ * The piece of a decoded path that a typed parameter matched. It is kept as
+ * an offset so that it can be resolved against the HTTPRequest's copy of
+ * the path
+ */
+struct RouteCapture {
+  uint32_t offset = 0;
+  uint32_t length = 0;
+  // Optional parameters might not match anything
+  bool matched = false;
+};
 
 /**
- * Converts match N from a regex match to the correct type
+ * The captures for all of a route's typed parameters. They are stored
+ * inline so that matching a route does not allocate
+ */
+class RouteCaptures {
+ private:
+  std::array<RouteCapture, kMaxRouteParams> captures_;
+  size_t size_ = 0;
+
+ public:
+  /**
+   * Adds a capture for a parameter that matched
+   *
+   * @param offset - Where the match starts in the decoded path
+   * @param length - The length of the match
+   */
+  inline void push_back(size_t offset, size_t length) {
+    DCHECK(size_ < kMaxRouteParams) << "Too many route parameters";
+    captures_[size_++] = RouteCapture{static_cast<uint32_t>(offset),
+                                      static_cast<uint32_t>(length), true};
+  }
+
+  /**
+   * Adds a capture for a piece of path
+   *
+   * @param path - The whole decoded path
+   * @param piece - The part of path that matched
+   */
+  inline void push_back(folly::StringPiece path, folly::StringPiece piece) {
+    DCHECK(piece.begin() >= path.begin() && piece.end() <= path.end());
+    push_back(piece.begin() - path.begin(), piece.size());
+  }
+
+  /**
+   * Adds a capture for an optional parameter that didn't match
+   */
+  inline void push_back_unmatched() {
+    DCHECK(size_ < kMaxRouteParams) << "Too many route parameters";
+    captures_[size_++] = RouteCapture();
+  }
+
+  inline void pop_back() { --size_; }
+  inline size_t size() const { return size_; }
+  inline const RouteCapture& operator[](size_t i) const {
+    return captures_[i];
+  }
+};
+
+/**
+ * Converts a capture to type T. See get_capture_arg
+ */
+template <typename T>
+struct CaptureArg {
+  static inline T get(folly::StringPiece path, const RouteCapture& capture) {
+    return parse_handler_arg<T>(path.subpiece(capture.offset, capture.length));
+  }
+};
+
+template <typename T>
+struct CaptureArg<folly::Optional<T>> {
+  static inline folly::Optional<T> get(folly::StringPiece path,
+                                       const RouteCapture& capture) {
+    if (!capture.matched) {
+      return folly::Optional<T>();
+    }
+    return parse_handler_arg<folly::Optional<T>>(
+        path.subpiece(capture.offset, capture.length));
+  }
+};
+
+/**
+ * Converts a route capture to type T. Optional types are empty if the
+ * parameter didn't match. StringPiece arguments point into path
  *
- * @param matches - Regex matches from a route's pattern matching
+ * @param path - The decoded path that the capture was made from
  */
-template <int N, typename T>
-inline T get_handler_args(const boost::smatch& matches) {
-  return get_handler_args<T>(N, matches);
+template <typename T>
+inline T get_capture_arg(folly::StringPiece path, const RouteCapture& capture) {
+  return CaptureArg<T>::get(path, capture);
 }
 
 /** Specialization used for variadic templates */
@@ -166,14 +807,63 @@ std::vector<RouteParamType> parse_function_parameters() {
 }
 
 /**
- * Parse a route string to a regular expresion and a vector of
- * all types that were found in the route. See Route.h for enumeration
- * of the options for route patterns
+ * Parse a route string to either a list of segments or a regular expresion,
+ * and a vector of all types that were found in the route. See Route.h for
+ * enumeration of the options for route patterns
  *
  * @throws runtime_error if there was a problem with the pattern including
  *                       invalid regex within types that accept regex
  */
-std::pair<boost::basic_regex<char>, std::vector<RouteParamType>>
-parse_route_pattern(const std::string& route);
+RoutePattern parse_route_pattern(const std::string& route);
+
+/**
+ * Gets the names of every capture group in a regular expression
+ *
+ * @returns One entry per capture group, in the order that the regex numbers
+ *          them (i.e. the entry for group 1 is first). Unnamed groups have
+ *          empty names
+ */
+std::vector<std::string> capture_group_names(folly::StringPiece regex);
+
+/**
+ * Paths with up to this many segments are split without allocating
+ */
+constexpr size_t kMaxInlinePathSegments = 16;
+
+/**
+ * The '/' delimited segments of a decoded path
+ */
+using PathSegments =
+    folly::small_vector<folly::StringPiece, kMaxInlinePathSegments>;
+
+/**
+ * Splits a (decoded) path into its '/' delimited segments. The leading
+ * slash produces an empty first segment, the same as in patterns
+ */
+PathSegments split_path(folly::StringPiece path);
+
+/**
+ * Whether a single path segment matches a typed parameter segment
+ */
+bool parameter_matches(SegmentType type, folly::StringPiece piece);
+
+/**
+ * Whether a single path segment matches a single pattern segment
+ */
+bool segment_matches(const PatternSegment& segment, folly::StringPiece piece);
+
+/**
+ * Matches a split path against a pattern's segments. On success, the
+ * pieces of the path that correspond to typed parameters are appended to
+ * captures in order
+ *
+ * @param path - The decoded path
+ * @param pathSegments - path split with split_path
+ * @returns whether the path matched
+ */
+bool match_segments(const std::vector<PatternSegment>& pattern,
+                    folly::StringPiece path,
+                    const PathSegments& pathSegments,
+                    RouteCaptures& captures);
 }
 }
@@ -0,0 +1,129 @@
+#include "src/RouteTrie.h"
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+using folly::StringPiece;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace nozomi {
+
+using route_parsing::PathSegments;
+using route_parsing::PatternSegment;
+using route_parsing::RouteCaptures;
+using route_parsing::SegmentType;
+
+RouteTrie::Node* RouteTrie::getOrCreateChild(Node& node,
+                                             const PatternSegment& segment) {
+  unique_ptr<Node>* child = nullptr;
+  switch (segment.type) {
+    case (SegmentType::Literal): {
+      auto it = std::lower_bound(
+          node.literals.begin(), node.literals.end(), segment.literal,
+          [](const auto& literal, const string& key) {
+            return literal.first < key;
+          });
+      if (it == node.literals.end() || it->first != segment.literal) {
+        it = node.literals.emplace(it, segment.literal,
+                                   std::make_unique<Node>());
+      }
+      return it->second.get();
+    }
+    case (SegmentType::Int64):
+      child = &node.int64Child;
+      break;
+    case (SegmentType::Double):
+      child = &node.doubleChild;
+      break;
+    case (SegmentType::String):
+      child = &node.stringChild;
+      break;
+  }
+  DCHECK(child != nullptr);
+  if (*child == nullptr) {
+    *child = std::make_unique<Node>();
+  }
+  return child->get();
+}
+
+const RouteTrie::Node* RouteTrie::findLiteral(const Node& node,
+                                              StringPiece piece) {
+  auto it = std::lower_bound(node.literals.begin(), node.literals.end(), piece,
+                             [](const auto& literal, StringPiece key) {
+                               return StringPiece(literal.first) < key;
+                             });
+  if (it == node.literals.end() || StringPiece(it->first) != piece) {
+    return nullptr;
+  }
+  return it->second.get();
+}
+
+void RouteTrie::insert(const vector<PatternSegment>& segments,
+                       size_t routeIndex) {
+  Node* node = &root_;
+  for (const auto& segment : segments) {
+    node = getOrCreateChild(*node, segment);
+  }
+  node->routes.push_back(routeIndex);
+  empty_ = false;
+}
+
+void RouteTrie::match(StringPiece path,
+                      const PathSegments& pathSegments,
+                      vector<Match>& matches) const {
+  if (empty_) {
+    return;
+  }
+  auto firstMatch = matches.size();
+  RouteCaptures captures;
+  match(root_, path, pathSegments, 0, captures, matches);
+  std::sort(matches.begin() + firstMatch, matches.end(),
+            [](const Match& lhs, const Match& rhs) {
+              return lhs.routeIndex < rhs.routeIndex;
+            });
+}
+
+vector<RouteTrie::Match> RouteTrie::match(
+    StringPiece path,
+    const PathSegments& pathSegments) const {
+  vector<Match> matches;
+  match(path, pathSegments, matches);
+  return matches;
+}
+
+void RouteTrie::match(const Node& node,
+                      StringPiece path,
+                      const PathSegments& pathSegments,
+                      size_t depth,
+                      RouteCaptures& captures,
+                      vector<Match>& matches) {
+  if (depth == pathSegments.size()) {
+    for (auto routeIndex : node.routes) {
+      matches.push_back(Match{routeIndex, captures});
+    }
+    return;
+  }
+
+  // Every branch that matches has to be followed. Routes are ordered by
+  // registration, not by how specific their segments are
+  const auto& piece = pathSegments[depth];
+  const auto* literal = findLiteral(node, piece);
+  if (literal != nullptr) {
+    match(*literal, path, pathSegments, depth + 1, captures, matches);
+  }
+
+  auto matchParameter = [&](const unique_ptr<Node>& child, SegmentType type) {
+    if (child != nullptr && route_parsing::parameter_matches(type, piece)) {
+      captures.push_back(path, piece);
+      match(*child, path, pathSegments, depth + 1, captures, matches);
+      captures.pop_back();
+    }
+  };
+  matchParameter(node.int64Child, SegmentType::Int64);
+  matchParameter(node.doubleChild, SegmentType::Double);
+  matchParameter(node.stringChild, SegmentType::String);
+}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <folly/Range.h>
+
+#include "src/RouteParsing.h"
+
+namespace nozomi {
+
+/**
+ * A trie of route patterns that were split into segments by
+ * route_parsing::parse_route_pattern. Matching a path walks the trie
+ * one segment at a time, so the cost depends on the length of the path
+ * rather than on the number of routes that were inserted.
+ */
+class RouteTrie {
+ public:
+  /**
+   * A route whose pattern matched a path, along with the pieces of the
+   * path that correspond to the route's typed parameters
+   */
+  struct Match {
+    size_t routeIndex;
+    route_parsing::RouteCaptures captures;
+  };
+
+  /**
+   * Adds a route's segments to the trie
+   *
+   * @param segments - The segments from parse_route_pattern
+   * @param routeIndex - The identifier to return when this route matches.
+   *                     Used by the Router to preserve registration order
+   */
+  void insert(const std::vector<route_parsing::PatternSegment>& segments,
+              size_t routeIndex);
+
+  /**
+   * Gets every route whose pattern matches a path
+   *
+   * @param path - The decoded path
+   * @param pathSegments - path split with route_parsing::split_path
+   * @param matches - All matches are appended to this, sorted by
+   *                  routeIndex. Captures are offsets into path. Reusing
+   *                  it between calls avoids allocating
+   */
+  void match(folly::StringPiece path,
+             const route_parsing::PathSegments& pathSegments,
+             std::vector<Match>& matches) const;
+
+  /**
+   * Gets every route whose pattern matches a path. See above
+   */
+  std::vector<Match> match(
+      folly::StringPiece path,
+      const route_parsing::PathSegments& pathSegments) const;
+
+  inline bool empty() const { return empty_; }
+
+ private:
+  struct Node {
+    // Sorted by literal so that lookups don't need to allocate a string
+    std::vector<std::pair<std::string, std::unique_ptr<Node>>> literals;
+    std::unique_ptr<Node> int64Child;
+    std::unique_ptr<Node> doubleChild;
+    std::unique_ptr<Node> stringChild;
+    std::vector<size_t> routes;
+  };
+
+  Node root_;
+  bool empty_ = true;
+
+  static Node* getOrCreateChild(Node& node,
+                                const route_parsing::PatternSegment& segment);
+  static const Node* findLiteral(const Node& node, folly::StringPiece piece);
+  static void match(const Node& node,
+                    folly::StringPiece path,
+                    const route_parsing::PathSegments& pathSegments,
+                    size_t depth,
+                    route_parsing::RouteCaptures& captures,
+                    std::vector<Match>& matches);
+};
+}
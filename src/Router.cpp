@@ -1,43 +1,241 @@
 #include "src/Router.h"
 
+#include <algorithm>
+#include <atomic>
+
 using std::vector;
 using std::unique_ptr;
 using std::unordered_map;
 
 namespace nozomi {
 
+namespace {
+// Identifies each router so that threads can tell when their match cache
+// belongs to a router that was replaced
+std::atomic<uint64_t> nextGeneration{1};
+
+// The number of routers that each thread keeps a match cache for. Caches
+// for routers that were replaced age out
+constexpr size_t kMaxThreadRouteCaches = 4;
+
+/**
+ * One of the calling thread's match caches, and the router generation that
+ * it belongs to
+ */
+struct ThreadRouteCache {
+  uint64_t generation;
+  std::unique_ptr<RouteCache> cache;
+};
+
+// Most recently used first
+inline vector<ThreadRouteCache>& thread_route_caches() {
+  static thread_local vector<ThreadRouteCache> threadCaches;
+  return threadCaches;
+}
+
+inline uint64_t method_bit(proxygen::HTTPMethod method) {
+  DCHECK(static_cast<size_t>(method) < 64);
+  return uint64_t(1) << static_cast<size_t>(method);
+}
+
+/**
+ * Adds a route that matched to a match cache. Matches that wrap some other
+ * callable instead of a route can't be rebuilt from an entry, so they
+ * aren't cached
+ */
+void cache_match(RouteCache& cache,
+                 const RoutingContext& context,
+                 const RouteMatch& match) {
+  if (match.handler.getRoute() != nullptr) {
+    cache.insert(context.getMethod(), context.getPath(),
+                 {match.handler.getRoute(), match.handler.getCaptures(),
+                  false});
+  } else if (match.streamingHandler.getRoute() != nullptr) {
+    cache.insert(context.getMethod(), context.getPath(),
+                 {match.streamingHandler.getRoute(),
+                  match.streamingHandler.getCaptures(), true});
+  }
+}
+
+inline uint64_t method_mask(
+    const std::unordered_set<proxygen::HTTPMethod>& methods) {
+  uint64_t mask = 0;
+  for (auto method : methods) {
+    mask |= method_bit(method);
+  }
+  return mask;
+}
+}
+
 Router::Router(unordered_map<int,
                              std::function<folly::Future<HTTPResponse>(
                                  const HTTPRequest&)>> errorRoutes,
                vector<unique_ptr<BaseRoute>> routes)
-    : errorRoutes_(std::move(errorRoutes)) {
+    : errorRoutes_(std::move(errorRoutes)),
+      generation_(nextGeneration.fetch_add(1, std::memory_order_relaxed)) {
   for (auto& route : routes) {
     if (route->isStaticRoute()) {
+      auto mask = method_mask(route->getMethods());
+      auto& entry = staticRouteTable_[route->getOriginalPattern()];
+      entry.methods |= mask;
+      entry.routes.emplace_back(mask, route.get());
       staticRoutes_.push_back(std::move(route));
     } else {
+      const auto* segments = route->getPatternSegments();
+      if (segments != nullptr) {
+        trie_.insert(*segments, routes_.size());
+      } else {
+        regexRoutes_.push_back(routes_.size());
+      }
       routes_.push_back(std::move(route));
     }
   }
 }
 
-RouteMatch Router::getHandler(const proxygen::HTTPMessage* request) const {
+void Router::combineRegexRoutes() {
+  vector<const boost::basic_regex<char>*> regexes;
+  regexes.reserve(regexRoutes_.size());
+  for (auto routeIndex : regexRoutes_) {
+    const auto* regex = routes_[routeIndex]->getRegex();
+    DCHECK(regex != nullptr) << "Regex routes must provide a regex";
+    regexes.push_back(regex);
+  }
+  combinedRegex_.emplace(regexes);
+}
+
+void Router::enableMatchCache(size_t capacity) {
+  DCHECK(capacity > 0) << "Match cache capacity must be at least 1";
+  matchCacheCapacity_ = capacity;
+  // Caches made with a different capacity are never used again
+  generation_ = nextGeneration.fetch_add(1, std::memory_order_relaxed);
+  matchCacheCounters_ = std::make_unique<MatchCacheCounters>();
+}
+
+RouteCacheStats Router::getMatchCacheStats() const {
+  if (matchCacheCounters_ == nullptr) {
+    return RouteCacheStats();
+  }
+  std::lock_guard<std::mutex> lock(matchCacheCounters_->mutex);
+  auto stats = matchCacheCounters_->retired;
+  for (const auto& counters : matchCacheCounters_->caches) {
+    stats.hits += counters->hits.load(std::memory_order_relaxed);
+    stats.misses += counters->misses.load(std::memory_order_relaxed);
+  }
+  return stats;
+}
+
+RouteCache& Router::getThreadMatchCache() const {
+  auto& caches = thread_route_caches();
+  auto found = std::find_if(caches.begin(), caches.end(),
+                            [this](const ThreadRouteCache& cache) {
+                              return cache.generation == generation_;
+                            });
+  if (found != caches.end()) {
+    std::rotate(caches.begin(), found, found + 1);
+    return *caches.front().cache;
+  }
+
+  if (caches.size() == kMaxThreadRouteCaches) {
+    caches.pop_back();
+  }
+  auto cache = std::make_unique<RouteCache>(matchCacheCapacity_);
+  {
+    std::lock_guard<std::mutex> lock(matchCacheCounters_->mutex);
+    // Fold in the counts of caches that were dropped, so that the list only
+    // grows with the number of live caches
+    auto& registered = matchCacheCounters_->caches;
+    auto retired = std::remove_if(
+        registered.begin(), registered.end(),
+        [this](const std::shared_ptr<RouteCacheCounters>& counters) {
+          if (counters.use_count() > 1) {
+            return false;
+          }
+          std::atomic_thread_fence(std::memory_order_acquire);
+          matchCacheCounters_->retired.hits +=
+              counters->hits.load(std::memory_order_relaxed);
+          matchCacheCounters_->retired.misses +=
+              counters->misses.load(std::memory_order_relaxed);
+          return true;
+        });
+    registered.erase(retired, registered.end());
+    registered.push_back(cache->getCounters());
+  }
+  caches.reserve(kMaxThreadRouteCaches);
+  caches.insert(caches.begin(),
+                ThreadRouteCache{generation_, std::move(cache)});
+  return *caches.front().cache;
+}
+
+RouteMatch Router::getHandler(const RoutingContext& context) const {
   // Check static routes first, then dynamic ones
   bool methodNotFound = false;
-  for (const auto& route : staticRoutes_) {
-    auto match = route->handler(request);
-    switch (match.result) {
-      case (RouteMatchResult::PathNotMatched):
-        continue;
-      case (RouteMatchResult::MethodNotMatched):
-        methodNotFound = true;
-        break;
-      case (RouteMatchResult::RouteMatched):
-        return match;
+  auto entry = staticRouteTable_.find(context.getPath());
+  if (entry != staticRouteTable_.end()) {
+    auto bit = method_bit(context.getMethod());
+    if (entry->second.methods & bit) {
+      for (const auto& route : entry->second.routes) {
+        if (route.first & bit) {
+          return route.second->handler(context);
+        }
+      }
+    }
+    methodNotFound = true;
+  }
+
+  RouteCache* cache = nullptr;
+  if (matchCacheCapacity_ > 0) {
+    cache = &getThreadMatchCache();
+    const auto* entry = cache->find(context.getMethod(), context.getPath());
+    if (entry != nullptr && entry->isStreaming) {
+      return RouteMatch(RouteMatchResult::RouteMatched,
+                        StreamingRouteHandler(entry->route, entry->captures,
+                                              context.getPathBuffer()));
+    } else if (entry != nullptr) {
+      return RouteMatch(RouteMatchResult::RouteMatched,
+                        RouteHandler(entry->route, entry->captures));
     }
   }
 
-  for (const auto& route : routes_) {
-    auto match = route->handler(request);
+  // Walk the trie matches and the regex routes together, in registration
+  // order, so that the first dynamic route registered still wins
+  // Scratch space is reused by each thread so that routing doesn't allocate
+  static thread_local vector<RouteTrie::Match> trieMatches;
+  static thread_local boost::smatch combinedMatches;
+  trieMatches.clear();
+  if (!trie_.empty()) {
+    trie_.match(context.getPath(), context.getPathSegments(), trieMatches);
+  }
+  auto trieMatch = trieMatches.cbegin();
+  auto regexRoute = regexRoutes_.cbegin();
+
+  // The combined regex finds the first regex route whose path matches, so
+  // the ones before it can be skipped
+  auto combinedRoute = regexRoutes_.cend();
+  if (combinedRegex_) {
+    auto index = combinedRegex_->match(context.getPath(), combinedMatches);
+    regexRoute = index ? regexRoutes_.cbegin() + index.value()
+                       : regexRoutes_.cend();
+    combinedRoute = regexRoute;
+  }
+
+  while (trieMatch != trieMatches.cend() || regexRoute != regexRoutes_.cend()) {
+    bool isRegexRoute = regexRoute != regexRoutes_.cend() &&
+                        (trieMatch == trieMatches.cend() ||
+                         *regexRoute < trieMatch->routeIndex);
+    RouteMatch match(RouteMatchResult::PathNotMatched);
+    if (isRegexRoute && regexRoute == combinedRoute) {
+      match = routes_[*regexRoute]->handlerFromMatch(
+          context, combinedMatches,
+          combinedRegex_->getGroupOffset(regexRoute - regexRoutes_.cbegin()));
+      ++regexRoute;
+    } else if (isRegexRoute) {
+      match = routes_[*regexRoute]->handler(context);
+      ++regexRoute;
+    } else {
+      match = routes_[trieMatch->routeIndex]->handlerFromCaptures(
+          context, trieMatch->captures);
+      ++trieMatch;
+    }
     switch (match.result) {
       case (RouteMatchResult::PathNotMatched):
         continue;
@@ -45,6 +243,9 @@ RouteMatch Router::getHandler(const proxygen::HTTPMessage* request) const {
         methodNotFound = true;
         break;
       case (RouteMatchResult::RouteMatched):
+        if (cache != nullptr) {
+          cache_match(*cache, context, match);
+        }
         return match;
     }
   }
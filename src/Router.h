@@ -1,16 +1,25 @@
 #pragma once
 
+#include <cstdint>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <boost/regex.hpp>
+#include <folly/Optional.h>
 #include <proxygen/lib/http/HTTPMessage.h>
 
 #include "src/BaseRoute.h"
+#include "src/CombinedRouteRegex.h"
 #include "src/HTTPRequest.h"
 #include "src/HTTPResponse.h"
+#include "src/RouteCache.h"
+#include "src/RouteTrie.h"
+#include "src/RoutingContext.h"
 #include "src/Util.h"
 
 namespace nozomi {
@@ -23,12 +32,51 @@ namespace nozomi {
  */
 class Router {
  private:
+  /**
+   * All static routes registered for a single path. routes is kept in
+   * registration order so that the first route registered for a method wins
+   */
+  struct StaticRouteEntry {
+    uint64_t methods = 0;
+    std::vector<std::pair<uint64_t, BaseRoute*>> routes;
+  };
+
   std::list<std::unique_ptr<BaseRoute>> staticRoutes_;
-  std::list<std::unique_ptr<BaseRoute>> routes_;
+  std::unordered_map<std::string, StaticRouteEntry> staticRouteTable_;
+  // Dynamic routes in registration order. Routes with pattern segments are
+  // looked up in trie_, and the rest are checked one at a time in order
+  std::vector<std::unique_ptr<BaseRoute>> routes_;
+  std::vector<size_t> regexRoutes_;
+  RouteTrie trie_;
+  // Set by combineRegexRoutes(). Alternatives are in the same order as
+  // regexRoutes_
+  folly::Optional<CombinedRouteRegex> combinedRegex_;
   std::unordered_map<
       int,
       std::function<folly::Future<HTTPResponse>(const HTTPRequest&)>>
       errorRoutes_;
+  /**
+   * The counters of every thread's match cache for this router, so that
+   * they can be read from any thread
+   */
+  struct MatchCacheCounters {
+    std::mutex mutex;
+    // What was counted by caches that no thread holds any more
+    RouteCacheStats retired;
+    std::vector<std::shared_ptr<RouteCacheCounters>> caches;
+  };
+
+  // Set by enableMatchCache(). Each thread keeps a cache for each of the
+  // last few router generations that it routed with
+  size_t matchCacheCapacity_ = 0;
+  uint64_t generation_;
+  std::unique_ptr<MatchCacheCounters> matchCacheCounters_;
+
+  /**
+   * Returns the calling thread's match cache for this router, creating it
+   * and registering its counters the first time
+   */
+  RouteCache& getThreadMatchCache() const;
 
  public:
   /**
@@ -48,7 +96,49 @@ class Router {
    * Gets the handler for a given HTTP request. If no matching handler
    * is found, a handler for either a 404 or 405 is returned
    */
-  RouteMatch getHandler(const proxygen::HTTPMessage* request) const;
+  RouteMatch getHandler(const RoutingContext& context) const;
+
+  /**
+   * Convenience method that builds the RoutingContext for a request.
+   * See getHandler(const RoutingContext&)
+   */
+  inline RouteMatch getHandler(const proxygen::HTTPMessage* request) const {
+    DCHECK(request != nullptr);
+    return getHandler(RoutingContext(request));
+  }
+
+  /**
+   * Opts into matching every regex route with a single combined regular
+   * expression instead of running each route's regular expression in turn.
+   * The first route registered still wins. If the first matching route does
+   * not support the request's method, the remaining regex routes are checked
+   * one at a time. This must be called before the router handles requests.
+   *
+   * @throws invalid_argument if a regex route refers to its own groups,
+   *                          e.g. with backreferences. See
+   *                          CombinedRouteRegex
+   */
+  void combineRegexRoutes();
+
+  /**
+   * Opts into caching the dynamic route that matched each method and
+   * decoded path, along with its captures, in a least recently used cache.
+   * Each thread has its own cache for each router, so lookups don't take
+   * locks. Caches are keyed by the router, so a replaced router's entries
+   * are never used, and a thread only keeps caches for the last few
+   * routers that it used. Static routes and 404/405 results are not
+   * cached. This must be called before the router handles requests.
+   *
+   * @param capacity - The maximum number of entries in each thread's cache
+   */
+  void enableMatchCache(size_t capacity);
+
+  /**
+   * Returns the number of hits and misses in every thread's match cache
+   * for this router. It can be called from any thread. Both are 0 if the
+   * cache is not enabled
+   */
+  RouteCacheStats getMatchCacheStats() const;
 
   /**
    * Gets an error handler given an error code. If none was provided
@@ -0,0 +1,65 @@
+#include "src/RoutingContext.h"
+
+#include <atomic>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "src/HTTPRequest.h"
+
+using std::shared_ptr;
+using std::string;
+
+namespace nozomi {
+
+namespace {
+/**
+ * The decoded path buffers of one thread. A buffer is handed out again once
+ * the pool holds its only reference, so it keeps its capacity, and decoding
+ * a path on a warm thread doesn't allocate
+ */
+class PathBufferPool {
+ public:
+  // Buffers beyond this many in flight are allocated for one request
+  static constexpr size_t kMaxBuffers = 64;
+
+  shared_ptr<string> acquire() {
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+      next_ = next_ + 1 < buffers_.size() ? next_ + 1 : 0;
+      const auto& buffer = buffers_[next_];
+      if (buffer.use_count() == 1) {
+        // Pairs with the release of the last request that used the buffer,
+        // which may have been on another thread
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return buffer;
+      }
+    }
+    auto buffer = std::make_shared<string>();
+    if (buffers_.size() < kMaxBuffers) {
+      buffers_.push_back(buffer);
+    }
+    return buffer;
+  }
+
+ private:
+  std::vector<shared_ptr<string>> buffers_;
+  size_t next_ = 0;
+};
+
+thread_local PathBufferPool path_buffers;
+}
+
+RoutingContext::RoutingContext(const proxygen::HTTPMessage* message) {
+  DCHECK(message != nullptr);
+  method_ = message->getMethod().value_or(proxygen::HTTPMethod::GET);
+  auto path = path_buffers.acquire();
+  HTTPRequest::unescapePath(message->getPath(), *path);
+  pathSegments_ = route_parsing::split_path(*path);
+  path_ = std::move(path);
+}
+
+shared_ptr<const string> RoutingContext::releasePath() {
+  pathSegments_.clear();
+  return std::move(path_);
+}
+}
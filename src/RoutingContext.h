@@ -0,0 +1,74 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <folly/Range.h>
+#include <proxygen/lib/http/HTTPMessage.h>
+#include <proxygen/lib/http/HTTPMethod.h>
+
+#include "src/RouteParsing.h"
+
+namespace nozomi {
+
+/**
+ * The parts of a request that routes match on. This is built once per
+ * request so that the path is only decoded and split once, no matter how
+ * many routes are checked. The decoded path lives in a shared buffer that
+ * is handed to the HTTPRequest, so path segments and StringPiece route
+ * arguments stay valid for as long as the request does. Buffers are reused
+ * by each thread once nothing refers to them, and segments are kept
+ * inline, so building a context usually doesn't allocate.
+ */
+class RoutingContext {
+ private:
+  proxygen::HTTPMethod method_;
+  std::shared_ptr<const std::string> path_;
+  route_parsing::PathSegments pathSegments_;
+
+ public:
+  /**
+   * Creates a RoutingContext
+   *
+   * @param message - The request's metadata. It is not retained
+   */
+  explicit RoutingContext(const proxygen::HTTPMessage* message);
+
+  RoutingContext(const RoutingContext&) = delete;
+  RoutingContext& operator=(const RoutingContext&) = delete;
+
+  /**
+   * Returns the method that the request was made with, or GET
+   * if the method was not able to be determined
+   */
+  inline proxygen::HTTPMethod getMethod() const { return method_; }
+
+  /**
+   * Returns the uri decoded path
+   */
+  inline const std::string& getPath() const { return *path_; }
+
+  /**
+   * Returns the buffer that holds the decoded path. Anything that points
+   * into getPath() or getPathSegments() can hold on to this to keep the
+   * path alive
+   */
+  inline const std::shared_ptr<const std::string>& getPathBuffer() const {
+    return path_;
+  }
+
+  /**
+   * Returns the decoded path split on '/'. See route_parsing::split_path
+   */
+  inline const route_parsing::PathSegments& getPathSegments() const {
+    return pathSegments_;
+  }
+
+  /**
+   * Moves the decoded path buffer out of the context so that an HTTPRequest
+   * can own it without decoding it again. The context must not be used to
+   * match routes afterwards
+   */
+  std::shared_ptr<const std::string> releasePath();
+};
+}
@@ -22,12 +22,18 @@ using folly::exception_wrapper;
 
 namespace nozomi {
 
-HTTPServerOptions getHTTPServerOptions(const Config& config, Router router) {
+HTTPServerOptions getHTTPServerOptions(
+    const Config& config,
+    Router router,
+    std::shared_ptr<ExecutorPools> executorPools,
+    std::shared_ptr<AdmissionController> admission,
+    std::shared_ptr<HTTPHandlerPools> handlerPools) {
   HTTPServerOptions options;
   options.threads = config.getWorkerThreads();
   vector<unique_ptr<RequestHandlerFactory>> handlerFactories;
-  handlerFactories.push_back(
-      std::make_unique<HTTPHandlerFactory<>>(config, std::move(router)));
+  handlerFactories.push_back(std::make_unique<HTTPHandlerFactory<>>(
+      config, std::move(router), std::move(executorPools),
+      std::move(admission), std::move(handlerPools)));
   options.handlerFactories = std::move(handlerFactories);
   options.enableContentCompression = true;
   return options;
@@ -35,7 +41,30 @@ HTTPServerOptions getHTTPServerOptions(const Config& config, Router router) {
 
 Server::Server(Config config, Router router)
     : config_(std::move(config)),
-      server_(getHTTPServerOptions(config_, std::move(router))) {}
+      executorPools_(
+          std::make_shared<ExecutorPools>(config_.getExecutorPools())),
+      admission_(
+          std::make_shared<AdmissionController>(config_.getAdmission())),
+      handlerPools_(std::make_shared<HTTPHandlerPools>(
+          config_.getMaxPooledHandlers())),
+      server_(getHTTPServerOptions(config_,
+                                   std::move(router),
+                                   executorPools_,
+                                   admission_,
+                                   handlerPools_)) {}
+
+std::unordered_map<std::string, ExecutorPoolStats>
+Server::getExecutorPoolStats() const {
+  return executorPools_->getStats();
+}
+
+AdmissionStats Server::getAdmissionStats() const {
+  return admission_->getStats();
+}
+
+vector<HTTPHandlerPoolStats> Server::getHandlerPoolStats() const {
+  return handlerPools_->getStats();
+}
 
 folly::Future<Unit> Server::start() {
   CHECK(!mainThread_) << "A server can only be started once";
@@ -1,12 +1,19 @@
 #pragma once
 
+#include <memory>
+#include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include <folly/Optional.h>
 #include <folly/futures/Future.h>
 #include <proxygen/httpserver/HTTPServer.h>
 
+#include "src/AdmissionController.h"
 #include "src/Config.h"
+#include "src/ExecutorPool.h"
+#include "src/HTTPHandlerPool.h"
 #include "src/Router.h"
 
 namespace nozomi {
@@ -14,6 +21,9 @@ namespace nozomi {
 class Server {
  private:
   Config config_;
+  std::shared_ptr<ExecutorPools> executorPools_;
+  std::shared_ptr<AdmissionController> admission_;
+  std::shared_ptr<HTTPHandlerPools> handlerPools_;
   folly::Optional<std::thread> mainThread_;
   proxygen::HTTPServer server_;
 
@@ -21,5 +31,24 @@ class Server {
   Server(Config config, Router router);
   folly::Future<folly::Unit> start();
   folly::Future<folly::Unit> stop();
+
+  /**
+   * Returns the queue depth, rejections and wait times of each of the
+   * executor pools declared in the Config, by name
+   */
+  std::unordered_map<std::string, ExecutorPoolStats> getExecutorPoolStats()
+      const;
+
+  /**
+   * Returns how many requests are in flight, and how many have been
+   * admitted and shed by the admission policy declared in the Config
+   */
+  AdmissionStats getAdmissionStats() const;
+
+  /**
+   * Returns how many idle handlers each worker thread has pooled, and how
+   * many handlers were allocated and reused
+   */
+  std::vector<HTTPHandlerPoolStats> getHandlerPoolStats() const;
 };
 }
@@ -1,45 +1,68 @@
 #pragma once
+
+#include "src/HandlerResult.h"
+
 namespace nozomi {
 
 namespace {
+/**
+ * Makes RouteMatch objects for matched static routes, and calls their
+ * handlers
+ */
 template <typename HandlerType, bool IsStreaming>
-struct StaticRouteMatchMaker {};
+struct StaticRouteCaller {};
 
 template <typename HandlerType>
-struct StaticRouteMatchMaker<HandlerType, false> {
-  inline RouteMatch operator()(HandlerType& handler) {
-    return RouteMatch(
-        RouteMatchResult::RouteMatched,
-        std::function<folly::Future<HTTPResponse>(const HTTPRequest&)>(
-            [&handler](const HTTPRequest& request) mutable {
-              return handler(request);
-            }));
+struct StaticRouteCaller<HandlerType, false> {
+  inline RouteMatch match(BaseRoute* route, const RoutingContext&) {
+    return RouteMatch(RouteMatchResult::RouteMatched,
+                      RouteHandler(route, route_parsing::RouteCaptures()));
+  }
+
+  inline folly::Future<HTTPResponse> call(HandlerType& handler,
+                                          const HTTPRequest& request,
+                                          folly::Executor* executor) {
+    return to_response_future(handler(request), request, executor);
+  }
+
+  inline proxygen::RequestHandler* callStreaming(HandlerType&) {
+    DCHECK(false) << "Non-streaming routes do not create streaming handlers";
+    return nullptr;
   }
 };
 
 template <typename HandlerType>
-struct StaticRouteMatchMaker<HandlerType, true> {
-  inline RouteMatch operator()(HandlerType& handler) {
+struct StaticRouteCaller<HandlerType, true> {
+  inline RouteMatch match(BaseRoute* route, const RoutingContext& context) {
     return RouteMatch(
         RouteMatchResult::RouteMatched,
-        std::function<proxygen::RequestHandler*()>([&handler]() mutable {
-          decltype(handler()) ret = nullptr;
-          try {
-            ret = handler();
-            if (ret == nullptr) {
-              return ret;
-            }
-            ret->setRequestArgs();
-          } catch (const std::exception& e) {
-            // TODO: Logging
-            if (ret != nullptr) {
-              delete ret;
-            }
-            ret = nullptr;
-          }
-          return ret;
+        StreamingRouteHandler(route, route_parsing::RouteCaptures(),
+                              context.getPathBuffer()));
+  }
 
-        }));
+  inline folly::Future<HTTPResponse> call(HandlerType&,
+                                          const HTTPRequest&,
+                                          folly::Executor*) {
+    DCHECK(false) << "Streaming routes are not called with a request";
+    return HTTPResponse::future(500);
+  }
+
+  inline proxygen::RequestHandler* callStreaming(HandlerType& handler) {
+    decltype(handler()) ret = nullptr;
+    try {
+      ret = handler();
+      if (ret == nullptr) {
+        return ret;
+      }
+      ret->setRequestArgs();
+    } catch (const std::exception& e) {
+      // TODO: Logging
+      if (ret != nullptr) {
+        delete ret;
+      }
+      ret = nullptr;
+    }
+    return ret;
   }
 };
 }
@@ -54,15 +77,30 @@ StaticRoute<HandlerType, IsStreaming>::StaticRoute(
 
 template <typename HandlerType, bool IsStreaming>
 RouteMatch StaticRoute<HandlerType, IsStreaming>::handler(
-    const proxygen::HTTPMessage* request) {
-  DCHECK(request != nullptr);
-  auto methodAndPath = HTTPRequest::getMethodAndPath(request);
-  if (std::get<1>(methodAndPath) != originalPattern_) {
+    const RoutingContext& context) {
+  if (context.getPath() != originalPattern_) {
     return RouteMatch(RouteMatchResult::PathNotMatched);
   }
-  if (methods_.find(std::get<0>(methodAndPath)) == methods_.end()) {
+  if (methods_.find(context.getMethod()) == methods_.end()) {
     return RouteMatch(RouteMatchResult::MethodNotMatched);
   }
-  return StaticRouteMatchMaker<HandlerType, IsStreaming>{}(handler_);
+  return StaticRouteCaller<HandlerType, IsStreaming>{}.match(this, context);
+}
+
+template <typename HandlerType, bool IsStreaming>
+folly::Future<HTTPResponse> StaticRoute<HandlerType, IsStreaming>::call(
+    const HTTPRequest& request,
+    const route_parsing::RouteCaptures&,
+    folly::Executor* executor) {
+  return StaticRouteCaller<HandlerType, IsStreaming>{}.call(handler_, request,
+                                                            executor);
+}
+
+template <typename HandlerType, bool IsStreaming>
+proxygen::RequestHandler*
+StaticRoute<HandlerType, IsStreaming>::callStreaming(
+    folly::StringPiece,
+    const route_parsing::RouteCaptures&) {
+  return StaticRouteCaller<HandlerType, IsStreaming>{}.callStreaming(handler_);
 }
 }
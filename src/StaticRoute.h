@@ -4,6 +4,7 @@
 #include <unordered_set>
 
 #include "src/BaseRoute.h"
+#include "src/HandlerResult.h"
 #include "src/HTTPRequest.h"
 #include "src/HTTPResponse.h"
 
@@ -22,16 +23,32 @@ class StaticRoute : public BaseRoute {
               std::unordered_set<proxygen::HTTPMethod> methods,
               HandlerType handler);
 
-  virtual RouteMatch handler(const proxygen::HTTPMessage* request) override;
+  using BaseRoute::handler;
+  virtual RouteMatch handler(const RoutingContext& context) override;
+  virtual folly::Future<HTTPResponse> call(
+      const HTTPRequest& request,
+      const route_parsing::RouteCaptures& captures,
+      folly::Executor* executor) override;
+  virtual proxygen::RequestHandler* callStreaming(
+      folly::StringPiece path,
+      const route_parsing::RouteCaptures& captures) override;
 };
 
+/**
+ * Creates a non-streaming StaticRoute
+ *
+ * @param executionPolicy - Where the handler is run. See ExecutionPolicy
+ */
 template <typename HandlerType>
 inline std::unique_ptr<BaseRoute> make_static_route(
     std::string pattern,
     std::unordered_set<proxygen::HTTPMethod> methods,
-    HandlerType handler) {
-  return std::make_unique<StaticRoute<HandlerType, false>>(
+    HandlerType handler,
+    ExecutionPolicy executionPolicy = ExecutionPolicy()) {
+  auto route = std::make_unique<StaticRoute<HandlerType, false>>(
       std::move(pattern), std::move(methods), std::move(handler));
+  route->setExecutionPolicy(std::move(executionPolicy));
+  return route;
 }
 
 template <typename HandlerType>
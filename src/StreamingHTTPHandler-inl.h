@@ -11,7 +11,6 @@ void StreamingHTTPHandler<HandlerArgs...>::onRequest(
   if (evb_ == nullptr) {
     evb_ = folly::EventBaseManager::get()->getEventBase();
   }
-  responseBuilder_ = std::make_unique<proxygen::ResponseBuilder>(downstream_);
   onRequestReceived(HTTPRequest(std::move(headers), folly::IOBuf::create(0)));
 }
 
@@ -46,17 +45,16 @@ void StreamingHTTPHandler<HandlerArgs...>::sendResponseHeaders(
   sentHeaders_ = true;
   evb_->runInEventBaseThread(
       [ response = std::move(response), this ]() mutable {
-        responseBuilder_->status(response.getStatusCode(), "");
-        response.getHeaders().getHeaders().forEach(
-            [this](const auto& header, const auto& value) {
-              responseBuilder_->header(header, value);
-            });
-        auto body = response.getBody();
-        // ResponseBuilder API doesn't allow 0 length bodies
-        if (body->length() != 0) {
-          responseBuilder_->body(response.getBody());
-        }
-        responseBuilder_->send();
+        auto status = response.getStatusCode();
+        auto body = std::move(response).getBody();
+        auto message = std::move(response).getHeaders();
+        message.setHTTPVersion(1, 1);
+        chunked_ = status >= 200 && status != 204 && status != 304 &&
+                   !message.getHeaders().exists(
+                       proxygen::HTTPHeaderCode::HTTP_HEADER_CONTENT_LENGTH);
+        message.setIsChunked(chunked_);
+        downstream_->sendHeaders(message);
+        sendBodyPiece(std::move(body));
       });
 }
 
@@ -65,20 +63,38 @@ void StreamingHTTPHandler<HandlerArgs...>::sendBody(
     std::unique_ptr<folly::IOBuf> data) noexcept {
   DCHECK(evb_ != nullptr);
   DCHECK(sentHeaders_);
-  // ResponseBuilder API doesn't allow 0 length bodies
-  if (data->length() == 0) {
+  if (data == nullptr || data->empty()) {
     return;
   }
   evb_->runInEventBaseThread([ data = std::move(data), this ]() mutable {
-    responseBuilder_->body(std::move(data)).send();
+    sendBodyPiece(std::move(data));
   });
 }
 
+template <typename... HandlerArgs>
+void StreamingHTTPHandler<HandlerArgs...>::sendBodyPiece(
+    std::unique_ptr<folly::IOBuf> data) noexcept {
+  if (data == nullptr) {
+    return;
+  }
+  auto length = data->computeChainDataLength();
+  // A zero length chunk would end the body
+  if (length == 0) {
+    return;
+  }
+  if (chunked_) {
+    downstream_->sendChunkHeader(length);
+    downstream_->sendBody(std::move(data));
+    downstream_->sendChunkTerminator();
+  } else {
+    downstream_->sendBody(std::move(data));
+  }
+}
+
 template <typename... HandlerArgs>
 void StreamingHTTPHandler<HandlerArgs...>::sendEOF() noexcept {
   DCHECK(evb_ != nullptr);
   DCHECK(sentHeaders_);
-  evb_->runInEventBaseThread(
-      [this]() mutable { responseBuilder_->sendWithEOM(); });
+  evb_->runInEventBaseThread([this]() mutable { downstream_->sendEOM(); });
 }
 }
@@ -6,7 +6,6 @@
 #include <folly/io/IOBuf.h>
 #include <folly/io/async/EventBase.h>
 #include <proxygen/httpserver/RequestHandler.h>
-#include <proxygen/httpserver/ResponseBuilder.h>
 #include <proxygen/lib/http/HTTPMessage.h>
 
 #include "src/HTTPRequest.h"
@@ -25,8 +24,16 @@ template <typename... HandlerArgs>
 class StreamingHTTPHandler : public proxygen::RequestHandler {
  private:
   folly::EventBase* evb_ = nullptr;
-  std::unique_ptr<proxygen::ResponseBuilder> responseBuilder_;
   bool sentHeaders_ = false;  // TODO: Maybe need to lock around this
+  // Set if the response has no Content-Length, and its body is sent in
+  // chunks. Only used on evb_
+  bool chunked_ = false;
+
+  /**
+   * Sends a piece of the body on evb_, as a chunk if the response is
+   * chunked
+   */
+  void sendBodyPiece(std::unique_ptr<folly::IOBuf> data) noexcept;
 
  public:
   /**
@@ -72,7 +79,9 @@ class StreamingHTTPHandler : public proxygen::RequestHandler {
 
   /**
    * Should be called by the implementation class when response headers are
-   * ready
+   * ready. The response's message and body are handed to proxygen without
+   * being copied. Unless the response has a Content-Length header, its body
+   * is sent in chunks.
    * This needs to be called before sendBody()
    */
   void sendResponseHeaders(HTTPResponse response) noexcept;
@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+#include "src/AdmissionController.h"
+#include "src/Config.h"
+
+using namespace std;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+namespace nozomi {
+namespace test {
+
+TEST(AdmissionControllerTest, accept_all_admits_everything) {
+  AdmissionController admission{AdmissionConfig()};
+
+  for (size_t i = 0; i < 100; ++i) {
+    ASSERT_TRUE(admission.tryAcquire());
+  }
+  auto stats = admission.getStats();
+  ASSERT_EQ(100, stats.inFlight);
+  ASSERT_EQ(100, stats.admitted);
+  ASSERT_EQ(0, stats.rejected);
+}
+
+TEST(AdmissionControllerTest, concurrency_limit_sheds_until_released) {
+  AdmissionConfig config;
+  config.policy = AdmissionPolicy::ConcurrencyLimit;
+  config.maxConcurrency = 2;
+  AdmissionController admission(config);
+
+  ASSERT_TRUE(admission.tryAcquire());
+  ASSERT_TRUE(admission.tryAcquire());
+  ASSERT_FALSE(admission.tryAcquire());
+  admission.release(microseconds(10));
+  ASSERT_TRUE(admission.tryAcquire());
+
+  auto stats = admission.getStats();
+  ASSERT_EQ(2, stats.inFlight);
+  ASSERT_EQ(2, stats.limit);
+  ASSERT_EQ(3, stats.admitted);
+  ASSERT_EQ(1, stats.rejected);
+}
+
+TEST(AdmissionControllerTest, queue_delay_keeps_serving_what_is_in_flight) {
+  AdmissionConfig config;
+  config.policy = AdmissionPolicy::QueueDelay;
+  config.targetDelay = milliseconds(5);
+  config.interval = milliseconds(100);
+  AdmissionController admission(config);
+  auto now = steady_clock::now();
+
+  ASSERT_TRUE(admission.tryAcquire());
+  ASSERT_TRUE(admission.tryAcquire());
+  ASSERT_TRUE(admission.tryAcquire());
+  // Every request in the interval waited longer than the target
+  admission.onStart(milliseconds(20), now);
+  admission.onStart(milliseconds(30), now + milliseconds(50));
+  admission.onStart(milliseconds(10), now + milliseconds(101));
+  ASSERT_EQ(3, admission.getStats().limit);
+  ASSERT_FALSE(admission.tryAcquire());
+
+  // Moderate overload still admits as many as are in flight
+  admission.release(milliseconds(1));
+  ASSERT_TRUE(admission.tryAcquire());
+  ASSERT_EQ(3, admission.getStats().inFlight);
+}
+
+TEST(AdmissionControllerTest, queue_delay_cuts_back_while_the_queue_stays) {
+  AdmissionConfig config;
+  config.policy = AdmissionPolicy::QueueDelay;
+  config.targetDelay = milliseconds(5);
+  config.interval = milliseconds(100);
+  AdmissionController admission(config);
+  auto now = steady_clock::now();
+
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE(admission.tryAcquire());
+  }
+  admission.onStart(milliseconds(20), now);
+  admission.onStart(milliseconds(10), now + milliseconds(101));
+  ASSERT_EQ(4, admission.getStats().limit);
+
+  // The queue didn't drain, so a quarter fewer are admitted
+  admission.onStart(milliseconds(10), now + milliseconds(150));
+  admission.onStart(milliseconds(10), now + milliseconds(202));
+  ASSERT_EQ(3, admission.getStats().limit);
+  ASSERT_FALSE(admission.tryAcquire());
+  admission.release(milliseconds(1));
+  admission.release(milliseconds(1));
+  ASSERT_TRUE(admission.tryAcquire());
+  ASSERT_FALSE(admission.tryAcquire());
+
+  // Once the queue drains, the limit is lifted
+  admission.onStart(milliseconds(1), now + milliseconds(250));
+  admission.onStart(milliseconds(1), now + milliseconds(303));
+  ASSERT_EQ(0, admission.getStats().limit);
+  ASSERT_TRUE(admission.tryAcquire());
+  ASSERT_TRUE(admission.tryAcquire());
+}
+
+TEST(AdmissionControllerTest, aimd_limit_grows_and_backs_off) {
+  AdmissionConfig config;
+  config.policy = AdmissionPolicy::AIMD;
+  config.minConcurrency = 2;
+  config.maxConcurrency = 4;
+  config.targetLatency = milliseconds(100);
+  config.backoffRatio = 0.5;
+  AdmissionController admission(config);
+
+  ASSERT_EQ(2, admission.getStats().limit);
+  ASSERT_TRUE(admission.tryAcquire());
+  ASSERT_TRUE(admission.tryAcquire());
+  ASSERT_FALSE(admission.tryAcquire());
+
+  // Roughly one more request per limit's worth of fast responses
+  admission.release(milliseconds(10));
+  admission.release(milliseconds(10));
+  ASSERT_TRUE(admission.tryAcquire());
+  admission.release(milliseconds(10));
+  ASSERT_EQ(3, admission.getStats().limit);
+
+  for (size_t i = 0; i < 20; ++i) {
+    ASSERT_TRUE(admission.tryAcquire());
+    admission.release(milliseconds(10));
+  }
+  ASSERT_EQ(4, admission.getStats().limit);
+
+  ASSERT_TRUE(admission.tryAcquire());
+  admission.release(milliseconds(500));
+  ASSERT_EQ(2, admission.getStats().limit);
+}
+}
+}
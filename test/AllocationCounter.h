@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+
+namespace nozomi {
+namespace test {
+
+/**
+ * Returns the number of times that operator new has been called by this
+ * process. Linking AllocationCounter replaces the global operator new and
+ * operator delete so that they can be counted, so tests and benchmarks can
+ * check how many allocations a request takes
+ */
+size_t allocation_count();
+}
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/regex.hpp>
+#include <folly/Optional.h>
+
+#include "src/CombinedRouteRegex.h"
+
+using namespace std;
+using boost::basic_regex;
+using folly::Optional;
+
+namespace nozomi {
+namespace test {
+
+Optional<size_t> matchIndex(const CombinedRouteRegex& combined,
+                            const string& path) {
+  boost::smatch matches;
+  return combined.match(path, matches);
+}
+
+TEST(CombinedRouteRegexTest, returns_first_matching_regex) {
+  basic_regex<char> re1(R"(/user/\d+)", boost::regex::perl);
+  basic_regex<char> re2(R"(/user/(\w+))", boost::regex::perl);
+  basic_regex<char> re3(R"(/user/.*)", boost::regex::perl);
+  CombinedRouteRegex combined({&re1, &re2, &re3});
+
+  ASSERT_EQ(3, combined.size());
+  ASSERT_EQ(Optional<size_t>(0), matchIndex(combined, "/user/1"));
+  ASSERT_EQ(Optional<size_t>(1), matchIndex(combined, "/user/me"));
+  ASSERT_EQ(Optional<size_t>(2), matchIndex(combined, "/user/me/posts"));
+  ASSERT_EQ(Optional<size_t>(), matchIndex(combined, "/users"));
+}
+
+TEST(CombinedRouteRegexTest, only_matches_whole_paths) {
+  basic_regex<char> re1(R"(/a)", boost::regex::perl);
+  basic_regex<char> re2(R"(/a/\d+)", boost::regex::perl);
+  CombinedRouteRegex combined({&re1, &re2});
+
+  ASSERT_EQ(Optional<size_t>(1), matchIndex(combined, "/a/1"));
+  ASSERT_EQ(Optional<size_t>(), matchIndex(combined, "/a/1/"));
+}
+
+TEST(CombinedRouteRegexTest, named_groups_refer_to_the_matching_regex) {
+  basic_regex<char> re1(R"(/a/(?<__0>\d+)x)", boost::regex::perl);
+  basic_regex<char> re2(R"(/a/(?<__0>\d+)?/(?<__1>\w+))", boost::regex::perl);
+  CombinedRouteRegex combined({&re1, &re2});
+  string path1 = "/a/12x";
+  string path2 = "/a/12/y";
+  string path3 = "/a//y";
+  boost::smatch matches1;
+  boost::smatch matches2;
+  boost::smatch matches3;
+
+  ASSERT_EQ(Optional<size_t>(0), combined.match(path1, matches1));
+  ASSERT_EQ(Optional<size_t>(1), combined.match(path2, matches2));
+  ASSERT_EQ(Optional<size_t>(1), combined.match(path3, matches3));
+
+  ASSERT_EQ("12", matches1["__0"].str());
+  ASSERT_EQ("12", matches2["__0"].str());
+  ASSERT_EQ("y", matches2["__1"].str());
+  ASSERT_FALSE(matches3["__0"].matched);
+  ASSERT_EQ("y", matches3["__1"].str());
+}
+
+TEST(CombinedRouteRegexTest, empty_list_matches_nothing) {
+  CombinedRouteRegex combined({});
+
+  ASSERT_EQ(0, combined.size());
+  ASSERT_EQ(Optional<size_t>(), matchIndex(combined, ""));
+  ASSERT_EQ(Optional<size_t>(), matchIndex(combined, "/"));
+}
+
+TEST(CombinedRouteRegexTest, throws_on_backreferences) {
+  basic_regex<char> re1(R"(/(\w)\1)", boost::regex::perl);
+  basic_regex<char> re2(R"(/(?<x>\w)\k<x>)", boost::regex::perl);
+  basic_regex<char> re3(R"(/\\1)", boost::regex::perl);
+
+  ASSERT_THROW(CombinedRouteRegex({&re1}), invalid_argument);
+  ASSERT_THROW(CombinedRouteRegex({&re2}), invalid_argument);
+  CombinedRouteRegex combined({&re3});
+  ASSERT_EQ(Optional<size_t>(0), matchIndex(combined, "/\\1"));
+}
+
+TEST(CombinedRouteRegexTest, throws_on_recursion_and_subroutine_calls) {
+  for (auto pattern : {R"(/(a|b(?1)))", R"(/(a)(?+1)(b))", R"(/(a)(?-1))",
+                       R"(/(a|b(?R)))", R"(/(?<x>a)(?&x))",
+                       R"(/(?<x>a)(?P>x))", R"(/(a)?(?(1)b|c))",
+                       R"(/(?<x>a)?(?(<x>)b|c))"}) {
+    basic_regex<char> re(pattern, boost::regex::perl);
+    ASSERT_THROW(CombinedRouteRegex({&re}), invalid_argument) << pattern;
+  }
+
+  // Flags, non capturing groups and literal parentheses are fine
+  basic_regex<char> re1(R"(/(?i)a(?-i:b))", boost::regex::perl);
+  basic_regex<char> re2(R"(/[(?1)]\(\?R\))", boost::regex::perl);
+  CombinedRouteRegex combined({&re1, &re2});
+  ASSERT_EQ(Optional<size_t>(0), matchIndex(combined, "/Ab"));
+  ASSERT_EQ(Optional<size_t>(1), matchIndex(combined, "/?(?R)"));
+}
+}
+}
@@ -116,6 +116,112 @@ TEST(ConfigTest, zero_timeout_throws) {
       "Timeout (0) must be greater than zero milliseconds");
 }
 
+TEST(ConfigTest, invalid_executor_pools_throw) {
+  auto make_config = [](vector<ExecutorPoolConfig> pools) {
+    Config c({make_tuple("::1", 1234, Config::Protocol::HTTP)}, 1,
+             Optional<string>(), std::chrono::milliseconds(45),
+             Config::kDefaultFileReaderBufferSize, std::move(pools));
+  };
+
+  ASSERT_THROW_MSG(make_config({{"", 1, 1}}), std::invalid_argument,
+                   "Executor pool names must not be empty");
+  ASSERT_THROW_MSG(make_config({{"disk", 1, 1}, {"disk", 2, 2}}),
+                   std::invalid_argument,
+                   "Executor pool disk was declared twice");
+  ASSERT_THROW_MSG(make_config({{"disk", 0, 1}}), std::invalid_argument,
+                   "Executor pool disk must have more than zero threads");
+  ASSERT_THROW_MSG(
+      make_config({{"disk", 1, 0}}), std::invalid_argument,
+      "Executor pool disk must have a queue size greater than zero");
+}
+
+TEST(ConfigTest, executor_pools_are_kept) {
+  Config c({make_tuple("::1", 1234, Config::Protocol::HTTP)}, 1,
+           Optional<string>(), std::chrono::milliseconds(45),
+           Config::kDefaultFileReaderBufferSize,
+           {{"disk", 4, 100}, {"reports", 1, 10}});
+
+  ASSERT_EQ(2, c.getExecutorPools().size());
+  ASSERT_EQ("disk", c.getExecutorPools()[0].name);
+  ASSERT_EQ(4, c.getExecutorPools()[0].threads);
+  ASSERT_EQ(100, c.getExecutorPools()[0].maxQueueSize);
+  ASSERT_EQ("reports", c.getExecutorPools()[1].name);
+}
+
+TEST(ConfigTest, invalid_admission_throws) {
+  auto make_config = [](AdmissionConfig admission) {
+    Config c({make_tuple("::1", 1234, Config::Protocol::HTTP)}, 1,
+             Optional<string>(), std::chrono::milliseconds(45),
+             Config::kDefaultFileReaderBufferSize, {}, admission);
+  };
+  AdmissionConfig admission;
+
+  admission.maxConcurrency = 0;
+  ASSERT_THROW_MSG(
+      make_config(admission), std::invalid_argument,
+      "The maximum admission concurrency must be greater than zero");
+
+  admission.policy = AdmissionPolicy::AIMD;
+  admission.minConcurrency = 20;
+  admission.maxConcurrency = 10;
+  ASSERT_THROW_MSG(make_config(admission), std::invalid_argument,
+                   "The minimum admission concurrency (20) must be between "
+                   "1 and the maximum (10)");
+
+  admission.minConcurrency = 1;
+  admission.interval = std::chrono::milliseconds(0);
+  ASSERT_THROW_MSG(make_config(admission), std::invalid_argument,
+                   "Admission delays and intervals must be greater than zero");
+
+  admission.interval = std::chrono::milliseconds(100);
+  admission.backoffRatio = 1;
+  ASSERT_THROW_MSG(make_config(admission), std::invalid_argument,
+                   "Admission backoff ratio (1) must be between 0 and 1");
+}
+
+TEST(ConfigTest, zero_max_body_size_throws) {
+  ASSERT_THROW_MSG(
+      Config({make_tuple("::1", 1234, Config::Protocol::HTTP)}, 1,
+             Optional<string>(), std::chrono::milliseconds(45),
+             Config::kDefaultFileReaderBufferSize, {}, AdmissionConfig(), 0),
+      std::invalid_argument,
+      "Maximum body size must be greater than zero bytes");
+}
+
+TEST(ConfigTest, invalid_arena_block_size_throws) {
+  ASSERT_THROW_MSG(
+      Config({make_tuple("::1", 1234, Config::Protocol::HTTP)}, 1,
+             Optional<string>(), std::chrono::milliseconds(45),
+             Config::kDefaultFileReaderBufferSize, {}, AdmissionConfig(),
+             Config::kDefaultMaxBodySize, 32),
+      std::invalid_argument,
+      "The arena block size (32) must be between 64 bytes and 64MB");
+}
+
+TEST(ConfigTest, max_pooled_handlers_is_kept) {
+  Config c({make_tuple("::1", 1234, Config::Protocol::HTTP)}, 1,
+           Optional<string>(), std::chrono::milliseconds(45),
+           Config::kDefaultFileReaderBufferSize, {}, AdmissionConfig(),
+           Config::kDefaultMaxBodySize, Config::kDefaultArenaBlockSize, 16);
+  Config defaults({make_tuple("::1", 1234, Config::Protocol::HTTP)}, 1);
+
+  ASSERT_EQ(16, c.getMaxPooledHandlers());
+  ASSERT_EQ(Config::kDefaultMaxPooledHandlers,
+            defaults.getMaxPooledHandlers());
+}
+
+TEST(ConfigTest, admission_is_kept) {
+  AdmissionConfig admission;
+  admission.policy = AdmissionPolicy::ConcurrencyLimit;
+  admission.maxConcurrency = 4;
+  Config c({make_tuple("::1", 1234, Config::Protocol::HTTP)}, 1,
+           Optional<string>(), std::chrono::milliseconds(45),
+           Config::kDefaultFileReaderBufferSize, {}, admission);
+
+  ASSERT_EQ(AdmissionPolicy::ConcurrencyLimit, c.getAdmission().policy);
+  ASSERT_EQ(4, c.getAdmission().maxConcurrency);
+}
+
 TEST(ConfigTest, public_dir_doesnt_exist_throws_error) {
   TempDir tempDir;
   auto publicDir = (tempDir.tempDir / "invalid").string();
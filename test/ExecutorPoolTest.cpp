@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <future>
+#include <string>
+
+#include "src/Config.h"
+#include "src/ExecutorPool.h"
+
+using namespace std;
+
+namespace nozomi {
+namespace test {
+
+TEST(ExecutorPoolTest, runs_functions_on_the_pool) {
+  ExecutorPool pool({"test", 2, 10});
+  promise<thread::id> ran;
+
+  ASSERT_TRUE(pool.tryAdd([&ran]() { ran.set_value(this_thread::get_id()); }));
+
+  ASSERT_NE(this_thread::get_id(), ran.get_future().get());
+}
+
+TEST(ExecutorPoolTest, rejects_functions_when_queue_is_full) {
+  ExecutorPool pool({"test", 1, 2});
+  promise<void> release;
+  auto released = release.get_future().share();
+  promise<void> running;
+
+  // Occupies the only thread, so the following functions wait in the queue
+  ASSERT_TRUE(pool.tryAdd([&running, released]() {
+    running.set_value();
+    released.wait();
+  }));
+  running.get_future().wait();
+  ASSERT_TRUE(pool.tryAdd([]() {}));
+  ASSERT_TRUE(pool.tryAdd([]() {}));
+  ASSERT_FALSE(pool.tryAdd([]() {}));
+
+  auto stats = pool.getStats();
+  ASSERT_EQ(2, stats.queueDepth);
+  ASSERT_EQ(1, stats.started);
+  ASSERT_EQ(1, stats.rejected);
+
+  release.set_value();
+  promise<void> drained;
+  while (!pool.tryAdd([&drained]() { drained.set_value(); })) {
+  }
+  drained.get_future().wait();
+
+  stats = pool.getStats();
+  ASSERT_EQ(0, stats.queueDepth);
+  ASSERT_EQ(4, stats.started);
+  ASSERT_LE(stats.maxWaitTime, stats.totalWaitTime);
+}
+
+TEST(ExecutorPoolTest, continuations_are_queued_when_queue_is_full) {
+  ExecutorPool pool({"test", 1, 1});
+  promise<void> release;
+  auto released = release.get_future().share();
+  promise<void> running;
+
+  ASSERT_TRUE(pool.tryAdd([&running, released]() {
+    running.set_value();
+    released.wait();
+  }));
+  running.get_future().wait();
+  ASSERT_TRUE(pool.tryAdd([]() {}));
+  ASSERT_FALSE(pool.tryAdd([]() {}));
+  promise<void> continued;
+  pool.add([&continued]() { continued.set_value(); });
+
+  auto stats = pool.getStats();
+  ASSERT_EQ(1, stats.queueDepth);
+  ASSERT_EQ(1, stats.rejected);
+  release.set_value();
+  continued.get_future().wait();
+  ASSERT_EQ(2, pool.getStats().started);
+}
+
+TEST(ExecutorPoolTest, pools_are_found_by_name) {
+  ExecutorPools pools({{"disk", 1, 1}, {"reports", 1, 1}});
+
+  ASSERT_NE(nullptr, pools.get("disk"));
+  ASSERT_EQ("disk", pools.get("disk")->getName());
+  ASSERT_EQ("reports", pools.get("reports")->getName());
+  ASSERT_EQ(nullptr, pools.get("missing"));
+  ASSERT_EQ(2, pools.getStats().size());
+  ASSERT_EQ(0, pools.getStats().at("disk").started);
+}
+}
+}
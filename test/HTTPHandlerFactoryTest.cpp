@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 
 #include <chrono>
+#include <memory>
+#include <string>
 
 #include <folly/io/async/EventBase.h>
 #include <proxygen/httpserver/HTTPServer.h>
@@ -13,6 +15,7 @@
 #include "src/Route.h"
 #include "src/Router.h"
 #include "src/StaticRoute.h"
+#include "test/AllocationCounter.h"
 #include "test/Common.h"
 
 using namespace std;
@@ -25,12 +28,33 @@ namespace test {
 struct CustomHandler : public proxygen::RequestHandler {
   std::chrono::milliseconds timeout;
   Router* router;
-  std::function<folly::Future<HTTPResponse>(const HTTPRequest&)> handler;
-  CustomHandler(
-      std::chrono::milliseconds timeout,
-      Router* router,
-      std::function<folly::Future<HTTPResponse>(const HTTPRequest&)> handler)
-      : timeout(timeout), router(router), handler(std::move(handler)) {}
+  RouteHandler handler;
+  proxygen::HTTPMethod method;
+  std::shared_ptr<const std::string> path;
+  ExecutorPools* executorPools;
+  AdmissionController* admission;
+  size_t maxBodySize;
+  size_t arenaBlockSize;
+  CustomHandler(std::chrono::milliseconds timeout,
+                Router* router,
+                RouteHandler handler,
+                proxygen::HTTPMethod method,
+                std::shared_ptr<const std::string> path,
+                folly::EventBase* responseEvb,
+                folly::Executor* ioExecutor,
+                ExecutorPools* executorPools,
+                AdmissionController* admission,
+                size_t maxBodySize,
+                size_t arenaBlockSize)
+      : timeout(timeout),
+        router(router),
+        handler(std::move(handler)),
+        method(method),
+        path(std::move(path)),
+        executorPools(executorPools),
+        admission(admission),
+        maxBodySize(maxBodySize),
+        arenaBlockSize(arenaBlockSize) {}
   virtual void onRequest(
       std::unique_ptr<proxygen::HTTPMessage> headers) noexcept override {}
   virtual void onBody(std::unique_ptr<folly::IOBuf> body) noexcept override {}
@@ -39,19 +63,23 @@ struct CustomHandler : public proxygen::RequestHandler {
   virtual void requestComplete() noexcept override {}
   virtual void onError(proxygen::ProxygenError err) noexcept override {}
 
-  virtual ~CustomHandler() noexcept {}
+  virtual ~CustomHandler() noexcept {
+    if (admission != nullptr) {
+      admission->release(std::chrono::microseconds(0));
+    }
+  }
 };
 
 TEST(HTTPHandlerFactoryTest, returns_nonstreaming_handler) {
   EventBase evb;
   auto router = make_router(
-      {}, make_static_route("/", {HTTPMethod::GET}, [](const auto&) {
+      {}, make_static_route("/test", {HTTPMethod::POST}, [](const auto&) {
         return HTTPResponse::future(200, "Sample string");
       }));
   Config c({make_tuple("::1", 8080, HTTPServer::Protocol::HTTP)}, 1,
            Optional<string>(), std::chrono::milliseconds(10000));
   HTTPHandlerFactory<CustomHandler> factory(std::move(c), std::move(router));
-  auto request = make_request("/");
+  auto request = make_request("/%74est", HTTPMethod::POST);
   auto rawRequest = request.getRawRequest();
 
   factory.onServerStart(&evb);
@@ -64,9 +92,127 @@ TEST(HTTPHandlerFactoryTest, returns_nonstreaming_handler) {
   ASSERT_TRUE(handler != nullptr);
   ASSERT_EQ(std::chrono::milliseconds(10000), castPtr->timeout);
   ASSERT_NE(nullptr, castPtr->router);
+  ASSERT_EQ(HTTPMethod::POST, castPtr->method);
+  ASSERT_EQ("/test", *castPtr->path);
+  ASSERT_NE(nullptr, castPtr->executorPools);
+  ASSERT_NE(nullptr, castPtr->admission);
+  ASSERT_EQ(Config::kDefaultMaxBodySize, castPtr->maxBodySize);
+  ASSERT_EQ(Config::kDefaultArenaBlockSize, castPtr->arenaBlockSize);
   ASSERT_EQ("Sample string", response.getBodyString());
 }
 
+TEST(HTTPHandlerFactoryTest, routes_override_the_max_body_size) {
+  EventBase evb;
+  auto route =
+      make_static_route("/test", {HTTPMethod::POST}, [](const auto&) {
+        return HTTPResponse::future(200, "Sample string");
+      });
+  route->setMaxBodySize(10);
+  auto router = make_router({}, std::move(route));
+  Config c({make_tuple("::1", 8080, HTTPServer::Protocol::HTTP)}, 1,
+           Optional<string>(), std::chrono::milliseconds(10000));
+  HTTPHandlerFactory<CustomHandler> factory(std::move(c), std::move(router));
+  auto request = make_request("/test", HTTPMethod::POST);
+  auto rawRequest = request.getRawRequest();
+
+  factory.onServerStart(&evb);
+  unique_ptr<RequestHandler> handler(factory.onRequest(nullptr, &rawRequest));
+
+  ASSERT_EQ(10, static_cast<CustomHandler*>(handler.get())->maxBodySize);
+}
+
+TEST(HTTPHandlerFactoryTest, too_large_requests_are_not_told_to_continue) {
+  EventBase evb;
+  auto route =
+      make_static_route("/test", {HTTPMethod::POST}, [](const auto&) {
+        return HTTPResponse::future(200, "Sample string");
+      });
+  route->setMaxBodySize(10);
+  auto router = make_router({}, std::move(route));
+  Config c({make_tuple("::1", 8080, HTTPServer::Protocol::HTTP)}, 1,
+           Optional<string>(), std::chrono::milliseconds(10000));
+  HTTPHandlerFactory<CustomHandler> factory(std::move(c), std::move(router));
+  auto request = make_request("/test", HTTPMethod::POST);
+  auto largeRequest = request.getRawRequest();
+  largeRequest.getHeaders().set("Content-Length", "11");
+  largeRequest.getHeaders().set("Expect", "100-continue");
+  auto smallRequest = request.getRawRequest();
+  smallRequest.getHeaders().set("Content-Length", "10");
+  smallRequest.getHeaders().set("Expect", "100-continue");
+
+  factory.onServerStart(&evb);
+  // proxygen's RequestHandlerAdaptor sees these messages after the factory,
+  // and only sends a 100 Continue for those that still expect one
+  unique_ptr<RequestHandler> large(factory.onRequest(nullptr, &largeRequest));
+  unique_ptr<RequestHandler> small(factory.onRequest(nullptr, &smallRequest));
+
+  ASSERT_FALSE(largeRequest.getHeaders().exists("Expect"));
+  ASSERT_EQ("100-continue",
+            smallRequest.getHeaders().getSingleOrEmpty("Expect"));
+}
+
+TEST(HTTPHandlerFactoryTest, routes_override_the_request_timeout) {
+  EventBase evb;
+  auto route =
+      make_static_route("/test", {HTTPMethod::POST}, [](const auto&) {
+        return HTTPResponse::future(200, "Sample string");
+      });
+  route->setTimeout(std::chrono::milliseconds(250));
+  auto router = make_router(
+      {}, std::move(route),
+      make_static_route("/default", {HTTPMethod::POST}, [](const auto&) {
+        return HTTPResponse::future(200, "Sample string");
+      }));
+  Config c({make_tuple("::1", 8080, HTTPServer::Protocol::HTTP)}, 1,
+           Optional<string>(), std::chrono::milliseconds(10000));
+  HTTPHandlerFactory<CustomHandler> factory(std::move(c), std::move(router));
+  auto request = make_request("/test", HTTPMethod::POST);
+  auto rawRequest = request.getRawRequest();
+  auto defaultRequest = make_request("/default", HTTPMethod::POST);
+  auto rawDefaultRequest = defaultRequest.getRawRequest();
+
+  factory.onServerStart(&evb);
+  unique_ptr<RequestHandler> handler(factory.onRequest(nullptr, &rawRequest));
+  unique_ptr<RequestHandler> defaultHandler(
+      factory.onRequest(nullptr, &rawDefaultRequest));
+
+  ASSERT_EQ(std::chrono::milliseconds(250),
+            static_cast<CustomHandler*>(handler.get())->timeout);
+  ASSERT_EQ(std::chrono::milliseconds(10000),
+            static_cast<CustomHandler*>(defaultHandler.get())->timeout);
+}
+
+TEST(HTTPHandlerFactoryTest, sheds_requests_over_the_admission_limit) {
+  EventBase evb;
+  auto router = make_router(
+      {}, make_static_route("/test", {HTTPMethod::GET}, [](const auto&) {
+        return HTTPResponse::future(200, "Sample string");
+      }));
+  AdmissionConfig admissionConfig;
+  admissionConfig.policy = AdmissionPolicy::ConcurrencyLimit;
+  admissionConfig.maxConcurrency = 1;
+  auto admission = std::make_shared<AdmissionController>(admissionConfig);
+  Config c({make_tuple("::1", 8080, HTTPServer::Protocol::HTTP)}, 1,
+           Optional<string>(), std::chrono::milliseconds(10000));
+  HTTPHandlerFactory<CustomHandler> factory(std::move(c), std::move(router),
+                                            nullptr, admission);
+  auto request = make_request("/test");
+  auto rawRequest = request.getRawRequest();
+  factory.onServerStart(&evb);
+
+  unique_ptr<RequestHandler> admitted(factory.onRequest(nullptr, &rawRequest));
+  unique_ptr<RequestHandler> rejected(factory.onRequest(nullptr, &rawRequest));
+
+  ASSERT_NE(nullptr, dynamic_cast<CustomHandler*>(admitted.get()));
+  ASSERT_NE(nullptr, dynamic_cast<RejectedRequestHandler*>(rejected.get()));
+  ASSERT_EQ(1, admission->getStats().rejected);
+
+  admitted.reset();
+  unique_ptr<RequestHandler> readmitted(
+      factory.onRequest(nullptr, &rawRequest));
+  ASSERT_NE(nullptr, dynamic_cast<CustomHandler*>(readmitted.get()));
+}
+
 TEST(HTTPHandlerFactoryTest, returns_streaming_handler) {
   EventBase evb;
   TestStreamingHandler<> streamingHandler(&evb);
@@ -86,5 +232,54 @@ TEST(HTTPHandlerFactoryTest, returns_streaming_handler) {
 
   ASSERT_EQ(&streamingHandler, handlerPtr);
 }
+
+TEST(HTTPHandlerFactoryTest, routing_to_a_pooled_handler_does_not_allocate) {
+  EventBase evb;
+  size_t handlerAllocations = 0;
+  auto handler = [&handlerAllocations](const HTTPRequest&, int64_t,
+                                       StringPiece) {
+    handlerAllocations = allocation_count();
+    return HTTPResponse::future(200);
+  };
+  auto router = make_router(
+      {},
+      make_static_route("/static", {HTTPMethod::GET},
+                        [&handlerAllocations](const auto&) {
+                          handlerAllocations = allocation_count();
+                          return HTTPResponse::future(200);
+                        },
+                        ExecutionMode::Inline),
+      make_route("/user/{{i}}/{{s:[^/]+}}", {HTTPMethod::GET}, handler,
+                 ExecutionMode::Inline));
+  Config c({make_tuple("::1", 8080, HTTPServer::Protocol::HTTP)}, 1,
+           Optional<string>(), std::chrono::milliseconds(10000));
+  HTTPHandlerFactory<> factory(std::move(c), std::move(router));
+  factory.onServerStart(&evb);
+  TestResponseHandler responseHandler(nullptr);
+
+  auto run = [&](const string& path) {
+    auto message = std::make_unique<HTTPMessage>();
+    message->setMethod(HTTPMethod::GET);
+    message->setURL(path);
+    handlerAllocations = 0;
+
+    // Everything from proxygen asking for a handler, to the route's handler
+    // being called
+    auto before = allocation_count();
+    auto* requestHandler = factory.onRequest(nullptr, message.get());
+    requestHandler->setResponseHandler(&responseHandler);
+    requestHandler->onRequest(std::move(message));
+    requestHandler->onEOM();
+    requestHandler->requestComplete();
+    return handlerAllocations - before;
+  };
+
+  for (string path : {"/static", "/user/1/name"}) {
+    // The first request fills the thread's handler pool and path buffers
+    run(path);
+    ASSERT_EQ(0, run(path)) << path;
+  }
+  ASSERT_EQ(4, responseHandler.messages.size());
+}
 }
 }
@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <folly/Format.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/EventBase.h>
+#include <proxygen/lib/http/HTTPMessage.h>
+
+#include "src/HTTPHandler.h"
+#include "src/HTTPHandlerPool.h"
+#include "src/StaticRoute.h"
+#include "test/Common.h"
+
+using namespace std;
+using namespace proxygen;
+
+namespace nozomi {
+namespace test {
+
+struct HTTPHandlerPoolTest : public ::testing::Test {
+  folly::EventBase evb;
+  // The capacity of the buffer that the last request's body was read into
+  size_t bodyCapacity = 0;
+  std::unique_ptr<BaseRoute> route;
+  Router router;
+
+  HTTPHandlerPoolTest()
+      : route(make_static_route(
+            "/", {HTTPMethod::GET},
+            [this](const HTTPRequest& request) {
+              bodyCapacity = request.getBodyAsBytes()->capacity();
+              return HTTPResponse::future(200, request.getBodyAsString());
+            },
+            ExecutionMode::Inline)),
+        router(make_router({})) {}
+
+  HTTPHandler* acquire(HTTPHandlerPool& pool) {
+    return pool.acquire(
+        std::chrono::milliseconds(50), &router,
+        RouteHandler(route.get(), route_parsing::RouteCaptures()),
+        HTTPMethod::GET, std::make_shared<const string>("/"), &evb, &evb,
+        nullptr, nullptr, 64 * 1024, RequestArena::kDefaultBlockSize);
+  }
+
+  /**
+   * Sends a request with a body through handler, and completes it
+   */
+  int run(HTTPHandler* handler, const string& body) {
+    TestResponseHandler responseHandler(handler);
+    handler->setResponseHandler(&responseHandler);
+    auto message = std::make_unique<HTTPMessage>();
+    message->setMethod(HTTPMethod::GET);
+    message->setURL("/");
+    message->getHeaders().set("Content-Length",
+                              folly::sformat("{}", body.size()));
+
+    handler->onRequest(std::move(message));
+    handler->onBody(folly::IOBuf::copyBuffer(body));
+    handler->onEOM();
+    evb.loop();
+    handler->requestComplete();
+
+    EXPECT_EQ(body, to_string(responseHandler.bodies.at(0)));
+    return responseHandler.messages.at(0).getStatusCode();
+  }
+};
+
+TEST_F(HTTPHandlerPoolTest, reuses_finished_handlers) {
+  HTTPHandlerPools pools(4);
+  auto& pool = pools.local();
+
+  auto* first = acquire(pool);
+  ASSERT_EQ(200, run(first, "first body"));
+  ASSERT_EQ(1, pool.getStats().pooled);
+
+  auto* second = acquire(pool);
+  ASSERT_EQ(first, second);
+  ASSERT_EQ(200, run(second, "second"));
+
+  auto stats = pool.getStats();
+  ASSERT_EQ(1, stats.pooled);
+  ASSERT_EQ(1, stats.created);
+  ASSERT_EQ(1, stats.reused);
+  ASSERT_EQ(0, stats.dropped);
+}
+
+TEST_F(HTTPHandlerPoolTest, keeps_only_small_body_buffers) {
+  HTTPHandlerPools pools(4);
+  auto& pool = pools.local();
+  string small(4 * 1024, 'a');
+  string large(HTTPHandler::kMaxPooledBodySize + 1, 'a');
+
+  auto* handler = acquire(pool);
+  run(handler, small);
+  handler = acquire(pool);
+  run(handler, "body");
+  ASSERT_GE(bodyCapacity, small.size());
+
+  handler = acquire(pool);
+  run(handler, large);
+  handler = acquire(pool);
+  run(handler, "body");
+  ASSERT_LT(bodyCapacity, HTTPHandler::kMaxPooledBodySize);
+}
+
+TEST_F(HTTPHandlerPoolTest, drops_handlers_when_full) {
+  HTTPHandlerPools pools(1);
+  auto& pool = pools.local();
+
+  auto* first = acquire(pool);
+  auto* second = acquire(pool);
+  run(first, "first");
+  run(second, "second");
+
+  auto stats = pool.getStats();
+  ASSERT_EQ(1, stats.pooled);
+  ASSERT_EQ(2, stats.created);
+  ASSERT_EQ(1, stats.dropped);
+}
+
+TEST_F(HTTPHandlerPoolTest, each_thread_has_its_own_pool) {
+  HTTPHandlerPools pools(4);
+  auto* mainPool = &pools.local();
+  HTTPHandlerPool* otherPool = nullptr;
+
+  std::thread([&pools, &otherPool]() { otherPool = &pools.local(); }).join();
+
+  ASSERT_EQ(mainPool, &pools.local());
+  ASSERT_NE(mainPool, otherPool);
+  ASSERT_EQ(2, pools.getStats().size());
+}
+
+TEST_F(HTTPHandlerPoolTest, threads_keep_a_pool_for_each_owner) {
+  HTTPHandlerPools first(4);
+  HTTPHandlerPools second(4);
+  auto* firstPool = &first.local();
+  auto* secondPool = &second.local();
+
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_EQ(firstPool, &first.local());
+    ASSERT_EQ(secondPool, &second.local());
+  }
+  ASSERT_NE(firstPool, secondPool);
+  ASSERT_EQ(1, first.getStats().size());
+  ASSERT_EQ(1, second.getStats().size());
+}
+
+TEST_F(HTTPHandlerPoolTest, handlers_outlive_the_pools_owner) {
+  auto pools = std::make_unique<HTTPHandlerPools>(4);
+  auto* handler = acquire(pools->local());
+  pools.reset();
+
+  // The handler keeps its pool alive, and is deleted when it finishes
+  ASSERT_EQ(200, run(handler, "body"));
+}
+}
+}
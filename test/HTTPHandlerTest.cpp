@@ -1,15 +1,25 @@
 #include <gtest/gtest.h>
 
 #include <chrono>
+#include <future>
 #include <string>
 #include <thread>
 #include <unordered_map>
 #include <vector>
 
+#include <folly/Portability.h>
+#include <folly/futures/Promise.h>
 #include <folly/io/IOBuf.h>
 #include <folly/io/async/EventBase.h>
 #include <proxygen/lib/http/HTTPMessage.h>
 
+#if FOLLY_HAS_COROUTINES
+#include <folly/experimental/coro/CurrentExecutor.h>
+#include <folly/experimental/coro/Task.h>
+#endif
+
+#include "src/AdmissionController.h"
+#include "src/ExecutorPool.h"
 #include "src/HTTPHandler.h"
 #include "src/HTTPRequest.h"
 #include "src/HTTPResponse.h"
@@ -101,6 +111,94 @@ TEST_F(HTTPHandlerTest, sends_response) {
   ASSERT_EQ("Body goes here", to_string(responseHandler.bodies[0]));
 }
 
+TEST_F(HTTPHandlerTest, sends_413_from_content_length) {
+  bool called = false;
+  HTTPHandler limitedHandler(std::chrono::milliseconds(50), &router,
+                             [&called](const HTTPRequest& request) {
+                               called = true;
+                               return HTTPResponse::future(200);
+                             },
+                             &evb, &evb, nullptr, nullptr, 4);
+  TestResponseHandler limitedResponseHandler(&limitedHandler);
+  limitedHandler.setResponseHandler(&limitedResponseHandler);
+  requestMessage->getHeaders().set("Content-Length", "8");
+  requestMessage->getHeaders().set("Expect", "100-continue");
+
+  limitedHandler.onRequest(std::move(requestMessage));
+  limitedHandler.onBody(body->clone());
+  limitedHandler.onEOM();
+  evb.loop();
+
+  ASSERT_FALSE(called);
+  ASSERT_EQ(1, limitedResponseHandler.messages.size());
+  ASSERT_EQ(413, limitedResponseHandler.messages[0].getStatusCode());
+  ASSERT_EQ("close",
+            limitedResponseHandler.messages[0].getHeaders().getSingleOrEmpty(
+                HTTPHeaderCode::HTTP_HEADER_CONNECTION));
+}
+
+TEST_F(HTTPHandlerTest, sends_413_once_the_body_is_too_large) {
+  bool called = false;
+  HTTPHandler limitedHandler(std::chrono::milliseconds(50), &router,
+                             [&called](const HTTPRequest& request) {
+                               called = true;
+                               return HTTPResponse::future(200);
+                             },
+                             &evb, &evb, nullptr, nullptr, 12);
+  TestResponseHandler limitedResponseHandler(&limitedHandler);
+  limitedHandler.setResponseHandler(&limitedResponseHandler);
+
+  limitedHandler.onRequest(std::move(requestMessage));
+  limitedHandler.onBody(body->clone());
+  limitedHandler.onBody(body->clone());
+  limitedHandler.onBody(body->clone());
+  limitedHandler.onEOM();
+  evb.loop();
+
+  ASSERT_FALSE(called);
+  ASSERT_EQ(1, limitedResponseHandler.messages.size());
+  ASSERT_EQ(413, limitedResponseHandler.messages[0].getStatusCode());
+  ASSERT_EQ("close",
+            limitedResponseHandler.messages[0].getHeaders().getSingleOrEmpty(
+                HTTPHeaderCode::HTTP_HEADER_CONNECTION));
+}
+
+TEST_F(HTTPHandlerTest, reads_known_lengths_into_one_buffer) {
+  bool chained = true;
+  std::string capturedBody;
+  handler = [&](const HTTPRequest& request) {
+    chained = request.getBodyAsBytes()->isChained();
+    capturedBody = request.getBodyAsString();
+    return HTTPResponse::future(201);
+  };
+  requestMessage->getHeaders().set("Content-Length", "16");
+
+  httpHandler.onRequest(std::move(requestMessage));
+  httpHandler.onBody(body->clone());
+  httpHandler.onBody(body->clone());
+  httpHandler.onEOM();
+  evb.loop();
+
+  ASSERT_FALSE(chained);
+  ASSERT_EQ("the bodythe body", capturedBody);
+  ASSERT_EQ(1, responseHandler.messages.size());
+  ASSERT_EQ(201, responseHandler.messages[0].getStatusCode());
+}
+
+TEST_F(HTTPHandlerTest, leaves_expect_headers_to_proxygen) {
+  requestMessage->getHeaders().set("Content-Length", "8");
+  requestMessage->getHeaders().set("Expect", "100-continue");
+
+  ASSERT_FALSE(httpHandler.canHandleExpect());
+  httpHandler.onRequest(std::move(requestMessage));
+  httpHandler.onBody(body->clone());
+  httpHandler.onEOM();
+  evb.loop();
+
+  ASSERT_EQ(1, responseHandler.messages.size());
+  ASSERT_EQ(201, responseHandler.messages[0].getStatusCode());
+}
+
 TEST_F(HTTPHandlerTest, sends_500_on_uncaught_exception_in_handler) {
   errorHandler = [&](const HTTPRequest& request) {
     return HTTPResponse::fromString(504, "Body goes here",
@@ -220,6 +318,388 @@ TEST_F(HTTPHandlerTest, returns_503_on_future_timeout) {
   ASSERT_EQ("Timed out!", to_string(responseHandler.bodies[0]));
 }
 
+TEST_F(HTTPHandlerTest, cancels_the_request_when_it_times_out) {
+  const HTTPRequest* handledRequest = nullptr;
+  bool cancelledWhenCalled = true;
+
+  timeoutHandler = [](const HTTPRequest& request) {
+    return HTTPResponse::future(503, "Timed out!");
+  };
+  handler = [&](const HTTPRequest& request) {
+    handledRequest = &request;
+    cancelledWhenCalled = request.isCancelled();
+    this_thread::sleep_for(chrono::milliseconds(60));
+    return HTTPResponse::future(201);
+  };
+
+  httpHandler.onRequest(std::move(requestMessage));
+  httpHandler.onEOM();
+  evb.loop();
+
+  ASSERT_FALSE(cancelledWhenCalled);
+  ASSERT_TRUE(handledRequest->isCancelled());
+  ASSERT_EQ(1, responseHandler.messages.size());
+  ASSERT_EQ(503, responseHandler.messages[0].getStatusCode());
+}
+
+TEST_F(HTTPHandlerTest, returns_503_when_response_completes_after_deadline) {
+  folly::Promise<HTTPResponse> promise;
+  timeoutHandler = [](const HTTPRequest& request) {
+    return HTTPResponse::future(503, "Timed out!");
+  };
+  handler = [&](const HTTPRequest& request) { return promise.getFuture(); };
+
+  httpHandler.onRequest(std::move(requestMessage));
+  httpHandler.onEOM();
+  // Only runs the handler. The request's deadline is still scheduled
+  evb.loopOnce();
+  this_thread::sleep_for(chrono::milliseconds(60));
+  // The response is queued on the evb before the timer's tick is processed,
+  // so it completes after the deadline while the timer is still pending
+  promise.setValue(HTTPResponse(201));
+  evb.loop();
+
+  ASSERT_EQ(1, responseHandler.messages.size());
+  ASSERT_EQ(503, responseHandler.messages[0].getStatusCode());
+  ASSERT_EQ("Timed out!", to_string(responseHandler.bodies[0]));
+}
+
+TEST_F(HTTPHandlerTest, handlers_see_the_request_deadline) {
+  std::chrono::milliseconds remaining(0);
+  handler = [&](const HTTPRequest& request) {
+    remaining = request.getRemainingTime();
+    return HTTPResponse::future(201);
+  };
+
+  httpHandler.onRequest(std::move(requestMessage));
+  httpHandler.onEOM();
+  evb.loop();
+
+  ASSERT_GT(remaining, std::chrono::milliseconds(0));
+  ASSERT_LE(remaining, std::chrono::milliseconds(50));
+  ASSERT_EQ(1, responseHandler.messages.size());
+  ASSERT_EQ(201, responseHandler.messages[0].getStatusCode());
+}
+
+TEST_F(HTTPHandlerTest, disconnects_cancel_running_handlers) {
+  folly::Promise<HTTPResponse> promise;
+  const HTTPRequest* handledRequest = nullptr;
+  handler = [&](const HTTPRequest& request) {
+    handledRequest = &request;
+    return promise.getFuture();
+  };
+  // Deleted by onError() once the response completes
+  auto* runningHandler = new HTTPHandler(
+      std::chrono::milliseconds(1000), &router,
+      [this](const HTTPRequest& request) { return handler(request); }, &evb,
+      &evb);
+  TestResponseHandler runningResponseHandler(runningHandler);
+  runningHandler->setResponseHandler(&runningResponseHandler);
+
+  runningHandler->onRequest(std::move(requestMessage));
+  runningHandler->onEOM();
+  // Only runs the handler. The request's deadline is still scheduled
+  evb.loopOnce();
+  ASSERT_FALSE(handledRequest->isCancelled());
+
+  runningHandler->onError(proxygen::kErrorEOF);
+  ASSERT_TRUE(handledRequest->isCancelled());
+
+  promise.setValue(HTTPResponse(200));
+  evb.loop();
+  ASSERT_EQ(0, runningResponseHandler.messages.size());
+}
+
+/**
+ * Queues the functions it is asked to run until run() is called
+ */
+struct QueueingExecutor : public folly::Executor {
+  vector<folly::Func> queued;
+  void add(folly::Func func) override { queued.push_back(std::move(func)); }
+  void run() {
+    auto funcs = std::move(queued);
+    queued.clear();
+    for (auto& func : funcs) {
+      func();
+    }
+  }
+};
+
+TEST_F(HTTPHandlerTest, disconnects_skip_handlers_that_have_not_started) {
+  QueueingExecutor executor;
+  bool called = false;
+  errorHandler = [](const HTTPRequest& request) {
+    return HTTPResponse::future(500);
+  };
+  handler = [&](const HTTPRequest& request) {
+    called = true;
+    return HTTPResponse::future(200);
+  };
+  // Deleted by onError() once the response completes
+  auto* queuedHandler = new HTTPHandler(
+      std::chrono::milliseconds(1000), &router,
+      [this](const HTTPRequest& request) { return handler(request); }, &evb,
+      &executor);
+  TestResponseHandler queuedResponseHandler(queuedHandler);
+  queuedHandler->setResponseHandler(&queuedResponseHandler);
+
+  queuedHandler->onRequest(std::move(requestMessage));
+  queuedHandler->onEOM();
+  queuedHandler->onError(proxygen::kErrorEOF);
+  executor.run();
+  evb.loop();
+
+  ASSERT_FALSE(called);
+  ASSERT_EQ(0, queuedResponseHandler.messages.size());
+}
+
+/**
+ * Counts the functions it is asked to run, and runs them immediately
+ */
+struct CountingExecutor : public folly::Executor {
+  size_t added = 0;
+  void add(folly::Func func) override {
+    ++added;
+    func();
+  }
+};
+
+TEST_F(HTTPHandlerTest, inline_routes_respond_without_an_executor) {
+  CountingExecutor executor;
+  auto route = make_static_route(
+      "/", {proxygen::HTTPMethod::GET},
+      [](const HTTPRequest& request) {
+        return HTTPResponse::future(201, request.getBodyAsString());
+      },
+      ExecutionMode::Inline);
+  HTTPHandler inlineHandler(
+      std::chrono::milliseconds(50), &router,
+      RouteHandler(route.get(), route_parsing::RouteCaptures()), &evb,
+      &executor);
+  TestResponseHandler inlineResponseHandler(&inlineHandler);
+  inlineHandler.setResponseHandler(&inlineResponseHandler);
+
+  inlineHandler.onRequest(std::move(requestMessage));
+  inlineHandler.onBody(body->clone());
+  inlineHandler.onEOM();
+
+  // Sent before the evb has run
+  ASSERT_EQ(0, executor.added);
+  ASSERT_EQ(1, inlineResponseHandler.messages.size());
+  ASSERT_EQ(201, inlineResponseHandler.messages[0].getStatusCode());
+  ASSERT_EQ("the body", to_string(inlineResponseHandler.bodies[0]));
+}
+
+TEST_F(HTTPHandlerTest, admitted_requests_are_released_when_destroyed) {
+  AdmissionConfig config;
+  config.policy = AdmissionPolicy::ConcurrencyLimit;
+  config.maxConcurrency = 1;
+  AdmissionController admission(config);
+  auto route = make_static_route(
+      "/", {proxygen::HTTPMethod::GET},
+      [](const HTTPRequest& request) { return HTTPResponse::future(200, ""); },
+      ExecutionMode::Inline);
+  ASSERT_TRUE(admission.tryAcquire());
+  {
+    HTTPHandler admittedHandler(
+        std::chrono::milliseconds(50), &router,
+        RouteHandler(route.get(), route_parsing::RouteCaptures()), &evb,
+        &evb, nullptr, &admission);
+    TestResponseHandler admittedResponseHandler(&admittedHandler);
+    admittedHandler.setResponseHandler(&admittedResponseHandler);
+
+    admittedHandler.onRequest(std::move(requestMessage));
+    admittedHandler.onEOM();
+
+    ASSERT_EQ(1, admittedResponseHandler.messages.size());
+    ASSERT_FALSE(admission.tryAcquire());
+  }
+
+  ASSERT_EQ(0, admission.getStats().inFlight);
+  ASSERT_TRUE(admission.tryAcquire());
+}
+
+TEST_F(HTTPHandlerTest, inline_routes_send_500_when_handler_throws) {
+  CountingExecutor executor;
+  errorHandler = [](const HTTPRequest& request) {
+    return HTTPResponse::future(504);
+  };
+  auto route = make_static_route(
+      "/", {proxygen::HTTPMethod::GET},
+      [](const HTTPRequest& request) -> folly::Future<HTTPResponse> {
+        throw std::runtime_error("Broken");
+      },
+      ExecutionMode::Inline);
+  HTTPHandler inlineHandler(
+      std::chrono::milliseconds(50), &router,
+      RouteHandler(route.get(), route_parsing::RouteCaptures()), &evb,
+      &executor);
+  TestResponseHandler inlineResponseHandler(&inlineHandler);
+  inlineHandler.setResponseHandler(&inlineResponseHandler);
+
+  inlineHandler.onRequest(std::move(requestMessage));
+  inlineHandler.onEOM();
+  evb.loop();
+
+  ASSERT_EQ(0, executor.added);
+  ASSERT_EQ(1, inlineResponseHandler.messages.size());
+  ASSERT_EQ(504, inlineResponseHandler.messages[0].getStatusCode());
+}
+
+TEST_F(HTTPHandlerTest, custom_executor_routes_run_on_their_executor) {
+  CountingExecutor ioExecutor;
+  CountingExecutor routeExecutor;
+  auto route = make_static_route("/", {proxygen::HTTPMethod::GET},
+                                 [](const HTTPRequest& request) {
+                                   return HTTPResponse::future(201);
+                                 },
+                                 &routeExecutor);
+  HTTPHandler customHandler(
+      std::chrono::milliseconds(50), &router,
+      RouteHandler(route.get(), route_parsing::RouteCaptures()), &evb,
+      &ioExecutor);
+  TestResponseHandler customResponseHandler(&customHandler);
+  customHandler.setResponseHandler(&customResponseHandler);
+
+  customHandler.onRequest(std::move(requestMessage));
+  customHandler.onEOM();
+  evb.loop();
+
+  ASSERT_EQ(0, ioExecutor.added);
+  ASSERT_EQ(1, routeExecutor.added);
+  ASSERT_EQ(1, customResponseHandler.messages.size());
+  ASSERT_EQ(201, customResponseHandler.messages[0].getStatusCode());
+}
+
+TEST_F(HTTPHandlerTest, pool_routes_run_on_their_pool) {
+  ExecutorPools pools({{"disk", 1, 1}});
+  auto route = make_static_route("/", {proxygen::HTTPMethod::GET},
+                                 [](const HTTPRequest& request) {
+                                   return HTTPResponse::future(201);
+                                 },
+                                 ExecutionPolicy::pool("disk"));
+  HTTPHandler poolHandler(
+      std::chrono::milliseconds(1000), &router,
+      RouteHandler(route.get(), route_parsing::RouteCaptures()), &evb, &evb,
+      &pools);
+  TestResponseHandler poolResponseHandler(&poolHandler);
+  poolHandler.setResponseHandler(&poolResponseHandler);
+
+  poolHandler.onRequest(std::move(requestMessage));
+  poolHandler.onEOM();
+  // The pool has one thread, so once this runs, the handler has finished
+  // and its response has been handed to the evb
+  std::promise<void> drained;
+  while (!pools.get("disk")->tryAdd([&drained]() { drained.set_value(); })) {
+  }
+  drained.get_future().wait();
+  evb.loop();
+
+  ASSERT_EQ(2, pools.get("disk")->getStats().started);
+  ASSERT_EQ(1, poolResponseHandler.messages.size());
+  ASSERT_EQ(201, poolResponseHandler.messages[0].getStatusCode());
+}
+
+TEST_F(HTTPHandlerTest, pool_routes_get_503_when_queue_is_full) {
+  bool called = false;
+  ExecutorPools pools({{"disk", 1, 1}});
+  std::promise<void> release;
+  auto released = release.get_future().share();
+  std::promise<void> running;
+  // Fill the only thread and the only queue slot
+  ASSERT_TRUE(pools.get("disk")->tryAdd([&running, released]() {
+    running.set_value();
+    released.wait();
+  }));
+  running.get_future().wait();
+  ASSERT_TRUE(pools.get("disk")->tryAdd([]() {}));
+
+  timeoutHandler = [](const HTTPRequest& request) {
+    return HTTPResponse::future(503, "Busy");
+  };
+  auto route = make_static_route("/", {proxygen::HTTPMethod::GET},
+                                 [&called](const HTTPRequest& request) {
+                                   called = true;
+                                   return HTTPResponse::future(201);
+                                 },
+                                 ExecutionPolicy::pool("disk"));
+  HTTPHandler poolHandler(
+      std::chrono::milliseconds(1000), &router,
+      RouteHandler(route.get(), route_parsing::RouteCaptures()), &evb, &evb,
+      &pools);
+  TestResponseHandler poolResponseHandler(&poolHandler);
+  poolHandler.setResponseHandler(&poolResponseHandler);
+
+  poolHandler.onRequest(std::move(requestMessage));
+  poolHandler.onEOM();
+  evb.loop();
+  release.set_value();
+
+  ASSERT_FALSE(called);
+  ASSERT_EQ(1, pools.get("disk")->getStats().rejected);
+  ASSERT_EQ(1, poolResponseHandler.messages.size());
+  ASSERT_EQ(503, poolResponseHandler.messages[0].getStatusCode());
+  ASSERT_EQ("Busy", to_string(poolResponseHandler.bodies[0]));
+}
+
+#if FOLLY_HAS_COROUTINES
+TEST_F(HTTPHandlerTest, admitted_coroutines_finish_when_pool_is_full) {
+  ExecutorPools pools({{"disk", 1, 1}});
+  auto respond = []() -> folly::coro::Task<HTTPResponse> {
+    co_await folly::coro::co_reschedule_on_current_executor;
+    co_return HTTPResponse(201);
+  };
+  auto route = make_static_route(
+      "/", {proxygen::HTTPMethod::GET},
+      [&pools, &respond](const HTTPRequest& request) {
+        // Another request takes the only queue slot while this one runs
+        EXPECT_TRUE(pools.get("disk")->tryAdd([]() {}));
+        return respond();
+      },
+      ExecutionPolicy::pool("disk"));
+  HTTPHandler poolHandler(
+      std::chrono::milliseconds(1000), &router,
+      RouteHandler(route.get(), route_parsing::RouteCaptures()), &evb, &evb,
+      &pools);
+  TestResponseHandler poolResponseHandler(&poolHandler);
+  poolHandler.setResponseHandler(&poolResponseHandler);
+
+  poolHandler.onRequest(std::move(requestMessage));
+  poolHandler.onEOM();
+  while (poolResponseHandler.messages.empty()) {
+    evb.loopOnce();
+  }
+
+  ASSERT_EQ(201, poolResponseHandler.messages[0].getStatusCode());
+  ASSERT_EQ(0, pools.get("disk")->getStats().rejected);
+}
+#endif
+
+TEST_F(HTTPHandlerTest, pool_routes_get_500_when_pool_does_not_exist) {
+  ExecutorPools pools({});
+  errorHandler = [](const HTTPRequest& request) {
+    return HTTPResponse::future(500, "No pool");
+  };
+  auto route = make_static_route("/", {proxygen::HTTPMethod::GET},
+                                 [](const HTTPRequest& request) {
+                                   return HTTPResponse::future(201);
+                                 },
+                                 ExecutionPolicy::pool("missing"));
+  HTTPHandler poolHandler(
+      std::chrono::milliseconds(1000), &router,
+      RouteHandler(route.get(), route_parsing::RouteCaptures()), &evb, &evb,
+      &pools);
+  TestResponseHandler poolResponseHandler(&poolHandler);
+  poolHandler.setResponseHandler(&poolResponseHandler);
+
+  poolHandler.onRequest(std::move(requestMessage));
+  poolHandler.onEOM();
+  evb.loop();
+
+  ASSERT_EQ(1, poolResponseHandler.messages.size());
+  ASSERT_EQ(500, poolResponseHandler.messages[0].getStatusCode());
+}
+
 TEST(DISABLED_HTTPHandlerTest, sets_unset_headers) {}
 TEST(DISABLED_HTTPHandlerTest, does_not_set_default_headers_if_already_set) {}
 TEST(DISABLED_HTTPHandlerTest, drives_future_with_correct_evb) {}
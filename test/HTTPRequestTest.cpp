@@ -1,5 +1,10 @@
 #include <gtest/gtest.h>
 
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
 #include <folly/dynamic.h>
 #include <folly/io/IOBuf.h>
 #include <proxygen/lib/http/HTTPCommonHeaders.h>
@@ -46,6 +51,17 @@ TEST(HTTPRequestTest, get_path_doesnt_decode_broken_uri_encoded_paths) {
   ASSERT_EQ("/testing%GGpath%20", request.getPath());
 }
 
+TEST(HTTPRequestTest, uses_provided_method_and_path_without_decoding) {
+  auto message = std::make_unique<HTTPMessage>();
+  message->setMethod(HTTPMethod::GET);
+  message->setURL("/testing%20path");
+  HTTPRequest request(std::move(message), IOBuf::create(0), HTTPMethod::PUT,
+                      std::make_shared<const std::string>("/already decoded"));
+
+  ASSERT_EQ(HTTPMethod::PUT, request.getMethod());
+  ASSERT_EQ("/already decoded", request.getPath());
+}
+
 TEST(HTTPRequestTest, headers_are_returned) {
   auto message = std::make_unique<HTTPMessage>();
   message->getHeaders().set("Location", "/index.php");
@@ -94,6 +110,21 @@ TEST(HTTPRequestTest, body_as_string_traverses_chains) {
   ASSERT_EQ("The first stringThe second string", request.getBodyAsString());
 }
 
+TEST(HTTPRequestTest, arena_uses_the_configured_block_size) {
+  auto message = std::make_unique<HTTPMessage>();
+  message->setURL("/");
+  HTTPRequest request(std::move(message), IOBuf::create(0), 128);
+  const auto& constRequest = request;
+
+  ArenaString scratch{ArenaAllocator<char>(constRequest.getArena())};
+  scratch.append("scratch space for a handler");
+
+  ASSERT_EQ(128, request.getArena().getBlockSize());
+  ASSERT_GT(request.getArena().getBytesUsed(), 0);
+  ASSERT_EQ("scratch space for a handler",
+            std::string(scratch.data(), scratch.size()));
+}
+
 TEST(HTTPRequestTest, json_decoding_throws_on_failure) {
   const char* s1 = "The first string";
   const char* s2 = "The second string";
@@ -120,6 +151,31 @@ TEST(HTTPRequestTest, json_decoding_works) {
   ASSERT_EQ("value", json["key"].asString());
 }
 
+TEST(HTTPRequestTest, body_piece_views_a_single_buffer_in_place) {
+  auto body = IOBuf::create(0);
+  auto tail = IOBuf::copyBuffer(std::string("{\"key\": 1}"));
+  auto data = reinterpret_cast<const char*>(tail->data());
+  body->prependChain(std::move(tail));
+  HTTPRequest request(std::make_unique<HTTPMessage>(), std::move(body));
+
+  auto piece = request.getBodyAsStringPiece();
+  ASSERT_EQ("{\"key\": 1}", piece);
+  ASSERT_EQ(data, piece.data());
+  ASSERT_EQ(0, request.getArena().getBytesUsed());
+}
+
+TEST(HTTPRequestTest, body_piece_coalesces_chains_once) {
+  auto body = IOBuf::copyBuffer(std::string("{\"key\": "));
+  body->prependChain(IOBuf::copyBuffer(std::string("\"value\"}")));
+  HTTPRequest request(std::make_unique<HTTPMessage>(), std::move(body));
+
+  auto piece = request.getBodyAsStringPiece();
+  ASSERT_EQ("{\"key\": \"value\"}", piece);
+  ASSERT_EQ(piece.size(), request.getArena().getBytesUsed());
+  ASSERT_EQ(piece.data(), request.getBodyAsStringPiece().data());
+  ASSERT_EQ(piece.size(), request.getArena().getBytesUsed());
+}
+
 TEST(HTTPRequestTest, returns_body_as_raw_iobuf) {
   const char* s = "Hello, world";
   auto buf = IOBuf::wrapBuffer(s, strlen(s));
@@ -158,6 +214,84 @@ TEST(HTTPRequestTest, skips_badly_encoded_params) {
   ASSERT_FALSE(request2.getQueryParams()["test value"].hasValue());
 }
 
+TEST(HTTPRequestTest, returns_every_value_of_repeated_query_params) {
+  auto message = std::make_unique<HTTPMessage>();
+  message->setURL("/index.php?tag=a&key=value&tag=b+c&tag=d%21");
+  HTTPRequest request(std::move(message), IOBuf::create(0));
+
+  auto values = request.getQueryParams().getQueryParamValues("tag");
+  ASSERT_EQ(3, values.size());
+  ASSERT_EQ("a", values[0]);
+  ASSERT_EQ("b c", values[1]);
+  ASSERT_EQ("d!", values[2]);
+  ASSERT_EQ("a", request.getQueryParams()["tag"].value());
+  ASSERT_EQ(0, request.getQueryParams().getQueryParamValues("tags").size());
+}
+
+TEST(HTTPRequestTest, iterates_over_query_params_in_order) {
+  auto message = std::make_unique<HTTPMessage>();
+  message->setURL("/index.php?b=1&&a&c%20d=%2F&bad=%G1");
+  HTTPRequest request(std::move(message), IOBuf::create(0));
+
+  std::vector<std::pair<std::string, std::string>> params;
+  for (const auto& param : request.getQueryParams()) {
+    params.emplace_back(param.name.str(), param.value.str());
+  }
+  std::vector<std::pair<std::string, std::string>> expected{
+      {"b", "1"}, {"a", ""}, {"c d", "/"}};
+  ASSERT_EQ(expected, params);
+  ASSERT_EQ(3, request.getQueryParams().size());
+}
+
+TEST(HTTPRequestTest, moved_requests_keep_their_query_params) {
+  auto message = std::make_unique<HTTPMessage>();
+  message->setURL("/index.php?a%20b=c&d=e");
+  HTTPRequest request(std::move(message), IOBuf::create(0));
+  ASSERT_EQ("c", request.getQueryParams()["a b"].value());
+
+  HTTPRequest moved(std::move(request));
+  ASSERT_EQ("c", moved.getQueryParams()["a b"].value());
+  ASSERT_EQ("e", moved.getQueryParams()["d"].value());
+}
+
+TEST(HTTPRequestTest, threads_sharing_a_request_coalesce_and_parse_once) {
+  auto message = std::make_unique<HTTPMessage>();
+  message->setURL("/index.php?a=1&b=2");
+  auto body = IOBuf::copyBuffer(std::string("{\"key\": "));
+  body->prependChain(IOBuf::copyBuffer(std::string("\"value\"}")));
+  const HTTPRequest request(std::move(message), std::move(body));
+
+  std::vector<const char*> bodies(4);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < bodies.size(); ++i) {
+    threads.emplace_back([&request, &bodies, i]() {
+      bodies[i] = request.getBodyAsStringPiece().data();
+      ASSERT_EQ("2", request.getQueryParams()["b"].value());
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (auto* data : bodies) {
+    ASSERT_EQ(bodies[0], data);
+  }
+  auto bytesUsed = request.getArena().getBytesUsed();
+  ASSERT_EQ("1", request.getQueryParams()["a"].value());
+  ASSERT_EQ(bodies[0], request.getBodyAsStringPiece().data());
+  ASSERT_EQ(bytesUsed, request.getArena().getBytesUsed());
+}
+
+TEST(HTTPRequestTest, returns_query_param_pieces) {
+  auto message = std::make_unique<HTTPMessage>();
+  message->setURL("/index.php?test%20variable=value%26&key=value");
+  HTTPRequest request(std::move(message), IOBuf::create(0));
+  ASSERT_EQ("value&",
+            request.getQueryParams().getQueryParamPiece("test variable"));
+  ASSERT_EQ("value", request.getQueryParams().getQueryParamPiece("key"));
+  ASSERT_FALSE(request.getQueryParams().getQueryParamPiece("other"));
+}
+
 TEST(HTTPRequestTest, returns_empty_value_when_header_not_set) {
   auto message = std::make_unique<HTTPMessage>();
   HTTPRequest request(std::move(message), IOBuf::create(0));
@@ -187,6 +321,41 @@ TEST(HTTPRequestTest, returns_empty_cookie_when_not_set) {
   ASSERT_FALSE(request.getCookies()["arg1"].hasValue());
 }
 
+TEST(HTTPRequestTest, returns_header_pieces) {
+  auto message = std::make_unique<HTTPMessage>();
+  message->getHeaders().set(HTTPHeaderCode::HTTP_HEADER_LOCATION, "/home");
+  message->getHeaders().set("X-Custom", "value");
+  HTTPRequest request(std::move(message), IOBuf::create(0));
+
+  const auto& headers = request.getHeaders();
+  ASSERT_EQ("/home",
+            headers.getHeaderPiece(HTTPHeaderCode::HTTP_HEADER_LOCATION));
+  ASSERT_EQ("/home", headers.getHeaderPiece("Location"));
+  ASSERT_EQ("value", headers.getHeaderPiece("X-Custom"));
+  ASSERT_FALSE(headers.getHeaderPiece("X-Other"));
+  ASSERT_FALSE(headers.getHeaderPiece(HTTPHeaderCode::HTTP_HEADER_HOST));
+}
+
+TEST(HTTPRequestTest, returns_every_value_of_repeated_headers) {
+  auto message = std::make_unique<HTTPMessage>();
+  message->getHeaders().add("X-Forwarded-For", "10.0.0.1");
+  message->getHeaders().add("X-Forwarded-For", "10.0.0.2");
+  message->getHeaders().add(HTTPHeaderCode::HTTP_HEADER_LOCATION, "/a");
+  HTTPRequest request(std::move(message), IOBuf::create(0));
+
+  const auto& headers = request.getHeaders();
+  auto forwarded = headers.getHeaderValues("X-Forwarded-For");
+  ASSERT_EQ(2, forwarded.size());
+  ASSERT_EQ("10.0.0.1", forwarded[0]);
+  ASSERT_EQ("10.0.0.2", forwarded[1]);
+  ASSERT_FALSE(headers.getHeaderPiece("X-Forwarded-For"));
+  auto location =
+      headers.getHeaderValues(HTTPHeaderCode::HTTP_HEADER_LOCATION);
+  ASSERT_EQ(1, location.size());
+  ASSERT_EQ("/a", location[0]);
+  ASSERT_EQ(0, headers.getHeaderValues("X-Other").size());
+}
+
 TEST(HTTPRequestTest, returns_cookie_when_set) {
   auto message = std::make_unique<HTTPMessage>();
   message->getHeaders().set("Cookie", "key1=value1;key2=value2;");
@@ -194,5 +363,57 @@ TEST(HTTPRequestTest, returns_cookie_when_set) {
   ASSERT_EQ("value1", request.getCookies()["key1"].value());
   ASSERT_EQ("value2", request.getCookies()["key2"].value());
 }
+
+TEST(HTTPRequestTest, returns_cookie_pieces) {
+  auto message = std::make_unique<HTTPMessage>();
+  message->getHeaders().set("Cookie", "key1=value1;key2=value2;");
+  HTTPRequest request(std::move(message), IOBuf::create(0));
+  ASSERT_EQ("value1", request.getCookies().getCookiePiece("key1"));
+  ASSERT_FALSE(request.getCookies().getCookiePiece("key3"));
+}
+
+TEST(HTTPRequestTest, requests_can_be_cancelled) {
+  HTTPRequest request(std::make_unique<HTTPMessage>(), IOBuf::create(0));
+
+  ASSERT_FALSE(request.isCancelled());
+  request.cancel();
+  ASSERT_TRUE(request.isCancelled());
+}
+
+#if NOZOMI_HAS_CANCELLATION_TOKEN
+TEST(HTTPRequestTest, cancellation_is_seen_by_earlier_tokens) {
+  HTTPRequest request(std::make_unique<HTTPMessage>(), IOBuf::create(0));
+  auto token = request.getCancellationToken();
+  bool called = false;
+  folly::CancellationCallback callback(token, [&called]() { called = true; });
+
+  ASSERT_FALSE(request.isCancelled());
+  request.cancel();
+  ASSERT_TRUE(request.isCancelled());
+  ASSERT_TRUE(token.isCancellationRequested());
+  ASSERT_TRUE(called);
+}
+
+TEST(HTTPRequestTest, tokens_taken_after_cancelling_are_cancelled) {
+  HTTPRequest request(std::make_unique<HTTPMessage>(), IOBuf::create(0));
+  request.cancel();
+
+  ASSERT_TRUE(request.getCancellationToken().isCancellationRequested());
+}
+#endif
+
+TEST(HTTPRequestTest, remaining_time_counts_down_to_the_deadline) {
+  HTTPRequest request(std::make_unique<HTTPMessage>(), IOBuf::create(0));
+  ASSERT_EQ(std::chrono::milliseconds::max(), request.getRemainingTime());
+
+  request.setDeadline(std::chrono::steady_clock::now() +
+                      std::chrono::milliseconds(1000));
+  ASSERT_GT(request.getRemainingTime(), std::chrono::milliseconds(900));
+  ASSERT_LE(request.getRemainingTime(), std::chrono::milliseconds(1000));
+
+  request.setDeadline(std::chrono::steady_clock::now() -
+                      std::chrono::milliseconds(10));
+  ASSERT_EQ(std::chrono::milliseconds(0), request.getRemainingTime());
+}
 }
 }
@@ -4,6 +4,8 @@
 #include <unordered_map>
 #include <vector>
 
+#include <folly/Format.h>
+#include <folly/dynamic.h>
 #include <folly/io/IOBuf.h>
 #include <folly/json.h>
 #include <proxygen/lib/http/HTTPCommonHeaders.h>
@@ -45,5 +47,31 @@ TEST(HTTPResponseTest, constructors_and_getters_work) {
                   HTTPHeaderCode::HTTP_HEADER_LOCATION));
   }
 }
+
+TEST(HTTPResponseTest, large_json_bodies_are_written_into_a_chain) {
+  dynamic items = dynamic::array();
+  for (int64_t i = 0; i < 2000; ++i) {
+    dynamic item = dynamic::object();
+    item.insert("id", i);
+    item.insert("name", sformat("item \"{}\"", i));
+    items.push_back(std::move(item));
+  }
+  HTTPResponse response(200, items, {{"Content-Type", "application/json"}});
+
+  ASSERT_TRUE(response.getBody()->isChained());
+  ASSERT_EQ(toJson(items), response.getBodyString());
+}
+
+TEST(HTTPResponseTest, moved_responses_give_up_their_body_and_headers) {
+  auto body = IOBuf::copyBuffer("body");
+  auto data = body->data();
+  HTTPResponse response(200, std::move(body), {{"Location", "/"}});
+
+  ASSERT_NE(data, response.getBody()->data());
+  auto moved = std::move(response).getBody();
+  ASSERT_EQ(data, moved->data());
+  auto message = std::move(response).getHeaders();
+  ASSERT_EQ("/", message.getHeaders().getSingleOrEmpty("Location"));
+}
 }
 }
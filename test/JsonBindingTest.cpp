@@ -0,0 +1,267 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <folly/Optional.h>
+#include <folly/dynamic.h>
+#include <folly/io/IOBuf.h>
+#include <folly/json.h>
+
+#include "src/JsonBinding.h"
+
+using namespace std;
+using folly::IOBuf;
+using folly::Optional;
+using folly::dynamic;
+
+namespace nozomi {
+namespace test {
+
+struct Address {
+  string city;
+  Optional<string> zip;
+};
+NOZOMI_JSON_FIELDS(Address, city, zip)
+
+struct Customer {
+  int64_t id = 0;
+  string name;
+  bool active = false;
+  double balance = 0;
+  uint16_t visits = 0;
+  vector<string> tags;
+  vector<Address> addresses;
+  Optional<int64_t> referrer;
+};
+NOZOMI_JSON_FIELDS(Customer,
+                   id,
+                   name,
+                   active,
+                   balance,
+                   visits,
+                   tags,
+                   addresses,
+                   referrer)
+
+string body_string(const IOBuf& buf) {
+  auto copy = buf.clone();
+  copy->coalesce();
+  return string(reinterpret_cast<const char*>(copy->data()), copy->length());
+}
+
+TEST(JsonBindingTest, reads_nested_structs) {
+  auto customer = from_json<Customer>(R"({
+    "id": 12,
+    "name": "Ada",
+    "active": true,
+    "balance": -3.25e1,
+    "visits": 7,
+    "tags": ["new", "vip"],
+    "addresses": [{"city": "Paris", "zip": "75001"}, {"city": "Lyon"}],
+    "referrer": null
+  })");
+
+  ASSERT_EQ(12, customer.id);
+  ASSERT_EQ("Ada", customer.name);
+  ASSERT_TRUE(customer.active);
+  ASSERT_EQ(-32.5, customer.balance);
+  ASSERT_EQ(7, customer.visits);
+  ASSERT_EQ((vector<string>{"new", "vip"}), customer.tags);
+  ASSERT_EQ(2, customer.addresses.size());
+  ASSERT_EQ("Paris", customer.addresses[0].city);
+  ASSERT_EQ("75001", customer.addresses[0].zip.value());
+  ASSERT_EQ("Lyon", customer.addresses[1].city);
+  ASSERT_FALSE(customer.addresses[1].zip.hasValue());
+  ASSERT_FALSE(customer.referrer.hasValue());
+}
+
+TEST(JsonBindingTest, skips_unknown_fields_and_keeps_missing_ones) {
+  Customer customer;
+  customer.name = "unchanged";
+  read_json(R"({"id": 3, "extra": {"a": [1, "}", {"b": null}]},
+                "more": false})",
+            customer);
+
+  ASSERT_EQ(3, customer.id);
+  ASSERT_EQ("unchanged", customer.name);
+}
+
+TEST(JsonBindingTest, unescapes_strings) {
+  auto address = from_json<Address>(
+      R"({"city": "a\"b\\c\/d\né😀", "zip": "1"})");
+
+  ASSERT_EQ("a\"b\\c/d\n\xc3\xa9\xf0\x9f\x98\x80", address.city);
+  ASSERT_EQ("1", address.zip.value());
+}
+
+TEST(JsonBindingTest, fails_on_malformed_json) {
+  ASSERT_THROW(from_json<Address>(R"({"city": "Paris")"), runtime_error);
+  ASSERT_THROW(from_json<Address>(R"({"city": "Paris",})"), runtime_error);
+  ASSERT_THROW(from_json<Address>(R"({"city" "Paris"})"), runtime_error);
+  ASSERT_THROW(from_json<Address>(R"({"city": "Paris"} x)"), runtime_error);
+  ASSERT_THROW(from_json<Address>("{\"city\": \"a\nb\"}"), runtime_error);
+  ASSERT_THROW(from_json<Address>(R"({"city": "\ud83d"})"), runtime_error);
+  ASSERT_THROW(from_json<Customer>(R"({"tags": ["a" "b"]})"), runtime_error);
+  ASSERT_THROW(from_json<Customer>(R"({"id": 01})"), runtime_error);
+  ASSERT_THROW(from_json<Customer>(string(300, '[')), runtime_error);
+}
+
+TEST(JsonBindingTest, fails_on_mismatched_types) {
+  ASSERT_THROW(from_json<Customer>(R"({"id": "12"})"), runtime_error);
+  ASSERT_THROW(from_json<Customer>(R"({"id": 1.5})"), runtime_error);
+  ASSERT_THROW(from_json<Customer>(R"({"visits": 70000})"), runtime_error);
+  ASSERT_THROW(from_json<Customer>(R"({"visits": -1})"), runtime_error);
+  ASSERT_THROW(from_json<Customer>(R"({"active": 1})"), runtime_error);
+  ASSERT_THROW(from_json<Customer>(R"({"tags": "a"})"), runtime_error);
+  ASSERT_THROW(from_json<Customer>(R"([])"), runtime_error);
+}
+
+TEST(JsonBindingTest, errors_say_where_parsing_failed) {
+  try {
+    from_json<Customer>(R"({"id": true})");
+    FAIL() << "Expected an exception";
+  } catch (const runtime_error& e) {
+    ASSERT_EQ(string("Invalid JSON at offset 7: expected a number"),
+              e.what());
+  }
+}
+
+TEST(JsonBindingTest, writes_structs) {
+  Customer customer;
+  customer.id = -4;
+  customer.name = "quote\" slash\\ tab\t bell\x07 caf\xc3\xa9";
+  customer.active = true;
+  customer.balance = 0.1;
+  customer.visits = 65535;
+  customer.tags = {"a"};
+  customer.addresses.push_back(Address{"Oslo", string("0150")});
+  customer.addresses.push_back(Address{"Bergen", folly::none});
+
+  ASSERT_EQ(
+      R"({"id":-4,"name":"quote\" slash\\ tab\t bell\u0007 caf)"
+      "\xc3\xa9"
+      R"(","active":true,"balance":0.1,"visits":65535,"tags":["a"],)"
+      R"("addresses":[{"city":"Oslo","zip":"0150"},)"
+      R"({"city":"Bergen","zip":null}],"referrer":null})",
+      body_string(*to_json_body(customer)));
+}
+
+TEST(JsonBindingTest, writer_grows_into_a_chain_of_buffers) {
+  JsonWriter writer(16);
+  vector<string> values(100, "0123456789");
+  write_json(writer, values);
+  auto length = writer.length();
+  auto body = writer.release();
+
+  ASSERT_TRUE(body->isChained());
+  ASSERT_EQ(length, body->computeChainDataLength());
+  ASSERT_EQ(values, from_json<vector<string>>(body_string(*body)));
+}
+
+TEST(JsonBindingTest, writer_starts_with_a_small_block) {
+  auto body = to_json_body(Address{"Paris", string("75001")});
+
+  ASSERT_FALSE(body->isChained());
+  ASSERT_LT(body->capacity(), JsonWriter::kBlockSize);
+}
+
+TEST(JsonBindingTest, writer_reuses_freed_blocks) {
+  // Long enough for the chain to grow into one block of kBlockSize
+  auto size = JsonWriter::kBlockSize;
+  auto first = to_json_body(string(size, 'a'));
+  auto data = first->prev()->data();
+  ASSERT_EQ(JsonWriter::kBlockSize, first->prev()->capacity());
+  first.reset();
+
+  auto second = to_json_body(string(size, 'b'));
+  ASSERT_EQ(data, second->prev()->data());
+  ASSERT_EQ('"' + string(size, 'b') + '"', body_string(*second));
+}
+
+TEST(JsonBindingTest, writer_escapes_strings_across_word_boundaries) {
+  for (size_t offset = 0; offset < 9; ++offset) {
+    auto value = string(offset, 'x') + "\"\\\x01" + string(offset, 'y');
+    JsonWriter writer;
+    writer.string(value);
+    ASSERT_EQ('"' + string(offset, 'x') + R"(\"\\\u0001)" +
+                  string(offset, 'y') + '"',
+              body_string(*writer.release()));
+  }
+}
+
+TEST(JsonBindingTest, reader_unescapes_strings_across_word_boundaries) {
+  for (size_t offset = 0; offset < 17; ++offset) {
+    auto city = string(offset, 'x') + R"(\"\\\u0041)" + string(offset, 'y');
+    auto address = from_json<Address>(R"({"city": ")" + city + R"("})");
+    ASSERT_EQ(string(offset, 'x') + "\"\\A" + string(offset, 'y'),
+              address.city);
+    ASSERT_THROW(from_json<Address>(R"({"city": ")" + string(offset, 'x') +
+                                    "\x01\"}"),
+                 runtime_error);
+  }
+}
+
+TEST(JsonBindingTest, reader_skips_long_runs_of_whitespace) {
+  auto compact = R"({"city":"Paris","zip":"75001","nested":[[{"a":1}]]})";
+  auto json = string(13, ' ') + "{\n" + string(16, ' ') +
+      "\"city\": \"Paris\",\n" + string(16, ' ') + "\"zip\" :\t\"75001\",\n" +
+      string(16, ' ') + "\"nested\": [\n" + string(24, ' ') + "[\r\n" +
+      string(32, ' ') + "{\"a\":   1}]]\n" + string(8, ' ') + "} \n\t" +
+      string(9, ' ');
+
+  auto address = from_json<Address>(json);
+  ASSERT_EQ("Paris", address.city);
+  ASSERT_EQ("75001", address.zip.value());
+  ASSERT_EQ(from_json<dynamic>(compact), from_json<dynamic>(json));
+}
+
+TEST(JsonBindingTest, dynamics_are_written_like_to_json) {
+  dynamic value = dynamic::object();
+  value.insert("name", "caf\xc3\xa9 \"quoted\"\n");
+  value.insert("count", 12);
+  value.insert("ratio", 0.25);
+  value.insert("ok", true);
+  value.insert("missing", nullptr);
+  value.insert("list", dynamic::array(1, "two", dynamic::object()));
+
+  ASSERT_EQ(folly::toJson(value), body_string(*to_json_body(value)));
+  ASSERT_EQ(value, from_json<dynamic>(folly::toJson(value)));
+}
+
+TEST(JsonBindingTest, dynamics_with_non_string_keys_are_rejected) {
+  dynamic value = dynamic::object();
+  value.insert(1, "one");
+  ASSERT_THROW(to_json_body(value), runtime_error);
+}
+
+TEST(JsonBindingTest, writer_rejects_numbers_json_cannot_represent) {
+  JsonWriter writer;
+  ASSERT_THROW(writer.number(numeric_limits<double>::infinity()),
+               runtime_error);
+  ASSERT_THROW(writer.number(numeric_limits<double>::quiet_NaN()),
+               runtime_error);
+}
+
+TEST(JsonBindingTest, written_structs_read_back_the_same) {
+  Customer customer;
+  customer.id = numeric_limits<int64_t>::min();
+  customer.name = string("\0\x1f\"\\", 4);
+  customer.balance = 1.0 / 3;
+  customer.referrer = 9;
+  customer.addresses.push_back(Address{"Rome", string("00100")});
+
+  auto copy = from_json<Customer>(body_string(*to_json_body(customer)));
+
+  ASSERT_EQ(customer.id, copy.id);
+  ASSERT_EQ(customer.name, copy.name);
+  ASSERT_EQ(customer.balance, copy.balance);
+  ASSERT_EQ(customer.referrer, copy.referrer);
+  ASSERT_EQ("Rome", copy.addresses.at(0).city);
+  ASSERT_EQ("00100", copy.addresses.at(0).zip.value());
+}
+}
+}
@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <string>
+
+#include "src/RequestArena.h"
+
+using namespace std;
+
+namespace nozomi {
+namespace test {
+
+TEST(RequestArenaTest, allocations_are_aligned_and_do_not_overlap) {
+  RequestArena arena(64);
+
+  auto* a = static_cast<char*>(arena.allocate(3, 1));
+  auto* b = static_cast<char*>(arena.allocate(8, 8));
+  auto* c = static_cast<char*>(arena.allocate(40, 16));
+
+  ASSERT_EQ(0, reinterpret_cast<uintptr_t>(b) % 8);
+  ASSERT_EQ(0, reinterpret_cast<uintptr_t>(c) % 16);
+  ASSERT_TRUE(b >= a + 3);
+  ASSERT_TRUE(c >= b + 8);
+  ASSERT_EQ(51, arena.getBytesUsed());
+}
+
+TEST(RequestArenaTest, large_allocations_get_their_own_block) {
+  RequestArena arena(64);
+  auto* small = static_cast<char*>(arena.allocate(8));
+  auto* large = static_cast<char*>(arena.allocate(1000, 64));
+  auto* next = static_cast<char*>(arena.allocate(8));
+
+  ASSERT_EQ(0, reinterpret_cast<uintptr_t>(large) % 64);
+  // Small allocations keep using the first block
+  ASSERT_EQ(16, next - small);
+  memset(large, 'x', 1000);
+  ASSERT_EQ(1016, arena.getBytesUsed());
+}
+
+TEST(RequestArenaTest, containers_allocate_from_the_arena) {
+  RequestArena arena;
+  ArenaString str{ArenaAllocator<char>(arena)};
+  ArenaVector<int64_t> numbers{ArenaAllocator<int64_t>(arena)};
+
+  str.append("a string that is too long for the small string buffer");
+  for (int64_t i = 0; i < 100; ++i) {
+    numbers.push_back(i);
+  }
+
+  ASSERT_EQ("a string that is too long for the small string buffer",
+            string(str.data(), str.size()));
+  ASSERT_EQ(4950, std::accumulate(numbers.begin(), numbers.end(), 0));
+  ASSERT_GT(arena.getBytesUsed(), 800);
+}
+
+TEST(RequestArenaTest, blocks_are_reused_after_clear) {
+  RequestArena arena(256);
+  auto* first = arena.allocate(16);
+  arena.clear();
+  ASSERT_EQ(0, arena.getBytesUsed());
+
+  RequestArena other(256);
+  ASSERT_EQ(first, other.allocate(16));
+}
+
+TEST(RequestArenaTest, moves_transfer_blocks) {
+  RequestArena arena(256);
+  auto* data = static_cast<char*>(arena.allocate(4));
+  memcpy(data, "abc", 4);
+
+  RequestArena moved(std::move(arena));
+
+  ASSERT_EQ(0, arena.getBytesUsed());
+  ASSERT_EQ(4, moved.getBytesUsed());
+  ASSERT_STREQ("abc", data);
+}
+}
+}
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <folly/Range.h>
+#include <proxygen/lib/http/HTTPMethod.h>
+
+#include "src/RouteCache.h"
+#include "src/RouteParsing.h"
+
+using namespace std;
+using folly::StringPiece;
+using proxygen::HTTPMethod;
+
+namespace nozomi {
+namespace test {
+
+using route_parsing::RouteCaptures;
+
+RouteCache::Entry make_entry(size_t routeId, uint32_t captureOffset = 0) {
+  RouteCaptures captures;
+  captures.push_back(captureOffset, 1);
+  return {reinterpret_cast<BaseRoute*>(routeId), captures, false};
+}
+
+size_t found_route(RouteCache& cache,
+                   HTTPMethod method,
+                   StringPiece path) {
+  const auto* entry = cache.find(method, path);
+  return entry == nullptr ? 0 : reinterpret_cast<size_t>(entry->route);
+}
+
+TEST(RouteCacheTest, finds_entries_by_method_and_path) {
+  RouteCache cache(4);
+  cache.insert(HTTPMethod::GET, "/a", make_entry(1, 3));
+  cache.insert(HTTPMethod::POST, "/a", make_entry(2));
+
+  string path = "/a";
+  const auto* entry = cache.find(HTTPMethod::GET, path);
+  ASSERT_NE(nullptr, entry);
+  ASSERT_EQ(reinterpret_cast<BaseRoute*>(1), entry->route);
+  ASSERT_EQ(1, entry->captures.size());
+  ASSERT_EQ(3, entry->captures[0].offset);
+  ASSERT_EQ(2, found_route(cache, HTTPMethod::POST, "/a"));
+  ASSERT_EQ(0, found_route(cache, HTTPMethod::PUT, "/a"));
+  ASSERT_EQ(0, found_route(cache, HTTPMethod::GET, "/b"));
+  ASSERT_EQ(2, cache.getStats().hits);
+  ASSERT_EQ(2, cache.getStats().misses);
+}
+
+TEST(RouteCacheTest, evicts_least_recently_used_entries) {
+  RouteCache cache(2);
+  cache.insert(HTTPMethod::GET, "/a", make_entry(1));
+  cache.insert(HTTPMethod::GET, "/b", make_entry(2));
+  // Makes /b the least recently used
+  ASSERT_EQ(1, found_route(cache, HTTPMethod::GET, "/a"));
+  cache.insert(HTTPMethod::GET, "/c", make_entry(3));
+
+  ASSERT_EQ(2, cache.size());
+  ASSERT_EQ(1, found_route(cache, HTTPMethod::GET, "/a"));
+  ASSERT_EQ(0, found_route(cache, HTTPMethod::GET, "/b"));
+  ASSERT_EQ(3, found_route(cache, HTTPMethod::GET, "/c"));
+}
+
+TEST(RouteCacheTest, inserting_an_existing_key_replaces_it) {
+  RouteCache cache(2);
+  cache.insert(HTTPMethod::GET, "/a", make_entry(1));
+  cache.insert(HTTPMethod::GET, "/b", make_entry(2));
+  cache.insert(HTTPMethod::GET, "/a", make_entry(3));
+  cache.insert(HTTPMethod::GET, "/c", make_entry(4));
+
+  ASSERT_EQ(3, found_route(cache, HTTPMethod::GET, "/a"));
+  ASSERT_EQ(0, found_route(cache, HTTPMethod::GET, "/b"));
+  ASSERT_EQ(4, found_route(cache, HTTPMethod::GET, "/c"));
+}
+
+TEST(RouteCacheTest, clear_removes_entries_and_keeps_stats) {
+  RouteCache cache(2);
+  cache.insert(HTTPMethod::GET, "/a", make_entry(1));
+  ASSERT_EQ(1, found_route(cache, HTTPMethod::GET, "/a"));
+  cache.clear();
+
+  ASSERT_EQ(0, cache.size());
+  ASSERT_EQ(0, found_route(cache, HTTPMethod::GET, "/a"));
+  ASSERT_EQ(1, cache.getStats().hits);
+  ASSERT_EQ(1, cache.getStats().misses);
+}
+}
+}
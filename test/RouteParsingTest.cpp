@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/regex.hpp>
+#include <folly/Optional.h>
+#include <folly/Range.h>
+
+#include "src/RouteParsing.h"
+
+using namespace std;
+using folly::Optional;
+using folly::StringPiece;
+
+namespace nozomi {
+namespace test {
+
+using route_parsing::RouteParamType;
+using route_parsing::capture_group_names;
+using route_parsing::get_handler_arg;
+using route_parsing::literal_length;
+using route_parsing::literal_prefix_length;
+using route_parsing::parse_pattern_info;
+using route_parsing::parse_route_pattern;
+using route_parsing::pattern_types_match;
+
+string literal_prefix(const string& pattern) {
+  return pattern.substr(
+      0, literal_prefix_length(pattern.data(), pattern.size()));
+}
+
+TEST(RouteParsingTest, capture_group_names_finds_all_capture_groups) {
+  ASSERT_EQ(vector<string>(), capture_group_names("/a/b"));
+  ASSERT_EQ(vector<string>({"", "x", "y", "z"}),
+            capture_group_names(R"(/(a)/(?<x>b)/(?P<y>c)/(?'z'd))"));
+  ASSERT_EQ(vector<string>({""}),
+            capture_group_names(R"(/(?:a)(?=b)(?!c)(?<=d)(?<!e)(?i)(f))"));
+  ASSERT_EQ(vector<string>({""}),
+            capture_group_names(R"(/\(a\)[()][^)(][]()][[:alpha:](](b))"));
+}
+
+TEST(RouteParsingTest, capture_group_names_agrees_with_boost) {
+  vector<string> patterns{
+      R"(/(a|b)/(?<__0>\d+)/(?:x|y))",
+      R"(/[(]+/((a)|(b))*(?<name>c))",
+      R"(/\\(a)/[\]()]/(b))",
+  };
+  for (const auto& pattern : patterns) {
+    boost::basic_regex<char> re(pattern, boost::regex::perl);
+    ASSERT_EQ(re.mark_count(), capture_group_names(pattern).size()) << pattern;
+  }
+}
+
+TEST(RouteParsingTest, parameter_groups_are_resolved_by_index) {
+  auto pattern =
+      parse_route_pattern(R"(/(a|b)/{{i}}/(x)?{{d?:/}}{{s:(\w)\w+}})");
+
+  ASSERT_TRUE(pattern.regex.hasValue());
+  ASSERT_EQ(vector<size_t>({2, 4, 5}), pattern.groups);
+
+  string path = "/a/12/x1.5/testing";
+  boost::smatch matches;
+  ASSERT_TRUE(boost::regex_match(path, matches, pattern.regex.value()));
+  ASSERT_EQ(12, get_handler_arg<int64_t>(matches[pattern.groups[0]]));
+  ASSERT_EQ(Optional<double>(1.5),
+            get_handler_arg<Optional<double>>(matches[pattern.groups[1]]));
+  ASSERT_EQ("testing", get_handler_arg<string>(matches[pattern.groups[2]]));
+}
+
+TEST(RouteParsingTest, unmatched_optional_groups_are_empty) {
+  auto pattern = parse_route_pattern(R"(/{{i?:/}}{{d?:/}}{{s?:\w+:/}}x)");
+  string path = "/x";
+  boost::smatch matches;
+
+  ASSERT_TRUE(boost::regex_match(path, matches, pattern.regex.value()));
+  ASSERT_EQ(Optional<int64_t>(),
+            get_handler_arg<Optional<int64_t>>(matches[pattern.groups[0]]));
+  ASSERT_EQ(Optional<double>(),
+            get_handler_arg<Optional<double>>(matches[pattern.groups[1]]));
+  ASSERT_EQ(Optional<string>(),
+            get_handler_arg<Optional<string>>(matches[pattern.groups[2]]));
+}
+TEST(RouteParsingTest, pattern_info_is_computed_at_compile_time) {
+  static constexpr char pattern[] = R"(/(a|b)/{{i}}/(x)?{{d?:/}}{{s:(\w)\w+}})";
+  constexpr auto info = parse_pattern_info<3>(pattern, literal_length(pattern));
+
+  static_assert(info.paramCount == 3, "");
+  static_assert(info.types[0] == RouteParamType::Int64, "");
+  static_assert(info.types[1] == RouteParamType::OptionalDouble, "");
+  static_assert(info.types[2] == RouteParamType::String, "");
+  static_assert(info.prefixLength == 1, "");
+  static_assert(
+      pattern_types_match<int64_t, Optional<double>, StringPiece>(info), "");
+  static_assert(!pattern_types_match<int64_t, double, string>(info), "");
+  ASSERT_EQ(parse_route_pattern(pattern).groups,
+            vector<size_t>(info.groups, info.groups + 3));
+}
+
+TEST(RouteParsingTest, literal_prefixes_stop_before_regular_expressions) {
+  ASSERT_EQ("/static/file", literal_prefix("/static/file"));
+  ASSERT_EQ("/user/", literal_prefix("/user/{{i}}"));
+  ASSERT_EQ("/user", literal_prefix("/users?/{{i}}"));
+  ASSERT_EQ("/", literal_prefix("/x{2}"));
+  ASSERT_EQ("/file", literal_prefix(R"(/file\.txt)"));
+  ASSERT_EQ("/a/", literal_prefix("/a/.*"));
+  ASSERT_EQ("/", literal_prefix("/(a|b)/x"));
+  ASSERT_EQ("", literal_prefix("/a|/b"));
+  ASSERT_EQ("", literal_prefix("/a{{s:x|y}}|/b"));
+}
+}
+}
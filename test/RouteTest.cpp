@@ -2,16 +2,24 @@
 
 #include <folly/Format.h>
 #include <folly/Optional.h>
+#include <folly/Portability.h>
 #include <proxygen/lib/http/HTTPMethod.h>
 
+#if FOLLY_HAS_COROUTINES
+#include <folly/executors/ManualExecutor.h>
+#endif
+
 #include "src/HTTPRequest.h"
 #include "src/HTTPResponse.h"
+#include "src/JsonBinding.h"
 #include "src/Route.h"
+#include "src/RoutingContext.h"
 #include "test/Common.h"
 
 using namespace std;
 using folly::Future;
 using folly::Optional;
+using folly::StringPiece;
 using folly::sformat;
 using proxygen::HTTPMethod;
 using std::function;
@@ -19,6 +27,12 @@ using std::function;
 namespace nozomi {
 namespace test {
 
+struct NewOrder {
+  string item;
+  int64_t quantity = 0;
+};
+NOZOMI_JSON_FIELDS(NewOrder, item, quantity)
+
 struct TestController {
   static Future<HTTPResponse> noArgHandler(const HTTPRequest& request) {
     return HTTPResponse::future(200, request.getPath());
@@ -193,6 +207,10 @@ TEST(RouteTest, properly_matches_paths) {
       "/testing1236", R"(/{{s?:\w+[0-5]{3}[6-9]?}})",
       make_tuple<Optional<string>>(Optional<string>("testing1236")));
 
+  testRouteMatching("/b/12/x/testing",
+                    R"(/(a|b)/{{i}}/(?:x|y)/{{s:(\w)\w+}})",
+                    make_tuple<int64_t, string>(12, "testing"));
+
   testRouteMatching(
       "/1/-2/1.5/-2.5/testing1235/other/3/3.5/last",
       R"(/{{i}}/{{i?:/}}{{d}}/{{d?:/}}{{s:\w+}}/{{s?:\w+:/}}{{i?:/}}{{d?:/}}{{s?:\w+:/}}{{i}}/{{d}}/{{s:\w+}})",
@@ -204,6 +222,82 @@ TEST(RouteTest, properly_matches_paths) {
           Optional<string>(), 3, 3.5, "last"));
 }
 
+TEST(RouteTest, string_pieces_are_passed_for_string_params) {
+  testRouteMatching("/obj/abc123", "/obj/{{s:[a-f0-9]+}}",
+                    make_tuple<StringPiece>("abc123"));
+  testRouteMatching("/obj/abc123", "/obj/{{s:[^/]+}}",
+                    make_tuple<StringPiece>("abc123"));
+  testRouteMatching("/y/x/", "/{{s?:y+:/}}\\w+/?",
+                    make_tuple<Optional<StringPiece>>(StringPiece("y")));
+  testRouteMatching("/x/", "/{{s?:y+:/}}\\w+/?",
+                    make_tuple<Optional<StringPiece>>(Optional<StringPiece>()));
+}
+
+TEST(RouteTest, string_pieces_point_into_the_request_path) {
+  StringPiece regexArg;
+  StringPiece segmentArg;
+  auto regexRoute = make_route(
+      "/obj/{{s:[a-f0-9]+}}", {HTTPMethod::GET},
+      [&regexArg](const HTTPRequest& request, StringPiece id) {
+        regexArg = id;
+        return HTTPResponse::future(200);
+      });
+  auto segmentRoute = make_route(
+      "/obj/{{s:[^/]+}}", {HTTPMethod::GET},
+      [&segmentArg](const HTTPRequest& request, StringPiece id) {
+        segmentArg = id;
+        return HTTPResponse::future(200);
+      });
+  auto message = std::make_unique<proxygen::HTTPMessage>();
+  message->setMethod(HTTPMethod::GET);
+  message->setURL("/obj/abc123");
+  RoutingContext context(message.get());
+
+  auto regexMatch = regexRoute->handler(context);
+  auto segmentMatch = segmentRoute->handler(context);
+  HTTPRequest request(std::move(message), folly::IOBuf::create(0),
+                      context.getMethod(), context.releasePath());
+  regexMatch.handler(request);
+  segmentMatch.handler(request);
+
+  const auto& path = request.getPath();
+  ASSERT_EQ("abc123", regexArg);
+  ASSERT_EQ("abc123", segmentArg);
+  ASSERT_EQ(path.data() + 5, regexArg.data());
+  ASSERT_EQ(path.data() + 5, segmentArg.data());
+}
+
+TEST(RouteTest, compile_time_patterns_match_paths) {
+  int64_t id = 0;
+  string name;
+  auto route = make_route(
+      NOZOMI_ROUTE_PATTERN(R"(/users?/{{i}}/{{s:\w+}})"), {HTTPMethod::GET},
+      [&id, &name](const HTTPRequest& request, int64_t i, StringPiece s) {
+        id = i;
+        name = s.str();
+        return HTTPResponse::future(200);
+      });
+  auto pointerRoute = make_route(NOZOMI_ROUTE_PATTERN("/{{i}}"),
+                                 {HTTPMethod::GET},
+                                 &TestController::dynamicHandler);
+
+  auto request = make_request("/user/12/testing", HTTPMethod::GET);
+  auto match = route->handler(&request.getRawRequest());
+  ASSERT_EQ(RouteMatchResult::RouteMatched, match.result);
+  match.handler(request);
+  ASSERT_EQ(12, id);
+  ASSERT_EQ("testing", name);
+
+  auto missing = make_request("/group/12/testing", HTTPMethod::GET);
+  ASSERT_EQ(RouteMatchResult::PathNotMatched,
+            route->handler(&missing.getRawRequest()).result);
+
+  auto pointerRequest = make_request("/5", HTTPMethod::GET);
+  auto pointerMatch = pointerRoute->handler(&pointerRequest.getRawRequest());
+  ASSERT_EQ(RouteMatchResult::RouteMatched, pointerMatch.result);
+  ASSERT_EQ("/5 5", pointerMatch.handler(pointerRequest).get().getBodyString());
+}
+
 TEST(RouteTest, overflow_is_handled) {
   int64_t int_result = 0;
   double double_result = 0.0;
@@ -376,5 +470,196 @@ TEST(RouteTest, streaming_handler_returns_nullptr_on_handler_nullptr) {
 
   ASSERT_EQ(nullptr, r->handler(&request.getRawRequest()).streamingHandler());
 }
+TEST(RouteTest, execution_policy_is_set_when_route_is_made) {
+  auto request = make_request("/1", HTTPMethod::GET);
+  auto handler = [](const HTTPRequest&, int64_t) {
+    return HTTPResponse::future(200);
+  };
+
+  auto defaultRoute = make_route("/{{i}}", {HTTPMethod::GET}, handler);
+  auto inlineRoute =
+      make_route("/{{i}}", {HTTPMethod::GET}, handler, ExecutionMode::Inline);
+  auto compiledRoute = make_route(NOZOMI_ROUTE_PATTERN("/{{i}}"),
+                                  {HTTPMethod::GET}, handler,
+                                  ExecutionMode::CPUPool);
+
+  ASSERT_EQ(ExecutionMode::IOExecutor,
+            defaultRoute->handler(&request.getRawRequest())
+                .handler.getExecutionPolicy()
+                .mode);
+  ASSERT_EQ(ExecutionMode::Inline,
+            inlineRoute->handler(&request.getRawRequest())
+                .handler.getExecutionPolicy()
+                .mode);
+  ASSERT_EQ(ExecutionMode::CPUPool,
+            compiledRoute->handler(&request.getRawRequest())
+                .handler.getExecutionPolicy()
+                .mode);
+}
+
+TEST(RouteTest, max_body_size_is_passed_to_matched_handlers) {
+  auto request = make_request("/1", HTTPMethod::GET);
+  auto route = make_route("/{{i}}", {HTTPMethod::GET},
+                          [](const HTTPRequest&, int64_t) {
+                            return HTTPResponse::future(200);
+                          });
+
+  ASSERT_FALSE(
+      route->handler(&request.getRawRequest()).handler.getMaxBodySize());
+  route->setMaxBodySize(1024);
+  ASSERT_EQ(folly::Optional<size_t>(1024),
+            route->handler(&request.getRawRequest()).handler.getMaxBodySize());
+}
+TEST(RouteTest, timeout_is_passed_to_matched_handlers) {
+  auto request = make_request("/1", HTTPMethod::GET);
+  auto route = make_route("/{{i}}", {HTTPMethod::GET},
+                          [](const HTTPRequest&, int64_t) {
+                            return HTTPResponse::future(200);
+                          });
+
+  ASSERT_FALSE(route->handler(&request.getRawRequest()).handler.getTimeout());
+  route->setTimeout(std::chrono::milliseconds(250));
+  ASSERT_EQ(std::chrono::milliseconds(250),
+            route->handler(&request.getRawRequest())
+                .handler.getTimeout()
+                .value());
+}
+
+TEST(RouteTest, json_bodies_are_parsed_into_the_last_argument) {
+  auto route = make_route(
+      "/users/{{i}}/orders", {HTTPMethod::POST},
+      [](const HTTPRequest&, int64_t userId, const NewOrder& order) {
+        return HTTPResponse::future(
+            200, sformat("{} {} {}", userId, order.item, order.quantity));
+      });
+  auto request =
+      make_request("/users/5/orders", HTTPMethod::POST,
+                   folly::IOBuf::copyBuffer(R"({"item":"tea","quantity":3})"));
+
+  auto match = route->handler(&request.getRawRequest());
+  ASSERT_EQ(RouteMatchResult::RouteMatched, match.result);
+  ASSERT_EQ("5 tea 3", match.handler(request).get().getBodyString());
+}
+
+TEST(RouteTest, invalid_json_bodies_are_rejected_without_calling_handler) {
+  bool called = false;
+  auto route = make_route("/orders", {HTTPMethod::POST},
+                          [&called](const HTTPRequest&, const NewOrder&) {
+                            called = true;
+                            return HTTPResponse::future(200);
+                          });
+  auto request = make_request("/orders", HTTPMethod::POST,
+                              folly::IOBuf::copyBuffer(R"({"quantity":"3"})"));
+
+  auto response = route->handler(&request.getRawRequest()).handler(request);
+  ASSERT_EQ(400, response.get().getStatusCode());
+  ASSERT_FALSE(called);
+}
+
+TEST(RouteTest, compile_time_patterns_take_json_bodies) {
+  auto route = make_route(
+      NOZOMI_ROUTE_PATTERN("/users/{{i}}/orders/{{s:[^/]+}}"),
+      {HTTPMethod::PUT},
+      [](const HTTPRequest&, int64_t userId, StringPiece id,
+         const NewOrder& order) {
+        return HTTPResponse::future(
+            200, sformat("{} {} {}", userId, id, order.item));
+      });
+  auto request = make_request("/users/5/orders/a1", HTTPMethod::PUT,
+                              folly::IOBuf::copyBuffer(R"({"item":"tea"})"));
+
+  auto response = route->handler(&request.getRawRequest()).handler(request);
+  ASSERT_EQ("5 a1 tea", response.get().getBodyString());
+}
+
+#if FOLLY_HAS_COROUTINES
+folly::coro::Task<HTTPResponse> coroutineHandler(const HTTPRequest& request,
+                                                 int64_t i) {
+  auto path = co_await folly::makeFuture(request.getPath());
+  co_return HTTPResponse(200, sformat("{} {}", path, i));
+}
+
+TEST(RouteTest, coroutine_handlers_are_called_with_typed_args) {
+  auto request = make_request("/12/abc", HTTPMethod::GET);
+  auto functionRoute =
+      make_route("/{{i}}/abc", {HTTPMethod::GET}, &coroutineHandler);
+  auto lambdaRoute = make_route(
+      NOZOMI_ROUTE_PATTERN("/{{i}}/{{s:[^/]+}}"), {HTTPMethod::GET},
+      [](const HTTPRequest&,
+         int64_t i,
+         StringPiece s) -> folly::coro::Task<HTTPResponse> {
+        co_return HTTPResponse(200, sformat("{} {}", i, s));
+      });
+
+  auto response =
+      functionRoute->handler(&request.getRawRequest()).handler(request);
+  ASSERT_EQ("/12/abc 12", response.get().getBodyString());
+  response = lambdaRoute->handler(&request.getRawRequest()).handler(request);
+  ASSERT_EQ("12 abc", response.get().getBodyString());
+}
+
+TEST(RouteTest, coroutine_handlers_run_on_the_executor_they_are_called_on) {
+  auto request = make_request("/1", HTTPMethod::GET);
+  folly::ManualExecutor executor;
+  auto route = make_route("/{{i}}", {HTTPMethod::GET}, &coroutineHandler);
+
+  auto response =
+      route->handler(&request.getRawRequest()).handler(request, &executor);
+  ASSERT_FALSE(response.isReady());
+  executor.drain();
+  ASSERT_TRUE(response.isReady());
+  ASSERT_EQ("/1 1", response.value().getBodyString());
+}
+
+#if NOZOMI_HAS_CANCELLATION_TOKEN
+TEST(RouteTest, coroutine_handlers_see_the_request_cancellation_token) {
+  auto request = make_request("/1", HTTPMethod::GET);
+  auto route = make_route(
+      "/{{i}}", {HTTPMethod::GET},
+      [](const HTTPRequest&, int64_t) -> folly::coro::Task<HTTPResponse> {
+        const auto& token = co_await folly::coro::co_current_cancellation_token;
+        co_return HTTPResponse(token.isCancellationRequested() ? 499 : 200);
+      });
+
+  auto match = route->handler(&request.getRawRequest());
+  ASSERT_EQ(200, match.handler(request).get().getStatusCode());
+  request.cancel();
+  ASSERT_EQ(499, match.handler(request).get().getStatusCode());
+}
+#endif
+
+TEST(RouteTest, coroutine_handler_exceptions_fail_the_future) {
+  auto request = make_request("/1", HTTPMethod::GET);
+  auto route = make_route(
+      "/{{i}}", {HTTPMethod::GET},
+      [](const HTTPRequest&, int64_t) -> folly::coro::Task<HTTPResponse> {
+        throw std::runtime_error("Handler failed");
+        co_return HTTPResponse(200);
+      });
+
+  auto response = route->handler(&request.getRawRequest()).handler(request);
+  ASSERT_THROW(response.get(), std::runtime_error);
+}
+
+TEST(RouteTest, coroutine_handlers_take_json_bodies) {
+  auto route = make_route(
+      "/users/{{i}}/orders", {HTTPMethod::POST},
+      [](const HTTPRequest& request,
+         int64_t userId,
+         const NewOrder& order) -> folly::coro::Task<HTTPResponse> {
+        auto path = co_await folly::makeFuture(request.getPath());
+        co_return HTTPResponse(200, sformat("{} {} {}", path, userId,
+                                            order.item));
+      });
+  auto request = make_request("/users/5/orders", HTTPMethod::POST,
+                              folly::IOBuf::copyBuffer(R"({"item":"tea"})"));
+  folly::ManualExecutor executor;
+
+  auto response =
+      route->handler(&request.getRawRequest()).handler(request, &executor);
+  executor.drain();
+  ASSERT_EQ("/users/5/orders 5 tea", response.value().getBodyString());
+}
+#endif
 }
 }
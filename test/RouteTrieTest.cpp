@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <folly/Range.h>
+
+#include "src/RouteParsing.h"
+#include "src/RouteTrie.h"
+
+using namespace std;
+using folly::StringPiece;
+
+namespace nozomi {
+namespace test {
+
+using route_parsing::get_capture_arg;
+using route_parsing::parse_route_pattern;
+using route_parsing::split_path;
+
+void insertPattern(RouteTrie& trie, const string& pattern, size_t routeIndex) {
+  auto routePattern = parse_route_pattern(pattern);
+  ASSERT_TRUE(routePattern.segments.hasValue()) << pattern;
+  trie.insert(routePattern.segments.value(), routeIndex);
+}
+
+vector<size_t> matchedRoutes(const RouteTrie& trie, const string& path) {
+  vector<size_t> ret;
+  for (const auto& match : trie.match(path, split_path(path))) {
+    ret.push_back(match.routeIndex);
+  }
+  return ret;
+}
+
+TEST(RouteTrieTest, only_simple_patterns_are_split_into_segments) {
+  ASSERT_TRUE(parse_route_pattern("/").segments.hasValue());
+  ASSERT_TRUE(parse_route_pattern("/user/{{i}}").segments.hasValue());
+  ASSERT_TRUE(parse_route_pattern("/user/{{d}}/x").segments.hasValue());
+  ASSERT_TRUE(parse_route_pattern("/obj/{{s:[^/]+}}/").segments.hasValue());
+  ASSERT_FALSE(parse_route_pattern("/\\d+").segments.hasValue());
+  ASSERT_FALSE(parse_route_pattern("/user{{i}}").segments.hasValue());
+  ASSERT_FALSE(parse_route_pattern("/{{i?:/}}").segments.hasValue());
+  ASSERT_FALSE(parse_route_pattern("/{{s:.*}}").segments.hasValue());
+  ASSERT_FALSE(parse_route_pattern("/file.txt").segments.hasValue());
+
+  ASSERT_FALSE(parse_route_pattern("/user/{{i}}").regex.hasValue());
+  ASSERT_TRUE(parse_route_pattern("/{{s:.*}}").regex.hasValue());
+}
+
+TEST(RouteTrieTest, segment_patterns_return_types) {
+  auto pattern = parse_route_pattern("/{{i}}/x/{{d}}/{{s:[^/]+}}");
+  vector<route_parsing::RouteParamType> expected{
+      route_parsing::RouteParamType::Int64,
+      route_parsing::RouteParamType::Double,
+      route_parsing::RouteParamType::String,
+  };
+  ASSERT_EQ(expected, pattern.types);
+}
+
+TEST(RouteTrieTest, matches_literals_and_parameters) {
+  RouteTrie trie;
+  insertPattern(trie, "/user", 0);
+  insertPattern(trie, "/user/{{i}}", 1);
+  insertPattern(trie, "/user/{{d}}", 2);
+  insertPattern(trie, "/user/{{s:[^/]+}}/posts", 3);
+  insertPattern(trie, "/user/me", 4);
+
+  ASSERT_EQ(vector<size_t>({0}), matchedRoutes(trie, "/user"));
+  ASSERT_EQ(vector<size_t>({1, 2}), matchedRoutes(trie, "/user/-12"));
+  ASSERT_EQ(vector<size_t>({2}), matchedRoutes(trie, "/user/12.5"));
+  ASSERT_EQ(vector<size_t>({3}), matchedRoutes(trie, "/user/12/posts"));
+  ASSERT_EQ(vector<size_t>({4}), matchedRoutes(trie, "/user/me"));
+  ASSERT_EQ(vector<size_t>(), matchedRoutes(trie, "/user/"));
+  ASSERT_EQ(vector<size_t>(), matchedRoutes(trie, "/user/12."));
+  ASSERT_EQ(vector<size_t>(), matchedRoutes(trie, "/user/12/posts/"));
+  ASSERT_EQ(vector<size_t>(), matchedRoutes(trie, "/users"));
+}
+
+TEST(RouteTrieTest, returns_matches_in_registration_order) {
+  RouteTrie trie;
+  insertPattern(trie, "/{{s:[^/]+}}/{{i}}", 0);
+  insertPattern(trie, "/x/{{i}}", 1);
+  insertPattern(trie, "/{{s:[^/]+}}/{{i}}", 2);
+
+  ASSERT_EQ(vector<size_t>({0, 1, 2}), matchedRoutes(trie, "/x/1"));
+  ASSERT_EQ(vector<size_t>({0, 2}), matchedRoutes(trie, "/y/1"));
+}
+
+TEST(RouteTrieTest, returns_captures_in_order) {
+  RouteTrie trie;
+  insertPattern(trie, "/{{i}}/x/{{d}}/{{s:[^/]+}}", 0);
+  auto path = string("/1/x/2.5/testing");
+
+  auto matches = trie.match(path, split_path(path));
+
+  ASSERT_EQ(1, matches.size());
+  vector<StringPiece> captures;
+  for (size_t i = 0; i < matches[0].captures.size(); ++i) {
+    captures.push_back(
+        get_capture_arg<StringPiece>(path, matches[0].captures[i]));
+  }
+  ASSERT_EQ(vector<StringPiece>({"1", "2.5", "testing"}), captures);
+  ASSERT_EQ(path.data() + 1, captures[0].data());
+}
+
+TEST(RouteTrieTest, empty_trie_matches_nothing) {
+  RouteTrie trie;
+  ASSERT_TRUE(trie.empty());
+  ASSERT_EQ(vector<size_t>(), matchedRoutes(trie, "/"));
+  insertPattern(trie, "/", 0);
+  ASSERT_FALSE(trie.empty());
+  ASSERT_EQ(vector<size_t>({0}), matchedRoutes(trie, "/"));
+}
+}
+}
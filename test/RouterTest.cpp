@@ -9,12 +9,16 @@
 #include "src/HTTPResponse.h"
 #include "src/Route.h"
 #include "src/Router.h"
+#include "src/RoutingContext.h"
 #include "src/StaticRoute.h"
+#include "test/AllocationCounter.h"
 
 #include <string>
+#include <thread>
 
 using namespace std;
 using folly::Optional;
+using folly::StringPiece;
 using proxygen::HTTPMethod;
 
 namespace nozomi {
@@ -89,6 +93,114 @@ TEST(RouterTest, returns_route_when_static_405d_but_regex_route_didnt) {
   ASSERT_EQ("202 Message", response.getBodyString());
 }
 
+TEST(RouterTest, static_routes_on_same_path_are_matched_by_method) {
+  vector<unique_ptr<BaseRoute>> routes;
+  routes.push_back(make_static_route(
+      "/1", {HTTPMethod::GET}, [](const HTTPRequest& request) {
+        return HTTPResponse::future(201, "201 Message");
+      }));
+  routes.push_back(make_static_route("/1", {HTTPMethod::POST, HTTPMethod::GET},
+                                     [](const HTTPRequest& request) {
+                                       return HTTPResponse::future(
+                                           202, "202 Message");
+                                     }));
+  Router router({}, std::move(routes));
+  auto request1 = make_request("/1", HTTPMethod::GET);
+  auto request2 = make_request("/1", HTTPMethod::POST);
+  auto request3 = make_request("/1", HTTPMethod::PUT);
+
+  auto handler1 = router.getHandler(&request1.getRawRequest()).handler;
+  auto response1 = handler1(std::move(request1)).get();
+  auto handler2 = router.getHandler(&request2.getRawRequest()).handler;
+  auto response2 = handler2(std::move(request2)).get();
+  auto handler3 = router.getHandler(&request3.getRawRequest()).handler;
+  auto response3 = handler3(std::move(request3)).get();
+
+  ASSERT_EQ(201, response1.getStatusCode());
+  ASSERT_EQ(202, response2.getStatusCode());
+  ASSERT_EQ(405, response3.getStatusCode());
+}
+
+TEST(RouterTest, dynamic_routes_are_checked_in_registration_order) {
+  auto make_routes = [](bool regexFirst) {
+    vector<unique_ptr<BaseRoute>> routes;
+    auto regexRoute = make_route("/\\d+", {HTTPMethod::GET},
+                                 [](const HTTPRequest& request) {
+                                   return HTTPResponse::future(201);
+                                 });
+    auto trieRoute = make_route("/{{i}}", {HTTPMethod::GET, HTTPMethod::POST},
+                                [](const HTTPRequest& request, int64_t) {
+                                  return HTTPResponse::future(202);
+                                });
+    if (regexFirst) {
+      routes.push_back(std::move(regexRoute));
+      routes.push_back(std::move(trieRoute));
+    } else {
+      routes.push_back(std::move(trieRoute));
+      routes.push_back(std::move(regexRoute));
+    }
+    return routes;
+  };
+  Router router1({}, make_routes(true));
+  Router router2({}, make_routes(false));
+  auto request1 = make_request("/1", HTTPMethod::GET);
+  auto request2 = make_request("/1", HTTPMethod::GET);
+  auto request3 = make_request("/1", HTTPMethod::POST);
+
+  auto handler1 = router1.getHandler(&request1.getRawRequest()).handler;
+  auto response1 = handler1(std::move(request1)).get();
+  auto handler2 = router2.getHandler(&request2.getRawRequest()).handler;
+  auto response2 = handler2(std::move(request2)).get();
+  auto handler3 = router1.getHandler(&request3.getRawRequest()).handler;
+  auto response3 = handler3(std::move(request3)).get();
+
+  ASSERT_EQ(201, response1.getStatusCode());
+  ASSERT_EQ(202, response2.getStatusCode());
+  ASSERT_EQ(202, response3.getStatusCode());
+}
+
+TEST(RouterTest, combined_regex_routes_are_checked_in_registration_order) {
+  vector<unique_ptr<BaseRoute>> routes;
+  routes.push_back(make_route("/{{i}}", {HTTPMethod::PUT},
+                              [](const HTTPRequest& request, int64_t) {
+                                return HTTPResponse::future(201);
+                              }));
+  routes.push_back(make_route("/(\\d)\\d*", {HTTPMethod::GET},
+                              [](const HTTPRequest& request) {
+                                return HTTPResponse::future(202);
+                              }));
+  routes.push_back(make_route("/{{s:.+}}", {HTTPMethod::GET, HTTPMethod::POST},
+                              [](const HTTPRequest& request, string value) {
+                                return HTTPResponse::future(203, value);
+                              }));
+  Router router({}, std::move(routes));
+  router.combineRegexRoutes();
+  auto request1 = make_request("/1", HTTPMethod::PUT);
+  auto request2 = make_request("/1", HTTPMethod::GET);
+  auto request3 = make_request("/1", HTTPMethod::POST);
+  auto request4 = make_request("/test", HTTPMethod::GET);
+  auto request5 = make_request("/test", HTTPMethod::DELETE);
+
+  auto handler1 = router.getHandler(&request1.getRawRequest()).handler;
+  auto response1 = handler1(std::move(request1)).get();
+  auto handler2 = router.getHandler(&request2.getRawRequest()).handler;
+  auto response2 = handler2(std::move(request2)).get();
+  auto handler3 = router.getHandler(&request3.getRawRequest()).handler;
+  auto response3 = handler3(std::move(request3)).get();
+  auto handler4 = router.getHandler(&request4.getRawRequest()).handler;
+  auto response4 = handler4(std::move(request4)).get();
+  auto handler5 = router.getHandler(&request5.getRawRequest()).handler;
+  auto response5 = handler5(std::move(request5)).get();
+
+  ASSERT_EQ(201, response1.getStatusCode());
+  ASSERT_EQ(202, response2.getStatusCode());
+  ASSERT_EQ(203, response3.getStatusCode());
+  ASSERT_EQ("1", response3.getBodyString());
+  ASSERT_EQ(203, response4.getStatusCode());
+  ASSERT_EQ("test", response4.getBodyString());
+  ASSERT_EQ(405, response5.getStatusCode());
+}
+
 TEST(RouterTest, returns_custom_error_handler_when_set) {
   vector<unique_ptr<BaseRoute>> routes;
   routes.push_back(make_static_route(
@@ -209,5 +321,160 @@ TEST(RouterTest, make_router_works) {
   ASSERT_EQ(414, response2.getStatusCode());
   ASSERT_EQ("414 Message", response2.getBodyString());
 }
+
+TEST(RouterTest, matching_and_calling_routes_does_not_allocate) {
+  size_t handlerAllocations = 0;
+  auto makeRoutes = [&handlerAllocations]() {
+    auto handler = [&handlerAllocations](const HTTPRequest&, int64_t,
+                                         StringPiece) {
+      handlerAllocations = allocation_count();
+      return HTTPResponse::future(200);
+    };
+    vector<unique_ptr<BaseRoute>> routes;
+    routes.push_back(make_static_route(
+        "/static", {HTTPMethod::GET}, [&handlerAllocations](const auto&) {
+          handlerAllocations = allocation_count();
+          return HTTPResponse::future(200);
+        }));
+    routes.push_back(
+        make_route("/user/{{i}}/{{s:[^/]+}}", {HTTPMethod::GET}, handler));
+    routes.push_back(
+        make_route("/file/{{i}}/{{s:.+}}", {HTTPMethod::GET}, handler));
+    return routes;
+  };
+  Router router({}, makeRoutes());
+  Router combinedRouter({}, makeRoutes());
+  combinedRouter.combineRegexRoutes();
+  Router cachedRouter({}, makeRoutes());
+  cachedRouter.enableMatchCache(8);
+
+  for (const auto* r : {&router, &combinedRouter, &cachedRouter}) {
+    for (string path : {"/static", "/user/1/name", "/file/2/a/b.txt"}) {
+      auto request = make_request(path, HTTPMethod::GET);
+      // The first request sets up each thread's scratch space and path
+      // buffers
+      r->getHandler(&request.getRawRequest()).handler(request);
+
+      auto before = allocation_count();
+      RoutingContext context(&request.getRawRequest());
+      auto match = r->getHandler(context);
+      ASSERT_EQ(before, allocation_count()) << path;
+      match.handler(request);
+      ASSERT_EQ(before, handlerAllocations) << path;
+    }
+  }
+}
+
+TEST(RouterTest, match_cache_returns_the_same_route_and_arguments) {
+  vector<int64_t> ids;
+  vector<string> names;
+  vector<unique_ptr<BaseRoute>> routes;
+  routes.push_back(make_route(
+      "/user/{{i}}/{{s:.+}}", {HTTPMethod::GET},
+      [&ids, &names](const HTTPRequest&, int64_t id, StringPiece name) {
+        ids.push_back(id);
+        names.push_back(name.str());
+        return HTTPResponse::future(200);
+      }));
+  Router router({}, std::move(routes));
+  router.enableMatchCache(2);
+
+  for (string path : {"/user/1/a/b", "/user/1/a/b", "/user/2/c", "/user/1/a/b",
+                      "/missing", "/missing"}) {
+    auto request = make_request(path, HTTPMethod::GET);
+    auto match = router.getHandler(&request.getRawRequest());
+    match.handler(request);
+  }
+  auto request = make_request("/user/1/a/b", HTTPMethod::POST);
+  ASSERT_EQ(RouteMatchResult::MethodNotMatched,
+            router.getHandler(&request.getRawRequest()).result);
+
+  ASSERT_EQ(vector<int64_t>({1, 1, 2, 1}), ids);
+  ASSERT_EQ(vector<string>({"a/b", "a/b", "c", "a/b"}), names);
+  // 404s and 405s are looked up, but never cached
+  ASSERT_EQ(2, router.getMatchCacheStats().hits);
+  ASSERT_EQ(5, router.getMatchCacheStats().misses);
+}
+
+TEST(RouterTest, match_cache_is_invalidated_when_router_is_replaced) {
+  auto makeRouter = [](int statusCode) {
+    vector<unique_ptr<BaseRoute>> routes;
+    routes.push_back(make_route("/user/{{i}}", {HTTPMethod::GET},
+                                [statusCode](const HTTPRequest&, int64_t) {
+                                  return HTTPResponse::future(statusCode);
+                                }));
+    Router router({}, std::move(routes));
+    router.enableMatchCache(8);
+    return router;
+  };
+  auto request = make_request("/user/1", HTTPMethod::GET);
+
+  Optional<Router> router = makeRouter(201);
+  router->getHandler(&request.getRawRequest());
+  ASSERT_EQ(201, router->getHandler(&request.getRawRequest())
+                     .handler(request)
+                     .get()
+                     .getStatusCode());
+  ASSERT_EQ(1, router->getMatchCacheStats().hits);
+
+  router = makeRouter(202);
+  ASSERT_EQ(0, router->getMatchCacheStats().hits);
+  ASSERT_EQ(202, router->getHandler(&request.getRawRequest())
+                     .handler(request)
+                     .get()
+                     .getStatusCode());
+  ASSERT_EQ(0, router->getMatchCacheStats().hits);
+  ASSERT_EQ(1, router->getMatchCacheStats().misses);
+}
+
+TEST(RouterTest, match_cache_stats_count_every_thread) {
+  vector<unique_ptr<BaseRoute>> routes;
+  routes.push_back(make_route("/user/{{i}}", {HTTPMethod::GET},
+                              [](const HTTPRequest&, int64_t) {
+                                return HTTPResponse::future(200);
+                              }));
+  Router router({}, std::move(routes));
+  router.enableMatchCache(8);
+
+  auto route = [&router]() {
+    auto request = make_request("/user/1", HTTPMethod::GET);
+    router.getHandler(&request.getRawRequest());
+    router.getHandler(&request.getRawRequest());
+  };
+  std::thread first(route);
+  first.join();
+  std::thread second(route);
+  second.join();
+
+  // This thread never routed, and the threads that did are gone
+  ASSERT_EQ(2, router.getMatchCacheStats().hits);
+  ASSERT_EQ(2, router.getMatchCacheStats().misses);
+}
+
+TEST(RouterTest, routers_on_one_thread_keep_their_own_match_caches) {
+  auto makeRouter = []() {
+    vector<unique_ptr<BaseRoute>> routes;
+    routes.push_back(make_route("/user/{{i}}", {HTTPMethod::GET},
+                                [](const HTTPRequest&, int64_t) {
+                                  return HTTPResponse::future(200);
+                                }));
+    Router router({}, std::move(routes));
+    router.enableMatchCache(8);
+    return router;
+  };
+  auto first = makeRouter();
+  auto second = makeRouter();
+  auto request = make_request("/user/1", HTTPMethod::GET);
+
+  for (int i = 0; i < 3; ++i) {
+    first.getHandler(&request.getRawRequest());
+    second.getHandler(&request.getRawRequest());
+  }
+
+  ASSERT_EQ(2, first.getMatchCacheStats().hits);
+  ASSERT_EQ(1, first.getMatchCacheStats().misses);
+  ASSERT_EQ(2, second.getMatchCacheStats().hits);
+  ASSERT_EQ(1, second.getMatchCacheStats().misses);
+}
 }
 }
@@ -2,6 +2,7 @@
 
 #include <folly/Format.h>
 #include <folly/Optional.h>
+#include <folly/Portability.h>
 #include <proxygen/lib/http/HTTPMethod.h>
 
 #include "src/HTTPRequest.h"
@@ -161,5 +162,18 @@ TEST(StaticRouteTest, streaming_handler_returns_nullptr_on_handler_nullptr) {
 
   ASSERT_EQ(nullptr, r->handler(&request.getRawRequest()).streamingHandler());
 }
+#if FOLLY_HAS_COROUTINES
+TEST(StaticRouteTest, coroutine_handlers_work) {
+  auto request = make_request("/testing", HTTPMethod::GET);
+  auto r = make_static_route(
+      "/testing", {HTTPMethod::GET},
+      [](const HTTPRequest& request) -> folly::coro::Task<HTTPResponse> {
+        co_return HTTPResponse(200, request.getPath());
+      });
+
+  auto response = r->handler(&request.getRawRequest()).handler(request);
+  ASSERT_EQ("/testing", response.get().getBodyString());
+}
+#endif
 }
 }
@@ -116,5 +116,26 @@ TEST_F(StreamingHTTPHandlerTest, sendBody_does_not_send_empty_body) {
   ASSERT_EQ("first part", to_string(responseHandler.bodies[0]));
   ASSERT_EQ("test body", to_string(responseHandler.bodies[1]));
 }
+TEST_F(StreamingHTTPHandlerTest, responses_without_length_are_chunked) {
+  HTTPResponse response(200, "first part");
+  httpHandler.onRequest(std::move(requestMessage));
+  httpHandler.sendResponseHeaders(std::move(response));
+  evb.loop();
+
+  ASSERT_EQ(1, responseHandler.messages.size());
+  ASSERT_TRUE(responseHandler.messages[0].getIsChunked());
+}
+
+TEST_F(StreamingHTTPHandlerTest, responses_with_length_are_not_chunked) {
+  HTTPResponse response(200, string("first part"), {{"Content-Length", "19"}});
+  httpHandler.onRequest(std::move(requestMessage));
+  httpHandler.sendResponseHeaders(std::move(response));
+  httpHandler.sendBody(IOBuf::copyBuffer("test body"));
+  evb.loop();
+
+  ASSERT_EQ(1, responseHandler.messages.size());
+  ASSERT_FALSE(responseHandler.messages[0].getIsChunked());
+  ASSERT_EQ(2, responseHandler.bodies.size());
+}
 }
 }